@@ -25,6 +25,7 @@ limitations under the License.
 #include "oneflow/api/cpp/framework/tensor.h"
 #include "oneflow/api/common/job_build_and_infer_ctx.h"
 #include "oneflow/api/python/job_build/job_build_and_infer.h"
+#include "oneflow/core/common/container_util.h"
 #include "oneflow/core/common/data_type.pb.h"
 #include "oneflow/core/common/global.h"
 #include "oneflow/core/common/hash_container.h"
@@ -54,6 +55,7 @@ limitations under the License.
 #include "oneflow/core/job/session.h"
 #include "oneflow/core/operator/interface_blob_conf.pb.h"
 #include "oneflow/core/operator/op_conf.pb.h"
+#include "oneflow/core/persistence/checkpoint_container.h"
 #include "oneflow/core/register/logical_blob_id.pb.h"
 #include "oneflow/core/vm/vm_util.h"
 
@@ -108,6 +110,21 @@ Shape OfShapeToOfApiShape(const of::Shape& of_shape) {
   return Shape(dims);
 }
 
+// The graph compiled for one batch size, batch_size is 0 for the input shapes saved in the model
+struct CompiledGraph {
+  explicit CompiledGraph(int64_t batch_size) : batch_size(batch_size) {}
+
+  int64_t batch_size;
+  std::shared_ptr<of::NNGraph> graph;
+  // smaller batches are copied into these before run, in the order of the inputs
+  std::vector<std::shared_ptr<of::one::Tensor>> padded_inputs;
+  of::HashMap<std::string, std::shared_ptr<of::one::Tensor>> output_name_to_tensor;
+  std::shared_ptr<of::one::TensorTuple> output_tensor_tuple;
+  // whether the first axis of each output of output_tensor_tuple is the batch axis
+  std::vector<bool> batch_major_outputs;
+  std::shared_ptr<of::one::TensorTuple> parameter_tensor_tuple;
+};
+
 }  // namespace
 
 class Graph::GraphImpl final {
@@ -125,35 +142,46 @@ class Graph::GraphImpl final {
   InputOutputInfos GetInputInfos();
   InputOutputInfos GetOutputInfos();
   std::vector<Tensor> Forward(const std::vector<Tensor>& inputs);
-  void set_batch_size(int batch_size) { batch_size_ = batch_size; }
+  void set_batch_size(int batch_size) { set_batch_size_buckets({batch_size}); }
+  void set_batch_size_buckets(const std::vector<int>& batch_sizes);
+  of::Maybe<void> CompileBatchSizeBuckets();
 
   of::Maybe<void> RegisterJobPass(
       const std::function<std::string(const std::string& job)>& pass_fn);
 
  private:
   of::Maybe<void> CollectInputOutputInfos();
-  of::Maybe<void> Compile(const std::vector<Tensor>& inputs);
-  of::Maybe<std::vector<Tensor>> Run(const std::vector<Tensor>& inputs) const;
-  of::Maybe<void> AddOp(of::OperatorConf op_conf);
-  of::Maybe<void> BuildGraph();
+  of::Maybe<int64_t> GetBatchSize(const std::vector<Tensor>& inputs) const;
+  int64_t SelectBatchSizeBucket(int64_t batch_size) const;
+  bool IsBatchMajorOutput(const std::string& name, const of::Shape& shape,
+                          int64_t batch_size) const;
+  of::Maybe<const CompiledGraph*> GetOrCompile(int64_t batch_size,
+                                               const std::vector<Tensor>& inputs);
+  of::Maybe<void> Compile(CompiledGraph* compiled, const std::vector<Tensor>& inputs);
+  of::Maybe<std::vector<Tensor>> Run(const CompiledGraph& compiled,
+                                     const std::vector<Tensor>& inputs, int64_t batch_size) const;
+  of::Maybe<std::vector<Tensor>> RunInChunks(const std::vector<Tensor>& inputs,
+                                             int64_t batch_size);
+  of::Maybe<void> AddOp(of::OperatorConf op_conf, int64_t batch_size);
+  of::Maybe<void> BuildGraph(CompiledGraph* compiled);
   of::Maybe<void> LoadCheckpoint();
-  of::Maybe<void> RegisterTensors(const std::vector<Tensor>& inputs);
+  of::Maybe<void> RegisterTensors(CompiledGraph* compiled,
+                                  const std::vector<std::shared_ptr<of::one::Tensor>>& inputs);
   of::Maybe<of::Job> ApplyJobPasses(const of::Job& job);
 
-  std::shared_ptr<of::NNGraph> graph_ = nullptr;
   std::string model_path_;
-  bool is_compiled_ = false;
-  int batch_size_ = 0;
   Device device_;
   of::Job job_;
 
   InputOutputInfos input_infos_;
   InputOutputInfos output_infos_;
-  of::HashMap<std::string, std::shared_ptr<of::one::Tensor>> output_name_to_tensor_;
+  // shared by the graphs of all batch sizes
   of::HashMap<std::string, std::shared_ptr<of::one::Tensor>> variable_op_name_to_tensor_;
-  std::shared_ptr<of::one::TensorTuple> output_tensor_tuple_;
-  std::shared_ptr<of::one::TensorTuple> parameter_tensor_tuple_;
   std::vector<std::function<std::string(const std::string&)>> registered_job_passes_;
+  // sorted, empty to run with the input shapes saved in the model
+  std::vector<int64_t> batch_size_buckets_;
+  // at most one graph per bucket, larger batches are split into chunks of the largest bucket
+  std::map<int64_t, std::unique_ptr<CompiledGraph>> compiled_graphs_;
 };
 
 Graph::Graph(const std::string& model_path, const Device& device)
@@ -201,6 +229,12 @@ IValue Graph::Forward(const IValue& inputs) {
 
 void Graph::set_batch_size(int batch_size) { graph_->set_batch_size(batch_size); }
 
+void Graph::set_batch_size_buckets(const std::vector<int>& batch_sizes) {
+  graph_->set_batch_size_buckets(batch_sizes);
+}
+
+void Graph::CompileBatchSizeBuckets() { CHECK_JUST(graph_->CompileBatchSizeBuckets()); }
+
 Graph Graph::Load(const std::string& model_path, const Device& device) {
   Graph graph(model_path, device);
   return graph;
@@ -245,7 +279,7 @@ of::Maybe<void> Graph::GraphImpl::CollectInputOutputInfos() {
 
 of::Maybe<void> Graph::GraphImpl::RegisterJobPass(
     const std::function<std::string(const std::string& job)>& pass_fn) {
-  if (is_compiled_) {
+  if (!compiled_graphs_.empty()) {
     return of::Error::RuntimeError() << "job pass should be registered before compile and forward";
   }
   registered_job_passes_.emplace_back(pass_fn);
@@ -265,59 +299,220 @@ of::Maybe<of::Job> Graph::GraphImpl::ApplyJobPasses(const of::Job& job) {
   return current_job;
 }
 
+void Graph::GraphImpl::set_batch_size_buckets(const std::vector<int>& batch_sizes) {
+  std::vector<int64_t> buckets;
+  for (int batch_size : batch_sizes) {
+    CHECK_GT(batch_size, 0) << "batch size should be positive";
+    buckets.emplace_back(batch_size);
+  }
+  std::sort(buckets.begin(), buckets.end());
+  buckets.erase(std::unique(buckets.begin(), buckets.end()), buckets.end());
+  batch_size_buckets_.swap(buckets);
+}
+
+of::Maybe<void> Graph::GraphImpl::CompileBatchSizeBuckets() {
+  CHECK_OR_RETURN(!batch_size_buckets_.empty()) << "no batch size bucket is set";
+  for (int64_t batch_size : batch_size_buckets_) { JUST(GetOrCompile(batch_size, {})); }
+  return of::Maybe<void>::Ok();
+}
+
 std::vector<Tensor> Graph::GraphImpl::Forward(const std::vector<Tensor>& inputs) {
-  if (!is_compiled_) {
-    static std::mutex mtx;
-    std::lock_guard<std::mutex> lock(mtx);
-    Compile(inputs).GetOrThrow();
-    is_compiled_ = true;
+  const int64_t batch_size = GetBatchSize(inputs).GetOrThrow();
+  if (!batch_size_buckets_.empty() && batch_size > batch_size_buckets_.back()) {
+    return RunInChunks(inputs, batch_size).GetOrThrow();
   }
-  return Run(inputs).GetOrThrow();
+  const CompiledGraph* compiled =
+      GetOrCompile(SelectBatchSizeBucket(batch_size), inputs).GetOrThrow();
+  return Run(*compiled, inputs, batch_size).GetOrThrow();
 }
 
-of::Maybe<void> Graph::GraphImpl::Compile(const std::vector<Tensor>& inputs) {
-  JUST(BuildGraph());
-  JUST(RegisterTensors(inputs));
-  JUST(graph_->CompileAndInitRuntime());
+of::Maybe<int64_t> Graph::GraphImpl::GetBatchSize(const std::vector<Tensor>& inputs) const {
+  if (batch_size_buckets_.empty()) { return 0; }
+  CHECK_OR_RETURN(!inputs.empty()) << "batch size buckets need a graph with inputs";
+  const int64_t batch_size =
+      inputs.at(0).tensor_->shape()->NumAxes() > 0 ? inputs.at(0).tensor_->shape()->At(0) : 0;
+  for (const auto& input : inputs) {
+    const auto& shape = input.tensor_->shape();
+    CHECK_GT_OR_RETURN(shape->NumAxes(), 0) << "the inputs should have a batch axis";
+    CHECK_EQ_OR_RETURN(shape->At(0), batch_size) << "the inputs should have the same batch size";
+  }
+  CHECK_GT_OR_RETURN(batch_size, 0) << "batch size should be positive";
+  return batch_size;
+}
+
+int64_t Graph::GraphImpl::SelectBatchSizeBucket(int64_t batch_size) const {
+  // without buckets the graph runs with the input shapes saved in the model
+  if (batch_size_buckets_.empty()) { return 0; }
+  const auto it =
+      std::lower_bound(batch_size_buckets_.cbegin(), batch_size_buckets_.cend(), batch_size);
+  CHECK(it != batch_size_buckets_.cend()) << "batch size " << batch_size << " exceeds all buckets";
+  return *it;
+}
+
+// An output is batch-major if its first axis follows the batch size: it is the batch size of the
+// graph, and was the batch size of the inputs in the model as saved.
+bool Graph::GraphImpl::IsBatchMajorOutput(const std::string& name, const of::Shape& shape,
+                                          int64_t batch_size) const {
+  if (batch_size == 0 || shape.NumAxes() == 0 || shape.At(0) != batch_size) { return false; }
+  const Shape& saved_shape = output_infos_.at(name).input_output_shape_;
+  if (saved_shape.NumAxes() == 0) { return false; }
+  for (const auto& input_info : input_infos_) {
+    const Shape& saved_input_shape = input_info.second.input_output_shape_;
+    if (saved_input_shape.NumAxes() > 0) { return saved_shape.At(0) == saved_input_shape.At(0); }
+  }
+  return false;
+}
+
+of::Maybe<const CompiledGraph*> Graph::GraphImpl::GetOrCompile(int64_t batch_size,
+                                                               const std::vector<Tensor>& inputs) {
+  static std::mutex mtx;
+  std::lock_guard<std::mutex> lock(mtx);
+  const auto it = compiled_graphs_.find(batch_size);
+  if (it != compiled_graphs_.end()) { return it->second.get(); }
+  auto compiled = std::make_unique<CompiledGraph>(batch_size);
+  JUST(Compile(compiled.get(), inputs));
+  const CompiledGraph* ptr = compiled.get();
+  compiled_graphs_.emplace(batch_size, std::move(compiled));
+  return ptr;
+}
+
+of::Maybe<void> Graph::GraphImpl::Compile(CompiledGraph* compiled,
+                                          const std::vector<Tensor>& inputs) {
+  JUST(BuildGraph(compiled));
+  std::vector<std::shared_ptr<of::one::Tensor>> input_tensors = compiled->padded_inputs;
+  if (compiled->batch_size == 0) {
+    for (const auto& input : inputs) { input_tensors.emplace_back(input.tensor_); }
+  }
+  JUST(RegisterTensors(compiled, input_tensors));
+  JUST(compiled->graph->CompileAndInitRuntime());
   return of::Maybe<void>::Ok();
 }
 
-of::Maybe<std::vector<Tensor>> Graph::GraphImpl::Run(const std::vector<Tensor>& inputs) const {
+of::Maybe<std::vector<Tensor>> Graph::GraphImpl::Run(const CompiledGraph& compiled,
+                                                     const std::vector<Tensor>& inputs,
+                                                     int64_t batch_size) const {
+  const bool is_padded = batch_size < compiled.batch_size;
   const auto input_tensor_tuple = std::make_shared<of::one::TensorTuple>();
-  for (const auto& tensor : inputs) { input_tensor_tuple->emplace_back(tensor.tensor_); }
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    const auto& tensor = inputs.at(i).tensor_;
+    if (!is_padded) {
+      input_tensor_tuple->emplace_back(tensor);
+      continue;
+    }
+    // the rows after batch_size are left as they are, their outputs are narrowed away
+    const auto& padded_input = JUST(of::VectorAt(compiled.padded_inputs, i));
+    const of::Shape& shape = *padded_input->shape();
+    std::vector<int64_t> start(shape.NumAxes(), 0);
+    std::vector<int64_t> stop(shape.dim_vec().begin(), shape.dim_vec().end());
+    std::vector<int64_t> step(shape.NumAxes(), 1);
+    stop[0] = batch_size;
+    JUST(of::one::functional::SliceUpdate(padded_input, tensor, start, stop, step,
+                                          /*inplace=*/true));
+    input_tensor_tuple->emplace_back(padded_input);
+  }
+
+  JUST(of::RunLazyNNGraph(*input_tensor_tuple, *compiled.output_tensor_tuple,
+                          *compiled.parameter_tensor_tuple, compiled.graph));
+  JUST(of::SoftSyncNNGraphBuffers(*compiled.output_tensor_tuple, compiled.graph));
 
-  JUST(of::RunLazyNNGraph(*input_tensor_tuple, *output_tensor_tuple_, *parameter_tensor_tuple_,
-                          graph_));
-  JUST(of::SoftSyncNNGraphBuffers(*output_tensor_tuple_, graph_));
+  std::vector<Tensor> outputs;
+  for (size_t i = 0; i < compiled.output_tensor_tuple->size(); ++i) {
+    const auto& tensor = compiled.output_tensor_tuple->at(i);
+    if (is_padded && compiled.batch_major_outputs.at(i)) {
+      outputs.emplace_back(Tensor(JUST(of::one::functional::Narrow(tensor, 0, 0, batch_size))));
+    } else {
+      outputs.emplace_back(Tensor(tensor));
+    }
+  }
+  return outputs;
+}
 
+// Runs a batch larger than the largest bucket as chunks of that bucket, the rest on the smallest
+// bucket that holds it, and concatenates the batch-major outputs. The other outputs can not be
+// split over the chunks.
+of::Maybe<std::vector<Tensor>> Graph::GraphImpl::RunInChunks(const std::vector<Tensor>& inputs,
+                                                             int64_t batch_size) {
+  const int64_t chunk_size = batch_size_buckets_.back();
+  const CompiledGraph* compiled = JUST(GetOrCompile(chunk_size, inputs));
+  std::vector<of::one::TensorTuple> output_chunks(compiled->output_tensor_tuple->size());
+  for (int64_t begin = 0; begin < batch_size; begin += chunk_size) {
+    const int64_t size = std::min(chunk_size, batch_size - begin);
+    if (size < chunk_size) { compiled = JUST(GetOrCompile(SelectBatchSizeBucket(size), inputs)); }
+    std::vector<Tensor> chunk_inputs;
+    for (const auto& input : inputs) {
+      const of::Shape& shape = *input.tensor_->shape();
+      std::vector<int64_t> start(shape.NumAxes(), 0);
+      std::vector<int64_t> stop(shape.dim_vec().begin(), shape.dim_vec().end());
+      std::vector<int64_t> step(shape.NumAxes(), 1);
+      start[0] = begin;
+      stop[0] = begin + size;
+      chunk_inputs.emplace_back(Tensor(JUST(of::one::functional::Slice(
+          input.tensor_, start, stop, step, /*enable_view_slice=*/false))));
+    }
+    const auto& chunk_outputs = JUST(Run(*compiled, chunk_inputs, size));
+    for (size_t i = 0; i < chunk_outputs->size(); ++i) {
+      CHECK_OR_RETURN(compiled->batch_major_outputs.at(i))
+          << of::Error::RuntimeError() << "the batch of size " << batch_size
+          << " is larger than all the buckets, but output " << i
+          << " is not batch-major and can not be computed in chunks";
+      // the outputs alias the buffers of the graph, which the next chunk overwrites
+      const auto& output = chunk_outputs->at(i).tensor_;
+      const of::Shape& shape = *output->shape();
+      std::vector<int64_t> start(shape.NumAxes(), 0);
+      std::vector<int64_t> stop(shape.dim_vec().begin(), shape.dim_vec().end());
+      std::vector<int64_t> step(shape.NumAxes(), 1);
+      output_chunks.at(i).emplace_back(JUST(of::one::functional::Slice(
+          output, start, stop, step, /*enable_view_slice=*/false)));
+    }
+  }
   std::vector<Tensor> outputs;
-  for (const auto& tensor : *output_tensor_tuple_) { outputs.emplace_back(Tensor(tensor)); }
+  for (const auto& chunks : output_chunks) {
+    outputs.emplace_back(Tensor(JUST(of::one::functional::Concat(chunks, 0))));
+  }
   return outputs;
 }
 
-of::Maybe<void> Graph::GraphImpl::AddOp(of::OperatorConf op_conf) {
+of::Maybe<void> Graph::GraphImpl::AddOp(of::OperatorConf op_conf, int64_t batch_size) {
   {
     const std::shared_ptr<of::Scope> scope = JUST(of::GetCurrentScope());
     op_conf.set_scope_symbol_id(scope->symbol_id().value_or(0));
   }
   op_conf.set_device_tag(GetDeviceTag(device_));
-  if (batch_size_ > 0 && op_conf.has_input_conf()) {
+  if (batch_size > 0 && op_conf.has_input_conf()) {
     op_conf.mutable_input_conf()->mutable_blob_conf()->mutable_shape()->mutable_dim()->Set(
-        0, batch_size_);
+        0, batch_size);
   }
   auto* ctx = JUST(of::GetCurInferCtx());
   JUST(ctx->AddAndInferConsistentOp(op_conf));
   return of::Maybe<void>::Ok();
 }
 
-of::Maybe<void> Graph::GraphImpl::BuildGraph() {
-  CompileScope build_graph_scope(job_.job_conf(), *device_.device_->shared_from_symbol());
+of::Maybe<void> Graph::GraphImpl::BuildGraph(CompiledGraph* compiled) {
+  const int64_t batch_size = compiled->batch_size;
+  // every batch size builds a job of its own, the variables are created and loaded by the first
+  const bool is_first_build = compiled_graphs_.empty();
+  of::JobConfigProto job_conf = job_.job_conf();
+  if (batch_size > 0) {
+    job_conf.set_job_name(job_conf.job_name() + "_batch_size_" + std::to_string(batch_size));
+    compiled->padded_inputs.resize(input_infos_.size());
+  }
+  CompileScope build_graph_scope(job_conf, *device_.device_->shared_from_symbol());
   {
     const of::OpGraph op_graph(job_);
     op_graph.TopoForEachNode([&](const of::OpNode* node) -> of::Maybe<void> {
       const of::OperatorConf& op_conf = node->op().op_conf();
-      JUST(AddOp(op_conf));
-      if (op_conf.has_variable_conf()) {
+      JUST(AddOp(op_conf, batch_size));
+      if (op_conf.has_input_conf() && batch_size > 0) {
+        const of::LazyMode::Guard lazy_mode_disabled_guard{false};
+        of::InterfaceBlobConf blob_conf = op_conf.input_conf().blob_conf();
+        blob_conf.mutable_shape()->set_dim(0, batch_size);
+        const size_t index = input_infos_.at(op_conf.name()).input_output_index_;
+        compiled->padded_inputs[index] = JUST(of::one::functional::Empty(
+            of::Shape(blob_conf.shape()),
+            JUST(of::DType::Get(static_cast<of::DataType>(blob_conf.data_type()))),
+            *device_.device_, /*pin_memory=*/false));
+      }
+      if (op_conf.has_variable_conf() && is_first_build) {
         const of::LazyMode::Guard lazy_mode_disabled_guard{false};
         const of::VariableOpConf& variable_conf = op_conf.variable_conf();
         variable_op_name_to_tensor_[op_conf.name()] = JUST(of::one::functional::Empty(
@@ -328,7 +523,12 @@ of::Maybe<void> Graph::GraphImpl::BuildGraph() {
       return of::Maybe<void>::Ok();
     });
   }
-  JUST(LoadCheckpoint());
+  if (is_first_build) {
+    JUST(LoadCheckpoint());
+  } else {
+    const auto& pair = Unzip(variable_op_name_to_tensor_);
+    JUST(of::FillVariableTensorMgr(pair.first, pair.second));
+  }
   JUST(of::CurJobBuildAndInferCtx_Complete());
   std::shared_ptr<of::Job> complete_job = JUST(of::GetCurrentJob());
   int64_t job_id = JUST(of::JobBuildAndInferCtx_GetCurrentJobId());
@@ -336,8 +536,8 @@ of::Maybe<void> Graph::GraphImpl::BuildGraph() {
 
   // apply custom job passes
   complete_job = JUST(ApplyJobPasses(*complete_job));
-  graph_ = std::make_shared<of::NNGraph>(job_.job_conf().job_name(), *complete_job, job_id,
-                                         of::Global<OneFlowEnv>::Get()->GetSessionCtx());
+  compiled->graph = std::make_shared<of::NNGraph>(job_conf.job_name(), *complete_job, job_id,
+                                                  of::Global<OneFlowEnv>::Get()->GetSessionCtx());
   {
     const of::OpGraph complete_graph(*complete_job);
     complete_graph.TopoForEachNode([&](const of::OpNode* node) -> of::Maybe<void> {
@@ -345,13 +545,13 @@ of::Maybe<void> Graph::GraphImpl::BuildGraph() {
       const of::OperatorConf& op_conf = node->op().op_conf();
       if (op_conf.has_output_conf()) {
         of::InterfaceBlobConf blob_conf = op_conf.output_conf().blob_conf();
-        if (batch_size_ > 0) {
+        if (batch_size > 0) {
           const std::string input_lbi_str = op_conf.output_conf().in();
           const of::LogicalBlobId input_lbi = of::GenLogicalBlobId(input_lbi_str);
-          int64_t batch_size = node->LogicalBlobDesc4Lbi(input_lbi).shape().At(0);
-          blob_conf.mutable_shape()->set_dim(0, batch_size);
+          int64_t output_batch_size = node->LogicalBlobDesc4Lbi(input_lbi).shape().At(0);
+          blob_conf.mutable_shape()->set_dim(0, output_batch_size);
         }
-        output_name_to_tensor_[op_conf.name()] = JUST(of::one::functional::Empty(
+        compiled->output_name_to_tensor[op_conf.name()] = JUST(of::one::functional::Empty(
             of::Shape(blob_conf.shape()),
             JUST(of::DType::Get(static_cast<of::DataType>(blob_conf.data_type()))),
             *device_.device_, /*pin_memory=*/false));
@@ -363,6 +563,29 @@ of::Maybe<void> Graph::GraphImpl::BuildGraph() {
 }
 
 of::Maybe<void> Graph::GraphImpl::LoadCheckpoint() {
+  const std::string container_path = model_path_ + "/" + of::kCheckpointContainerFileName;
+  if (of::CheckpointContainerExists(container_path)) {
+    // Copies straight from the mapped container into the variables
+    const auto& container = JUST(of::CheckpointContainer::Open(container_path));
+    for (const auto& variable_op_name_and_tensor : variable_op_name_to_tensor_) {
+      const auto& variable_op_name = variable_op_name_and_tensor.first;
+      const auto& variable_tensor = variable_op_name_and_tensor.second;
+      const of::CheckpointContainer::Tensor* saved = container->Find(variable_op_name);
+      CHECK_NOTNULL_OR_RETURN(saved) << "variable " << variable_op_name << " is not found in "
+                                     << container_path;
+      CHECK_OR_RETURN(saved->shape == *variable_tensor->shape())
+          << "shape mismatch of variable " << variable_op_name;
+      CHECK_EQ_OR_RETURN(saved->data_type, variable_tensor->dtype()->data_type())
+          << "data type mismatch of variable " << variable_op_name;
+      const auto& callback = [&](uint64_t of_blob_ptr) {
+        CHECK_JUST(of::BlobBufferCopyUtil<void>::From(of_blob_ptr, saved->data, saved->size));
+      };
+      JUST(of::one::SyncAccessTensorWithTimeOut(variable_tensor, callback, "mut"));
+    }
+    const auto& pair = Unzip(variable_op_name_to_tensor_);
+    JUST(of::FillVariableTensorMgr(pair.first, pair.second));
+    return of::Maybe<void>::Ok();
+  }
   for (const auto& variable_op_name_and_tensor : variable_op_name_to_tensor_) {
     const auto& variable_op_name = variable_op_name_and_tensor.first;
     const auto& variable_tensor = variable_op_name_and_tensor.second;
@@ -387,30 +610,35 @@ of::Maybe<void> Graph::GraphImpl::LoadCheckpoint() {
   return of::Maybe<void>::Ok();
 }
 
-of::Maybe<void> Graph::GraphImpl::RegisterTensors(const std::vector<Tensor>& inputs) {
+of::Maybe<void> Graph::GraphImpl::RegisterTensors(
+    CompiledGraph* compiled, const std::vector<std::shared_ptr<of::one::Tensor>>& inputs) {
   {
     std::vector<std::string> input_op_names(inputs.size());
     std::vector<std::shared_ptr<of::one::Tensor>> input_tensors(inputs.size());
     for (const auto& input_info : input_infos_) {
       size_t index = input_info.second.input_output_index_;
       input_op_names[index] = input_info.first;
-      input_tensors[index] = inputs.at(index).tensor_;
+      input_tensors[index] = inputs.at(index);
     }
-    JUST(graph_->RegisterInputOpNamesAndTensors(input_op_names, input_tensors));
+    JUST(compiled->graph->RegisterInputOpNamesAndTensors(input_op_names, input_tensors));
   }
   {
-    const auto& pair = Unzip(output_name_to_tensor_);
+    const auto& pair = Unzip(compiled->output_name_to_tensor);
     const std::vector<std::string>& output_op_names = pair.first;
     const std::vector<std::shared_ptr<of::one::Tensor>>& output_tensors = pair.second;
-    JUST(graph_->RegisterOutputOpNamesAndTensors(output_op_names, output_tensors));
-    output_tensor_tuple_ = ConvertToTensorTuple(output_tensors);
+    JUST(compiled->graph->RegisterOutputOpNamesAndTensors(output_op_names, output_tensors));
+    compiled->output_tensor_tuple = ConvertToTensorTuple(output_tensors);
+    for (size_t i = 0; i < output_op_names.size(); ++i) {
+      compiled->batch_major_outputs.push_back(IsBatchMajorOutput(
+          output_op_names.at(i), *output_tensors.at(i)->shape(), compiled->batch_size));
+    }
   }
   {
     const auto& t = of::DumpVariableTensorMgr();
     const std::vector<std::string>& variable_op_names = std::get<0>(t);
     const std::vector<std::shared_ptr<of::one::Tensor>>& variable_tensors = std::get<1>(t);
-    JUST(graph_->RegisterVariableOpNamesAndTensors(variable_op_names, variable_tensors));
-    parameter_tensor_tuple_ = ConvertToTensorTuple(variable_tensors);
+    JUST(compiled->graph->RegisterVariableOpNamesAndTensors(variable_op_names, variable_tensors));
+    compiled->parameter_tensor_tuple = ConvertToTensorTuple(variable_tensors);
   }
   return of::Maybe<void>::Ok();
 }
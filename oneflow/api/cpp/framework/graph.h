@@ -26,6 +26,7 @@ limitations under the License.
 #include <string>
 #include <functional>
 #include <unordered_map>
+#include <vector>
 
 namespace oneflow {
 
@@ -64,6 +65,14 @@ class Graph {
   InputOutputInfos GetOutputInfos();
   IValue Forward(const IValue& inputs);
   void set_batch_size(int batch_size);
+  // Treats the first axis of every input as the batch axis. A batch is padded to the smallest
+  // of batch_sizes not less than it and the batch-major outputs, whose first axis follows the
+  // batch size, are narrowed back. A batch larger than all of them runs in chunks of the largest
+  // and its batch-major outputs are concatenated, it fails if there are other outputs. A graph
+  // is compiled per bucket on its first Forward, the compiled graphs share the parameters.
+  void set_batch_size_buckets(const std::vector<int>& batch_sizes);
+  // Compiles the graphs of all the batch size buckets now instead of on their first Forward.
+  void CompileBatchSizeBuckets();
 
   void RegisterJobPass(const std::function<std::string(const std::string& job)>& pass_fn);
 
@@ -92,6 +92,22 @@ TEST(Api, graph_cpu_batching_test) {
   Forward(graph, device, 10);
 }
 
+TEST(Api, graph_cpu_batch_size_buckets_test) {
+  EnvScope scope;
+  Device device("cpu");
+  Graph graph = LoadGraph(device);
+  graph.set_batch_size_buckets({8, 4});
+  graph.CompileBatchSizeBuckets();
+  Forward(graph, device, 3);
+  Forward(graph, device, 8);
+  Forward(graph, device, 5);
+  Forward(graph, device, 10);
+  Forward(graph, device, 3);
+  // larger than all the buckets, runs as chunks of 8
+  Forward(graph, device, 20);
+  Forward(graph, device, 16);
+}
+
 #ifdef WITH_CUDA
 TEST(Api, graph_gpu_batching_test) {
   EnvScope scope;
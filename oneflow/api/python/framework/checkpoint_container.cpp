@@ -0,0 +1,94 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+#include "oneflow/api/python/of_api_registry.h"
+#include "oneflow/core/persistence/checkpoint_container.h"
+#include "oneflow/extension/python/numpy.h"
+
+namespace py = pybind11;
+
+namespace oneflow {
+
+namespace {
+
+Maybe<void> SaveCheckpointContainer(const std::string& path,
+                                    const std::vector<std::string>& names,
+                                    const std::vector<py::object>& arrays, int64_t num_shards) {
+  CHECK_EQ_OR_RETURN(names.size(), arrays.size())
+      << "The number of names is not equal with the number of arrays.";
+  std::vector<CheckpointTensor> tensors;
+  tensors.reserve(arrays.size());
+  for (size_t i = 0; i < arrays.size(); ++i) {
+    PyObject* obj = arrays.at(i).ptr();
+    if (!PyArray_Check(obj)) {
+      return Error::TypeError() << "expected np.ndarray, but got " << Py_TYPE(obj)->tp_name;
+    }
+    auto* array = reinterpret_cast<PyArrayObject*>(obj);
+    CHECK_OR_RETURN(PyArray_IS_C_CONTIGUOUS(array))
+        << "the array of " << names.at(i) << " is not contiguous";
+    const npy_intp* dims_ptr = PyArray_SHAPE(array);
+    tensors.emplace_back(CheckpointTensor{
+        names.at(i), JUST(numpy::GetOFDataTypeFromNpArray(array)),
+        Shape(DimVector(dims_ptr, dims_ptr + PyArray_NDIM(array))), PyArray_DATA(array)});
+  }
+  // The arrays are kept alive by the caller, only their data is read from here on.
+  py::gil_scoped_release release;
+  return WriteCheckpointContainer(path, tensors, num_shards);
+}
+
+// Returns the tensors of the container as arrays that view the mapped files. Each array holds a
+// reference to the container, so the mapping lives until the last array, and any tensor sharing
+// its memory, is gone.
+Maybe<py::dict> LoadCheckpointContainer(const std::string& path) {
+  const std::shared_ptr<CheckpointContainer> container = JUST(CheckpointContainer::Open(path));
+  py::dict arrays;
+  for (const CheckpointContainer::Tensor& tensor : container->tensors()) {
+    const auto& dim_vec = tensor.shape.dim_vec();
+    std::vector<npy_intp> dims(dim_vec.begin(), dim_vec.end());
+    PyObject* array = PyArray_New(&PyArray_Type, static_cast<int>(dims.size()), dims.data(),
+                                  JUST(numpy::OFDataTypeToNumpyType(tensor.data_type)), nullptr,
+                                  tensor.data, 0, NPY_ARRAY_CARRAY, nullptr);
+    if (array == nullptr) { throw py::error_already_set(); }
+    auto* holder = new std::shared_ptr<CheckpointContainer>(container);
+    PyObject* base = PyCapsule_New(holder, nullptr, [](PyObject* capsule) {
+      delete static_cast<std::shared_ptr<CheckpointContainer>*>(
+          PyCapsule_GetPointer(capsule, nullptr));
+    });
+    if (base == nullptr) {
+      delete holder;
+      Py_DECREF(array);
+      throw py::error_already_set();
+    }
+    // steals the reference to base, also on failure
+    if (PyArray_SetBaseObject(reinterpret_cast<PyArrayObject*>(array), base) != 0) {
+      Py_DECREF(array);
+      throw py::error_already_set();
+    }
+    arrays[py::str(tensor.name)] = py::reinterpret_steal<py::object>(array);
+  }
+  return arrays;
+}
+
+}  // namespace
+
+ONEFLOW_API_PYBIND11_MODULE("", m) {
+  m.def("SaveCheckpointContainer", &SaveCheckpointContainer);
+  m.def("LoadCheckpointContainer", &LoadCheckpointContainer);
+  m.def("CheckpointContainerExists", &CheckpointContainerExists);
+}
+
+}  // namespace oneflow
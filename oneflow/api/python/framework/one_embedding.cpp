@@ -38,31 +38,39 @@ class OneEmbeddingHandler final {
   }
 
   void LoadSnapshot(const std::string& snapshot_name) {
-#ifdef WITH_CUDA
     Global<embedding::EmbeddingManager>::Get()->LoadSnapshot(embedding_name_, local_rank_id_,
                                                              rank_id_, snapshot_name);
-#else
-    UNIMPLEMENTED() << "Only Support with CUDA";
-#endif
   }
 
   void SaveSnapshot(const std::string& snapshot_name) {
-#ifdef WITH_CUDA
     Global<embedding::EmbeddingManager>::Get()->SaveSnapshot(embedding_name_, local_rank_id_,
                                                              rank_id_, snapshot_name);
-#else
-    UNIMPLEMENTED() << "Only Support with CUDA";
-#endif
+  }
+
+  void SaveDeltaSnapshot(const std::string& snapshot_name, const std::string& base_snapshot_name) {
+    Global<embedding::EmbeddingManager>::Get()->SaveDeltaSnapshot(
+        embedding_name_, local_rank_id_, rank_id_, snapshot_name, base_snapshot_name);
+  }
+
+  void MergeSnapshot(const std::string& snapshot_name, const std::string& merged_snapshot_name) {
+    Global<embedding::EmbeddingManager>::Get()->MergeSnapshot(
+        embedding_name_, local_rank_id_, rank_id_, snapshot_name, merged_snapshot_name);
+  }
+
+  void Prefetch(const py::array& keys) {
+    embedding::KeyValueStore* store =
+        Global<embedding::EmbeddingManager>::Get()->GetKeyValueStore(embedding_name_, rank_id_);
+    CHECK_EQ(static_cast<size_t>(keys.itemsize()), store->KeySize())
+        << "the ids to prefetch must be of the key type";
+    CHECK(keys.flags() & py::array::c_style) << "the ids to prefetch must be contiguous";
+    Global<embedding::EmbeddingManager>::Get()->Prefetch(embedding_name_, local_rank_id_, rank_id_,
+                                                         keys.size(), keys.data());
   }
 
  private:
   void CreateKeyValueStore(const embedding::KeyValueStoreOptions& key_value_store_options) {
-#ifdef WITH_CUDA
     Global<embedding::EmbeddingManager>::Get()->CreateKeyValueStore(
         key_value_store_options, local_rank_id_, rank_id_, world_size_);
-#else
-    UNIMPLEMENTED() << "Only Support with CUDA";
-#endif
   }
 
   std::string embedding_name_;
@@ -320,6 +328,9 @@ ONEFLOW_API_PYBIND11_MODULE("", m) {
                                                      rank_id, world_size);
       }))
       .def("SaveSnapshot", &OneEmbeddingHandler::SaveSnapshot)
+      .def("SaveDeltaSnapshot", &OneEmbeddingHandler::SaveDeltaSnapshot)
+      .def("MergeSnapshot", &OneEmbeddingHandler::MergeSnapshot)
+      .def("Prefetch", &OneEmbeddingHandler::Prefetch)
       .def("LoadSnapshot", &OneEmbeddingHandler::LoadSnapshot);
 
   py::class_<embedding::PersistentTableWriter, std::shared_ptr<embedding::PersistentTableWriter>>(
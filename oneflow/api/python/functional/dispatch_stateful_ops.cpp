@@ -52,6 +52,8 @@ ONEFLOW_FUNCTION_LIBRARY(m) {
       [](const std::shared_ptr<OpExpr>& op, const std::string& data_dir, int32_t data_part_num,
          const std::string& part_name_prefix, int32_t part_name_suffix_length, int32_t batch_size,
          int32_t shuffle_buffer_size, bool random_shuffle, bool shuffle_after_epoch, int64_t seed,
+         int32_t num_reader_threads, int32_t prefetch_buffer_size, bool indexed,
+         int64_t start_sample_offset,
          const Optional<Symbol<Device>>& device) -> Maybe<Tensor> {
         MutableAttrMap attrs;
         JUST(attrs.SetAttr("data_dir", data_dir));
@@ -63,6 +65,10 @@ ONEFLOW_FUNCTION_LIBRARY(m) {
         JUST(attrs.SetAttr("random_shuffle", random_shuffle));
         JUST(attrs.SetAttr("shuffle_after_epoch", shuffle_after_epoch));
         JUST(attrs.SetAttr("seed", seed));
+        JUST(attrs.SetAttr("num_reader_threads", num_reader_threads));
+        JUST(attrs.SetAttr("prefetch_buffer_size", prefetch_buffer_size));
+        JUST(attrs.SetAttr("indexed", indexed));
+        JUST(attrs.SetAttr("start_sample_offset", start_sample_offset));
         return OpInterpUtil::Dispatch<Tensor>(*op, {}, OpExprInterpContext(attrs, JUST(device)));
       });
   m.add_functor(
@@ -70,6 +76,8 @@ ONEFLOW_FUNCTION_LIBRARY(m) {
       [](const std::shared_ptr<OpExpr>& op, const std::string& data_dir, int32_t data_part_num,
          const std::string& part_name_prefix, int32_t part_name_suffix_length, int32_t batch_size,
          int32_t shuffle_buffer_size, bool random_shuffle, bool shuffle_after_epoch, int64_t seed,
+         int32_t num_reader_threads, int32_t prefetch_buffer_size, bool indexed,
+         int64_t start_sample_offset,
          const Symbol<ParallelDesc>& placement,
          const std::vector<Symbol<SbpParallel>>& sbp_tuple) -> Maybe<Tensor> {
         MutableAttrMap attrs;
@@ -82,6 +90,10 @@ ONEFLOW_FUNCTION_LIBRARY(m) {
         JUST(attrs.SetAttr("random_shuffle", random_shuffle));
         JUST(attrs.SetAttr("shuffle_after_epoch", shuffle_after_epoch));
         JUST(attrs.SetAttr("seed", seed));
+        JUST(attrs.SetAttr("num_reader_threads", num_reader_threads));
+        JUST(attrs.SetAttr("prefetch_buffer_size", prefetch_buffer_size));
+        JUST(attrs.SetAttr("indexed", indexed));
+        JUST(attrs.SetAttr("start_sample_offset", start_sample_offset));
         JUST(attrs.SetAttr("nd_sbp", *JUST(GetNdSbpStrList(sbp_tuple))));
         auto nd_sbp = JUST(GetNdSbp(sbp_tuple));
         return OpInterpUtil::Dispatch<Tensor>(*op, {},
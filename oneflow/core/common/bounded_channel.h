@@ -0,0 +1,308 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_COMMON_BOUNDED_CHANNEL_H_
+#define ONEFLOW_CORE_COMMON_BOUNDED_CHANNEL_H_
+
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/common/channel.h"
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+namespace oneflow {
+
+enum class ChannelWaitStrategy {
+  // Parks on a condition variable right away, like Channel.
+  kPark = 0,
+  // Spins for a while before parking. The spin limit adapts to how often spinning succeeds, so a
+  // channel that is mostly idle stops burning cpu.
+  kSpinThenPark,
+};
+
+namespace detail {
+
+constexpr size_t kCacheLineSize = 64;
+
+inline size_t RoundUpToPowerOfTwo(size_t n) {
+  size_t power = 1;
+  while (power < n) { power <<= 1; }
+  return power;
+}
+
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(_M_X64)
+  _mm_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield" ::: "memory");
+#else
+  std::this_thread::yield();
+#endif
+}
+
+class ChannelWaiter final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ChannelWaiter);
+  explicit ChannelWaiter(ChannelWaitStrategy strategy)
+      : strategy_(strategy), spin_limit_(kMaxSpinLimit), num_parked_(0) {}
+  ~ChannelWaiter() = default;
+
+  // Returns once ready() holds. ready() must only read state that is changed before Notify().
+  template<typename ReadyT>
+  void Wait(const ReadyT& ready) {
+    if (ready()) { return; }
+    if (strategy_ == ChannelWaitStrategy::kSpinThenPark) {
+      const int32_t spin_limit = spin_limit_.load(std::memory_order_relaxed);
+      for (int32_t i = 0; i < spin_limit; ++i) {
+        if (i < spin_limit / 2) {
+          CpuRelax();
+        } else {
+          std::this_thread::yield();
+        }
+        if (ready()) {
+          if (spin_limit < kMaxSpinLimit) {
+            spin_limit_.store(std::min(spin_limit * 2, kMaxSpinLimit), std::memory_order_relaxed);
+          }
+          return;
+        }
+      }
+      spin_limit_.store(std::max(spin_limit / 2, kMinSpinLimit), std::memory_order_relaxed);
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    num_parked_.fetch_add(1, std::memory_order_relaxed);
+    // Pairs with the fence in Notify, either Notify sees the waiter or the waiter sees the change.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    cond_.wait(lock, ready);
+    num_parked_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  void NotifyOne() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (num_parked_.load(std::memory_order_relaxed) == 0) { return; }
+    std::lock_guard<std::mutex> lock(mutex_);
+    cond_.notify_one();
+  }
+
+  void NotifyAll() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (num_parked_.load(std::memory_order_relaxed) == 0) { return; }
+    std::lock_guard<std::mutex> lock(mutex_);
+    cond_.notify_all();
+  }
+
+ private:
+  static constexpr int32_t kMinSpinLimit = 16;
+  static constexpr int32_t kMaxSpinLimit = 4096;
+
+  ChannelWaitStrategy strategy_;
+  std::atomic<int32_t> spin_limit_;
+  std::atomic<int32_t> num_parked_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+};
+
+}  // namespace detail
+
+// A lock-free bounded multi-producer multi-consumer channel, see Dmitry Vyukov's bounded MPMC
+// queue. Send blocks while the channel is full, otherwise it behaves like Channel: Send fails once
+// closed, Receive returns the remaining items and then fails.
+template<typename T>
+class BoundedChannel final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(BoundedChannel);
+  BoundedChannel(size_t capacity, ChannelWaitStrategy strategy);
+  explicit BoundedChannel(size_t capacity)
+      : BoundedChannel(capacity, ChannelWaitStrategy::kSpinThenPark) {}
+  ~BoundedChannel();
+
+  template<typename U>
+  ChannelStatus Send(U&& item);
+  ChannelStatus Receive(T* item);
+  ChannelStatus ReceiveMany(std::queue<T>* items);
+  void Close();
+
+ private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+  };
+
+  template<typename U>
+  bool TrySend(U&& item);
+  bool TryReceive(T* item);
+  bool HasItem() const;
+  bool HasRoom() const;
+
+  std::vector<Cell> cells_;
+  size_t mask_;
+  // Senders and receivers are kept on separate cache lines.
+  char send_pos_padding_[detail::kCacheLineSize];
+  std::atomic<size_t> send_pos_;
+  char receive_pos_padding_[detail::kCacheLineSize - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> receive_pos_;
+  char receive_pos_tail_padding_[detail::kCacheLineSize - sizeof(std::atomic<size_t>)];
+  std::atomic<bool> is_closed_;
+  // Senders that passed the closed check, Receive only fails after they are done.
+  std::atomic<int64_t> num_sending_;
+  detail::ChannelWaiter not_empty_waiter_;
+  detail::ChannelWaiter not_full_waiter_;
+};
+
+template<typename T>
+BoundedChannel<T>::BoundedChannel(size_t capacity, ChannelWaitStrategy strategy)
+    : cells_(detail::RoundUpToPowerOfTwo(std::max<size_t>(capacity, 2))),
+      mask_(cells_.size() - 1),
+      send_pos_(0),
+      receive_pos_(0),
+      is_closed_(false),
+      num_sending_(0),
+      not_empty_waiter_(strategy),
+      not_full_waiter_(strategy) {
+  for (size_t i = 0; i < cells_.size(); ++i) {
+    cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+template<typename T>
+BoundedChannel<T>::~BoundedChannel() {
+  const size_t send_pos = send_pos_.load(std::memory_order_acquire);
+  for (size_t pos = receive_pos_.load(std::memory_order_acquire); pos != send_pos; ++pos) {
+    reinterpret_cast<T*>(&cells_[pos & mask_].storage)->~T();
+  }
+}
+
+template<typename T>
+template<typename U>
+bool BoundedChannel<T>::TrySend(U&& item) {
+  size_t pos = send_pos_.load(std::memory_order_relaxed);
+  while (true) {
+    Cell* cell = &cells_[pos & mask_];
+    const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+    const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+    if (diff == 0) {
+      if (send_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        new (&cell->storage) T(std::forward<U>(item));
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+      }
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = send_pos_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+template<typename T>
+bool BoundedChannel<T>::TryReceive(T* item) {
+  size_t pos = receive_pos_.load(std::memory_order_relaxed);
+  while (true) {
+    Cell* cell = &cells_[pos & mask_];
+    const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+    const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+    if (diff == 0) {
+      if (receive_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        T* stored = reinterpret_cast<T*>(&cell->storage);
+        *item = std::move(*stored);
+        stored->~T();
+        cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+      }
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = receive_pos_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+template<typename T>
+bool BoundedChannel<T>::HasItem() const {
+  const size_t pos = receive_pos_.load(std::memory_order_relaxed);
+  return cells_[pos & mask_].sequence.load(std::memory_order_acquire) == pos + 1;
+}
+
+template<typename T>
+bool BoundedChannel<T>::HasRoom() const {
+  const size_t pos = send_pos_.load(std::memory_order_relaxed);
+  return cells_[pos & mask_].sequence.load(std::memory_order_acquire) == pos;
+}
+
+template<typename T>
+template<typename U>
+ChannelStatus BoundedChannel<T>::Send(U&& item) {
+  num_sending_.fetch_add(1, std::memory_order_seq_cst);
+  ChannelStatus status = kChannelStatusSuccess;
+  while (true) {
+    if (is_closed_.load(std::memory_order_seq_cst)) {
+      status = kChannelStatusErrorClosed;
+      break;
+    }
+    if (TrySend(std::forward<U>(item))) { break; }
+    not_full_waiter_.Wait(
+        [this]() { return HasRoom() || is_closed_.load(std::memory_order_relaxed); });
+  }
+  if (num_sending_.fetch_sub(1, std::memory_order_seq_cst) == 1
+      && is_closed_.load(std::memory_order_relaxed)) {
+    // The last in-flight sender after Close, receivers waiting for it may fail now.
+    not_empty_waiter_.NotifyAll();
+  } else if (status == kChannelStatusSuccess) {
+    not_empty_waiter_.NotifyOne();
+  }
+  return status;
+}
+
+template<typename T>
+ChannelStatus BoundedChannel<T>::Receive(T* item) {
+  while (true) {
+    if (TryReceive(item)) {
+      not_full_waiter_.NotifyOne();
+      return kChannelStatusSuccess;
+    }
+    if (is_closed_.load(std::memory_order_seq_cst)
+        && num_sending_.load(std::memory_order_seq_cst) == 0 && !HasItem()) {
+      return kChannelStatusErrorClosed;
+    }
+    not_empty_waiter_.Wait([this]() {
+      return HasItem()
+             || (is_closed_.load(std::memory_order_relaxed)
+                 && num_sending_.load(std::memory_order_relaxed) == 0);
+    });
+  }
+}
+
+template<typename T>
+ChannelStatus BoundedChannel<T>::ReceiveMany(std::queue<T>* items) {
+  T item;
+  if (Receive(&item) != kChannelStatusSuccess) { return kChannelStatusErrorClosed; }
+  items->push(std::move(item));
+  // Bounded by the capacity, so that steady senders cannot keep the receiver here forever.
+  for (size_t i = 1; i < cells_.size() && TryReceive(&item); ++i) {
+    items->push(std::move(item));
+  }
+  not_full_waiter_.NotifyAll();
+  return kChannelStatusSuccess;
+}
+
+template<typename T>
+void BoundedChannel<T>::Close() {
+  is_closed_.store(true, std::memory_order_seq_cst);
+  not_full_waiter_.NotifyAll();
+  not_empty_waiter_.NotifyAll();
+}
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_COMMON_BOUNDED_CHANNEL_H_
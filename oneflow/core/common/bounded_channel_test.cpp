@@ -0,0 +1,207 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "gtest/gtest.h"
+#include "oneflow/core/common/bounded_channel.h"
+#include "oneflow/core/common/buffer.h"
+
+namespace oneflow {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void TestManySendersManyReceivers(ChannelWaitStrategy strategy) {
+  BoundedChannel<int64_t> channel(16, strategy);
+  const int64_t num_senders = 8;
+  const int64_t num_receivers = 8;
+  const int64_t num_items_per_sender = 10000;
+  std::vector<std::atomic<int32_t>> visits(num_senders * num_items_per_sender);
+  for (auto& visit : visits) { visit = 0; }
+  std::vector<std::thread> senders;
+  std::vector<std::thread> receivers;
+  for (int64_t i = 0; i < num_receivers; ++i) {
+    receivers.emplace_back([&]() {
+      int64_t item = 0;
+      while (channel.Receive(&item) == kChannelStatusSuccess) { visits.at(item) += 1; }
+    });
+  }
+  for (int64_t i = 0; i < num_senders; ++i) {
+    senders.emplace_back([&, i]() {
+      for (int64_t j = 0; j < num_items_per_sender; ++j) {
+        ASSERT_EQ(channel.Send(i * num_items_per_sender + j), kChannelStatusSuccess);
+      }
+    });
+  }
+  for (std::thread& sender : senders) { sender.join(); }
+  channel.Close();
+  for (std::thread& receiver : receivers) { receiver.join(); }
+  for (const auto& visit : visits) { ASSERT_EQ(visit, 1); }
+}
+
+struct BenchmarkResult {
+  double items_per_second;
+  double p50_latency_us;
+  double p99_latency_us;
+};
+
+// Every item carries its send time, receivers record the latency of each item.
+template<typename SendT, typename ReceiveT, typename CloseT>
+BenchmarkResult RunBenchmark(int32_t num_senders, int32_t num_receivers, int64_t num_items,
+                             const SendT& Send, const ReceiveT& Receive, const CloseT& Close) {
+  std::vector<std::vector<double>> latencies(num_receivers);
+  std::vector<std::thread> senders;
+  std::vector<std::thread> receivers;
+  const auto start = Clock::now();
+  for (int32_t i = 0; i < num_receivers; ++i) {
+    receivers.emplace_back([&, i]() {
+      Clock::time_point sent;
+      while (Receive(&sent)) {
+        latencies.at(i).push_back(
+            std::chrono::duration<double, std::micro>(Clock::now() - sent).count());
+      }
+    });
+  }
+  for (int32_t i = 0; i < num_senders; ++i) {
+    senders.emplace_back([&]() {
+      for (int64_t j = 0; j < num_items / num_senders; ++j) { Send(Clock::now()); }
+    });
+  }
+  for (std::thread& sender : senders) { sender.join(); }
+  Close();
+  for (std::thread& receiver : receivers) { receiver.join(); }
+  const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  std::vector<double> all_latencies;
+  for (const auto& latency : latencies) {
+    all_latencies.insert(all_latencies.end(), latency.begin(), latency.end());
+  }
+  std::sort(all_latencies.begin(), all_latencies.end());
+  BenchmarkResult result{};
+  result.items_per_second = all_latencies.size() / seconds;
+  result.p50_latency_us = all_latencies.at(all_latencies.size() / 2);
+  result.p99_latency_us = all_latencies.at(all_latencies.size() * 99 / 100);
+  return result;
+}
+
+void LogBenchmarkResult(const std::string& name, int32_t num_senders, int32_t num_receivers,
+                        const BenchmarkResult& result) {
+  LOG(INFO) << name << " " << num_senders << "x" << num_receivers
+            << ": items/s: " << result.items_per_second << ", p50: " << result.p50_latency_us
+            << " us, p99: " << result.p99_latency_us << " us";
+}
+
+}  // namespace
+
+TEST(BoundedChannel, ManySendersManyReceivers) {
+  TestManySendersManyReceivers(ChannelWaitStrategy::kPark);
+  TestManySendersManyReceivers(ChannelWaitStrategy::kSpinThenPark);
+}
+
+TEST(BoundedChannel, Close) {
+  BoundedChannel<std::shared_ptr<int>> channel(4);
+  auto item = std::make_shared<int>(1);
+  ASSERT_EQ(channel.Send(item), kChannelStatusSuccess);
+  ASSERT_EQ(channel.Send(item), kChannelStatusSuccess);
+  ASSERT_EQ(item.use_count(), 3);
+  channel.Close();
+  ASSERT_EQ(channel.Send(item), kChannelStatusErrorClosed);
+  std::shared_ptr<int> received;
+  ASSERT_EQ(channel.Receive(&received), kChannelStatusSuccess);
+  ASSERT_EQ(*received, 1);
+  ASSERT_EQ(channel.Receive(&received), kChannelStatusSuccess);
+  ASSERT_EQ(channel.Receive(&received), kChannelStatusErrorClosed);
+  received.reset();
+  ASSERT_EQ(item.use_count(), 1);
+  {
+    // Items left in the channel are destroyed with it.
+    BoundedChannel<std::shared_ptr<int>> unread(4);
+    ASSERT_EQ(unread.Send(item), kChannelStatusSuccess);
+    ASSERT_EQ(item.use_count(), 2);
+  }
+  ASSERT_EQ(item.use_count(), 1);
+}
+
+TEST(BoundedChannel, SendBlocksWhenFull) {
+  BoundedChannel<int> channel(2);
+  ASSERT_EQ(channel.Send(0), kChannelStatusSuccess);
+  ASSERT_EQ(channel.Send(1), kChannelStatusSuccess);
+  std::atomic<bool> sent(false);
+  std::thread sender([&]() {
+    ASSERT_EQ(channel.Send(2), kChannelStatusSuccess);
+    sent = true;
+    ASSERT_EQ(channel.Send(3), kChannelStatusSuccess);
+    ASSERT_EQ(channel.Send(4), kChannelStatusSuccess);
+    // Blocks until Close.
+    ASSERT_EQ(channel.Send(5), kChannelStatusErrorClosed);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  ASSERT_FALSE(sent);
+  int item = -1;
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_EQ(channel.Receive(&item), kChannelStatusSuccess);
+    ASSERT_EQ(item, i);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  channel.Close();
+  sender.join();
+  std::queue<int> items;
+  ASSERT_EQ(channel.ReceiveMany(&items), kChannelStatusSuccess);
+  ASSERT_EQ(items.size(), 2);
+  ASSERT_EQ(items.front(), 3);
+  ASSERT_EQ(items.back(), 4);
+  ASSERT_EQ(channel.ReceiveMany(&items), kChannelStatusErrorClosed);
+}
+
+TEST(BoundedChannel, Benchmark) {
+  const int64_t num_items = 200000;
+  const size_t capacity = 1024;
+  const int32_t max_num_threads = std::max<int32_t>(std::thread::hardware_concurrency() / 2, 1);
+  for (int32_t num_threads = 1; num_threads <= max_num_threads; num_threads *= 2) {
+    {
+      Channel<Clock::time_point> channel;
+      LogBenchmarkResult(
+          "Channel", num_threads, num_threads,
+          RunBenchmark(
+              num_threads, num_threads, num_items,
+              [&](Clock::time_point t) { channel.Send(t); },
+              [&](Clock::time_point* t) { return channel.Receive(t) == kChannelStatusSuccess; },
+              [&]() { channel.Close(); }));
+    }
+    {
+      Buffer<Clock::time_point> buffer(capacity);
+      LogBenchmarkResult(
+          "Buffer", num_threads, num_threads,
+          RunBenchmark(
+              num_threads, num_threads, num_items,
+              [&](Clock::time_point t) { buffer.Push(t); },
+              [&](Clock::time_point* t) { return buffer.Pull(t) == kBufferStatusSuccess; },
+              [&]() { buffer.Close(); }));
+    }
+    for (const auto strategy : {ChannelWaitStrategy::kPark, ChannelWaitStrategy::kSpinThenPark}) {
+      BoundedChannel<Clock::time_point> channel(capacity, strategy);
+      LogBenchmarkResult(
+          strategy == ChannelWaitStrategy::kPark ? "BoundedChannel(park)"
+                                                 : "BoundedChannel(spin then park)",
+          num_threads, num_threads,
+          RunBenchmark(
+              num_threads, num_threads, num_items,
+              [&](Clock::time_point t) { channel.Send(t); },
+              [&](Clock::time_point* t) { return channel.Receive(t) == kChannelStatusSuccess; },
+              [&]() { channel.Close(); }));
+    }
+  }
+}
+
+}  // namespace oneflow
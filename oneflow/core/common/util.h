@@ -221,6 +221,16 @@ void Erase(T& container, const std::function<bool(const typename T::value_type&)
 #define ALWAYS_INLINE inline
 #endif
 
+// Compiles a function for the baseline target and again for AVX2 and FMA, the dynamic loader
+// binds the calls to the version the cpu supports. Only for hot cpu loops called per row or per
+// block, a call through the resolver is not inlined.
+#if defined(__GNUC__) && __GNUC__ >= 7 && !defined(__clang__) && !defined(__CUDACC__) \
+    && defined(__x86_64__) && defined(__linux__) && !defined(__AVX2__)
+#define OF_CPU_TARGET_CLONES __attribute__((target_clones("arch=haswell", "default")))
+#else
+#define OF_CPU_TARGET_CLONES
+#endif
+
 bool IsKernelSafeInt32(int64_t n);
 
 class RoundModeGuard final {
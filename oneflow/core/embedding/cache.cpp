@@ -16,22 +16,31 @@ limitations under the License.
 #include "oneflow/core/embedding/cache.h"
 #include "oneflow/core/embedding/full_cache.h"
 #include "oneflow/core/embedding/lru_cache.h"
+#include "oneflow/core/embedding/host_cache.h"
+#include "oneflow/core/embedding/tiny_lfu_cache.h"
 
 namespace oneflow {
 
 namespace embedding {
 
-std::unique_ptr<Cache> NewCache(const CacheOptions& options) {
+namespace {
+
+std::unique_ptr<Cache> NewEvictionCache(const CacheOptions& options, DeviceType device_type) {
+  if (device_type == DeviceType::kCPU) {
+    CHECK(options.value_memory_kind == CacheOptions::MemoryKind::kHost)
+        << "Caches queried from CPU streams must keep their values in host memory";
+    return NewHostCache(options);
+  }
 #ifdef WITH_CUDA
-  CHECK_GT(options.key_size, 0);
-  CHECK_GT(options.value_size, 0);
-  CHECK_GT(options.capacity, 0);
+  CHECK(device_type == DeviceType::kCUDA);
+  CHECK(options.admission_policy == CacheOptions::AdmissionPolicy::kNone)
+      << "Admission policies are only supported by host caches";
   if (options.policy == CacheOptions::Policy::kLRU) {
     return NewLruCache(options);
   } else if (options.policy == CacheOptions::Policy::kFull) {
     return NewFullCache(options);
   } else {
-    UNIMPLEMENTED();
+    UNIMPLEMENTED() << "Use NewHostCache for lfu caches queried from CPU streams";
     return nullptr;
   }
 #else
@@ -40,6 +49,27 @@ std::unique_ptr<Cache> NewCache(const CacheOptions& options) {
 #endif  // WITH_CUDA
 }
 
+}  // namespace
+
+std::unique_ptr<Cache> NewCache(const CacheOptions& options, DeviceType device_type) {
+  CHECK_GT(options.key_size, 0);
+  CHECK_GT(options.value_size, 0);
+  CHECK_GT(options.capacity, 0);
+  std::unique_ptr<Cache> cache = NewEvictionCache(options, device_type);
+  if (options.admission_policy == CacheOptions::AdmissionPolicy::kTinyLFU) {
+    cache = NewTinyLfuCache(std::move(cache), options);
+  }
+  return cache;
+}
+
+std::unique_ptr<Cache> NewCache(const CacheOptions& options) {
+#ifdef WITH_CUDA
+  return NewCache(options, DeviceType::kCUDA);
+#else
+  return NewCache(options, DeviceType::kCPU);
+#endif  // WITH_CUDA
+}
+
 }  // namespace embedding
 
 }  // namespace oneflow
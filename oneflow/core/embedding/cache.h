@@ -28,17 +28,32 @@ struct CacheOptions {
   enum class Policy {
     kLRU,
     kFull,
+    kLFU,
   };
   enum class MemoryKind {
     kDevice,
     kHost,
   };
+  enum class AdmissionPolicy {
+    kNone,
+    kTinyLFU,
+  };
   Policy policy = Policy::kLRU;
   MemoryKind value_memory_kind = MemoryKind::kDevice;
   uint64_t capacity{};
   uint32_t key_size{};
   uint32_t value_size{};
   float load_factor = 0.75;
+  AdmissionPolicy admission_policy = AdmissionPolicy::kNone;
+  uint32_t admission_min_frequency = 2;
+};
+
+struct CacheStatistics {
+  uint64_t num_queries = 0;
+  uint64_t num_hits = 0;
+  uint64_t num_evictions = 0;
+  uint64_t num_admissions = 0;
+  uint64_t num_rejections = 0;
 };
 
 class Cache {
@@ -60,13 +75,27 @@ class Cache {
                    uint32_t* n_missing, void* missing_keys, uint32_t* missing_indices) = 0;
   virtual void Put(ep::Stream* stream, uint32_t n_keys, const void* keys, const void* values,
                    uint32_t* n_evicted, void* evicted_keys, void* evicted_values) = 0;
+  // Like Put, except that the keys an admission filter turns away are handed back in
+  // rejected_keys and rejected_values instead of with the evicted ones, so that the caller can
+  // skip writing back those it knows to be unchanged. n_rejected is a host pointer.
+  virtual void PutWithAdmission(ep::Stream* stream, uint32_t n_keys, const void* keys,
+                                const void* values, uint32_t* n_evicted, void* evicted_keys,
+                                void* evicted_values, uint32_t* n_rejected, void* rejected_keys,
+                                void* rejected_values) {
+    Put(stream, n_keys, keys, values, n_evicted, evicted_keys, evicted_values);
+    *n_rejected = 0;
+  }
   virtual void Dump(ep::Stream* stream, uint64_t start_key_index, uint64_t end_key_index,
                     uint32_t* n_dumped, void* keys, void* values) = 0;
   virtual void Clear() = 0;
+  virtual void GetStatistics(CacheStatistics* statistics) { *statistics = CacheStatistics(); }
 };
 
 std::unique_ptr<Cache> NewCache(const CacheOptions& options);
 
+// A cache queried from streams of device_type, the caches of CPU streams are host caches.
+std::unique_ptr<Cache> NewCache(const CacheOptions& options, DeviceType device_type);
+
 }  // namespace embedding
 
 }  // namespace oneflow
@@ -91,9 +91,12 @@ class CacheKeyValueStoreImpl : public KeyValueStore {
   void Get(ep::Stream* stream, uint32_t num_keys, const void* keys, void* values,
            uint32_t* n_missing, uint32_t* missing_indices) override;
   void Put(ep::Stream* stream, uint32_t num_keys, const void* keys, const void* values) override;
+  void Prefetch(uint32_t num_keys, const void* keys) override { store_->Prefetch(num_keys, keys); }
   bool SnapshotExists(const std::string& name) override;
   void LoadSnapshot(const std::string& name) override;
   void SaveSnapshot(const std::string& name) override;
+  void SaveDeltaSnapshot(const std::string& name, const std::string& base) override;
+  void MergeSnapshot(const std::string& name, const std::string& merged_name) override;
   void LoadSnapshot(const std::string& name,
                     const std::function<void(KVIterator* iter)>& Hook) override;
 
@@ -217,6 +220,23 @@ void CacheKeyValueStoreImpl<Key, Elem>::SaveSnapshot(const std::string& name) {
   store_->SaveSnapshot(name);
 }
 
+template<typename Key, typename Elem>
+void CacheKeyValueStoreImpl<Key, Elem>::SaveDeltaSnapshot(const std::string& name,
+                                                          const std::string& base) {
+  CudaCurrentDeviceGuard guard(device_index_);
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  SyncCacheToStore();
+  store_->SaveDeltaSnapshot(name, base);
+}
+
+template<typename Key, typename Elem>
+void CacheKeyValueStoreImpl<Key, Elem>::MergeSnapshot(const std::string& name,
+                                                      const std::string& merged_name) {
+  // Snapshots on disk do not depend on the cache, there is nothing to sync.
+  CudaCurrentDeviceGuard guard(device_index_);
+  store_->MergeSnapshot(name, merged_name);
+}
+
 template<typename Key, typename Elem>
 void CacheKeyValueStoreImpl<Key, Elem>::SyncCacheToStore() {
   if (synced_) { return; }
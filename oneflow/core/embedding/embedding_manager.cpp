@@ -17,14 +17,37 @@ limitations under the License.
 #include "oneflow/core/embedding/persistent_table_key_value_store.h"
 #include "oneflow/core/ep/include/device_manager_registry.h"
 #include "oneflow/core/embedding/cached_key_value_store.h"
+#include "oneflow/core/embedding/host_key_value_store.h"
 
 namespace oneflow {
 
 namespace embedding {
 
+constexpr size_t kDefaultMaxQueryLength = 65536;
+
+namespace {
+
+// Makes local_rank_id the current CUDA device while the store of a CUDA embedding is used, stores
+// queried from CPU streams need no device.
+class StoreDeviceGuard final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(StoreDeviceGuard);
+  StoreDeviceGuard(DeviceType device_type, int64_t local_rank_id) {
+#ifdef WITH_CUDA
+    if (device_type == DeviceType::kCUDA) {
+      cuda_guard_.reset(new CudaCurrentDeviceGuard(local_rank_id));
+    }
+#endif  // WITH_CUDA
+  }
+  ~StoreDeviceGuard() = default;
+
+ private:
 #ifdef WITH_CUDA
+  std::unique_ptr<CudaCurrentDeviceGuard> cuda_guard_;
+#endif  // WITH_CUDA
+};
 
-constexpr size_t kDefaultMaxQueryLength = 65536;
+}  // namespace
 
 KeyValueStore* EmbeddingManager::GetKeyValueStore(const std::string& embedding_name,
                                                   int64_t rank_id) {
@@ -39,7 +62,8 @@ KeyValueStore* EmbeddingManager::GetKeyValueStore(const std::string& embedding_n
 void EmbeddingManager::CreateKeyValueStore(const KeyValueStoreOptions& key_value_store_options,
                                            int64_t local_rank_id, int64_t rank_id,
                                            int64_t world_size) {
-  CudaCurrentDeviceGuard guard(local_rank_id);
+  const DeviceType device_type = key_value_store_options.StoreDeviceType();
+  StoreDeviceGuard guard(device_type, local_rank_id);
   const std::string& name = key_value_store_options.Name();
   const uint32_t line_size = key_value_store_options.LineSize();
   std::pair<std::string, int64_t> map_key = std::make_pair(name, rank_id);
@@ -57,36 +81,94 @@ void EmbeddingManager::CreateKeyValueStore(const KeyValueStoreOptions& key_value
       key_value_store_options.PersistentTablePhysicalBlockSize();
   options.table_options.target_chunk_size_mb = 4 * 1024;
   options.table_options.capacity_hint = key_value_store_options.PersistentTableCapacityHint();
-  store = NewPersistentTableKeyValueStore(options);
+  options.table_options.enable_compaction =
+      key_value_store_options.PersistentTableEnableCompaction();
+  options.table_options.compaction_dead_ratio_threshold =
+      key_value_store_options.PersistentTableCompactionDeadRatioThreshold();
+  options.table_options.compaction_io_rate_limit_mb =
+      key_value_store_options.PersistentTableCompactionIoRateLimitMb();
+  options.table_options.value_codecs = key_value_store_options.PersistentTableValueCodecs();
   const std::vector<CacheOptions>& cache_options = key_value_store_options.GetCachesOptions();
-  for (int i = cache_options.size() - 1; i >= 0; --i) {
-    std::unique_ptr<Cache> cache = NewCache(cache_options.at(i));
-    store = NewCachedKeyValueStore(std::move(store), std::move(cache));
+  if (device_type == DeviceType::kCPU) {
+    store = NewHostPersistentTableKeyValueStore(options);
+    for (int i = cache_options.size() - 1; i >= 0; --i) {
+      std::unique_ptr<Cache> cache = NewCache(cache_options.at(i), DeviceType::kCPU);
+      store = NewHostCachedKeyValueStore(std::move(store), std::move(cache));
+    }
+  } else {
+#ifdef WITH_CUDA
+    store = NewPersistentTableKeyValueStore(options);
+    for (int i = cache_options.size() - 1; i >= 0; --i) {
+      std::unique_ptr<Cache> cache = NewCache(cache_options.at(i), DeviceType::kCUDA);
+      store = NewCachedKeyValueStore(std::move(store), std::move(cache));
+    }
+#else
+    UNIMPLEMENTED() << "Embeddings on cuda need a build with CUDA, use the cpu store instead";
+#endif  // WITH_CUDA
   }
   store->ReserveQueryLength(kDefaultMaxQueryLength);
   CHECK(key_value_store_map_.emplace(map_key, std::move(store)).second)
       << "Can't create an embedding with same name of an existing embedding, the name: " << name;
+  device_type_map_[map_key] = device_type;
 }
 
 void EmbeddingManager::SaveSnapshot(const std::string& embedding_name, int64_t local_rank_id,
                                     int64_t rank_id, const std::string& snapshot_name) {
-  CudaCurrentDeviceGuard guard(local_rank_id);
   std::pair<std::string, int64_t> map_key = std::make_pair(embedding_name, rank_id);
   std::unique_lock<std::mutex> lock(mutex_);
 
   auto it = key_value_store_map_.find(map_key);
   CHECK(it != key_value_store_map_.end())
       << "Can not find embedding: " << embedding_name << "-" << rank_id;
+  StoreDeviceGuard guard(device_type_map_.at(map_key), local_rank_id);
   it->second->SaveSnapshot(snapshot_name);
 }
 
+void EmbeddingManager::Prefetch(const std::string& embedding_name, int64_t local_rank_id,
+                                int64_t rank_id, uint32_t num_keys, const void* keys) {
+  std::pair<std::string, int64_t> map_key = std::make_pair(embedding_name, rank_id);
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  auto it = key_value_store_map_.find(map_key);
+  CHECK(it != key_value_store_map_.end())
+      << "Can not find embedding: " << embedding_name << "-" << rank_id;
+  StoreDeviceGuard guard(device_type_map_.at(map_key), local_rank_id);
+  it->second->Prefetch(num_keys, keys);
+}
+
+void EmbeddingManager::SaveDeltaSnapshot(const std::string& embedding_name, int64_t local_rank_id,
+                                         int64_t rank_id, const std::string& snapshot_name,
+                                         const std::string& base_snapshot_name) {
+  std::pair<std::string, int64_t> map_key = std::make_pair(embedding_name, rank_id);
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  auto it = key_value_store_map_.find(map_key);
+  CHECK(it != key_value_store_map_.end())
+      << "Can not find embedding: " << embedding_name << "-" << rank_id;
+  StoreDeviceGuard guard(device_type_map_.at(map_key), local_rank_id);
+  it->second->SaveDeltaSnapshot(snapshot_name, base_snapshot_name);
+}
+
+void EmbeddingManager::MergeSnapshot(const std::string& embedding_name, int64_t local_rank_id,
+                                     int64_t rank_id, const std::string& snapshot_name,
+                                     const std::string& merged_snapshot_name) {
+  std::pair<std::string, int64_t> map_key = std::make_pair(embedding_name, rank_id);
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  auto it = key_value_store_map_.find(map_key);
+  CHECK(it != key_value_store_map_.end())
+      << "Can not find embedding: " << embedding_name << "-" << rank_id;
+  StoreDeviceGuard guard(device_type_map_.at(map_key), local_rank_id);
+  it->second->MergeSnapshot(snapshot_name, merged_snapshot_name);
+}
+
 void EmbeddingManager::LoadSnapshot(const std::string& embedding_name, int64_t local_rank_id,
                                     int64_t rank_id, const std::string& snapshot_name) {
-  CudaCurrentDeviceGuard guard(local_rank_id);
   std::pair<std::string, int64_t> map_key = std::make_pair(embedding_name, rank_id);
   auto it = key_value_store_map_.find(map_key);
   CHECK(it != key_value_store_map_.end())
       << "Can not find embedding: " << embedding_name << "-" << rank_id;
+  StoreDeviceGuard guard(device_type_map_.at(map_key), local_rank_id);
   if (it->second->SnapshotExists(snapshot_name)) {
     it->second->LoadSnapshot(snapshot_name);
   } else {
@@ -95,8 +177,6 @@ void EmbeddingManager::LoadSnapshot(const std::string& embedding_name, int64_t l
   }
 }
 
-#endif  // WITH_CUDA
-
 }  // namespace embedding
 
 }  // namespace oneflow
@@ -25,8 +25,6 @@ namespace oneflow {
 
 namespace embedding {
 
-#ifdef WITH_CUDA
-
 class EmbeddingManager final {
  public:
   EmbeddingManager() = default;
@@ -34,8 +32,15 @@ class EmbeddingManager final {
 
   void SaveSnapshot(const std::string& embedding_name, int64_t local_rank_id, int64_t rank_id,
                     const std::string& snapshot_name);
+  void SaveDeltaSnapshot(const std::string& embedding_name, int64_t local_rank_id, int64_t rank_id,
+                         const std::string& snapshot_name, const std::string& base_snapshot_name);
+  void MergeSnapshot(const std::string& embedding_name, int64_t local_rank_id, int64_t rank_id,
+                     const std::string& snapshot_name, const std::string& merged_snapshot_name);
   void LoadSnapshot(const std::string& embedding_name, int64_t local_rank_id, int64_t rank_id,
                     const std::string& snapshot_name);
+  // Starts reading the values of keys, a host array of the key type, ahead of their lookup.
+  void Prefetch(const std::string& embedding_name, int64_t local_rank_id, int64_t rank_id,
+                uint32_t num_keys, const void* keys);
 
   KeyValueStore* GetKeyValueStore(const std::string& embedding_name, int64_t rank_id);
 
@@ -44,11 +49,11 @@ class EmbeddingManager final {
 
  private:
   HashMap<std::pair<std::string, int64_t>, std::unique_ptr<KeyValueStore>> key_value_store_map_;
+  // Device of the streams each store is queried from.
+  HashMap<std::pair<std::string, int64_t>, DeviceType> device_type_map_;
   std::mutex mutex_;
 };
 
-#endif  // WITH_CUDA
-
 }  // namespace embedding
 }  // namespace oneflow
 
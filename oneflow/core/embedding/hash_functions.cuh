@@ -65,6 +65,9 @@ static const size_t kLocalUniqueHashSeed = 2;
 static const size_t kGlobalUniqueHashSeed = 3;
 static const size_t kFullCacheHashSeed = 4;
 static const size_t kLruCacheHashSeed = 5;
+static const size_t kPersistentTableHashSeed = 6;
+static const size_t kHostCacheHashSeed = 7;
+static const size_t kTinyLfuSketchHashSeed = 8;
 
 }  // namespace
 
@@ -95,6 +98,25 @@ struct LruCacheHash {
   OF_DEVICE_FUNC size_t operator()(uint64_t v) { return xxh64_uint64(v, kLruCacheHashSeed); }
 };
 
+struct PersistentTableHash {
+  OF_DEVICE_FUNC size_t operator()(uint64_t v) const {
+    return xxh64_uint64(v, kPersistentTableHashSeed);
+  }
+  OF_DEVICE_FUNC size_t operator()(uint32_t v) const {
+    return xxh64_uint64(v, kPersistentTableHashSeed);
+  }
+};
+
+struct HostCacheHash {
+  OF_DEVICE_FUNC size_t operator()(uint64_t v) const { return xxh64_uint64(v, kHostCacheHashSeed); }
+};
+
+struct TinyLfuSketchHash {
+  OF_DEVICE_FUNC size_t operator()(uint64_t v) const {
+    return xxh64_uint64(v, kTinyLfuSketchHashSeed);
+  }
+};
+
 }  // namespace embedding
 }  // namespace oneflow
 #endif  // ONEFLOW_CORE_EMBEDDING_HASH_FUNCTION_H_
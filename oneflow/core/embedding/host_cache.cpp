@@ -0,0 +1,384 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/embedding/host_cache.h"
+#include "oneflow/core/embedding/hash_functions.cuh"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include <atomic>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define OF_HOST_CACHE_X86
+#endif
+
+namespace oneflow {
+
+namespace embedding {
+
+namespace {
+
+constexpr uint32_t kNumWays = 16;
+constexpr uint32_t kFullWayMask = (1U << kNumWays) - 1;
+constexpr uint32_t kLfuMaxFrequency = 1U << 15;
+constexpr int64_t kParallelForGrainSize = 4096;
+
+#if defined(OF_HOST_CACHE_X86)
+
+// AVX2 is checked at runtime, so the build does not need to enable it. SSE2 is part of x86-64.
+#if defined(__AVX2__)
+#define OF_HOST_CACHE_AVX2_TARGET
+inline bool CpuHasAvx2() { return true; }
+#else
+#define OF_HOST_CACHE_AVX2_TARGET __attribute__((target("avx2")))
+inline bool CpuHasAvx2() {
+  static const bool has_avx2 = []() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+  }();
+  return has_avx2;
+}
+#endif
+
+OF_HOST_CACHE_AVX2_TARGET inline uint32_t MatchWaysAvx2(const uint64_t* keys, uint64_t key) {
+  uint32_t mask = 0;
+  const __m256i needle = _mm256_set1_epi64x(static_cast<int64_t>(key));
+  for (uint32_t i = 0; i < kNumWays; i += 4) {
+    const __m256i ways = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+    const __m256i eq = _mm256_cmpeq_epi64(ways, needle);
+    mask |= static_cast<uint32_t>(_mm256_movemask_pd(_mm256_castsi256_pd(eq))) << i;
+  }
+  return mask;
+}
+
+OF_HOST_CACHE_AVX2_TARGET inline uint32_t MatchWaysAvx2(const uint32_t* keys, uint32_t key) {
+  uint32_t mask = 0;
+  const __m256i needle = _mm256_set1_epi32(static_cast<int32_t>(key));
+  for (uint32_t i = 0; i < kNumWays; i += 8) {
+    const __m256i ways = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+    const __m256i eq = _mm256_cmpeq_epi32(ways, needle);
+    mask |= static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(eq))) << i;
+  }
+  return mask;
+}
+
+inline uint32_t MatchWaysSse2(const uint64_t* keys, uint64_t key) {
+  uint32_t mask = 0;
+  const __m128i needle = _mm_set1_epi64x(static_cast<int64_t>(key));
+  for (uint32_t i = 0; i < kNumWays; i += 2) {
+    const __m128i ways = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+    // SSE2 has no 64-bit compare, both 32-bit halves have to match.
+    const __m128i eq32 = _mm_cmpeq_epi32(ways, needle);
+    const __m128i eq = _mm_and_si128(eq32, _mm_shuffle_epi32(eq32, _MM_SHUFFLE(2, 3, 0, 1)));
+    mask |= static_cast<uint32_t>(_mm_movemask_pd(_mm_castsi128_pd(eq))) << i;
+  }
+  return mask;
+}
+
+inline uint32_t MatchWaysSse2(const uint32_t* keys, uint32_t key) {
+  uint32_t mask = 0;
+  const __m128i needle = _mm_set1_epi32(static_cast<int32_t>(key));
+  for (uint32_t i = 0; i < kNumWays; i += 4) {
+    const __m128i ways = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+    const __m128i eq = _mm_cmpeq_epi32(ways, needle);
+    mask |= static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(eq))) << i;
+  }
+  return mask;
+}
+
+#endif  // OF_HOST_CACHE_X86
+
+// Returns the bitmask of the ways whose key equals to the given key.
+template<typename Key>
+inline uint32_t MatchWays(const Key* keys, Key key) {
+#if defined(OF_HOST_CACHE_X86)
+  if (CpuHasAvx2()) { return MatchWaysAvx2(keys, key); }
+  return MatchWaysSse2(keys, key);
+#else
+  uint32_t mask = 0;
+  for (uint32_t i = 0; i < kNumWays; ++i) { mask |= static_cast<uint32_t>(keys[i] == key) << i; }
+  return mask;
+#endif
+}
+
+template<typename Key>
+struct CacheSet {
+  void lock() {
+    while (locked.exchange(true, std::memory_order_acquire)) {
+      while (locked.load(std::memory_order_relaxed)) {}
+    }
+  }
+
+  void unlock() { locked.store(false, std::memory_order_release); }
+
+  int Lookup(Key key) const {
+    const uint32_t mask = MatchWays(keys, key) & valid_mask;
+    if (mask == 0) { return -1; }
+    return __builtin_ctz(mask);
+  }
+
+  void Reset() {
+    std::fill(keys, keys + kNumWays, 0);
+    std::fill(metadata, metadata + kNumWays, 0);
+    clock = 0;
+    valid_mask = 0;
+  }
+
+  Key keys[kNumWays];
+  // The last access tick of each way for LRU, or its access frequency for LFU.
+  uint32_t metadata[kNumWays];
+  uint32_t clock;
+  uint32_t valid_mask;
+  std::atomic<bool> locked;
+};
+
+template<typename Key>
+class HostCache : public Cache {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(HostCache);
+  explicit HostCache(const CacheOptions& options)
+      : value_size_(options.value_size),
+        policy_(options.policy),
+        max_query_length_(0),
+        num_queries_(0),
+        num_hits_(0),
+        num_evictions_(0) {
+    CHECK(policy_ == CacheOptions::Policy::kLRU || policy_ == CacheOptions::Policy::kLFU)
+        << "Host cache only supports lru and lfu policies";
+    CHECK(options.value_memory_kind == CacheOptions::MemoryKind::kHost);
+    n_set_ = (options.capacity - 1 + kNumWays) / kNumWays;
+    CHECK_GT(n_set_, 0);
+    sets_.reset(new CacheSet<Key>[n_set_]());
+    values_.resize(n_set_ * kNumWays * value_size_);
+  }
+  ~HostCache() override = default;
+
+  uint32_t KeySize() const override { return sizeof(Key); }
+  uint32_t ValueSize() const override { return value_size_; }
+  uint64_t Capacity() const override { return n_set_ * kNumWays; }
+  uint32_t MaxQueryLength() const override { return max_query_length_; }
+
+  void ReserveQueryLength(uint32_t query_length) override {
+    max_query_length_ = std::max(max_query_length_, query_length);
+  }
+
+  CacheOptions::Policy Policy() const override { return policy_; }
+
+  void Test(ep::Stream* stream, uint32_t n_keys, const void* keys, uint32_t* n_missing,
+            void* missing_keys, uint32_t* missing_indices) override {
+    Query<true>(stream, n_keys, static_cast<const Key*>(keys), nullptr, n_missing,
+                static_cast<Key*>(missing_keys), missing_indices);
+  }
+
+  void Get(ep::Stream* stream, uint32_t n_keys, const void* keys, void* values, uint32_t* n_missing,
+           void* missing_keys, uint32_t* missing_indices) override {
+    Query<false>(stream, n_keys, static_cast<const Key*>(keys), static_cast<char*>(values),
+                 n_missing, static_cast<Key*>(missing_keys), missing_indices);
+  }
+
+  void Put(ep::Stream* stream, uint32_t n_keys, const void* keys, const void* values,
+           uint32_t* n_evicted, void* evicted_keys, void* evicted_values) override;
+
+  void Dump(ep::Stream* stream, uint64_t start_key_index, uint64_t end_key_index,
+            uint32_t* n_dumped, void* keys, void* values) override;
+
+  void Clear() override {
+    for (uint64_t i = 0; i < n_set_; ++i) { sets_[i].Reset(); }
+  }
+
+  void GetStatistics(CacheStatistics* statistics) override {
+    statistics->num_queries = num_queries_;
+    statistics->num_hits = num_hits_;
+    statistics->num_evictions = num_evictions_;
+  }
+
+ private:
+  template<bool test_only>
+  void Query(ep::Stream* stream, uint32_t n_keys, const Key* keys, char* values,
+             uint32_t* n_missing, Key* missing_keys, uint32_t* missing_indices);
+  template<typename F>
+  void ParallelFor(ep::Stream* stream, uint32_t n_keys, const F& f);
+  uint64_t SetId(Key key) const { return HostCacheHash()(static_cast<uint64_t>(key)) % n_set_; }
+  char* ValuePtr(uint64_t set_id, uint32_t way) {
+    return values_.data() + (set_id * kNumWays + way) * value_size_;
+  }
+  uint32_t NextTick(CacheSet<Key>* set);
+  void Touch(CacheSet<Key>* set, uint32_t way);
+  uint32_t Victim(const CacheSet<Key>& set) const;
+
+  uint32_t value_size_;
+  CacheOptions::Policy policy_;
+  uint32_t max_query_length_;
+  uint64_t n_set_;
+  std::unique_ptr<CacheSet<Key>[]> sets_;
+  std::vector<char> values_;
+  std::atomic<uint64_t> num_queries_;
+  std::atomic<uint64_t> num_hits_;
+  std::atomic<uint64_t> num_evictions_;
+};
+
+template<typename Key>
+template<typename F>
+void HostCache<Key>::ParallelFor(ep::Stream* stream, uint32_t n_keys, const F& f) {
+  CHECK_EQ(stream->device_type(), DeviceType::kCPU);
+  stream->As<ep::CpuStream>()->ParallelFor(0, n_keys, f, kParallelForGrainSize);
+}
+
+template<typename Key>
+template<bool test_only>
+void HostCache<Key>::Query(ep::Stream* stream, uint32_t n_keys, const Key* keys, char* values,
+                           uint32_t* n_missing, Key* missing_keys, uint32_t* missing_indices) {
+  CHECK_LE(n_keys, max_query_length_);
+  std::atomic<uint32_t> missing_count(0);
+  std::atomic<uint64_t> hit_count(0);
+  ParallelFor(stream, n_keys, [&](int64_t start, int64_t end) {
+    uint64_t n_hits = 0;
+    for (int64_t i = start; i < end; ++i) {
+      const Key key = keys[i];
+      const uint64_t set_id = SetId(key);
+      CacheSet<Key>* set = &sets_[set_id];
+      std::lock_guard<CacheSet<Key>> lock(*set);
+      const int way = set->Lookup(key);
+      if (way < 0) {
+        const uint32_t missing_index = missing_count.fetch_add(1, std::memory_order_relaxed);
+        missing_keys[missing_index] = key;
+        missing_indices[missing_index] = i;
+      } else {
+        n_hits += 1;
+        if (!test_only) {
+          Touch(set, way);
+          std::memcpy(values + i * value_size_, ValuePtr(set_id, way), value_size_);
+        }
+      }
+    }
+    hit_count.fetch_add(n_hits, std::memory_order_relaxed);
+  });
+  *n_missing = missing_count;
+  if (!test_only) {
+    num_queries_ += n_keys;
+    num_hits_ += hit_count;
+  }
+}
+
+template<typename Key>
+void HostCache<Key>::Put(ep::Stream* stream, uint32_t n_keys, const void* keys,
+                         const void* values, uint32_t* n_evicted, void* evicted_keys,
+                         void* evicted_values) {
+  CHECK_LE(n_keys, max_query_length_);
+  std::atomic<uint32_t> evicted_count(0);
+  ParallelFor(stream, n_keys, [&](int64_t start, int64_t end) {
+    for (int64_t i = start; i < end; ++i) {
+      const Key key = static_cast<const Key*>(keys)[i];
+      const uint64_t set_id = SetId(key);
+      CacheSet<Key>* set = &sets_[set_id];
+      std::lock_guard<CacheSet<Key>> lock(*set);
+      int way = set->Lookup(key);
+      if (way >= 0) {
+        Touch(set, way);
+      } else {
+        if (set->valid_mask != kFullWayMask) {
+          way = __builtin_ctz(~set->valid_mask);
+          set->valid_mask |= (1U << way);
+        } else {
+          way = Victim(*set);
+          const uint32_t evicted_index = evicted_count.fetch_add(1, std::memory_order_relaxed);
+          static_cast<Key*>(evicted_keys)[evicted_index] = set->keys[way];
+          std::memcpy(static_cast<char*>(evicted_values) + evicted_index * value_size_,
+                      ValuePtr(set_id, way), value_size_);
+        }
+        set->keys[way] = key;
+        set->metadata[way] = (policy_ == CacheOptions::Policy::kLRU) ? NextTick(set) : 1;
+      }
+      std::memcpy(ValuePtr(set_id, way), static_cast<const char*>(values) + i * value_size_,
+                  value_size_);
+    }
+  });
+  *n_evicted = evicted_count;
+  num_evictions_ += evicted_count;
+}
+
+template<typename Key>
+void HostCache<Key>::Dump(ep::Stream* stream, uint64_t start_key_index, uint64_t end_key_index,
+                          uint32_t* n_dumped, void* keys, void* values) {
+  CHECK_LE(end_key_index, Capacity());
+  uint32_t count = 0;
+  for (uint64_t i = start_key_index; i < end_key_index; ++i) {
+    const uint64_t set_id = i / kNumWays;
+    const uint32_t way = i % kNumWays;
+    CacheSet<Key>* set = &sets_[set_id];
+    std::lock_guard<CacheSet<Key>> lock(*set);
+    if ((set->valid_mask & (1U << way)) == 0) { continue; }
+    static_cast<Key*>(keys)[count] = set->keys[way];
+    std::memcpy(static_cast<char*>(values) + count * value_size_, ValuePtr(set_id, way),
+                value_size_);
+    count += 1;
+  }
+  *n_dumped = count;
+}
+
+template<typename Key>
+uint32_t HostCache<Key>::NextTick(CacheSet<Key>* set) {
+  if (set->clock == std::numeric_limits<uint32_t>::max()) {
+    // Renumber the ticks of the set by their order, so the clock never wraps around.
+    uint32_t ways[kNumWays];
+    uint32_t n_valid = 0;
+    for (uint32_t way = 0; way < kNumWays; ++way) {
+      if (set->valid_mask & (1U << way)) { ways[n_valid++] = way; }
+    }
+    std::sort(ways, ways + n_valid,
+              [&](uint32_t a, uint32_t b) { return set->metadata[a] < set->metadata[b]; });
+    for (uint32_t i = 0; i < n_valid; ++i) { set->metadata[ways[i]] = i + 1; }
+    set->clock = n_valid;
+  }
+  set->clock += 1;
+  return set->clock;
+}
+
+template<typename Key>
+void HostCache<Key>::Touch(CacheSet<Key>* set, uint32_t way) {
+  if (policy_ == CacheOptions::Policy::kLRU) {
+    set->metadata[way] = NextTick(set);
+  } else {
+    if (set->metadata[way] >= kLfuMaxFrequency) {
+      // Halve all frequencies of the set, so keys that were hot long ago can age out.
+      for (uint32_t i = 0; i < kNumWays; ++i) { set->metadata[i] >>= 1; }
+    }
+    set->metadata[way] += 1;
+  }
+}
+
+template<typename Key>
+uint32_t HostCache<Key>::Victim(const CacheSet<Key>& set) const {
+  uint32_t victim = 0;
+  for (uint32_t way = 1; way < kNumWays; ++way) {
+    if (set.metadata[way] < set.metadata[victim]) { victim = way; }
+  }
+  return victim;
+}
+
+}  // namespace
+
+std::unique_ptr<Cache> NewHostCache(const CacheOptions& options) {
+  if (options.key_size == sizeof(uint32_t)) {
+    return std::unique_ptr<Cache>(new HostCache<uint32_t>(options));
+  } else if (options.key_size == sizeof(uint64_t)) {
+    return std::unique_ptr<Cache>(new HostCache<uint64_t>(options));
+  } else {
+    UNIMPLEMENTED();
+    return nullptr;
+  }
+}
+
+}  // namespace embedding
+
+}  // namespace oneflow
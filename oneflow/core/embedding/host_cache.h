@@ -0,0 +1,33 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_EMBEDDING_HOST_CACHE_H_
+#define ONEFLOW_CORE_EMBEDDING_HOST_CACHE_H_
+
+#include "oneflow/core/embedding/cache.h"
+
+namespace oneflow {
+
+namespace embedding {
+
+// A set-associative cache living entirely in host memory, queried from CPU streams. Keys, values,
+// counts and indices passed to it are all host pointers.
+std::unique_ptr<Cache> NewHostCache(const CacheOptions& options);
+
+}  // namespace embedding
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_EMBEDDING_HOST_CACHE_H_
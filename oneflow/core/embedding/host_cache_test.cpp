@@ -0,0 +1,195 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/embedding/host_cache.h"
+#include <gtest/gtest.h>
+#include "oneflow/core/ep/include/device_manager_registry.h"
+
+namespace oneflow {
+
+namespace embedding {
+
+namespace {
+
+CacheOptions GetHostCacheOptions(CacheOptions::Policy policy, uint32_t line_size,
+                                 uint64_t capacity) {
+  CacheOptions options{};
+  options.policy = policy;
+  options.value_size = line_size * sizeof(float);
+  options.capacity = capacity;
+  options.key_size = sizeof(int64_t);
+  options.value_memory_kind = CacheOptions::MemoryKind::kHost;
+  return options;
+}
+
+void TestHostCache(Cache* cache, uint32_t line_size) {
+  std::unique_ptr<ep::DeviceManagerRegistry> device_manager_registry(
+      new ep::DeviceManagerRegistry());
+  auto device = device_manager_registry->GetDevice(DeviceType::kCPU, 0);
+  ep::Stream* stream = device->CreateStream();
+
+  std::unordered_set<int64_t> in_cache;
+  const size_t n_iter = 32;
+  const uint32_t n_keys = 1024;
+  std::vector<int64_t> keys(n_keys);
+  uint32_t n_missing = 0;
+  std::vector<int64_t> missing_keys(n_keys);
+  std::vector<uint32_t> missing_indices(n_keys);
+  std::vector<float> values(n_keys * line_size);
+  uint32_t n_evicted = 0;
+  std::vector<int64_t> evicted_keys(n_keys);
+  std::vector<float> evicted_values(n_keys * line_size);
+  std::vector<int64_t> random_keys(n_keys * 32);
+  std::iota(random_keys.begin(), random_keys.end(), 1);
+  std::random_device rd;
+  std::mt19937 g(rd());
+  for (size_t iter = 0; iter < n_iter; ++iter) {
+    std::shuffle(random_keys.begin(), random_keys.end(), g);
+    std::copy(random_keys.begin(), random_keys.begin() + n_keys, keys.begin());
+    std::unordered_set<int64_t> expect_missing_keys_set;
+    std::unordered_set<int64_t> keys_set;
+    for (size_t i = 0; i < n_keys; ++i) {
+      keys_set.emplace(keys[i]);
+      if (in_cache.count(keys[i]) == 0) { expect_missing_keys_set.emplace(keys[i]); }
+    }
+    // test
+    cache->Test(stream, n_keys, keys.data(), &n_missing, missing_keys.data(),
+                missing_indices.data());
+    ASSERT_EQ(n_missing, expect_missing_keys_set.size());
+    std::unordered_set<int64_t> test_missing_keys_set;
+    for (size_t i = 0; i < n_missing; ++i) {
+      test_missing_keys_set.emplace(missing_keys[i]);
+      ASSERT_EQ(keys[missing_indices[i]], missing_keys[i]);
+    }
+    ASSERT_EQ(test_missing_keys_set, expect_missing_keys_set);
+
+    // get
+    cache->Get(stream, n_keys, keys.data(), values.data(), &n_missing, missing_keys.data(),
+               missing_indices.data());
+    ASSERT_EQ(n_missing, expect_missing_keys_set.size());
+    std::unordered_set<int64_t> get_missing_keys_set;
+    for (size_t i = 0; i < n_missing; ++i) {
+      get_missing_keys_set.emplace(missing_keys[i]);
+      ASSERT_EQ(keys[missing_indices[i]], missing_keys[i]);
+    }
+    ASSERT_EQ(get_missing_keys_set, expect_missing_keys_set);
+    for (size_t i = 0; i < n_keys; ++i) {
+      if (get_missing_keys_set.count(keys[i]) == 0) {
+        for (size_t j = 0; j < line_size; ++j) {
+          ASSERT_EQ(values[i * line_size + j], static_cast<float>(keys[i] * line_size + j));
+        }
+      }
+    }
+
+    // put
+    for (size_t i = 0; i < n_keys; ++i) {
+      for (size_t j = 0; j < line_size; ++j) {
+        values[i * line_size + j] = static_cast<float>(keys[i] * line_size + j);
+      }
+    }
+    cache->Put(stream, n_keys, keys.data(), values.data(), &n_evicted, evicted_keys.data(),
+               evicted_values.data());
+    for (size_t i = 0; i < n_evicted; ++i) {
+      ASSERT_TRUE(in_cache.count(evicted_keys[i]) > 0 || keys_set.count(evicted_keys[i]) > 0);
+      for (size_t j = 0; j < line_size; ++j) {
+        ASSERT_EQ(evicted_values[i * line_size + j],
+                  static_cast<float>(evicted_keys[i] * line_size + j));
+      }
+    }
+    for (size_t i = 0; i < n_keys; ++i) { in_cache.emplace(keys[i]); }
+    for (size_t i = 0; i < n_evicted; ++i) { in_cache.erase(evicted_keys[i]); }
+  }
+  const uint64_t dump_capacity = cache->DumpCapacity();
+  for (size_t start_key_index = 0; start_key_index < dump_capacity; start_key_index += n_keys) {
+    cache->Dump(stream, start_key_index, std::min(start_key_index + n_keys, dump_capacity),
+                &n_evicted, evicted_keys.data(), evicted_values.data());
+    for (size_t i = 0; i < n_evicted; ++i) {
+      ASSERT_TRUE(in_cache.count(evicted_keys[i]) > 0);
+      in_cache.erase(evicted_keys[i]);
+      for (size_t j = 0; j < line_size; ++j) {
+        ASSERT_EQ(evicted_values[i * line_size + j],
+                  static_cast<float>(evicted_keys[i] * line_size + j));
+      }
+    }
+  }
+  ASSERT_EQ(in_cache.size(), 0);
+  CacheStatistics statistics;
+  cache->GetStatistics(&statistics);
+  ASSERT_EQ(statistics.num_queries, n_iter * n_keys);
+  ASSERT_LE(statistics.num_hits, statistics.num_queries);
+  ASSERT_GT(statistics.num_evictions, 0);
+  device->DestroyStream(stream);
+}
+
+TEST(HostCache, LruCache) {
+  const uint32_t line_size = 32;
+  std::unique_ptr<Cache> cache(
+      NewHostCache(GetHostCacheOptions(CacheOptions::Policy::kLRU, line_size, 16384)));
+  cache->ReserveQueryLength(65536);
+  TestHostCache(cache.get(), line_size);
+}
+
+TEST(HostCache, LfuCache) {
+  const uint32_t line_size = 32;
+  std::unique_ptr<Cache> cache(
+      NewHostCache(GetHostCacheOptions(CacheOptions::Policy::kLFU, line_size, 16384)));
+  cache->ReserveQueryLength(65536);
+  TestHostCache(cache.get(), line_size);
+}
+
+TEST(HostCache, LfuKeepsFrequentKeys) {
+  std::unique_ptr<ep::DeviceManagerRegistry> device_manager_registry(
+      new ep::DeviceManagerRegistry());
+  auto device = device_manager_registry->GetDevice(DeviceType::kCPU, 0);
+  ep::Stream* stream = device->CreateStream();
+  const uint32_t line_size = 4;
+  const uint32_t n_keys = 1024;
+  std::unique_ptr<Cache> cache(
+      NewHostCache(GetHostCacheOptions(CacheOptions::Policy::kLFU, line_size, 4 * n_keys)));
+  cache->ReserveQueryLength(n_keys);
+  std::vector<int64_t> keys(n_keys);
+  std::vector<float> values(n_keys * line_size);
+  uint32_t n_missing = 0;
+  std::vector<int64_t> missing_keys(n_keys);
+  std::vector<uint32_t> missing_indices(n_keys);
+  uint32_t n_evicted = 0;
+  std::vector<int64_t> evicted_keys(n_keys);
+  std::vector<float> evicted_values(n_keys * line_size);
+  std::iota(keys.begin(), keys.end(), 0);
+  cache->Put(stream, n_keys, keys.data(), values.data(), &n_evicted, evicted_keys.data(),
+             evicted_values.data());
+  for (int i = 0; i < 4; ++i) {
+    cache->Get(stream, n_keys, keys.data(), values.data(), &n_missing, missing_keys.data(),
+               missing_indices.data());
+    ASSERT_EQ(n_missing, 0);
+  }
+  // A scan over many keys touched only once must not flush the frequently read ones.
+  std::vector<int64_t> scan_keys(n_keys);
+  for (int64_t start = n_keys; start < 32 * n_keys; start += n_keys) {
+    std::iota(scan_keys.begin(), scan_keys.end(), start);
+    cache->Put(stream, n_keys, scan_keys.data(), values.data(), &n_evicted, evicted_keys.data(),
+               evicted_values.data());
+  }
+  cache->Test(stream, n_keys, keys.data(), &n_missing, missing_keys.data(),
+              missing_indices.data());
+  ASSERT_EQ(n_missing, 0);
+  device->DestroyStream(stream);
+}
+
+}  // namespace
+
+}  // namespace embedding
+
+}  // namespace oneflow
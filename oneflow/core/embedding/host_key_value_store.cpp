@@ -0,0 +1,352 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/embedding/host_key_value_store.h"
+#include "oneflow/core/embedding/persistent_table.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/core/ep/include/device_manager_registry.h"
+
+namespace oneflow {
+
+namespace embedding {
+
+namespace {
+
+void CheckCpuStream(ep::Stream* stream) { CHECK_EQ(stream->device_type(), DeviceType::kCPU); }
+
+uint64_t KeyAt(const void* keys, uint32_t key_size, uint32_t index) {
+  if (key_size == sizeof(uint32_t)) { return static_cast<const uint32_t*>(keys)[index]; }
+  return static_cast<const uint64_t*>(keys)[index];
+}
+
+class HostIteratorImpl : public KVIterator {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(HostIteratorImpl);
+  HostIteratorImpl(PersistentTable::Iterator* base_iter, uint32_t max_query_length)
+      : base_iter_(base_iter), max_query_length_(max_query_length) {}
+  ~HostIteratorImpl() override = default;
+
+  void NextN(ep::Stream* stream, uint32_t n_request, uint32_t* n_result, void* keys,
+             void* values) override {
+    CheckCpuStream(stream);
+    CHECK_LE(n_request, max_query_length_);
+    base_iter_->Next(n_request, n_result, keys, values);
+  }
+
+  void Reset() override { base_iter_->Reset(); }
+
+ private:
+  PersistentTable::Iterator* base_iter_;
+  uint32_t max_query_length_;
+};
+
+class HostPersistentTableKeyValueStore : public KeyValueStore {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(HostPersistentTableKeyValueStore);
+  explicit HostPersistentTableKeyValueStore(const PersistentTableKeyValueStoreOptions& options)
+      : key_size_(options.table_options.key_size),
+        value_size_(options.table_options.value_size),
+        max_query_length_(0) {
+    table_ = NewPersistentTable(options.table_options);
+  }
+  ~HostPersistentTableKeyValueStore() override = default;
+
+  uint32_t KeySize() const override { return key_size_; }
+  uint32_t ValueSize() const override { return value_size_; }
+  uint32_t MaxQueryLength() const override { return max_query_length_; }
+  void ReserveQueryLength(uint32_t query_length) override {
+    max_query_length_ = std::max(max_query_length_, query_length);
+  }
+
+  void Get(ep::Stream* stream, uint32_t num_keys, const void* keys, void* values,
+           uint32_t* n_missing, uint32_t* missing_indices) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CheckCpuStream(stream);
+    CHECK_LE(num_keys, max_query_length_);
+    if (num_keys == 0) {
+      *n_missing = 0;
+      return;
+    }
+    table_->Get(num_keys, keys, values, n_missing, missing_indices);
+  }
+
+  void Put(ep::Stream* stream, uint32_t num_keys, const void* keys, const void* values) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CheckCpuStream(stream);
+    CHECK_LE(num_keys, max_query_length_);
+    if (num_keys == 0) { return; }
+    table_->Put(num_keys, keys, values);
+  }
+
+  void Prefetch(uint32_t num_keys, const void* keys) override { table_->Prefetch(num_keys, keys); }
+  bool SnapshotExists(const std::string& name) override { return table_->SnapshotExists(name); }
+  void LoadSnapshot(const std::string& name) override { LoadSnapshot(name, nullptr); }
+
+  void LoadSnapshot(const std::string& name,
+                    const std::function<void(KVIterator* iter)>& Hook) override {
+    if (Hook) {
+      table_->LoadSnapshot(name, [&](PersistentTable::Iterator* chunk_iterator) {
+        HostIteratorImpl iterator(chunk_iterator, max_query_length_);
+        Hook(&iterator);
+      });
+    } else {
+      table_->LoadSnapshot(name);
+    }
+  }
+
+  void SaveSnapshot(const std::string& name) override { table_->SaveSnapshot(name); }
+  void SaveDeltaSnapshot(const std::string& name, const std::string& base) override {
+    table_->SaveDeltaSnapshot(name, base);
+  }
+  void MergeSnapshot(const std::string& name, const std::string& merged_name) override {
+    table_->MergeSnapshot(name, merged_name);
+  }
+
+ private:
+  uint32_t key_size_;
+  uint32_t value_size_;
+  uint32_t max_query_length_;
+  std::mutex mutex_;
+  std::unique_ptr<PersistentTable> table_;
+};
+
+class HostCachedKeyValueStore : public KeyValueStore {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(HostCachedKeyValueStore);
+  HostCachedKeyValueStore(std::unique_ptr<KeyValueStore>&& store, std::unique_ptr<Cache>&& cache)
+      : store_(std::move(store)), cache_(std::move(cache)), max_query_length_(0), synced_(true) {
+    CHECK_EQ(store_->KeySize(), cache_->KeySize());
+    CHECK_EQ(store_->ValueSize(), cache_->ValueSize());
+  }
+  ~HostCachedKeyValueStore() override {
+    cache_.reset();
+    store_.reset();
+  }
+
+  uint32_t KeySize() const override { return store_->KeySize(); }
+  uint32_t ValueSize() const override { return store_->ValueSize(); }
+  uint32_t MaxQueryLength() const override { return max_query_length_; }
+
+  void ReserveQueryLength(uint32_t query_length) override {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    if (query_length <= max_query_length_) { return; }
+    if (query_length > cache_->MaxQueryLength()) { cache_->ReserveQueryLength(query_length); }
+    if (query_length > store_->MaxQueryLength()) { store_->ReserveQueryLength(query_length); }
+    keys_buffer_.resize(static_cast<size_t>(query_length) * store_->KeySize());
+    values_buffer_.resize(static_cast<size_t>(query_length) * store_->ValueSize());
+    store_values_.resize(static_cast<size_t>(query_length) * store_->ValueSize());
+    rejected_keys_buffer_.resize(static_cast<size_t>(query_length) * store_->KeySize());
+    rejected_values_buffer_.resize(static_cast<size_t>(query_length) * store_->ValueSize());
+    indices_buffer0_.resize(query_length);
+    indices_buffer1_.resize(query_length);
+    max_query_length_ = query_length;
+  }
+
+  void Get(ep::Stream* stream, uint32_t num_keys, const void* keys, void* values,
+           uint32_t* n_missing, uint32_t* missing_indices) override;
+  void Put(ep::Stream* stream, uint32_t num_keys, const void* keys, const void* values) override;
+  void Prefetch(uint32_t num_keys, const void* keys) override { store_->Prefetch(num_keys, keys); }
+  bool SnapshotExists(const std::string& name) override { return store_->SnapshotExists(name); }
+  void LoadSnapshot(const std::string& name) override { LoadSnapshot(name, nullptr); }
+  void LoadSnapshot(const std::string& name,
+                    const std::function<void(KVIterator* iter)>& Hook) override;
+  void SaveSnapshot(const std::string& name) override;
+  void SaveDeltaSnapshot(const std::string& name, const std::string& base) override;
+  void MergeSnapshot(const std::string& name, const std::string& merged_name) override {
+    // Snapshots on disk do not depend on the cache, there is nothing to sync.
+    store_->MergeSnapshot(name, merged_name);
+  }
+
+ private:
+  void SyncCacheToStore();
+
+  std::unique_ptr<KeyValueStore> store_;
+  std::unique_ptr<Cache> cache_;
+
+  std::vector<char> keys_buffer_;
+  std::vector<char> values_buffer_;
+  // The values the last Get read from the store, by key. A key the cache turns away is only
+  // written back when its value differs from the one read.
+  std::vector<char> store_values_;
+  std::unordered_map<uint64_t, uint32_t> store_value_index_;
+  std::vector<char> rejected_keys_buffer_;
+  std::vector<char> rejected_values_buffer_;
+  std::vector<uint32_t> indices_buffer0_;
+  std::vector<uint32_t> indices_buffer1_;
+  uint32_t max_query_length_;
+  std::recursive_mutex mutex_;
+  bool synced_;
+};
+
+void HostCachedKeyValueStore::Get(ep::Stream* stream, uint32_t num_keys, const void* keys,
+                                  void* values, uint32_t* n_missing, uint32_t* missing_indices) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  CheckCpuStream(stream);
+  if (cache_->Policy() == CacheOptions::Policy::kFull) {
+    cache_->Get(stream, num_keys, keys, values, n_missing, keys_buffer_.data(), missing_indices);
+    return;
+  }
+  uint32_t num_cache_missing = 0;
+  cache_->Get(stream, num_keys, keys, values, &num_cache_missing, keys_buffer_.data(),
+              indices_buffer0_.data());
+  if (num_cache_missing == 0) {
+    *n_missing = 0;
+    return;
+  }
+  store_->Get(stream, num_cache_missing, keys_buffer_.data(), store_values_.data(), n_missing,
+              indices_buffer1_.data());
+  const uint32_t key_size = KeySize();
+  store_value_index_.clear();
+  for (uint32_t i = 0; i < num_cache_missing; ++i) {
+    store_value_index_[KeyAt(keys_buffer_.data(), key_size, i)] = i;
+  }
+  for (uint32_t i = 0; i < *n_missing; ++i) {
+    store_value_index_.erase(KeyAt(keys_buffer_.data(), key_size, indices_buffer1_[i]));
+  }
+  // Scatters the values found in the store to the rows of values that missed the cache, and maps
+  // the indices of the store misses back to indices of keys.
+  const size_t value_size = ValueSize();
+  const uint32_t* cache_missing_indices = indices_buffer0_.data();
+  const char* store_values = store_values_.data();
+  char* dst_values = static_cast<char*>(values);
+  stream->As<ep::CpuStream>()->ParallelFor(
+      0, num_cache_missing,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+          std::memcpy(dst_values + cache_missing_indices[i] * value_size,
+                      store_values + i * value_size, value_size);
+        }
+      },
+      ep::GetParallelForGrainSize(value_size * ep::parallel_for_cost::kIndexed));
+  for (uint32_t i = 0; i < *n_missing; ++i) {
+    missing_indices[i] = cache_missing_indices[indices_buffer1_[i]];
+  }
+}
+
+void HostCachedKeyValueStore::Put(ep::Stream* stream, uint32_t num_keys, const void* keys,
+                                  const void* values) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  CheckCpuStream(stream);
+  synced_ = false;
+  uint32_t num_evicted = 0;
+  uint32_t num_rejected = 0;
+  cache_->PutWithAdmission(stream, num_keys, keys, values, &num_evicted, keys_buffer_.data(),
+                           values_buffer_.data(), &num_rejected, rejected_keys_buffer_.data(),
+                           rejected_values_buffer_.data());
+  if (cache_->Policy() == CacheOptions::Policy::kFull) { return; }
+  // Appends the rejected keys whose values changed since they were read to the evicted ones
+  const uint32_t key_size = KeySize();
+  const size_t value_size = ValueSize();
+  for (uint32_t i = 0; i < num_rejected; ++i) {
+    const char* value = rejected_values_buffer_.data() + i * value_size;
+    const auto it = store_value_index_.find(KeyAt(rejected_keys_buffer_.data(), key_size, i));
+    if (it != store_value_index_.end()
+        && std::memcmp(value, store_values_.data() + it->second * value_size, value_size) == 0) {
+      continue;
+    }
+    std::memcpy(keys_buffer_.data() + num_evicted * key_size,
+                rejected_keys_buffer_.data() + i * key_size, key_size);
+    std::memcpy(values_buffer_.data() + num_evicted * value_size, value, value_size);
+    num_evicted += 1;
+  }
+  // The store may hold other values of the put keys from now on
+  if (!store_value_index_.empty()) {
+    for (uint32_t i = 0; i < num_keys; ++i) { store_value_index_.erase(KeyAt(keys, key_size, i)); }
+  }
+  store_->Put(stream, num_evicted, keys_buffer_.data(), values_buffer_.data());
+}
+
+void HostCachedKeyValueStore::LoadSnapshot(const std::string& name,
+                                           const std::function<void(KVIterator* iter)>& Hook) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  CHECK_GT(max_query_length_, 0);
+  cache_->Clear();
+  store_value_index_.clear();
+  auto device = Global<ep::DeviceManagerRegistry>::Get()->GetDevice(DeviceType::kCPU, 0);
+  CHECK(device);
+  auto* stream = device->CreateStream();
+  store_->LoadSnapshot(name, [&](KVIterator* iter) {
+    if (cache_->Policy() == CacheOptions::Policy::kFull) {
+      while (true) {
+        uint32_t num_keys = 0;
+        iter->NextN(stream, max_query_length_, &num_keys, keys_buffer_.data(),
+                    values_buffer_.data());
+        if (num_keys == 0) { break; }
+        uint32_t num_evicted = 0;
+        cache_->Put(stream, num_keys, keys_buffer_.data(), values_buffer_.data(), &num_evicted,
+                    nullptr, nullptr);
+        CHECK_EQ(num_evicted, 0);
+      }
+    }
+    if (Hook) {
+      iter->Reset();
+      Hook(iter);
+    }
+  });
+  device->DestroyStream(stream);
+  store_->LoadSnapshot(name);
+}
+
+void HostCachedKeyValueStore::SaveSnapshot(const std::string& name) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  SyncCacheToStore();
+  store_->SaveSnapshot(name);
+}
+
+void HostCachedKeyValueStore::SaveDeltaSnapshot(const std::string& name,
+                                                const std::string& base) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  SyncCacheToStore();
+  store_->SaveDeltaSnapshot(name, base);
+}
+
+void HostCachedKeyValueStore::SyncCacheToStore() {
+  if (synced_) { return; }
+  auto device = Global<ep::DeviceManagerRegistry>::Get()->GetDevice(DeviceType::kCPU, 0);
+  CHECK(device);
+  auto* stream = device->CreateStream();
+  const uint64_t dump_capacity = cache_->DumpCapacity();
+  CHECK_GT(max_query_length_, 0);
+  for (uint64_t start_key_index = 0; start_key_index < dump_capacity;
+       start_key_index += max_query_length_) {
+    uint32_t num_dumped = 0;
+    cache_->Dump(stream, start_key_index,
+                 std::min(start_key_index + max_query_length_, dump_capacity), &num_dumped,
+                 keys_buffer_.data(), values_buffer_.data());
+    if (num_dumped == 0) { continue; }
+    store_->Put(stream, num_dumped, keys_buffer_.data(), values_buffer_.data());
+  }
+  device->DestroyStream(stream);
+  synced_ = true;
+}
+
+}  // namespace
+
+std::unique_ptr<KeyValueStore> NewHostPersistentTableKeyValueStore(
+    const PersistentTableKeyValueStoreOptions& options) {
+  const uint32_t key_size = options.table_options.key_size;
+  CHECK(key_size == sizeof(uint32_t) || key_size == sizeof(uint64_t));
+  return std::unique_ptr<KeyValueStore>(new HostPersistentTableKeyValueStore(options));
+}
+
+std::unique_ptr<KeyValueStore> NewHostCachedKeyValueStore(std::unique_ptr<KeyValueStore>&& store,
+                                                          std::unique_ptr<Cache>&& cache) {
+  return std::unique_ptr<KeyValueStore>(
+      new HostCachedKeyValueStore(std::move(store), std::move(cache)));
+}
+
+}  // namespace embedding
+
+}  // namespace oneflow
@@ -38,11 +38,19 @@ class KeyValueStore {
   virtual void Get(ep::Stream* stream, uint32_t num_keys, const void* keys, void* values,
                    uint32_t* n_missing, uint32_t* missing_indices) = 0;
   virtual void Put(ep::Stream* stream, uint32_t num_keys, const void* keys, const void* values) = 0;
+  // Starts staging the values of keys that are about to be queried, e.g. the ids of the next
+  // batch, without blocking the caller. keys is a host pointer. Stores that have no slow level to
+  // read ahead from ignore it.
+  virtual void Prefetch(uint32_t num_keys, const void* keys) {}
   virtual bool SnapshotExists(const std::string& name) = 0;
   virtual void LoadSnapshot(const std::string& name) = 0;
   virtual void LoadSnapshot(const std::string& name,
                             const std::function<void(KVIterator* iter)>& Hook) = 0;
   virtual void SaveSnapshot(const std::string& name) = 0;
+  // Saves only what changed since snapshot `base`, the last one saved or loaded.
+  virtual void SaveDeltaSnapshot(const std::string& name, const std::string& base) = 0;
+  // Rewrites snapshot `name` and the snapshots it is based on as one full snapshot `merged_name`.
+  virtual void MergeSnapshot(const std::string& name, const std::string& merged_name) = 0;
 };
 
 }  // namespace embedding
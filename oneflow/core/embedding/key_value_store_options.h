@@ -18,6 +18,7 @@ limitations under the License.
 #include "nlohmann/json.hpp"
 #include "oneflow/core/job/resource_desc.h"
 #include "oneflow/core/embedding/cache.h"
+#include "oneflow/core/embedding/value_codec.h"
 
 namespace oneflow {
 namespace embedding {
@@ -34,6 +35,11 @@ void ParseCacheOptions(const nlohmann::json& cache_obj, CacheOptions* cache_opti
     cache_options->policy = CacheOptions::Policy::kLRU;
   } else if (policy == "full") {
     cache_options->policy = CacheOptions::Policy::kFull;
+  } else if (policy == "lfu") {
+    cache_options->policy = CacheOptions::Policy::kLFU;
+  } else if (policy == "tinylfu") {
+    cache_options->policy = CacheOptions::Policy::kLRU;
+    cache_options->admission_policy = CacheOptions::AdmissionPolicy::kTinyLFU;
   } else {
     UNIMPLEMENTED() << "Unsupported cache policy";
   }
@@ -50,6 +56,10 @@ void ParseCacheOptions(const nlohmann::json& cache_obj, CacheOptions* cache_opti
       capacity = cache_memory_budget_mb * 1024 * 1024 / cache_options->value_size;
     }
   }
+  if (cache_obj.contains("admission_min_frequency")) {
+    CHECK(cache_obj["admission_min_frequency"].is_number());
+    cache_options->admission_min_frequency = cache_obj["admission_min_frequency"].get<int64_t>();
+  }
   CHECK_GT(capacity, 0) << "capacity or cache_memory_budget_mb must be set";
   // add an extra_capacity to avoid crash by uneven partition.
   const int64_t extra_capacity = capacity * 0.05;
@@ -94,6 +104,20 @@ class KeyValueStoreOptions final {
     CHECK(json_object["storage_dim"].is_number());
     line_size_ = json_object["storage_dim"].get<int64_t>();
 
+    if (json_object.contains("device")) {
+      CHECK(json_object["device"].is_string());
+      const std::string device = json_object["device"].get<std::string>();
+      if (device == "cpu") {
+        device_type_ = DeviceType::kCPU;
+      } else if (device == "cuda") {
+        device_type_ = DeviceType::kCUDA;
+      } else {
+        UNIMPLEMENTED() << "Unsupported key value store device: " << device;
+      }
+    } else {
+      device_type_ = DeviceType::kCUDA;
+    }
+
     CHECK(json_object.contains("kv_store"));
     auto kv_store = json_object["kv_store"];
 
@@ -140,16 +164,56 @@ class KeyValueStoreOptions final {
     } else {
       persistent_table_capacity_hint_ = 0;
     }
+    if (persistent_table.contains("enable_compaction")) {
+      CHECK(persistent_table["enable_compaction"].is_boolean());
+      persistent_table_enable_compaction_ = persistent_table["enable_compaction"].get<bool>();
+    } else {
+      persistent_table_enable_compaction_ = false;
+    }
+    if (persistent_table.contains("compaction_dead_ratio_threshold")) {
+      CHECK(persistent_table["compaction_dead_ratio_threshold"].is_number());
+      persistent_table_compaction_dead_ratio_threshold_ =
+          persistent_table["compaction_dead_ratio_threshold"].get<float>();
+    } else {
+      persistent_table_compaction_dead_ratio_threshold_ = 0.5;
+    }
+    if (persistent_table.contains("compaction_io_rate_limit_mb")) {
+      CHECK(persistent_table["compaction_io_rate_limit_mb"].is_number());
+      persistent_table_compaction_io_rate_limit_mb_ =
+          persistent_table["compaction_io_rate_limit_mb"].get<int64_t>();
+    } else {
+      persistent_table_compaction_io_rate_limit_mb_ = 64;
+    }
+    if (persistent_table.contains("value_codecs")) {
+      CHECK(persistent_table["value_codecs"].is_array());
+      for (const auto& codec : persistent_table["value_codecs"]) {
+        CHECK(codec.is_string());
+        persistent_table_value_codecs_.push_back(ParseValueCodec(codec.get<std::string>()));
+      }
+      CHECK_EQ(value_type_size_, sizeof(float)) << "Value codecs only apply to float values";
+    }
   }
   ~KeyValueStoreOptions() = default;
   int64_t KeyTypeSize() const { return key_type_size_; }
   int64_t ValueTypeSize() const { return value_type_size_; }
   const std::string& Name() const { return name_; }
   int64_t LineSize() const { return line_size_; }
+  // Device of the streams the store is queried from.
+  DeviceType StoreDeviceType() const { return device_type_; }
   const std::vector<CacheOptions>& GetCachesOptions() const { return cache_options_; }
   const std::vector<std::string>& PersistentTablePaths() const { return persistent_table_paths_; }
   int64_t PersistentTablePhysicalBlockSize() const { return persistent_table_physical_block_size_; }
   int64_t PersistentTableCapacityHint() const { return persistent_table_capacity_hint_; }
+  bool PersistentTableEnableCompaction() const { return persistent_table_enable_compaction_; }
+  float PersistentTableCompactionDeadRatioThreshold() const {
+    return persistent_table_compaction_dead_ratio_threshold_;
+  }
+  int64_t PersistentTableCompactionIoRateLimitMb() const {
+    return persistent_table_compaction_io_rate_limit_mb_;
+  }
+  const std::vector<ValueCodec>& PersistentTableValueCodecs() const {
+    return persistent_table_value_codecs_;
+  }
   bool IsFullCache() const {
     if (cache_options_.size() > 0 && cache_options_.at(0).policy == CacheOptions::Policy::kFull) {
       return true;
@@ -162,9 +226,14 @@ class KeyValueStoreOptions final {
   int64_t value_type_size_;
   std::string name_;
   int64_t line_size_;
+  DeviceType device_type_;
   std::vector<std::string> persistent_table_paths_;
   int64_t persistent_table_physical_block_size_;
   int64_t persistent_table_capacity_hint_;
+  bool persistent_table_enable_compaction_;
+  float persistent_table_compaction_dead_ratio_threshold_;
+  int64_t persistent_table_compaction_io_rate_limit_mb_;
+  std::vector<ValueCodec> persistent_table_value_codecs_;
   std::vector<CacheOptions> cache_options_;
 };
 
@@ -17,6 +17,7 @@ limitations under the License.
 #include "oneflow/core/embedding/cached_key_value_store.h"
 #include "oneflow/core/embedding/mock_key_value_store.h"
 #include "oneflow/core/embedding/cache.h"
+#include "oneflow/core/embedding/host_key_value_store.h"
 #include "oneflow/core/device/cuda_util.h"
 #include <gtest/gtest.h>
 #include "oneflow/core/ep/include/device_manager_registry.h"
@@ -28,8 +29,6 @@ namespace embedding {
 
 namespace {
 
-#ifdef WITH_CUDA
-
 std::string CreateTempDirectory() {
   const char* tmp_env = getenv("TMPDIR");
   const char* tmp_dir = tmp_env == nullptr ? "/tmp" : tmp_env;
@@ -39,6 +38,8 @@ std::string CreateTempDirectory() {
   return std::string(path);
 }
 
+#ifdef WITH_CUDA
+
 bool HasCudaDevice() {
   int device_count = 0;
   if (cudaGetDeviceCount(&device_count) != cudaSuccess) { return false; }
@@ -263,6 +264,198 @@ TEST(MockKeyValueStore, Mock) {
 
 #endif  // WITH_CUDA
 
+void TestHostKeyValueStore(KeyValueStore* store, size_t num_embeddings,
+                           size_t embedding_vec_size) {
+  auto device = Global<ep::DeviceManagerRegistry>::Get()->GetDevice(DeviceType::kCPU, 0);
+  ep::Stream* stream = device->CreateStream();
+  const size_t batch_size = 128;
+  std::vector<uint64_t> keys(num_embeddings);
+  std::vector<float> values(num_embeddings * embedding_vec_size);
+  std::vector<float> values1(num_embeddings * embedding_vec_size);
+  std::vector<uint32_t> missing_indices(batch_size);
+  uint32_t n_missing = 0;
+  for (size_t i = 0; i < num_embeddings; ++i) {
+    keys[i] = i + 1;
+    for (size_t j = 0; j < embedding_vec_size; j++) {
+      values[i * embedding_vec_size + j] = keys[i];
+    }
+  }
+
+  store->SaveSnapshot("init");
+  for (size_t offset = 0; offset < num_embeddings; offset += batch_size) {
+    const size_t num_keys = std::min(batch_size, num_embeddings - offset);
+    store->Get(stream, num_keys, keys.data() + offset,
+               values1.data() + offset * embedding_vec_size, &n_missing, missing_indices.data());
+    ASSERT_EQ(n_missing, num_keys);
+    store->Put(stream, num_keys, keys.data() + offset, values.data() + offset * embedding_vec_size);
+  }
+  store->SaveSnapshot("final");
+
+  store->LoadSnapshot("init");
+  for (size_t offset = 0; offset < num_embeddings; offset += batch_size) {
+    const size_t num_keys = std::min(batch_size, num_embeddings - offset);
+    store->Get(stream, num_keys, keys.data() + offset,
+               values1.data() + offset * embedding_vec_size, &n_missing, missing_indices.data());
+    ASSERT_EQ(n_missing, num_keys);
+  }
+
+  store->LoadSnapshot("final");
+  std::fill(values1.begin(), values1.end(), 0);
+  for (size_t offset = 0; offset < num_embeddings; offset += batch_size) {
+    const size_t num_keys = std::min(batch_size, num_embeddings - offset);
+    store->Get(stream, num_keys, keys.data() + offset,
+               values1.data() + offset * embedding_vec_size, &n_missing, missing_indices.data());
+    ASSERT_EQ(n_missing, 0);
+  }
+  ASSERT_EQ(values1, values);
+  CHECK_JUST(stream->Sync());
+  device->DestroyStream(stream);
+}
+
+PersistentTableKeyValueStoreOptions HostStoreOptions(const std::string& path,
+                                                     uint32_t value_length) {
+  PersistentTableKeyValueStoreOptions options{};
+  options.table_options.path = path;
+  options.table_options.value_size = value_length * sizeof(float);
+  options.table_options.key_size = GetSizeOfDataType(DataType::kUInt64);
+  options.table_options.physical_block_size = 512;
+  return options;
+}
+
+TEST(HostKeyValueStore, PersistentTable) {
+  Global<ep::DeviceManagerRegistry>::New();
+  uint32_t value_length = 128;
+  std::string path = CreateTempDirectory();
+  std::unique_ptr<KeyValueStore> store =
+      NewHostPersistentTableKeyValueStore(HostStoreOptions(path, value_length));
+  store->ReserveQueryLength(128);
+  TestHostKeyValueStore(store.get(), 1024, value_length);
+  store.reset();
+  PosixFile::RecursiveDelete(path);
+  Global<ep::DeviceManagerRegistry>::Delete();
+}
+
+TEST(HostKeyValueStore, LRU) {
+  Global<ep::DeviceManagerRegistry>::New();
+  uint32_t value_length = 128;
+  std::string path = CreateTempDirectory();
+  std::unique_ptr<KeyValueStore> store =
+      NewHostPersistentTableKeyValueStore(HostStoreOptions(path, value_length));
+  CacheOptions cache_options{};
+  cache_options.policy = CacheOptions::Policy::kLRU;
+  cache_options.value_memory_kind = CacheOptions::MemoryKind::kHost;
+  cache_options.value_size = value_length * sizeof(float);
+  cache_options.capacity = 512;
+  cache_options.key_size = 8;
+  std::unique_ptr<KeyValueStore> cached_store =
+      NewHostCachedKeyValueStore(std::move(store), NewCache(cache_options, DeviceType::kCPU));
+  cached_store->ReserveQueryLength(128);
+  TestHostKeyValueStore(cached_store.get(), 1024, value_length);
+  cached_store.reset();
+  PosixFile::RecursiveDelete(path);
+  Global<ep::DeviceManagerRegistry>::Delete();
+}
+
+TEST(HostKeyValueStore, TinyLfuWriteBack) {
+  Global<ep::DeviceManagerRegistry>::New();
+  auto device = Global<ep::DeviceManagerRegistry>::Get()->GetDevice(DeviceType::kCPU, 0);
+  ep::Stream* stream = device->CreateStream();
+  const uint32_t value_length = 128;
+  const uint32_t num_keys = 128;
+  std::string path = CreateTempDirectory();
+  std::unique_ptr<KeyValueStore> store =
+      NewHostPersistentTableKeyValueStore(HostStoreOptions(path, value_length));
+  CacheOptions cache_options{};
+  cache_options.policy = CacheOptions::Policy::kLRU;
+  cache_options.value_memory_kind = CacheOptions::MemoryKind::kHost;
+  cache_options.value_size = value_length * sizeof(float);
+  cache_options.capacity = 512;
+  cache_options.key_size = 8;
+  cache_options.admission_policy = CacheOptions::AdmissionPolicy::kTinyLFU;
+  cache_options.admission_min_frequency = 2;
+  std::unique_ptr<KeyValueStore> cached_store =
+      NewHostCachedKeyValueStore(std::move(store), NewCache(cache_options, DeviceType::kCPU));
+  cached_store->ReserveQueryLength(num_keys);
+  const std::string value_file_path = path + "/values/value-000000000000";
+  std::vector<uint64_t> keys(num_keys);
+  std::iota(keys.begin(), keys.end(), 1);
+  std::vector<float> values(num_keys * value_length, 1);
+  std::vector<float> values1(num_keys * value_length);
+  std::vector<uint32_t> missing_indices(num_keys);
+  uint32_t n_missing = 0;
+
+  // New keys are rejected by the cache and written to the table.
+  cached_store->Put(stream, num_keys, keys.data(), values.data());
+  const size_t table_size = PosixFile(value_file_path, O_RDONLY, 0644).Size();
+  ASSERT_GT(table_size, 0);
+
+  // Putting back the values just read does not write them again.
+  cached_store->Get(stream, num_keys, keys.data(), values1.data(), &n_missing,
+                    missing_indices.data());
+  ASSERT_EQ(n_missing, 0);
+  cached_store->Put(stream, num_keys, keys.data(), values1.data());
+  ASSERT_EQ(PosixFile(value_file_path, O_RDONLY, 0644).Size(), table_size);
+
+  // Changed values are written even though the cache still rejects them.
+  std::fill(values.begin(), values.end(), 2);
+  cached_store->Put(stream, num_keys, keys.data(), values.data());
+  ASSERT_GT(PosixFile(value_file_path, O_RDONLY, 0644).Size(), table_size);
+  cached_store->Get(stream, num_keys, keys.data(), values1.data(), &n_missing,
+                    missing_indices.data());
+  ASSERT_EQ(n_missing, 0);
+  ASSERT_EQ(values1, values);
+  device->DestroyStream(stream);
+  cached_store.reset();
+  PosixFile::RecursiveDelete(path);
+  Global<ep::DeviceManagerRegistry>::Delete();
+}
+
+TEST(HostKeyValueStore, MergeSnapshot) {
+  Global<ep::DeviceManagerRegistry>::New();
+  auto device = Global<ep::DeviceManagerRegistry>::Get()->GetDevice(DeviceType::kCPU, 0);
+  ep::Stream* stream = device->CreateStream();
+  const uint32_t value_length = 128;
+  const uint32_t num_keys = 128;
+  std::string path = CreateTempDirectory();
+  std::unique_ptr<KeyValueStore> store =
+      NewHostPersistentTableKeyValueStore(HostStoreOptions(path, value_length));
+  CacheOptions cache_options{};
+  cache_options.policy = CacheOptions::Policy::kLRU;
+  cache_options.value_memory_kind = CacheOptions::MemoryKind::kHost;
+  cache_options.value_size = value_length * sizeof(float);
+  cache_options.capacity = 512;
+  cache_options.key_size = 8;
+  std::unique_ptr<KeyValueStore> cached_store =
+      NewHostCachedKeyValueStore(std::move(store), NewCache(cache_options, DeviceType::kCPU));
+  cached_store->ReserveQueryLength(num_keys);
+  std::vector<uint64_t> keys(num_keys);
+  std::iota(keys.begin(), keys.end(), 1);
+  std::vector<float> values(num_keys * value_length, 1);
+  std::vector<float> values1(num_keys * value_length);
+  std::vector<uint32_t> missing_indices(num_keys);
+  uint32_t n_missing = 0;
+
+  cached_store->Put(stream, num_keys / 2, keys.data(), values.data());
+  cached_store->SaveSnapshot("base");
+  std::fill(values.begin(), values.end(), 2);
+  cached_store->Put(stream, num_keys, keys.data(), values.data());
+  cached_store->SaveDeltaSnapshot("delta", "base");
+  cached_store->MergeSnapshot("delta", "merged");
+  // The merged snapshot holds every row on its own.
+  PosixFile::RecursiveDelete(PosixFile::JoinPath(path, "snapshots/base"));
+  PosixFile::RecursiveDelete(PosixFile::JoinPath(path, "snapshots/delta"));
+  ASSERT_TRUE(cached_store->SnapshotExists("merged"));
+  cached_store->LoadSnapshot("merged");
+  cached_store->Get(stream, num_keys, keys.data(), values1.data(), &n_missing,
+                    missing_indices.data());
+  ASSERT_EQ(n_missing, 0);
+  ASSERT_EQ(values1, values);
+  device->DestroyStream(stream);
+  cached_store.reset();
+  PosixFile::RecursiveDelete(path);
+  Global<ep::DeviceManagerRegistry>::Delete();
+}
+
 }  // namespace
 
 }  // namespace embedding
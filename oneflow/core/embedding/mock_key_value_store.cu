@@ -136,6 +136,8 @@ class KeyValueStoreImpl : public KeyValueStore {
   void LoadSnapshot(const std::string& name,
                     const std::function<void(KVIterator* iter)>& Hook) override;
   void SaveSnapshot(const std::string& name) override;
+  void SaveDeltaSnapshot(const std::string& name, const std::string& base) override;
+  void MergeSnapshot(const std::string& name, const std::string& merged_name) override;
 
  private:
   int device_index_;
@@ -231,6 +233,22 @@ void KeyValueStoreImpl<Key>::SaveSnapshot(const std::string& name) {
   snapshots_[name] = store_;
 }
 
+template<typename Key>
+void KeyValueStoreImpl<Key>::SaveDeltaSnapshot(const std::string& name, const std::string& base) {
+  // The mock keeps every snapshot in memory, a full copy is as good as a delta.
+  SaveSnapshot(name);
+}
+
+template<typename Key>
+void KeyValueStoreImpl<Key>::MergeSnapshot(const std::string& name,
+                                           const std::string& merged_name) {
+  // Every snapshot of the mock is already full.
+  CudaCurrentDeviceGuard guard(device_index_);
+  CHECK(SnapshotExists(name)) << "Snapshot " << name << " does not exist";
+  HashMap<Key, std::string> merged = snapshots_.at(name);
+  snapshots_[merged_name] = std::move(merged);
+}
+
 }  // namespace
 
 std::unique_ptr<KeyValueStore> NewMockKeyValueStore(const MockKeyValueStoreOptions& options) {
@@ -21,17 +21,15 @@ limitations under the License.
 
 #include "oneflow/core/common/channel.h"
 #include "oneflow/core/embedding/posix_file.h"
+#include "oneflow/core/persistence/posix/io_engine.h"
 #include "oneflow/core/common/blocking_counter.h"
 #include <robin_hood.h>
+#include <shared_mutex>
+#include <deque>
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <dirent.h>
-#include <sys/syscall.h>
-#include <linux/aio_abi.h>
 #include <unistd.h>
-#ifdef WITH_LIBURING
-#include <liburing.h>
-#endif  // WITH_LIBURING
 
 #endif  // __linux__
 
@@ -44,9 +42,6 @@ namespace embedding {
 namespace {
 
 constexpr uint32_t kDefaultNumWorkerThreads = 4;
-constexpr uint32_t kRingQueueDepth = 128;
-constexpr uint32_t kRingSubmitBatch = 32;
-constexpr uint32_t kAioQueueDepth = 128;
 constexpr uint32_t kChunkNameSuffixLength = 12;
 constexpr char const* kKeyFileNamePrefix = "key-";
 constexpr char const* kIndexFileNamePrefix = "index-";
@@ -54,13 +49,27 @@ constexpr char const* kValueFileNamePrefix = "value-";
 constexpr char const* kLockFileName = "LOCK";
 constexpr char const* kKeySizeFileName = "KEY_SIZE";
 constexpr char const* kValueSizeFileName = "VALUE_SIZE";
+constexpr char const* kValueCodecsFileName = "VALUE_CODECS";
 constexpr char const* kPhysicalBlockSizeFileName = "PHYSICAL_BLOCK_SIZE";
 constexpr char const* kNumLogicalBlocksPerChunkFileName = "NUM_LOGICAL_BLOCKS_PER_CHUNK";
 constexpr char const* kKeysDirName = "keys";
 constexpr char const* kValuesDirName = "values";
 constexpr char const* kSnapshotsDirName = "snapshots";
 constexpr char const* kSnapshotListFileName = "LIST";
+constexpr char const* kSnapshotHashIndexFileName = "HASH_INDEX";
+constexpr char const* kSnapshotBaseFileName = "BASE";
+constexpr uint64_t kHashIndexMagic = 0x584544494854504FULL;
+constexpr uint32_t kHashIndexVersion = 1;
+constexpr uint64_t kInvalidRowId = std::numeric_limits<uint64_t>::max();
 constexpr size_t kParallelForStride = 256;
+constexpr uint32_t kCompactionBatchSize = 4096;
+constexpr uint64_t kDefaultCompactionIntervalMs = 60 * 1000;
+// Prefetched values that have not been read by the time this many newer prefetches arrived are
+// dropped, so that keys the caller never queries do not pile up.
+constexpr uint64_t kMaxPrefetchGenerations = 2;
+// Prefetch requests queued behind this many are dropped, oldest first, so that a caller that
+// prefetches faster than the table reads does not pile them up.
+constexpr size_t kMaxPrefetchQueueLength = 4;
 
 template<typename T>
 T* BytesOffset(T* ptr, size_t bytes) {
@@ -87,6 +96,26 @@ void InitOrCheckMetaValue(const std::string& pathname, int64_t expected, bool in
   }
 }
 
+// Tables without value codecs have no codecs file, so that tables created before codecs existed
+// are still accepted.
+void InitOrCheckValueCodecs(const std::string& pathname, const std::string& expected, bool init) {
+  bool exists = PosixFile::FileExists(pathname);
+  if (init) {
+    CHECK(!exists) << pathname;
+    if (!expected.empty()) {
+      std::ofstream ofs(pathname);
+      ofs << expected << std::endl;
+    }
+  } else {
+    std::string value;
+    if (exists) {
+      std::ifstream ifs(pathname);
+      ifs >> value;
+    }
+    if (value != expected) { LOG(FATAL) << "Check failed: " << pathname; }
+  }
+}
+
 std::string GetChunkName(uint64_t chunk_id) {
   const std::string chunk_name_wo_leading_zero = std::to_string(chunk_id);
   CHECK_LE(chunk_name_wo_leading_zero.size(), kChunkNameSuffixLength);
@@ -120,6 +149,24 @@ void ListChunkFiles(const std::string& base, const std::string& prefix,
   PCHECK(closedir(dir) == 0);
 }
 
+void ListSnapshotChunkIds(const std::string& snapshots_dir, const std::string& prefix,
+                          std::unordered_set<uint64_t>* chunk_ids) {
+  if (!PosixFile::FileExists(snapshots_dir)) { return; }
+  DIR* dir = opendir(snapshots_dir.c_str());
+  PCHECK(dir != nullptr);
+  struct dirent* ent = nullptr;
+  while ((ent = readdir(dir)) != nullptr) {
+    if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) { continue; }
+    const std::string snapshot_dir = PosixFile::JoinPath(snapshots_dir, ent->d_name);
+    std::ifstream list_if(PosixFile::JoinPath(snapshot_dir, kSnapshotListFileName));
+    std::string index_filename;
+    while (std::getline(list_if, index_filename)) {
+      chunk_ids->insert(GetChunkId(index_filename, prefix));
+    }
+  }
+  PCHECK(closedir(dir) == 0);
+}
+
 uint32_t GetLogicalBlockSize(uint32_t physical_block_size, uint32_t value_size) {
   return physical_block_size >= value_size ? physical_block_size
                                            : RoundUp(value_size, physical_block_size);
@@ -146,6 +193,232 @@ class AlignedBuffer final {
   std::unique_ptr<char> ptr_;
 };
 
+struct HashIndexHeader {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t key_size;
+  uint64_t num_slots;
+  uint64_t num_entries;
+  uint64_t reserved[4];
+};
+
+static_assert(sizeof(HashIndexHeader) == 64, "");
+
+// A shared mutex that does not let a steady stream of readers starve writers, which
+// std::shared_timed_mutex does not guarantee. A writer keeps the gate closed from the moment it
+// starts waiting, so new readers queue up behind it.
+class SharedMutex final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(SharedMutex);
+  SharedMutex() = default;
+  ~SharedMutex() = default;
+
+  void lock() {
+    gate_.lock();
+    mutex_.lock();
+  }
+
+  void unlock() {
+    mutex_.unlock();
+    gate_.unlock();
+  }
+
+  void lock_shared() {
+    std::lock_guard<std::mutex> gate_lock(gate_);
+    mutex_.lock_shared();
+  }
+
+  void unlock_shared() { mutex_.unlock_shared(); }
+
+ private:
+  std::mutex gate_;
+  std::shared_timed_mutex mutex_;
+};
+
+// Scratch buffers of a single Get, pooled so that concurrent readers never share them.
+struct GetContext {
+  OF_DISALLOW_COPY_AND_MOVE(GetContext);
+  explicit GetContext(size_t alignment) : blocks_buffer(alignment) {}
+  ~GetContext() = default;
+
+  std::vector<uint32_t> offsets_buffer;
+  AlignedBuffer blocks_buffer;
+  std::vector<uint32_t> pending_indices;
+  std::vector<uint32_t> pending_missing_indices;
+  std::vector<char> pending_keys;
+  std::vector<char> pending_values;
+};
+
+struct PrefetchedValue {
+  uint64_t slot;
+  uint64_t generation;
+};
+
+template<typename Key>
+struct HashIndexSlot {
+  Key key;
+  uint64_t row_id;
+};
+
+// An open-addressing hash table with linear probing, stored in a snapshot so that it can be mmaped
+// and queried in place instead of being rebuilt entry by entry when the snapshot is loaded.
+template<typename Key>
+class MappedHashIndex final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(MappedHashIndex);
+  explicit MappedHashIndex(const std::string& pathname) {
+    PosixFile file(pathname, O_RDONLY, 0644);
+    const size_t file_size = file.Size();
+    CHECK_GE(file_size, sizeof(HashIndexHeader));
+    mapped_file_ = PosixMappedFile(std::move(file), file_size, PROT_READ);
+    const auto* header = static_cast<const HashIndexHeader*>(mapped_file_.ptr());
+    CHECK_EQ(header->magic, kHashIndexMagic) << pathname;
+    CHECK_EQ(header->version, kHashIndexVersion) << pathname;
+    CHECK_EQ(header->key_size, sizeof(Key)) << pathname;
+    CHECK_EQ(file_size, sizeof(HashIndexHeader) + header->num_slots * sizeof(HashIndexSlot<Key>))
+        << pathname;
+    num_slots_ = header->num_slots;
+    num_entries_ = header->num_entries;
+    slots_ = BytesOffset(static_cast<const HashIndexSlot<Key>*>(mapped_file_.ptr()),
+                         sizeof(HashIndexHeader));
+    // Lookups are random, readahead would only waste page cache.
+    PCHECK(madvise(mapped_file_.ptr(), file_size, MADV_RANDOM) == 0);
+  }
+  ~MappedHashIndex() = default;
+
+  uint64_t Size() const { return num_entries_; }
+
+  bool Find(const Key& key, uint64_t* row_id) const {
+    const uint64_t mask = num_slots_ - 1;
+    for (uint64_t pos = PersistentTableHash()(key) & mask;; pos = (pos + 1) & mask) {
+      const HashIndexSlot<Key>& slot = slots_[pos];
+      if (slot.row_id == kInvalidRowId) { return false; }
+      if (slot.key == key) {
+        *row_id = slot.row_id;
+        return true;
+      }
+    }
+  }
+
+  template<typename Func>
+  void ForEach(const Func& func) const {
+    for (uint64_t i = 0; i < num_slots_; ++i) {
+      const HashIndexSlot<Key>& slot = slots_[i];
+      if (slot.row_id != kInvalidRowId) { func(slot.key, slot.row_id); }
+    }
+  }
+
+  template<typename ForEachFunc>
+  static void Write(const std::string& pathname, uint64_t num_entries,
+                    const ForEachFunc& for_each) {
+    // Keep the load factor at or below 0.5 so that probe sequences stay short.
+    uint64_t num_slots = 2;
+    while (num_slots < num_entries * 2) { num_slots *= 2; }
+    const size_t file_size = sizeof(HashIndexHeader) + num_slots * sizeof(HashIndexSlot<Key>);
+    // Write to a temporary file and rename it, the index being replaced may still be mapped.
+    const std::string tmp_pathname = pathname + ".tmp";
+    PosixFile file(tmp_pathname, O_CREAT | O_TRUNC | O_RDWR, 0644);
+    file.Truncate(file_size);
+    PosixMappedFile mapped_file(std::move(file), file_size, PROT_READ | PROT_WRITE);
+    auto* header = static_cast<HashIndexHeader*>(mapped_file.ptr());
+    std::memset(header, 0, sizeof(HashIndexHeader));
+    header->magic = kHashIndexMagic;
+    header->version = kHashIndexVersion;
+    header->key_size = sizeof(Key);
+    header->num_slots = num_slots;
+    header->num_entries = num_entries;
+    auto* slots = BytesOffset(static_cast<HashIndexSlot<Key>*>(mapped_file.ptr()),
+                              sizeof(HashIndexHeader));
+    std::memset(slots, 0xFF, num_slots * sizeof(HashIndexSlot<Key>));
+    const uint64_t mask = num_slots - 1;
+    uint64_t count = 0;
+    for_each([&](const Key& key, uint64_t row_id) {
+      CHECK_NE(row_id, kInvalidRowId);
+      uint64_t pos = PersistentTableHash()(key) & mask;
+      while (slots[pos].row_id != kInvalidRowId) { pos = (pos + 1) & mask; }
+      slots[pos].key = key;
+      slots[pos].row_id = row_id;
+      count += 1;
+    });
+    CHECK_EQ(count, num_entries);
+    PCHECK(msync(mapped_file.ptr(), file_size, MS_SYNC) == 0);
+    PCHECK(rename(tmp_pathname.c_str(), pathname.c_str()) == 0);
+  }
+
+ private:
+  PosixMappedFile mapped_file_;
+  const HashIndexSlot<Key>* slots_;
+  uint64_t num_slots_;
+  uint64_t num_entries_;
+};
+
+// Maps keys to row ids. Rows loaded from a snapshot hash index are served from the mmaped index,
+// rows written after loading are kept in an in-memory overlay that shadows the index.
+template<typename Key>
+class RowIdMapping final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(RowIdMapping);
+  RowIdMapping() : num_overlay_only_entries_(0) {}
+  ~RowIdMapping() = default;
+
+  uint64_t Size() const {
+    return (base_ ? base_->Size() : 0) + num_overlay_only_entries_;
+  }
+
+  bool Empty() const { return Size() == 0; }
+
+  void Reserve(uint64_t capacity) { overlay_.reserve(capacity); }
+
+  void Clear() {
+    base_.reset();
+    overlay_.clear();
+    num_overlay_only_entries_ = 0;
+  }
+
+  void ResetBase(std::unique_ptr<MappedHashIndex<Key>>&& base) {
+    Clear();
+    base_ = std::move(base);
+  }
+
+  bool Find(const Key& key, uint64_t* row_id) const {
+    auto it = overlay_.find(key);
+    if (it != overlay_.end()) {
+      *row_id = it->second;
+      return true;
+    }
+    return base_ && base_->Find(key, row_id);
+  }
+
+  // Returns whether the key was already mapped, and if so its previous row id.
+  bool Update(const Key& key, uint64_t row_id, uint64_t* prev_row_id) {
+    auto it = overlay_.find(key);
+    if (it != overlay_.end()) {
+      *prev_row_id = it->second;
+      it->second = row_id;
+      return true;
+    }
+    const bool exists = base_ && base_->Find(key, prev_row_id);
+    if (!exists) { num_overlay_only_entries_ += 1; }
+    overlay_.emplace(key, row_id);
+    return exists;
+  }
+
+  template<typename Func>
+  void ForEach(const Func& func) const {
+    for (const auto& pair : overlay_) { func(pair.first, pair.second); }
+    if (base_) {
+      base_->ForEach([&](const Key& key, uint64_t row_id) {
+        if (overlay_.find(key) == overlay_.end()) { func(key, row_id); }
+      });
+    }
+  }
+
+ private:
+  std::unique_ptr<MappedHashIndex<Key>> base_;
+  robin_hood::unordered_flat_map<Key, uint64_t> overlay_;
+  uint64_t num_overlay_only_entries_;
+};
+
 template<typename Key>
 class ChunkIteratorImpl : public PersistentTable::Iterator {
  public:
@@ -198,103 +471,9 @@ class ChunkIteratorImpl : public PersistentTable::Iterator {
 };
 
 #ifdef WITH_LIBURING
-
-class RingEngine final {
- public:
-  OF_DISALLOW_COPY_AND_MOVE(RingEngine);
-  RingEngine() : ring_{}, pending_submit_(0), num_readings_(0) {
-    PCHECK(io_uring_queue_init(kRingQueueDepth, &ring_, 0) == 0);
-  }
-  ~RingEngine() {
-    WaitUntilDone();
-    io_uring_queue_exit(&ring_);
-  }
-
-  void AsyncPread(int fd, void* buf, size_t count, off_t offset) {
-    if (num_readings_ == kRingQueueDepth) {
-      struct io_uring_cqe* cqe = nullptr;
-      PCHECK(io_uring_wait_cqe(&ring_, &cqe) == 0);
-      CHECK_GE(cqe->res, 0);
-      io_uring_cqe_seen(&ring_, cqe);
-    } else {
-      num_readings_ += 1;
-    }
-    io_uring_sqe* sqe = CHECK_NOTNULL(io_uring_get_sqe(&ring_));
-    io_uring_prep_read(sqe, fd, buf, count, offset);
-    pending_submit_ += 1;
-    if (pending_submit_ == kRingSubmitBatch) {
-      PCHECK(io_uring_submit(&ring_) == pending_submit_);
-      pending_submit_ = 0;
-    }
-  }
-
-  void WaitUntilDone() {
-    if (pending_submit_ > 0) {
-      PCHECK(io_uring_submit(&ring_) == pending_submit_);
-      pending_submit_ = 0;
-    }
-    while (num_readings_ != 0) {
-      struct io_uring_cqe* cqe = nullptr;
-      PCHECK(io_uring_wait_cqe(&ring_, &cqe) == 0);
-      CHECK_GE(cqe->res, 0);
-      io_uring_cqe_seen(&ring_, cqe);
-      num_readings_ -= 1;
-    }
-  }
-
- private:
-  io_uring ring_;
-  uint32_t pending_submit_;
-  uint32_t num_readings_;
-};
-
+using fs::RingEngine;
 #endif  // WITH_LIBURING
-
-class AioEngine final {
- public:
-  OF_DISALLOW_COPY_AND_MOVE(AioEngine);
-  AioEngine() : ctx_{}, num_readings_(0) {
-    PCHECK(syscall(__NR_io_setup, kAioQueueDepth, &ctx_) >= 0);
-    cbs_.resize(kAioQueueDepth);
-    cbs_ptr_.resize(kAioQueueDepth);
-    for (uint32_t i = 0; i < kAioQueueDepth; ++i) { cbs_ptr_[i] = &cbs_[i]; }
-    events_.resize(kAioQueueDepth);
-  }
-  ~AioEngine() {
-    WaitUntilDone();
-    PCHECK(syscall(__NR_io_destroy, ctx_) >= 0);
-  }
-
-  void AsyncPread(int fd, void* buf, size_t count, off_t offset) {
-    if (num_readings_ == kAioQueueDepth) { WaitUntilDone(); }
-    struct iocb* cb = &cbs_.at(num_readings_);
-    cb->aio_fildes = fd;
-    cb->aio_lio_opcode = IOCB_CMD_PREAD;
-    cb->aio_reqprio = 0;
-    cb->aio_buf = reinterpret_cast<uintptr_t>(buf);
-    cb->aio_nbytes = count;
-    cb->aio_offset = offset;
-    const long nr = 1;
-    PCHECK(syscall(__NR_io_submit, ctx_, nr, &cbs_ptr_.at(num_readings_)) >= 0);
-    num_readings_ += 1;
-  }
-
-  void WaitUntilDone() {
-    if (num_readings_ != 0) {
-      PCHECK(syscall(__NR_io_getevents, ctx_, num_readings_, num_readings_, events_.data(), nullptr)
-             >= 0);
-      for (long i = 0; i < num_readings_; ++i) { CHECK_GT(events_.at(i).res, 0); }
-      num_readings_ = 0;
-    }
-  }
-
- private:
-  aio_context_t ctx_;
-  long num_readings_;
-  std::vector<struct iocb> cbs_;
-  std::vector<struct iocb*> cbs_ptr_;
-  std::vector<struct io_event> events_;
-};
+using fs::AioEngine;
 
 constexpr size_t kCacheLineSize = 64;
 
@@ -358,7 +537,12 @@ class PersistentTableImpl : public PersistentTable {
   void LoadSnapshot(const std::string& name,
                     const std::function<void(Iterator* iter)>& Hook) override;
   void SaveSnapshot(const std::string& name) override;
+  void SaveDeltaSnapshot(const std::string& name, const std::string& base) override;
+  void MergeSnapshot(const std::string& name, const std::string& merged_name) override;
   Iterator* ReadSnapshot(const std::string& name) override;
+  void Compact(float dead_ratio_threshold) override;
+  void GetStatistics(PersistentTableStatistics* statistics) override;
+  void Prefetch(uint32_t num_keys, const void* keys) override;
 
  private:
   friend class SnapshotIteratorImpl<Key, Engine>;
@@ -367,9 +551,43 @@ class PersistentTableImpl : public PersistentTable {
   std::string IndexFilePath(const std::string& name, uint64_t chunk_id) const;
   std::string SnapshotDirPath(const std::string& name) const;
   std::string SnapshotListFilePath(const std::string& name) const;
-  void LoadSnapshotImpl(const std::string& name);
+  std::string SnapshotHashIndexFilePath(const std::string& name) const;
+  std::string SnapshotBaseFilePath(const std::string& name) const;
+  std::vector<std::string> SnapshotChain(const std::string& name) const;
+  void ResolveSnapshot(const std::string& name, RowIdMapping<Key>* mapping,
+                       std::vector<uint64_t>* chunk_num_live_values,
+                       const std::function<void(Iterator* iter)>& Hook);
+  void LoadSnapshotIndices(const std::string& name, bool is_delta, RowIdMapping<Key>* mapping,
+                           std::vector<uint64_t>* chunk_num_live_values,
+                           const std::function<void(Iterator* iter)>& Hook);
+  template<typename ForEachFunc>
+  void WriteSnapshot(const std::string& name, const std::string& base, uint64_t num_entries,
+                     const ForEachFunc& for_each);
+  void LoadSnapshotImpl(const std::string& name, const std::function<void(Iterator* iter)>& Hook);
   void SaveSnapshotImpl(const std::string& name);
+  void MarkDirty(uint32_t num_keys, const void* keys);
   void ParallelFor(size_t total, const ForRange<Engine>& for_range);
+  std::unique_ptr<Engine> AcquireCallerEngine();
+  void ReleaseCallerEngine(std::unique_ptr<Engine>&& engine);
+  void GetBlocksImpl(uint32_t num_keys, const void* keys, void* blocks, uint32_t* offsets);
+  void GetImpl(uint32_t num_keys, const void* keys, void* values, uint32_t* n_missing,
+               uint32_t* missing_indices);
+  void PutBlocksImpl(uint32_t num_keys, const void* keys, const void* blocks);
+  void PutImpl(uint32_t num_keys, const void* keys, const void* values);
+  std::unique_ptr<GetContext> AcquireGetContext();
+  void ReleaseGetContext(std::unique_ptr<GetContext>&& context);
+  void UpdateRowId(const Key& key, uint64_t row_id);
+  uint64_t ChunkNumValues(uint64_t chunk_id);
+  void CompactChunk(uint64_t chunk_id);
+  void ReclaimChunks();
+  void ThrottleCompaction(uint64_t io_bytes);
+  void CompactionLoop();
+  bool GetPrefetched(uint32_t num_keys, const void* keys, void* values, uint32_t* n_missing,
+                     uint32_t* missing_indices);
+  void DropPrefetched(uint32_t num_keys, const void* keys);
+  void ClearPrefetched();
+  void ReleasePrefetchedBufferIfEmpty();
+  void PrefetchLoop();
 
   std::string root_dir_;
   std::string keys_dir_;
@@ -384,17 +602,57 @@ class PersistentTableImpl : public PersistentTable {
   uint32_t logical_block_size_;
 
   std::vector<std::unique_ptr<Worker<Engine>>> workers_;
+  // A read that overlaps another one runs on its caller's thread with one of these engines instead
+  // of queueing behind the other read on the shared workers.
+  std::atomic<uint32_t> num_active_reads_;
+  std::mutex caller_engines_mutex_;
+  std::vector<std::unique_ptr<Engine>> caller_engines_;
 
-  std::vector<uint32_t> offsets_buffer_;
   AlignedBuffer blocks_buffer_;
+  std::mutex get_contexts_mutex_;
+  std::vector<std::unique_ptr<GetContext>> get_contexts_;
 
-  std::recursive_mutex mutex_;
+  // Get and GetBlocks only read the mapping and the value files, so they share the lock and run
+  // concurrently. Everything that modifies the table takes it exclusively.
+  SharedMutex mutex_;
   uint64_t physical_table_size_;
-  robin_hood::unordered_flat_map<Key, uint64_t> row_id_mapping_;
+  RowIdMapping<Key> row_id_mapping_;
   std::vector<PosixFile> value_files_;
   PosixFile writable_key_file_;
   uint64_t writable_key_file_chunk_id_;
   PosixFileLockGuard lock_;
+  // Keys written since snapshot delta_base_ was saved or loaded, they make up the next delta.
+  std::string delta_base_;
+  robin_hood::unordered_flat_set<Key> dirty_keys_;
+
+  std::vector<uint64_t> chunk_num_live_values_;
+  uint64_t num_compacted_values_;
+  uint64_t num_reclaimed_chunks_;
+  float compaction_dead_ratio_threshold_;
+  uint64_t compaction_io_rate_limit_;
+  uint64_t compaction_interval_ms_;
+  AlignedBuffer compaction_values_buffer_;
+  std::vector<Key> compaction_keys_buffer_;
+  std::vector<uint32_t> compaction_missing_indices_buffer_;
+  std::atomic<bool> compaction_shutdown_;
+  std::mutex compaction_mutex_;
+  std::condition_variable compaction_cond_;
+  std::thread compaction_thread_;
+
+  std::deque<std::vector<Key>> prefetch_queue_;
+  bool prefetch_shutdown_;
+  std::mutex prefetch_mutex_;
+  std::condition_variable prefetch_cond_;
+  std::thread prefetch_thread_;
+  // Values read ahead by Prefetch. They are only inserted while holding the table lock shared and
+  // dropped by every Put of their keys, so they never go stale.
+  std::mutex prefetched_mutex_;
+  robin_hood::unordered_flat_map<Key, PrefetchedValue> prefetched_values_;
+  std::vector<char> prefetched_values_buffer_;
+  std::vector<uint64_t> free_prefetched_slots_;
+  uint64_t prefetch_generation_;
+  uint64_t num_prefetched_values_;
+  uint64_t num_prefetch_hits_;
 };
 
 template<typename Key, typename Engine>
@@ -404,11 +662,22 @@ PersistentTableImpl<Key, Engine>::PersistentTableImpl(const PersistentTableOptio
       value_size_(options.value_size),
       physical_block_size_(options.physical_block_size),
       logical_block_size_(GetLogicalBlockSize(options.physical_block_size, value_size_)),
+      num_active_reads_(0),
       blocks_buffer_(options.physical_block_size),
-      writable_key_file_chunk_id_(-1) {
+      writable_key_file_chunk_id_(-1),
+      num_compacted_values_(0),
+      num_reclaimed_chunks_(0),
+      compaction_dead_ratio_threshold_(options.compaction_dead_ratio_threshold),
+      compaction_io_rate_limit_(options.compaction_io_rate_limit_mb * 1024 * 1024),
+      compaction_values_buffer_(options.physical_block_size),
+      compaction_shutdown_(false),
+      prefetch_shutdown_(false),
+      prefetch_generation_(0),
+      num_prefetched_values_(0),
+      num_prefetch_hits_(0) {
   const uint64_t capacity_hint = ParseIntegerFromEnv(
       "ONEFLOW_ONE_EMBEDDING_PERSISTENT_TABLE_CAPACITY_HINT", options.capacity_hint);
-  if (capacity_hint > 0) { row_id_mapping_.reserve(capacity_hint); }
+  if (capacity_hint > 0) { row_id_mapping_.Reserve(capacity_hint); }
   PosixFile::RecursiveCreateDirectory(options.path, 0755);
   const std::string lock_filename = PosixFile::JoinPath(options.path, kLockFileName);
   const bool init = !PosixFile::FileExists(lock_filename);
@@ -420,6 +689,8 @@ PersistentTableImpl<Key, Engine>::PersistentTableImpl(const PersistentTableOptio
   num_values_per_chunk_ = num_values_per_block_ * num_logical_blocks_per_chunk_;
   InitOrCheckMetaValue(PosixFile::JoinPath(options.path, kKeySizeFileName), key_size_, init);
   InitOrCheckMetaValue(PosixFile::JoinPath(options.path, kValueSizeFileName), value_size_, init);
+  InitOrCheckValueCodecs(PosixFile::JoinPath(options.path, kValueCodecsFileName),
+                         ValueCodecsToString(options.value_codecs), init);
   InitOrCheckMetaValue(PosixFile::JoinPath(options.path, kPhysicalBlockSizeFileName),
                        options.physical_block_size, init);
   InitOrCheckMetaValue(PosixFile::JoinPath(options.path, kNumLogicalBlocksPerChunkFileName),
@@ -452,10 +723,35 @@ PersistentTableImpl<Key, Engine>::PersistentTableImpl(const PersistentTableOptio
   } else {
     physical_table_size_ = 0;
   }
+  chunk_num_live_values_.resize(value_files_.size());
+  compaction_interval_ms_ =
+      ParseIntegerFromEnv("ONEFLOW_ONE_EMBEDDING_PERSISTENT_TABLE_COMPACTION_INTERVAL_MS",
+                          kDefaultCompactionIntervalMs);
+  if (options.enable_compaction) {
+    CHECK_GT(compaction_dead_ratio_threshold_, 0);
+    CHECK_LE(compaction_dead_ratio_threshold_, 1);
+    compaction_thread_ = std::thread(&PersistentTableImpl<Key, Engine>::CompactionLoop, this);
+  }
 }
 
 template<typename Key, typename Engine>
 PersistentTableImpl<Key, Engine>::~PersistentTableImpl() {
+  if (prefetch_thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(prefetch_mutex_);
+      prefetch_shutdown_ = true;
+    }
+    prefetch_cond_.notify_all();
+    prefetch_thread_.join();
+  }
+  if (compaction_thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(compaction_mutex_);
+      compaction_shutdown_ = true;
+    }
+    compaction_cond_.notify_all();
+    compaction_thread_.join();
+  }
   for (uint32_t tid = 0; tid < workers_.size(); ++tid) { workers_.at(tid)->Shutdown(); }
 }
 
@@ -467,15 +763,78 @@ uint32_t PersistentTableImpl<Key, Engine>::LogicalBlockSize() const {
 template<typename Key, typename Engine>
 void PersistentTableImpl<Key, Engine>::GetBlocks(uint32_t num_keys, const void* keys, void* blocks,
                                                  uint32_t* offsets) {
-  std::lock_guard<std::recursive_mutex> lock(mutex_);
-  ParallelFor(num_keys, [&](Engine* engine, size_t start, size_t end) {
+  std::shared_lock<SharedMutex> lock(mutex_);
+  GetBlocksImpl(num_keys, keys, blocks, offsets);
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::Get(uint32_t num_keys, const void* keys, void* values,
+                                           uint32_t* n_missing, uint32_t* missing_indices) {
+  std::shared_lock<SharedMutex> lock(mutex_);
+  if (GetPrefetched(num_keys, keys, values, n_missing, missing_indices)) { return; }
+  GetImpl(num_keys, keys, values, n_missing, missing_indices);
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::PutBlocks(uint32_t num_keys, const void* keys,
+                                                 const void* blocks) {
+  std::unique_lock<SharedMutex> lock(mutex_);
+  DropPrefetched(num_keys, keys);
+  MarkDirty(num_keys, keys);
+  PutBlocksImpl(num_keys, keys, blocks);
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::Put(uint32_t num_keys, const void* keys,
+                                           const void* values) {
+  std::unique_lock<SharedMutex> lock(mutex_);
+  DropPrefetched(num_keys, keys);
+  MarkDirty(num_keys, keys);
+  PutImpl(num_keys, keys, values);
+}
+
+template<typename Key, typename Engine>
+std::unique_ptr<GetContext> PersistentTableImpl<Key, Engine>::AcquireGetContext() {
+  std::lock_guard<std::mutex> lock(get_contexts_mutex_);
+  if (get_contexts_.empty()) {
+    return std::unique_ptr<GetContext>(new GetContext(physical_block_size_));
+  }
+  std::unique_ptr<GetContext> context = std::move(get_contexts_.back());
+  get_contexts_.pop_back();
+  return context;
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::ReleaseGetContext(std::unique_ptr<GetContext>&& context) {
+  std::lock_guard<std::mutex> lock(get_contexts_mutex_);
+  get_contexts_.push_back(std::move(context));
+}
+
+template<typename Key, typename Engine>
+std::unique_ptr<Engine> PersistentTableImpl<Key, Engine>::AcquireCallerEngine() {
+  std::lock_guard<std::mutex> lock(caller_engines_mutex_);
+  if (caller_engines_.empty()) { return std::unique_ptr<Engine>(new Engine); }
+  std::unique_ptr<Engine> engine = std::move(caller_engines_.back());
+  caller_engines_.pop_back();
+  return engine;
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::ReleaseCallerEngine(std::unique_ptr<Engine>&& engine) {
+  std::lock_guard<std::mutex> lock(caller_engines_mutex_);
+  caller_engines_.push_back(std::move(engine));
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::GetBlocksImpl(uint32_t num_keys, const void* keys,
+                                                     void* blocks, uint32_t* offsets) {
+  const ForRange<Engine> read_range = [&](Engine* engine, size_t start, size_t end) {
     for (uint64_t i = start; i < end; ++i) {
       const Key key = static_cast<const Key*>(keys)[i];
-      auto it = row_id_mapping_.find(key);
-      if (it == row_id_mapping_.end()) {
+      uint64_t id = 0;
+      if (!row_id_mapping_.Find(key, &id)) {
         offsets[i] = logical_block_size_;
       } else {
-        const uint64_t id = it->second;
         const uint64_t block_id = id / num_values_per_block_;
         const uint32_t id_in_block = id - block_id * num_values_per_block_;
         const uint32_t offset_in_block = id_in_block * value_size_;
@@ -488,47 +847,63 @@ void PersistentTableImpl<Key, Engine>::GetBlocks(uint32_t num_keys, const void*
                            logical_block_size_, block_offset);
       }
     }
-  });
+  };
+  if (num_active_reads_.fetch_add(1, std::memory_order_relaxed) == 0) {
+    ParallelFor(num_keys, read_range);
+  } else {
+    std::unique_ptr<Engine> engine = AcquireCallerEngine();
+    read_range(engine.get(), 0, num_keys);
+    engine->WaitUntilDone();
+    ReleaseCallerEngine(std::move(engine));
+  }
+  num_active_reads_.fetch_sub(1, std::memory_order_relaxed);
 }
 
 template<typename Key, typename Engine>
-void PersistentTableImpl<Key, Engine>::Get(uint32_t num_keys, const void* keys, void* values,
-                                           uint32_t* n_missing, uint32_t* missing_indices) {
-  std::lock_guard<std::recursive_mutex> lock(mutex_);
-  offsets_buffer_.resize(num_keys);
+void PersistentTableImpl<Key, Engine>::GetImpl(uint32_t num_keys, const void* keys, void* values,
+                                               uint32_t* n_missing, uint32_t* missing_indices) {
+  std::unique_ptr<GetContext> context = AcquireGetContext();
+  std::vector<uint32_t>& offsets = context->offsets_buffer;
+  offsets.resize(num_keys);
   void* blocks_ptr = nullptr;
   if (value_size_ == logical_block_size_
       && reinterpret_cast<uintptr_t>(values) % physical_block_size_ == 0) {
     blocks_ptr = values;
   } else {
-    blocks_buffer_.Resize(num_keys * logical_block_size_);
-    blocks_ptr = blocks_buffer_.ptr();
+    context->blocks_buffer.Resize(num_keys * logical_block_size_);
+    blocks_ptr = context->blocks_buffer.ptr();
   }
-  GetBlocks(num_keys, keys, blocks_ptr, offsets_buffer_.data());
+  GetBlocksImpl(num_keys, keys, blocks_ptr, offsets.data());
   uint32_t missing_count = 0;
   for (uint32_t i = 0; i < num_keys; ++i) {
-    if (offsets_buffer_.at(i) == logical_block_size_) {
+    if (offsets.at(i) == logical_block_size_) {
       missing_indices[missing_count] = i;
       missing_count += 1;
     } else {
-      if (value_size_ != logical_block_size_) {
-        MemcpyOffset(values, i * value_size_, blocks_ptr,
-                     (i * logical_block_size_) + offsets_buffer_[i], value_size_);
+      if (blocks_ptr != values) {
+        MemcpyOffset(values, i * value_size_, blocks_ptr, (i * logical_block_size_) + offsets[i],
+                     value_size_);
       }
     }
   }
   *n_missing = missing_count;
+  ReleaseGetContext(std::move(context));
 }
 
 template<typename Key, typename Engine>
-void PersistentTableImpl<Key, Engine>::PutBlocks(uint32_t num_keys, const void* keys,
-                                                 const void* blocks) {
-  std::lock_guard<std::recursive_mutex> lock(mutex_);
+void PersistentTableImpl<Key, Engine>::PutBlocksImpl(uint32_t num_keys, const void* keys,
+                                                     const void* blocks) {
   const uint32_t num_blocks = RoundUp(num_keys, num_values_per_block_) / num_values_per_block_;
   const uint32_t num_padded_keys = num_blocks * num_values_per_block_;
   const uint64_t start_index = physical_table_size_;
   physical_table_size_ += num_padded_keys;
   CHECK_EQ(start_index % num_values_per_block_, 0);
+  if (num_padded_keys > 0) {
+    const uint64_t end_chunk_id = (physical_table_size_ - 1) / num_values_per_chunk_;
+    if (chunk_num_live_values_.size() <= end_chunk_id) {
+      chunk_num_live_values_.resize(end_chunk_id + 1);
+    }
+  }
   const uint64_t start_block_id = start_index / num_values_per_block_;
   uint64_t written_blocks = 0;
   const uint64_t block_keys_size = num_values_per_block_ * sizeof(Key);
@@ -571,15 +946,14 @@ void PersistentTableImpl<Key, Engine>::PutBlocks(uint32_t num_keys, const void*
     bc.Decrease();
   });
   for (uint64_t i = 0; i < num_keys; ++i) {
-    row_id_mapping_[static_cast<const Key*>(keys)[i]] = start_index + i;
+    UpdateRowId(static_cast<const Key*>(keys)[i], start_index + i);
   }
   bc.WaitForeverUntilCntEqualZero();
 }
 
 template<typename Key, typename Engine>
-void PersistentTableImpl<Key, Engine>::Put(uint32_t num_keys, const void* keys,
-                                           const void* values) {
-  std::lock_guard<std::recursive_mutex> lock(mutex_);
+void PersistentTableImpl<Key, Engine>::PutImpl(uint32_t num_keys, const void* keys,
+                                               const void* values) {
   const void* blocks_ptr = nullptr;
   if (value_size_ == logical_block_size_
       && reinterpret_cast<uintptr_t>(values) % physical_block_size_ == 0) {
@@ -597,7 +971,7 @@ void PersistentTableImpl<Key, Engine>::Put(uint32_t num_keys, const void* keys,
     }
     blocks_ptr = blocks_buffer_.ptr();
   }
-  PutBlocks(num_keys, keys, blocks_ptr);
+  PutBlocksImpl(num_keys, keys, blocks_ptr);
 }
 
 template<typename Key, typename Engine>
@@ -627,11 +1001,67 @@ std::string PersistentTableImpl<Key, Engine>::SnapshotListFilePath(const std::st
 }
 
 template<typename Key, typename Engine>
-void PersistentTableImpl<Key, Engine>::LoadSnapshotImpl(const std::string& name) {
-  std::lock_guard<std::recursive_mutex> lock(mutex_);
+std::string PersistentTableImpl<Key, Engine>::SnapshotHashIndexFilePath(
+    const std::string& name) const {
+  return PosixFile::JoinPath(SnapshotDirPath(name), kSnapshotHashIndexFileName);
+}
+
+template<typename Key, typename Engine>
+std::string PersistentTableImpl<Key, Engine>::SnapshotBaseFilePath(const std::string& name) const {
+  return PosixFile::JoinPath(SnapshotDirPath(name), kSnapshotBaseFileName);
+}
+
+template<typename Key, typename Engine>
+std::vector<std::string> PersistentTableImpl<Key, Engine>::SnapshotChain(
+    const std::string& name) const {
+  std::vector<std::string> chain{name};
+  while (true) {
+    const std::string base_file = SnapshotBaseFilePath(chain.back());
+    if (!PosixFile::FileExists(base_file)) { break; }
+    std::ifstream base_if(base_file);
+    std::string base;
+    std::getline(base_if, base);
+    CHECK(std::find(chain.begin(), chain.end(), base) == chain.end())
+        << "Snapshot " << name << " is built on itself";
+    CHECK(PosixFile::FileExists(SnapshotListFilePath(base)))
+        << "Missing snapshot " << base << ", the base of " << chain.back();
+    chain.push_back(base);
+  }
+  std::reverse(chain.begin(), chain.end());
+  return chain;
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::ResolveSnapshot(
+    const std::string& name, RowIdMapping<Key>* mapping,
+    std::vector<uint64_t>* chunk_num_live_values,
+    const std::function<void(Iterator* iter)>& Hook) {
+  // Deltas are applied oldest first, so Hook sees the rows of later deltas after the rows they
+  // overwrite.
+  const std::vector<std::string> chain = SnapshotChain(name);
+  for (size_t i = 0; i < chain.size(); ++i) {
+    LoadSnapshotIndices(chain.at(i), i != 0, mapping, chunk_num_live_values, Hook);
+  }
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::LoadSnapshotIndices(
+    const std::string& name, bool is_delta, RowIdMapping<Key>* mapping,
+    std::vector<uint64_t>* chunk_num_live_values,
+    const std::function<void(Iterator* iter)>& Hook) {
   const std::string snapshot_base = SnapshotDirPath(name);
   const std::string snapshot_list = SnapshotListFilePath(name);
-  row_id_mapping_.clear();
+  const std::string snapshot_hash_index = SnapshotHashIndexFilePath(name);
+  // Snapshots saved before hash indices were introduced are loaded by rebuilding the mapping.
+  const bool has_hash_index = !is_delta && PosixFile::FileExists(snapshot_hash_index);
+  if (!is_delta) {
+    mapping->Clear();
+    if (has_hash_index) {
+      mapping->ResetBase(
+          std::unique_ptr<MappedHashIndex<Key>>(new MappedHashIndex<Key>(snapshot_hash_index)));
+    }
+    chunk_num_live_values->assign(value_files_.size(), 0);
+  }
   std::ifstream list_if(snapshot_list);
   std::string index_filename;
   while (std::getline(list_if, index_filename)) {
@@ -639,32 +1069,69 @@ void PersistentTableImpl<Key, Engine>::LoadSnapshotImpl(const std::string& name)
     PosixFile index_file(PosixFile::JoinPath(snapshot_base, index_filename), O_RDONLY, 0644);
     const size_t index_file_size = index_file.Size();
     CHECK_EQ(index_file_size % sizeof(uint64_t), 0);
-    if (index_file_size == 0) { return; }
+    if (index_file_size == 0) { continue; }
     const size_t n_entries = index_file_size / sizeof(uint64_t);
+    if (!is_delta) { chunk_num_live_values->at(chunk_id) += n_entries; }
+    if (has_hash_index && !Hook) { continue; }
     PosixMappedFile mapped_index(std::move(index_file), index_file_size, PROT_READ);
     PosixFile key_file(KeyFilePath(chunk_id), O_RDONLY, 0644);
     PosixMappedFile mapped_key(std::move(key_file), key_file.Size(), PROT_READ);
     const uint64_t* indices = static_cast<const uint64_t*>(mapped_index.ptr());
     const Key* keys = static_cast<const Key*>(mapped_key.ptr());
     const uint64_t chunk_start_index = chunk_id * num_values_per_chunk_;
-    row_id_mapping_.reserve(row_id_mapping_.size() + n_entries);
-    for (size_t i = 0; i < n_entries; ++i) {
-      CHECK(row_id_mapping_.emplace(keys[indices[i] - chunk_start_index], indices[i]).second);
+    if (is_delta) {
+      for (size_t i = 0; i < n_entries; ++i) {
+        uint64_t prev_row_id = 0;
+        if (mapping->Update(keys[indices[i] - chunk_start_index], indices[i], &prev_row_id)) {
+          chunk_num_live_values->at(prev_row_id / num_values_per_chunk_) -= 1;
+        }
+        chunk_num_live_values->at(chunk_id) += 1;
+      }
+    } else if (!has_hash_index) {
+      mapping->Reserve(mapping->Size() + n_entries);
+      for (size_t i = 0; i < n_entries; ++i) {
+        uint64_t prev_row_id = 0;
+        CHECK(!mapping->Update(keys[indices[i] - chunk_start_index], indices[i], &prev_row_id));
+      }
+    }
+    if (Hook) {
+      PosixFile value_file(ValueFilePath(chunk_id), O_RDONLY, 0644);
+      PosixMappedFile mapped_value(std::move(value_file), value_file.Size(), PROT_READ);
+      ChunkIteratorImpl<Key> chunk_iterator(value_size_, logical_block_size_, num_values_per_block_,
+                                            num_values_per_chunk_, chunk_id, n_entries, keys,
+                                            indices, mapped_value.ptr());
+      Hook(&chunk_iterator);
     }
   }
 }
 
 template<typename Key, typename Engine>
-void PersistentTableImpl<Key, Engine>::SaveSnapshotImpl(const std::string& name) {
-  std::lock_guard<std::recursive_mutex> lock(mutex_);
+template<typename ForEachFunc>
+void PersistentTableImpl<Key, Engine>::WriteSnapshot(const std::string& name,
+                                                     const std::string& base, uint64_t num_entries,
+                                                     const ForEachFunc& for_each) {
   PosixFile::RecursiveCreateDirectory(SnapshotDirPath(name), 0755);
+  // A full snapshot has a hash index, a delta records its base instead.
+  const std::string stale_file =
+      base.empty() ? SnapshotBaseFilePath(name) : SnapshotHashIndexFilePath(name);
+  if (PosixFile::FileExists(stale_file)) { PCHECK(unlink(stale_file.c_str()) == 0); }
   std::ofstream list_ofs(SnapshotListFilePath(name));
-  if (row_id_mapping_.empty()) { return; }
+  if (!base.empty()) {
+    std::ofstream base_ofs(SnapshotBaseFilePath(name));
+    base_ofs << base << std::endl;
+  }
+  if (num_entries == 0) {
+    const std::string snapshot_hash_index = SnapshotHashIndexFilePath(name);
+    if (PosixFile::FileExists(snapshot_hash_index)) {
+      PCHECK(unlink(snapshot_hash_index.c_str()) == 0);
+    }
+    return;
+  }
   std::vector<PosixMappedFile> index_files(value_files_.size());
   std::vector<uint64_t> counters(value_files_.size());
   const uint64_t max_index_file_size = num_values_per_chunk_ * sizeof(uint64_t);
-  for (const auto& pair : row_id_mapping_) {
-    const uint64_t chunk_id = pair.second / num_values_per_chunk_;
+  for_each([&](const Key& key, uint64_t row_id) {
+    const uint64_t chunk_id = row_id / num_values_per_chunk_;
     CHECK(chunk_id < value_files_.size());
     if (index_files[chunk_id].ptr() == nullptr) {
       PosixFile snapshot_file(IndexFilePath(name, chunk_id), O_CREAT | O_RDWR, 0644);
@@ -675,9 +1142,9 @@ void PersistentTableImpl<Key, Engine>::SaveSnapshotImpl(const std::string& name)
     uint64_t* indices = static_cast<uint64_t*>(index_files[chunk_id].ptr());
     uint64_t& count = counters[chunk_id];
     CHECK_LT(count, num_values_per_chunk_);
-    indices[count] = pair.second;
+    indices[count] = row_id;
     count += 1;
-  }
+  });
   for (size_t i = 0; i < value_files_.size(); ++i) {
     const uint64_t count = counters[i];
     if (count > 0) {
@@ -687,54 +1154,52 @@ void PersistentTableImpl<Key, Engine>::SaveSnapshotImpl(const std::string& name)
       CHECK(index_files[i].ptr() == nullptr);
     }
   }
+  if (base.empty()) {
+    MappedHashIndex<Key>::Write(SnapshotHashIndexFilePath(name), num_entries, for_each);
+  }
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::LoadSnapshotImpl(
+    const std::string& name, const std::function<void(Iterator* iter)>& Hook) {
+  std::unique_lock<SharedMutex> lock(mutex_);
+  ClearPrefetched();
+  ResolveSnapshot(name, &row_id_mapping_, &chunk_num_live_values_, Hook);
+  delta_base_ = name;
+  dirty_keys_.clear();
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::SaveSnapshotImpl(const std::string& name) {
+  std::unique_lock<SharedMutex> lock(mutex_);
+  WriteSnapshot(name, "", row_id_mapping_.Size(),
+                [&](const auto& func) { row_id_mapping_.ForEach(func); });
+  delta_base_ = name;
+  dirty_keys_.clear();
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::MarkDirty(uint32_t num_keys, const void* keys) {
+  // Nothing to track until there is a snapshot to build deltas on.
+  if (delta_base_.empty()) { return; }
+  for (uint32_t i = 0; i < num_keys; ++i) { dirty_keys_.insert(static_cast<const Key*>(keys)[i]); }
 }
 
 template<typename Key, typename Engine>
 bool PersistentTableImpl<Key, Engine>::SnapshotExists(const std::string& name) {
-  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  std::shared_lock<SharedMutex> lock(mutex_);
   return PosixFile::FileExists(SnapshotListFilePath(name));
 }
 
 template<typename Key, typename Engine>
 void PersistentTableImpl<Key, Engine>::LoadSnapshot(const std::string& name) {
-  LoadSnapshotImpl(name);
+  LoadSnapshotImpl(name, nullptr);
 }
 
 template<typename Key, typename Engine>
 void PersistentTableImpl<Key, Engine>::LoadSnapshot(
     const std::string& name, const std::function<void(Iterator* iter)>& Hook) {
-  std::lock_guard<std::recursive_mutex> lock(mutex_);
-  const std::string snapshot_base = SnapshotDirPath(name);
-  const std::string snapshot_list = SnapshotListFilePath(name);
-  row_id_mapping_.clear();
-  std::ifstream list_if(snapshot_list);
-  std::string index_filename;
-  while (std::getline(list_if, index_filename)) {
-    const uint64_t chunk_id = GetChunkId(index_filename, kIndexFileNamePrefix);
-    PosixFile index_file(PosixFile::JoinPath(snapshot_base, index_filename), O_RDONLY, 0644);
-    const size_t index_file_size = index_file.Size();
-    CHECK_EQ(index_file_size % sizeof(uint64_t), 0);
-    if (index_file_size == 0) { return; }
-    const size_t n_entries = index_file_size / sizeof(uint64_t);
-    PosixMappedFile mapped_index(std::move(index_file), index_file_size, PROT_READ);
-    PosixFile key_file(KeyFilePath(chunk_id), O_RDONLY, 0644);
-    PosixMappedFile mapped_key(std::move(key_file), key_file.Size(), PROT_READ);
-    const uint64_t* indices = static_cast<const uint64_t*>(mapped_index.ptr());
-    const Key* keys = static_cast<const Key*>(mapped_key.ptr());
-    const uint64_t chunk_start_index = chunk_id * num_values_per_chunk_;
-    row_id_mapping_.reserve(row_id_mapping_.size() + n_entries);
-    for (size_t i = 0; i < n_entries; ++i) {
-      CHECK(row_id_mapping_.emplace(keys[indices[i] - chunk_start_index], indices[i]).second);
-    }
-    if (Hook) {
-      PosixFile value_file(ValueFilePath(chunk_id), O_RDONLY, 0644);
-      PosixMappedFile mapped_value(std::move(value_file), value_file.Size(), PROT_READ);
-      ChunkIteratorImpl<Key> chunk_iterator(value_size_, logical_block_size_, num_values_per_block_,
-                                            num_values_per_chunk_, chunk_id, n_entries, keys,
-                                            indices, mapped_value.ptr());
-      Hook(&chunk_iterator);
-    }
-  }
+  LoadSnapshotImpl(name, Hook);
 }
 
 template<typename Key, typename Engine>
@@ -742,12 +1207,364 @@ void PersistentTableImpl<Key, Engine>::SaveSnapshot(const std::string& name) {
   SaveSnapshotImpl(name);
 }
 
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::SaveDeltaSnapshot(const std::string& name,
+                                                         const std::string& base) {
+  std::unique_lock<SharedMutex> lock(mutex_);
+  CHECK(!base.empty() && base == delta_base_)
+      << "A delta snapshot must be based on the last snapshot saved or loaded";
+  const std::vector<std::string> chain = SnapshotChain(base);
+  CHECK(std::find(chain.begin(), chain.end(), name) == chain.end())
+      << "Snapshot " << name << " can not be a delta of itself";
+  WriteSnapshot(name, base, dirty_keys_.size(), [&](const auto& func) {
+    for (const Key& key : dirty_keys_) {
+      uint64_t row_id = 0;
+      CHECK(row_id_mapping_.Find(key, &row_id));
+      func(key, row_id);
+    }
+  });
+  delta_base_ = name;
+  dirty_keys_.clear();
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::MergeSnapshot(const std::string& name,
+                                                     const std::string& merged_name) {
+  // Merging does not modify the table, it only has to keep chunks from being reclaimed.
+  std::shared_lock<SharedMutex> lock(mutex_);
+  const std::vector<std::string> chain = SnapshotChain(name);
+  if (chain.size() == 1 && merged_name == name) { return; }
+  CHECK(merged_name == name || std::find(chain.begin(), chain.end(), merged_name) == chain.end())
+      << "Merging " << name << " would overwrite its base " << merged_name;
+  RowIdMapping<Key> mapping;
+  std::vector<uint64_t> chunk_num_live_values;
+  ResolveSnapshot(name, &mapping, &chunk_num_live_values, nullptr);
+  WriteSnapshot(merged_name, "", mapping.Size(), [&](const auto& func) { mapping.ForEach(func); });
+}
+
 template<typename Key, typename Engine>
 PersistentTable::Iterator* PersistentTableImpl<Key, Engine>::ReadSnapshot(const std::string& name) {
   return new SnapshotIteratorImpl<Key, Engine>(this, name, value_size_, logical_block_size_,
                                                num_values_per_block_, num_values_per_chunk_);
 }
 
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::Compact(float dead_ratio_threshold) {
+  std::vector<uint64_t> chunk_ids;
+  {
+    std::shared_lock<SharedMutex> lock(mutex_);
+    // The last chunk is still being appended to, so it is never compacted.
+    for (uint64_t chunk_id = 0; chunk_id + 1 < value_files_.size(); ++chunk_id) {
+      const uint64_t num_values = ChunkNumValues(chunk_id);
+      const uint64_t num_live_values = chunk_num_live_values_.at(chunk_id);
+      if (num_values == 0 || num_live_values == 0) { continue; }
+      const uint64_t num_dead_values = num_values - num_live_values;
+      if (num_dead_values >= dead_ratio_threshold * num_values) { chunk_ids.push_back(chunk_id); }
+    }
+  }
+  for (const uint64_t chunk_id : chunk_ids) {
+    if (compaction_shutdown_) { return; }
+    CompactChunk(chunk_id);
+  }
+  std::unique_lock<SharedMutex> lock(mutex_);
+  ReclaimChunks();
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::GetStatistics(PersistentTableStatistics* statistics) {
+  std::shared_lock<SharedMutex> lock(mutex_);
+  *statistics = PersistentTableStatistics();
+  for (uint64_t chunk_id = 0; chunk_id < value_files_.size(); ++chunk_id) {
+    if (!value_files_.at(chunk_id).IsOpen()) { continue; }
+    const uint64_t num_values = ChunkNumValues(chunk_id);
+    const uint64_t num_live_values = chunk_num_live_values_.at(chunk_id);
+    statistics->num_chunks += 1;
+    statistics->num_live_values += num_live_values;
+    statistics->num_dead_values += num_values - num_live_values;
+  }
+  statistics->num_compacted_values = num_compacted_values_;
+  statistics->num_reclaimed_chunks = num_reclaimed_chunks_;
+  std::lock_guard<std::mutex> prefetched_lock(prefetched_mutex_);
+  statistics->num_prefetched_values = num_prefetched_values_;
+  statistics->num_prefetch_hits = num_prefetch_hits_;
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::UpdateRowId(const Key& key, uint64_t row_id) {
+  uint64_t prev_row_id = 0;
+  if (row_id_mapping_.Update(key, row_id, &prev_row_id)) {
+    chunk_num_live_values_.at(prev_row_id / num_values_per_chunk_) -= 1;
+  }
+  chunk_num_live_values_.at(row_id / num_values_per_chunk_) += 1;
+}
+
+template<typename Key, typename Engine>
+uint64_t PersistentTableImpl<Key, Engine>::ChunkNumValues(uint64_t chunk_id) {
+  PosixFile& value_file = value_files_.at(chunk_id);
+  if (!value_file.IsOpen()) { return 0; }
+  return value_file.Size() / logical_block_size_ * num_values_per_block_;
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::CompactChunk(uint64_t chunk_id) {
+  PosixMappedFile mapped_key;
+  uint64_t num_rows = 0;
+  {
+    std::shared_lock<SharedMutex> lock(mutex_);
+    if (!value_files_.at(chunk_id).IsOpen()) { return; }
+    PosixFile key_file(KeyFilePath(chunk_id), O_RDONLY, 0644);
+    const size_t key_file_size = key_file.Size();
+    if (key_file_size == 0) { return; }
+    num_rows = key_file_size / sizeof(Key);
+    mapped_key = PosixMappedFile(std::move(key_file), key_file_size, PROT_READ);
+  }
+  const Key* chunk_keys = static_cast<const Key*>(mapped_key.ptr());
+  const uint64_t chunk_start_index = chunk_id * num_values_per_chunk_;
+  for (uint64_t start = 0; start < num_rows; start += kCompactionBatchSize) {
+    if (compaction_shutdown_) { return; }
+    const uint64_t end = std::min<uint64_t>(start + kCompactionBatchSize, num_rows);
+    uint64_t io_bytes = 0;
+    {
+      // Rows are re-checked under the lock, so values overwritten by a concurrent Put are never
+      // moved back over newer ones.
+      std::unique_lock<SharedMutex> lock(mutex_);
+      compaction_keys_buffer_.resize(kCompactionBatchSize);
+      uint32_t num_live_keys = 0;
+      for (uint64_t i = start; i < end; ++i) {
+        uint64_t row_id = 0;
+        if (row_id_mapping_.Find(chunk_keys[i], &row_id) && row_id == chunk_start_index + i) {
+          compaction_keys_buffer_.at(num_live_keys) = chunk_keys[i];
+          num_live_keys += 1;
+        }
+      }
+      if (num_live_keys > 0) {
+        compaction_values_buffer_.Resize(
+            RoundUp(num_live_keys * value_size_, physical_block_size_));
+        compaction_missing_indices_buffer_.resize(num_live_keys);
+        uint32_t n_missing = 0;
+        GetImpl(num_live_keys, compaction_keys_buffer_.data(), compaction_values_buffer_.ptr(),
+                &n_missing, compaction_missing_indices_buffer_.data());
+        CHECK_EQ(n_missing, 0);
+        PutImpl(num_live_keys, compaction_keys_buffer_.data(), compaction_values_buffer_.ptr());
+        num_compacted_values_ += num_live_keys;
+        io_bytes = num_live_keys * (logical_block_size_ + value_size_);
+      }
+    }
+    ThrottleCompaction(io_bytes);
+  }
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::ReclaimChunks() {
+  // The caller holds the table lock exclusively.
+  std::unordered_set<uint64_t> snapshot_chunk_ids;
+  ListSnapshotChunkIds(snapshots_dir_, kIndexFileNamePrefix, &snapshot_chunk_ids);
+  for (uint64_t chunk_id = 0; chunk_id + 1 < value_files_.size(); ++chunk_id) {
+    PosixFile& value_file = value_files_.at(chunk_id);
+    if (!value_file.IsOpen() || chunk_num_live_values_.at(chunk_id) != 0) { continue; }
+    // Chunks referenced by a saved snapshot must stay until that snapshot is removed.
+    if (snapshot_chunk_ids.count(chunk_id) != 0) { continue; }
+    value_file.Close();
+    PCHECK(unlink(ValueFilePath(chunk_id).c_str()) == 0);
+    const std::string key_file_path = KeyFilePath(chunk_id);
+    if (PosixFile::FileExists(key_file_path)) { PCHECK(unlink(key_file_path.c_str()) == 0); }
+    num_reclaimed_chunks_ += 1;
+  }
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::ThrottleCompaction(uint64_t io_bytes) {
+  if (compaction_io_rate_limit_ == 0 || io_bytes == 0) { return; }
+  std::unique_lock<std::mutex> lock(compaction_mutex_);
+  compaction_cond_.wait_for(
+      lock, std::chrono::microseconds(io_bytes * 1000 * 1000 / compaction_io_rate_limit_),
+      [&]() { return compaction_shutdown_.load(); });
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::CompactionLoop() {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(compaction_mutex_);
+      if (compaction_cond_.wait_for(lock, std::chrono::milliseconds(compaction_interval_ms_),
+                                    [&]() { return compaction_shutdown_.load(); })) {
+        break;
+      }
+    }
+    PersistentTableStatistics before;
+    GetStatistics(&before);
+    Compact(compaction_dead_ratio_threshold_);
+    PersistentTableStatistics after;
+    GetStatistics(&after);
+    if (after.num_compacted_values != before.num_compacted_values
+        || after.num_reclaimed_chunks != before.num_reclaimed_chunks) {
+      const uint64_t num_values = after.num_live_values + after.num_dead_values;
+      const double dead_ratio =
+          num_values == 0 ? 0.0 : static_cast<double>(after.num_dead_values) / num_values;
+      LOG(INFO) << "PersistentTable " << root_dir_ << " compacted "
+                << after.num_compacted_values - before.num_compacted_values << " values, reclaimed "
+                << after.num_reclaimed_chunks - before.num_reclaimed_chunks << " chunks, live "
+                << after.num_live_values << "/" << num_values << ", dead ratio " << dead_ratio;
+    }
+  }
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::Prefetch(uint32_t num_keys, const void* keys) {
+  if (num_keys == 0) { return; }
+  const Key* prefetch_keys = static_cast<const Key*>(keys);
+  {
+    std::lock_guard<std::mutex> lock(prefetch_mutex_);
+    if (!prefetch_thread_.joinable()) {
+      prefetch_thread_ = std::thread(&PersistentTableImpl<Key, Engine>::PrefetchLoop, this);
+    }
+    if (prefetch_queue_.size() == kMaxPrefetchQueueLength) { prefetch_queue_.pop_front(); }
+    prefetch_queue_.emplace_back(prefetch_keys, prefetch_keys + num_keys);
+  }
+  prefetch_cond_.notify_one();
+}
+
+template<typename Key, typename Engine>
+bool PersistentTableImpl<Key, Engine>::GetPrefetched(uint32_t num_keys, const void* keys,
+                                                     void* values, uint32_t* n_missing,
+                                                     uint32_t* missing_indices) {
+  std::unique_ptr<GetContext> context;
+  {
+    std::lock_guard<std::mutex> lock(prefetched_mutex_);
+    if (prefetched_values_.empty()) { return false; }
+    context = AcquireGetContext();
+    context->pending_indices.clear();
+    for (uint32_t i = 0; i < num_keys; ++i) {
+      auto it = prefetched_values_.find(static_cast<const Key*>(keys)[i]);
+      if (it == prefetched_values_.end()) {
+        context->pending_indices.push_back(i);
+      } else {
+        MemcpyOffset(values, i * value_size_, prefetched_values_buffer_.data(),
+                     it->second.slot * value_size_, value_size_);
+        free_prefetched_slots_.push_back(it->second.slot);
+        prefetched_values_.erase(it);
+        num_prefetch_hits_ += 1;
+      }
+    }
+    ReleasePrefetchedBufferIfEmpty();
+  }
+  const uint32_t num_pending = context->pending_indices.size();
+  uint32_t num_pending_missing = 0;
+  if (num_pending != 0) {
+    context->pending_keys.resize(num_pending * key_size_);
+    context->pending_values.resize(num_pending * value_size_);
+    context->pending_missing_indices.resize(num_pending);
+    Key* pending_keys = reinterpret_cast<Key*>(context->pending_keys.data());
+    for (uint32_t i = 0; i < num_pending; ++i) {
+      pending_keys[i] = static_cast<const Key*>(keys)[context->pending_indices.at(i)];
+    }
+    GetImpl(num_pending, pending_keys, context->pending_values.data(), &num_pending_missing,
+            context->pending_missing_indices.data());
+  }
+  uint32_t missing_count = 0;
+  for (uint32_t i = 0; i < num_pending; ++i) {
+    const uint32_t index = context->pending_indices.at(i);
+    if (missing_count < num_pending_missing
+        && context->pending_missing_indices.at(missing_count) == i) {
+      missing_indices[missing_count] = index;
+      missing_count += 1;
+    } else {
+      MemcpyOffset(values, index * value_size_, context->pending_values.data(),
+                   i * value_size_, value_size_);
+    }
+  }
+  *n_missing = missing_count;
+  ReleaseGetContext(std::move(context));
+  return true;
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::DropPrefetched(uint32_t num_keys, const void* keys) {
+  std::lock_guard<std::mutex> lock(prefetched_mutex_);
+  if (prefetched_values_.empty()) { return; }
+  for (uint32_t i = 0; i < num_keys; ++i) {
+    auto it = prefetched_values_.find(static_cast<const Key*>(keys)[i]);
+    if (it == prefetched_values_.end()) { continue; }
+    free_prefetched_slots_.push_back(it->second.slot);
+    prefetched_values_.erase(it);
+  }
+  ReleasePrefetchedBufferIfEmpty();
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::ClearPrefetched() {
+  std::lock_guard<std::mutex> lock(prefetched_mutex_);
+  prefetched_values_.clear();
+  ReleasePrefetchedBufferIfEmpty();
+}
+
+// Gives the memory of the prefetched values back once all of them have been read or dropped, the
+// buffer would otherwise stay at its peak size. Called with prefetched_mutex_ held.
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::ReleasePrefetchedBufferIfEmpty() {
+  if (!prefetched_values_.empty()) { return; }
+  std::vector<char>().swap(prefetched_values_buffer_);
+  std::vector<uint64_t>().swap(free_prefetched_slots_);
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::PrefetchLoop() {
+  std::vector<Key> keys;
+  std::vector<char> values;
+  std::vector<uint32_t> missing_indices;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(prefetch_mutex_);
+      prefetch_cond_.wait(lock, [&]() { return prefetch_shutdown_ || !prefetch_queue_.empty(); });
+      if (prefetch_shutdown_) { break; }
+      keys = std::move(prefetch_queue_.front());
+      prefetch_queue_.pop_front();
+    }
+    std::shared_lock<SharedMutex> lock(mutex_);
+    {
+      std::lock_guard<std::mutex> prefetched_lock(prefetched_mutex_);
+      prefetch_generation_ += 1;
+      for (auto it = prefetched_values_.begin(); it != prefetched_values_.end();) {
+        if (it->second.generation + kMaxPrefetchGenerations <= prefetch_generation_) {
+          free_prefetched_slots_.push_back(it->second.slot);
+          it = prefetched_values_.erase(it);
+        } else {
+          ++it;
+        }
+      }
+      ReleasePrefetchedBufferIfEmpty();
+      keys.erase(std::remove_if(keys.begin(), keys.end(),
+                                [&](const Key& key) { return prefetched_values_.count(key); }),
+                 keys.end());
+    }
+    if (keys.empty()) { continue; }
+    values.resize(keys.size() * value_size_);
+    missing_indices.resize(keys.size());
+    uint32_t n_missing = 0;
+    GetImpl(keys.size(), keys.data(), values.data(), &n_missing, missing_indices.data());
+    std::lock_guard<std::mutex> prefetched_lock(prefetched_mutex_);
+    uint32_t missing_count = 0;
+    for (uint32_t i = 0; i < keys.size(); ++i) {
+      if (missing_count < n_missing && missing_indices.at(missing_count) == i) {
+        missing_count += 1;
+        continue;
+      }
+      PrefetchedValue& prefetched = prefetched_values_[keys.at(i)];
+      if (free_prefetched_slots_.empty()) {
+        prefetched.slot = prefetched_values_buffer_.size() / value_size_;
+        prefetched_values_buffer_.resize(prefetched_values_buffer_.size() + value_size_);
+      } else {
+        prefetched.slot = free_prefetched_slots_.back();
+        free_prefetched_slots_.pop_back();
+      }
+      prefetched.generation = prefetch_generation_;
+      MemcpyOffset(prefetched_values_buffer_.data(), prefetched.slot * value_size_, values.data(),
+                   i * value_size_, value_size_);
+      num_prefetched_values_ += 1;
+    }
+  }
+}
+
 template<typename Key, typename Engine>
 void PersistentTableImpl<Key, Engine>::ParallelFor(size_t total,
                                                    const ForRange<Engine>& for_range) {
@@ -847,6 +1664,145 @@ class SnapshotIteratorImpl : public PersistentTable::Iterator {
   std::unique_ptr<ChunkIteratorImpl<Key>> chunk_iterator_;
 };
 
+class DecodingIterator : public PersistentTable::Iterator {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(DecodingIterator);
+  DecodingIterator(PersistentTable::Iterator* iter, const ValueCodecLayout* layout)
+      : iter_(iter), layout_(layout) {}
+  DecodingIterator(std::unique_ptr<PersistentTable::Iterator>&& iter,
+                   const ValueCodecLayout* layout)
+      : iter_(iter.get()), owned_iter_(std::move(iter)), layout_(layout) {}
+  ~DecodingIterator() override = default;
+
+  void Next(uint32_t n_request, uint32_t* n_result, void* keys, void* values) override {
+    encoded_values_.resize(static_cast<size_t>(n_request) * layout_->EncodedValueSize());
+    iter_->Next(n_request, n_result, keys, encoded_values_.data());
+    layout_->Decode(*n_result, encoded_values_.data(), values);
+  }
+
+  void Reset() override { iter_->Reset(); }
+
+ private:
+  PersistentTable::Iterator* iter_;
+  std::unique_ptr<PersistentTable::Iterator> owned_iter_;
+  const ValueCodecLayout* layout_;
+  std::vector<char> encoded_values_;
+};
+
+// Stores values in their encoded format in the wrapped table, which is created with the encoded
+// value size, and converts them on the way in and out.
+class EncodedPersistentTable : public PersistentTable {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(EncodedPersistentTable);
+  EncodedPersistentTable(const PersistentTableOptions& options,
+                         std::unique_ptr<PersistentTable>&& table)
+      : layout_(options.value_size, options.value_codecs), table_(std::move(table)) {
+    CHECK_EQ(table_->ValueSize(), layout_.EncodedValueSize());
+  }
+  ~EncodedPersistentTable() override = default;
+
+  uint32_t KeySize() const override { return table_->KeySize(); }
+  uint32_t ValueSize() const override { return layout_.ValueSize(); }
+  uint32_t LogicalBlockSize() const override { return table_->LogicalBlockSize(); }
+
+  void GetBlocks(uint32_t num_keys, const void* keys, void* blocks, uint32_t* offsets) override {
+    table_->GetBlocks(num_keys, keys, blocks, offsets);
+  }
+
+  void Get(uint32_t num_keys, const void* keys, void* values, uint32_t* n_missing,
+           uint32_t* missing_indices) override {
+    std::vector<char> buffer = AcquireBuffer(num_keys);
+    table_->Get(num_keys, keys, buffer.data(), n_missing, missing_indices);
+    // Decodes the runs of rows between the missing ones, the rows of missing keys keep whatever
+    // the caller put there.
+    const size_t encoded_value_size = layout_.EncodedValueSize();
+    const size_t value_size = layout_.ValueSize();
+    uint32_t start = 0;
+    for (uint32_t i = 0; i <= *n_missing; ++i) {
+      const uint32_t end = i < *n_missing ? missing_indices[i] : num_keys;
+      if (end > start) {
+        layout_.Decode(end - start, buffer.data() + start * encoded_value_size,
+                       static_cast<char*>(values) + start * value_size);
+      }
+      start = end + 1;
+    }
+    ReleaseBuffer(std::move(buffer));
+  }
+
+  void PutBlocks(uint32_t num_keys, const void* keys, const void* blocks) override {
+    table_->PutBlocks(num_keys, keys, blocks);
+  }
+
+  void Put(uint32_t num_keys, const void* keys, const void* values) override {
+    std::vector<char> buffer = AcquireBuffer(num_keys);
+    layout_.Encode(num_keys, values, buffer.data());
+    table_->Put(num_keys, keys, buffer.data());
+    ReleaseBuffer(std::move(buffer));
+  }
+
+  bool SnapshotExists(const std::string& name) override { return table_->SnapshotExists(name); }
+
+  void LoadSnapshot(const std::string& name) override { table_->LoadSnapshot(name); }
+
+  void LoadSnapshot(const std::string& name,
+                    const std::function<void(Iterator* iter)>& Hook) override {
+    if (!Hook) {
+      table_->LoadSnapshot(name, Hook);
+      return;
+    }
+    table_->LoadSnapshot(name, [&](Iterator* iter) {
+      DecodingIterator decoding_iter(iter, &layout_);
+      Hook(&decoding_iter);
+    });
+  }
+
+  void SaveSnapshot(const std::string& name) override { table_->SaveSnapshot(name); }
+
+  void SaveDeltaSnapshot(const std::string& name, const std::string& base) override {
+    table_->SaveDeltaSnapshot(name, base);
+  }
+
+  void MergeSnapshot(const std::string& name, const std::string& merged_name) override {
+    table_->MergeSnapshot(name, merged_name);
+  }
+
+  Iterator* ReadSnapshot(const std::string& name) override {
+    return new DecodingIterator(std::unique_ptr<Iterator>(table_->ReadSnapshot(name)), &layout_);
+  }
+
+  void Compact(float dead_ratio_threshold) override { table_->Compact(dead_ratio_threshold); }
+
+  void GetStatistics(PersistentTableStatistics* statistics) override {
+    table_->GetStatistics(statistics);
+  }
+
+  void Prefetch(uint32_t num_keys, const void* keys) override { table_->Prefetch(num_keys, keys); }
+
+ private:
+  std::vector<char> AcquireBuffer(uint32_t num_keys) {
+    std::vector<char> buffer;
+    {
+      std::lock_guard<std::mutex> lock(buffers_mutex_);
+      if (!buffers_.empty()) {
+        buffer = std::move(buffers_.back());
+        buffers_.pop_back();
+      }
+    }
+    buffer.resize(static_cast<size_t>(num_keys) * layout_.EncodedValueSize());
+    return buffer;
+  }
+
+  void ReleaseBuffer(std::vector<char>&& buffer) {
+    std::lock_guard<std::mutex> lock(buffers_mutex_);
+    buffers_.push_back(std::move(buffer));
+  }
+
+  ValueCodecLayout layout_;
+  std::unique_ptr<PersistentTable> table_;
+  std::mutex buffers_mutex_;
+  std::vector<std::vector<char>> buffers_;
+};
+
 template<typename Engine>
 std::unique_ptr<PersistentTable> DispatchKeyType(const PersistentTableOptions& options) {
   if (options.key_size == 4) {
@@ -859,23 +1815,9 @@ std::unique_ptr<PersistentTable> DispatchKeyType(const PersistentTableOptions& o
   }
 }
 
-bool IsRingIOSupported() {
-#ifdef WITH_LIBURING
-  struct io_uring ring {};
-  if (io_uring_queue_init(1, &ring, 0) == 0) {
-    io_uring_queue_exit(&ring);
-    return true;
-  } else {
-    return false;
-  }
-#else
-  return false;
-#endif
-}
-
 std::unique_ptr<PersistentTable> DispatchEngine(const PersistentTableOptions& options) {
 #ifdef WITH_LIBURING
-  static bool ring_io_supported = IsRingIOSupported();
+  static bool ring_io_supported = fs::IsRingIOSupported();
   if (ring_io_supported) {
     return DispatchKeyType<RingEngine>(options);
   } else {
@@ -897,7 +1839,12 @@ std::unique_ptr<PersistentTable> NewPersistentTable(const PersistentTableOptions
   CHECK_GT(options.target_chunk_size_mb, 0);
   CHECK_GT(options.physical_block_size, 0);
   CHECK_GT(options.key_size, 0);
-  return DispatchEngine(options);
+  if (options.value_codecs.empty()) { return DispatchEngine(options); }
+  PersistentTableOptions encoded_options = options;
+  encoded_options.value_size =
+      ValueCodecLayout(options.value_size, options.value_codecs).EncodedValueSize();
+  return std::unique_ptr<PersistentTable>(
+      new EncodedPersistentTable(options, DispatchEngine(encoded_options)));
 #else
   UNIMPLEMENTED();
   return nullptr;
@@ -17,6 +17,7 @@ limitations under the License.
 #define ONEFLOW_CORE_EMBEDDING_PERSISTENT_TABLE_H_
 
 #include "oneflow/core/common/util.h"
+#include "oneflow/core/embedding/value_codec.h"
 
 namespace oneflow {
 
@@ -29,6 +30,22 @@ struct PersistentTableOptions {
   uint64_t target_chunk_size_mb = 4 * 1024;
   uint16_t physical_block_size = 4096;
   uint64_t capacity_hint = 0;
+  bool enable_compaction = false;
+  float compaction_dead_ratio_threshold = 0.5;
+  uint64_t compaction_io_rate_limit_mb = 64;
+  // Storage codecs of the segments of a fp32 value, see ValueCodecLayout. Values are stored as raw
+  // bytes when empty.
+  std::vector<ValueCodec> value_codecs;
+};
+
+struct PersistentTableStatistics {
+  uint64_t num_chunks = 0;
+  uint64_t num_live_values = 0;
+  uint64_t num_dead_values = 0;
+  uint64_t num_compacted_values = 0;
+  uint64_t num_reclaimed_chunks = 0;
+  uint64_t num_prefetched_values = 0;
+  uint64_t num_prefetch_hits = 0;
 };
 
 class PersistentTable {
@@ -49,6 +66,8 @@ class PersistentTable {
 
   virtual uint32_t KeySize() const = 0;
   virtual uint32_t ValueSize() const = 0;
+  // Blocks hold values in their storage format, which differs from ValueSize() when the table has
+  // value codecs.
   virtual uint32_t LogicalBlockSize() const = 0;
   virtual void GetBlocks(uint32_t num_keys, const void* keys, void* blocks, uint32_t* offsets) = 0;
   virtual void Get(uint32_t num_keys, const void* keys, void* values, uint32_t* n_missing,
@@ -60,7 +79,20 @@ class PersistentTable {
   virtual void LoadSnapshot(const std::string& name,
                             const std::function<void(Iterator* iter)>& Hook) = 0;
   virtual void SaveSnapshot(const std::string& name) = 0;
+  // Saves only the rows written since `base` was saved or loaded, `base` must be the last snapshot
+  // this table saved or loaded. Loading a delta snapshot resolves the chain of snapshots it is
+  // built on, so bases have to be kept as long as deltas refer to them. ReadSnapshot of a delta
+  // only iterates the rows of that delta.
+  virtual void SaveDeltaSnapshot(const std::string& name, const std::string& base) = 0;
+  // Writes the chain of snapshots `name` resolves to as a single full snapshot `merged_name`, which
+  // may be `name` itself.
+  virtual void MergeSnapshot(const std::string& name, const std::string& merged_name) = 0;
   virtual Iterator* ReadSnapshot(const std::string& name) = 0;
+  virtual void Compact(float dead_ratio_threshold) = 0;
+  virtual void GetStatistics(PersistentTableStatistics* statistics) = 0;
+  // Reads the values of the given keys in the background, so that a following Get of them is
+  // served from memory. Returns immediately.
+  virtual void Prefetch(uint32_t num_keys, const void* keys) = 0;
 };
 
 std::unique_ptr<PersistentTable> NewPersistentTable(const PersistentTableOptions& options);
@@ -130,11 +130,14 @@ class KeyValueStoreImpl : public KeyValueStore {
   void Get(ep::Stream* stream, uint32_t num_keys, const void* keys, void* values,
            uint32_t* n_missing, uint32_t* missing_indices) override;
   void Put(ep::Stream* stream, uint32_t num_keys, const void* keys, const void* values) override;
+  void Prefetch(uint32_t num_keys, const void* keys) override { table_->Prefetch(num_keys, keys); }
   bool SnapshotExists(const std::string& name) override;
   void LoadSnapshot(const std::string& name) override;
   void LoadSnapshot(const std::string& name,
                     const std::function<void(KVIterator* iter)>& Hook) override;
   void SaveSnapshot(const std::string& name) override;
+  void SaveDeltaSnapshot(const std::string& name, const std::string& base) override;
+  void MergeSnapshot(const std::string& name, const std::string& merged_name) override;
 
  private:
   int device_index_;
@@ -224,6 +227,19 @@ void KeyValueStoreImpl<Key>::SaveSnapshot(const std::string& name) {
   table_->SaveSnapshot(name);
 }
 
+template<typename Key>
+void KeyValueStoreImpl<Key>::SaveDeltaSnapshot(const std::string& name, const std::string& base) {
+  CudaCurrentDeviceGuard guard(device_index_);
+  table_->SaveDeltaSnapshot(name, base);
+}
+
+template<typename Key>
+void KeyValueStoreImpl<Key>::MergeSnapshot(const std::string& name,
+                                           const std::string& merged_name) {
+  CudaCurrentDeviceGuard guard(device_index_);
+  table_->MergeSnapshot(name, merged_name);
+}
+
 }  // namespace
 
 std::unique_ptr<KeyValueStore> NewPersistentTableKeyValueStore(
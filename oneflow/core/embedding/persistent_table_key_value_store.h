@@ -23,12 +23,12 @@ namespace oneflow {
 
 namespace embedding {
 
-#ifdef WITH_CUDA
-
 struct PersistentTableKeyValueStoreOptions {
   PersistentTableOptions table_options{};
 };
 
+#ifdef WITH_CUDA
+
 std::unique_ptr<KeyValueStore> NewPersistentTableKeyValueStore(
     const PersistentTableKeyValueStoreOptions& options);
 
@@ -0,0 +1,429 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/embedding/persistent_table.h"
+#include <gtest/gtest.h>
+#include "oneflow/core/embedding/posix_file.h"
+#include <chrono>
+#include <iostream>
+
+namespace oneflow {
+
+namespace embedding {
+
+namespace {
+
+#ifdef __linux__
+
+std::string CreateTempDirectory() {
+  const char* tmp_env = getenv("TMPDIR");
+  const char* tmp_dir = tmp_env == nullptr ? "/tmp" : tmp_env;
+  std::string tpl = std::string(tmp_dir) + "/test_pt_XXXXXX";
+  char* path = mkdtemp(const_cast<char*>(tpl.c_str()));
+  PCHECK(path != nullptr);
+  return std::string(path);
+}
+
+PersistentTableOptions GetTestOptions(const std::string& path, uint32_t value_length) {
+  PersistentTableOptions options{};
+  options.path = path;
+  options.key_size = sizeof(uint64_t);
+  options.value_size = value_length * sizeof(float);
+  options.physical_block_size = 512;
+  options.target_chunk_size_mb = 1;
+  return options;
+}
+
+void PutRange(PersistentTable* table, const std::vector<uint64_t>& keys, uint32_t value_length,
+              float value) {
+  const uint32_t batch_size = 1024;
+  std::vector<float> values(batch_size * value_length, value);
+  for (size_t offset = 0; offset < keys.size(); offset += batch_size) {
+    const uint32_t num_keys = std::min<size_t>(batch_size, keys.size() - offset);
+    table->Put(num_keys, keys.data() + offset, values.data());
+  }
+}
+
+void CheckRange(PersistentTable* table, const std::vector<uint64_t>& keys, uint32_t value_length,
+                float value) {
+  std::vector<float> values(keys.size() * value_length);
+  std::vector<uint32_t> missing_indices(keys.size());
+  uint32_t n_missing = 0;
+  table->Get(keys.size(), keys.data(), values.data(), &n_missing, missing_indices.data());
+  ASSERT_EQ(n_missing, 0);
+  for (size_t i = 0; i < values.size(); ++i) { ASSERT_EQ(values.at(i), value); }
+}
+
+TEST(PersistentTable, Compact) {
+  const std::string path = CreateTempDirectory();
+  const uint32_t value_length = 32;
+  const PersistentTableOptions options = GetTestOptions(path, value_length);
+  std::vector<uint64_t> cold_keys(4096);
+  std::iota(cold_keys.begin(), cold_keys.end(), 1);
+  std::vector<uint64_t> hot_keys(4096);
+  std::iota(hot_keys.begin(), hot_keys.end(), cold_keys.size() + 1);
+  {
+    std::unique_ptr<PersistentTable> table = NewPersistentTable(options);
+    PutRange(table.get(), cold_keys, value_length, 0);
+    for (int i = 0; i < 4; ++i) { PutRange(table.get(), hot_keys, value_length, i); }
+    PersistentTableStatistics statistics;
+    table->GetStatistics(&statistics);
+    ASSERT_EQ(statistics.num_live_values, cold_keys.size() + hot_keys.size());
+    ASSERT_EQ(statistics.num_dead_values, hot_keys.size() * 3);
+    table->SaveSnapshot("before");
+    table->Compact(0.5);
+    table->GetStatistics(&statistics);
+    ASSERT_EQ(statistics.num_compacted_values, cold_keys.size());
+    // Only the chunk holding overwritten hot values is reclaimed, the compacted chunk is still
+    // referenced by snapshot "before".
+    ASSERT_EQ(statistics.num_reclaimed_chunks, 1);
+    CheckRange(table.get(), cold_keys, value_length, 0);
+    CheckRange(table.get(), hot_keys, value_length, 3);
+    PosixFile::RecursiveDelete(PosixFile::JoinPath(path, "snapshots/before"));
+    table->Compact(0.5);
+    table->GetStatistics(&statistics);
+    ASSERT_EQ(statistics.num_compacted_values, cold_keys.size());
+    ASSERT_EQ(statistics.num_reclaimed_chunks, 2);
+    ASSERT_EQ(statistics.num_live_values, cold_keys.size() + hot_keys.size());
+    ASSERT_EQ(statistics.num_dead_values, 0);
+    table->SaveSnapshot("after");
+  }
+  {
+    std::unique_ptr<PersistentTable> table = NewPersistentTable(options);
+    table->LoadSnapshot("after");
+    CheckRange(table.get(), cold_keys, value_length, 0);
+    CheckRange(table.get(), hot_keys, value_length, 3);
+  }
+  PosixFile::RecursiveDelete(path);
+}
+
+TEST(PersistentTable, SnapshotHashIndex) {
+  const std::string path = CreateTempDirectory();
+  const uint32_t value_length = 32;
+  const PersistentTableOptions options = GetTestOptions(path, value_length);
+  std::vector<uint64_t> keys(16384);
+  std::iota(keys.begin(), keys.end(), 1);
+  std::vector<uint64_t> updated_keys(keys.begin(), keys.begin() + keys.size() / 2);
+  std::vector<uint64_t> missing_keys(1024);
+  std::iota(missing_keys.begin(), missing_keys.end(), keys.size() + 1);
+  {
+    std::unique_ptr<PersistentTable> table = NewPersistentTable(options);
+    PutRange(table.get(), keys, value_length, 1);
+    table->SaveSnapshot("snapshot");
+  }
+  ASSERT_TRUE(PosixFile::FileExists(PosixFile::JoinPath(path, "snapshots/snapshot/HASH_INDEX")));
+  {
+    std::unique_ptr<PersistentTable> table = NewPersistentTable(options);
+    table->LoadSnapshot("snapshot");
+    CheckRange(table.get(), keys, value_length, 1);
+    std::vector<float> values(missing_keys.size() * value_length);
+    std::vector<uint32_t> missing_indices(missing_keys.size());
+    uint32_t n_missing = 0;
+    table->Get(missing_keys.size(), missing_keys.data(), values.data(), &n_missing,
+               missing_indices.data());
+    ASSERT_EQ(n_missing, missing_keys.size());
+    // Overwrite the snapshot whose index is currently mapped.
+    PutRange(table.get(), updated_keys, value_length, 2);
+    PutRange(table.get(), missing_keys, value_length, 3);
+    table->SaveSnapshot("snapshot");
+    PersistentTableStatistics statistics;
+    table->GetStatistics(&statistics);
+    ASSERT_EQ(statistics.num_live_values, keys.size() + missing_keys.size());
+  }
+  {
+    std::unique_ptr<PersistentTable> table = NewPersistentTable(options);
+    table->LoadSnapshot("snapshot");
+    CheckRange(table.get(), updated_keys, value_length, 2);
+    CheckRange(table.get(), std::vector<uint64_t>(keys.begin() + updated_keys.size(), keys.end()),
+               value_length, 1);
+    CheckRange(table.get(), missing_keys, value_length, 3);
+  }
+  PosixFile::RecursiveDelete(path);
+}
+
+TEST(PersistentTable, DeltaSnapshot) {
+  const std::string path = CreateTempDirectory();
+  const uint32_t value_length = 32;
+  const PersistentTableOptions options = GetTestOptions(path, value_length);
+  std::vector<uint64_t> keys(8192);
+  std::iota(keys.begin(), keys.end(), 1);
+  std::vector<uint64_t> updated_keys(keys.begin(), keys.begin() + 1024);
+  std::vector<uint64_t> new_keys(512);
+  std::iota(new_keys.begin(), new_keys.end(), keys.size() + 1);
+  auto CountRows = [&](PersistentTable* table, const std::string& name) {
+    std::unique_ptr<PersistentTable::Iterator> iter(table->ReadSnapshot(name));
+    std::vector<uint64_t> iter_keys(keys.size());
+    std::vector<float> iter_values(keys.size() * value_length);
+    uint64_t num_rows = 0;
+    uint32_t n_result = 0;
+    do {
+      iter->Next(keys.size(), &n_result, iter_keys.data(), iter_values.data());
+      num_rows += n_result;
+    } while (n_result != 0);
+    return num_rows;
+  };
+  {
+    std::unique_ptr<PersistentTable> table = NewPersistentTable(options);
+    PutRange(table.get(), keys, value_length, 1);
+    table->SaveSnapshot("full");
+    PutRange(table.get(), updated_keys, value_length, 2);
+    table->SaveDeltaSnapshot("delta1", "full");
+    PutRange(table.get(), new_keys, value_length, 3);
+    // Writing the same keys twice still records them once.
+    PutRange(table.get(), new_keys, value_length, 4);
+    table->SaveDeltaSnapshot("delta2", "delta1");
+    ASSERT_EQ(CountRows(table.get(), "full"), keys.size());
+    ASSERT_EQ(CountRows(table.get(), "delta1"), updated_keys.size());
+    ASSERT_EQ(CountRows(table.get(), "delta2"), new_keys.size());
+  }
+  std::vector<uint64_t> unchanged_keys(keys.begin() + updated_keys.size(), keys.end());
+  {
+    std::unique_ptr<PersistentTable> table = NewPersistentTable(options);
+    table->LoadSnapshot("delta1");
+    CheckRange(table.get(), unchanged_keys, value_length, 1);
+    CheckRange(table.get(), updated_keys, value_length, 2);
+    table->LoadSnapshot("delta2");
+    CheckRange(table.get(), unchanged_keys, value_length, 1);
+    CheckRange(table.get(), updated_keys, value_length, 2);
+    CheckRange(table.get(), new_keys, value_length, 4);
+    PersistentTableStatistics statistics;
+    table->GetStatistics(&statistics);
+    ASSERT_EQ(statistics.num_live_values, keys.size() + new_keys.size());
+    table->MergeSnapshot("delta2", "merged");
+    ASSERT_EQ(CountRows(table.get(), "merged"), keys.size() + new_keys.size());
+  }
+  for (const std::string name : {"full", "delta1", "delta2"}) {
+    PosixFile::RecursiveDelete(PosixFile::JoinPath(path, "snapshots/" + name));
+  }
+  {
+    std::unique_ptr<PersistentTable> table = NewPersistentTable(options);
+    table->LoadSnapshot("merged");
+    table->Compact(0.1);
+    CheckRange(table.get(), unchanged_keys, value_length, 1);
+    CheckRange(table.get(), updated_keys, value_length, 2);
+    CheckRange(table.get(), new_keys, value_length, 4);
+  }
+  PosixFile::RecursiveDelete(path);
+}
+
+TEST(PersistentTable, Prefetch) {
+  const std::string path = CreateTempDirectory();
+  const uint32_t value_length = 32;
+  const PersistentTableOptions options = GetTestOptions(path, value_length);
+  std::unique_ptr<PersistentTable> table = NewPersistentTable(options);
+  std::vector<uint64_t> keys(4096);
+  std::iota(keys.begin(), keys.end(), 1);
+  PutRange(table.get(), keys, value_length, 1);
+  // Every other key of the prefetched batch has never been put.
+  std::vector<uint64_t> prefetch_keys(keys.size());
+  for (size_t i = 0; i < prefetch_keys.size(); ++i) { prefetch_keys.at(i) = i * 2 + 1; }
+  auto WaitPrefetched = [&](uint64_t num_prefetched_values) {
+    PersistentTableStatistics statistics;
+    do {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      table->GetStatistics(&statistics);
+    } while (statistics.num_prefetched_values < num_prefetched_values);
+  };
+  table->Prefetch(prefetch_keys.size(), prefetch_keys.data());
+  WaitPrefetched(keys.size() / 2);
+  std::vector<float> values(prefetch_keys.size() * value_length);
+  std::vector<uint32_t> missing_indices(prefetch_keys.size());
+  uint32_t n_missing = 0;
+  table->Get(prefetch_keys.size(), prefetch_keys.data(), values.data(), &n_missing,
+             missing_indices.data());
+  ASSERT_EQ(n_missing, prefetch_keys.size() / 2);
+  for (uint32_t i = 0; i < n_missing; ++i) {
+    ASSERT_GT(prefetch_keys.at(missing_indices.at(i)), keys.size());
+  }
+  for (size_t i = 0; i < prefetch_keys.size(); ++i) {
+    if (prefetch_keys.at(i) > keys.size()) { continue; }
+    for (size_t j = 0; j < value_length; ++j) { ASSERT_EQ(values.at(i * value_length + j), 1); }
+  }
+  PersistentTableStatistics statistics;
+  table->GetStatistics(&statistics);
+  ASSERT_EQ(statistics.num_prefetch_hits, keys.size() / 2);
+
+  // A Put after the prefetch must win over the prefetched values.
+  table->Prefetch(keys.size(), keys.data());
+  WaitPrefetched(keys.size() / 2 + keys.size());
+  PutRange(table.get(), keys, value_length, 2);
+  CheckRange(table.get(), keys, value_length, 2);
+  table->GetStatistics(&statistics);
+  ASSERT_EQ(statistics.num_prefetch_hits, keys.size() / 2);
+  PosixFile::RecursiveDelete(path);
+}
+
+TEST(PersistentTable, ValueCodecs) {
+  const std::string path = CreateTempDirectory();
+  const uint32_t value_length = 96;
+  PersistentTableOptions options = GetTestOptions(path, value_length);
+  // Embedding in bf16, first moment in int8 and second moment in fp16.
+  options.value_codecs = {ValueCodec::kBFloat16, ValueCodec::kInt8, ValueCodec::kFloat16};
+  std::vector<uint64_t> keys(4096);
+  std::iota(keys.begin(), keys.end(), 1);
+  {
+    std::unique_ptr<PersistentTable> table = NewPersistentTable(options);
+    ASSERT_EQ(table->ValueSize(), value_length * sizeof(float));
+    // Small integers are exact in every codec.
+    PutRange(table.get(), keys, value_length, 3);
+    CheckRange(table.get(), keys, value_length, 3);
+    table->SaveSnapshot("snapshot");
+  }
+  std::ifstream value_size_file(PosixFile::JoinPath(path, "VALUE_SIZE"));
+  uint32_t encoded_value_size = 0;
+  value_size_file >> encoded_value_size;
+  ASSERT_EQ(encoded_value_size, 32 * 2 + (4 + 32) + 32 * 2);
+  {
+    std::unique_ptr<PersistentTable> table = NewPersistentTable(options);
+    table->LoadSnapshot("snapshot");
+    CheckRange(table.get(), keys, value_length, 3);
+    std::unique_ptr<PersistentTable::Iterator> iter(table->ReadSnapshot("snapshot"));
+    std::vector<uint64_t> iter_keys(keys.size());
+    std::vector<float> iter_values(keys.size() * value_length);
+    uint32_t n_result = 0;
+    iter->Next(keys.size(), &n_result, iter_keys.data(), iter_values.data());
+    ASSERT_EQ(n_result, keys.size());
+    for (float value : iter_values) { ASSERT_EQ(value, 3); }
+  }
+  {
+    // The rows of missing keys are left as they were.
+    std::unique_ptr<PersistentTable> table = NewPersistentTable(options);
+    table->LoadSnapshot("snapshot");
+    std::vector<uint64_t> mixed_keys(keys.size());
+    for (size_t i = 0; i < mixed_keys.size(); ++i) { mixed_keys.at(i) = i * 2 + 1; }
+    std::vector<float> values(mixed_keys.size() * value_length, -1);
+    std::vector<uint32_t> missing_indices(mixed_keys.size());
+    uint32_t n_missing = 0;
+    table->Get(mixed_keys.size(), mixed_keys.data(), values.data(), &n_missing,
+               missing_indices.data());
+    ASSERT_EQ(n_missing, mixed_keys.size() / 2);
+    for (size_t i = 0; i < mixed_keys.size(); ++i) {
+      const float expected = mixed_keys.at(i) > keys.size() ? -1 : 3;
+      for (size_t j = 0; j < value_length; ++j) {
+        ASSERT_EQ(values.at(i * value_length + j), expected);
+      }
+    }
+  }
+  PosixFile::RecursiveDelete(path);
+}
+
+TEST(PersistentTable, ConcurrentGet) {
+  const std::string path = CreateTempDirectory();
+  const uint32_t value_length = 32;
+  PersistentTableOptions options = GetTestOptions(path, value_length);
+  std::unique_ptr<PersistentTable> table = NewPersistentTable(options);
+  std::vector<uint64_t> keys(16384);
+  std::iota(keys.begin(), keys.end(), 1);
+  const uint32_t batch_size = 1024;
+  for (size_t offset = 0; offset < keys.size(); offset += batch_size) {
+    std::vector<float> values(batch_size * value_length);
+    for (uint32_t i = 0; i < batch_size; ++i) {
+      std::fill_n(values.data() + i * value_length, value_length, keys.at(offset + i));
+    }
+    table->Put(batch_size, keys.data() + offset, values.data());
+  }
+  const uint32_t num_threads = 8;
+  const uint32_t num_batches_per_thread = 16;
+  std::vector<std::thread> threads;
+  for (uint32_t tid = 0; tid < num_threads; ++tid) {
+    threads.emplace_back([&, tid]() {
+      std::mt19937 rng(tid);
+      std::vector<uint64_t> batch_keys(batch_size);
+      std::vector<float> values(batch_size * value_length);
+      std::vector<uint32_t> missing_indices(batch_size);
+      for (uint32_t batch = 0; batch < num_batches_per_thread; ++batch) {
+        // One key in eight has never been put.
+        for (auto& key : batch_keys) { key = rng() % (keys.size() + keys.size() / 7) + 1; }
+        std::fill(values.begin(), values.end(), -1);
+        uint32_t n_missing = 0;
+        table->Get(batch_size, batch_keys.data(), values.data(), &n_missing,
+                   missing_indices.data());
+        uint32_t missing_count = 0;
+        for (uint32_t i = 0; i < batch_size; ++i) {
+          const uint64_t key = batch_keys.at(i);
+          if (key > keys.size()) {
+            ASSERT_LT(missing_count, n_missing);
+            ASSERT_EQ(missing_indices.at(missing_count), i);
+            missing_count += 1;
+          } else {
+            for (uint32_t j = 0; j < value_length; ++j) {
+              ASSERT_EQ(values.at(i * value_length + j), key);
+            }
+          }
+        }
+        ASSERT_EQ(missing_count, n_missing);
+      }
+    });
+  }
+  for (auto& thread : threads) { thread.join(); }
+  table.reset();
+  PosixFile::RecursiveDelete(path);
+}
+
+// Measures the keys/s of Get called from 1, 2, 4, ... threads at once, not run by default:
+//
+//   oneflow_testexe --gtest_also_run_disabled_tests \
+//       --gtest_filter=PersistentTable.DISABLED_GetThroughput
+//
+// The table is written under TMPDIR, point it at the disk to measure and drop the page cache
+// between runs to measure cold reads.
+TEST(PersistentTable, DISABLED_GetThroughput) {
+  const std::string path = CreateTempDirectory();
+  const uint32_t value_length = 128;
+  PersistentTableOptions options = GetTestOptions(path, value_length);
+  options.target_chunk_size_mb = 64;
+  std::unique_ptr<PersistentTable> table = NewPersistentTable(options);
+  std::vector<uint64_t> keys(1 << 20);
+  std::iota(keys.begin(), keys.end(), 1);
+  PutRange(table.get(), keys, value_length, 1);
+  const uint32_t batch_size = 4096;
+  const uint32_t num_batches_per_thread = 64;
+  const uint32_t max_num_threads = std::max(std::thread::hardware_concurrency(), 2U);
+  std::cout << "threads\tkeys/s" << std::endl;
+  for (uint32_t num_threads = 1; num_threads <= max_num_threads; num_threads *= 2) {
+    std::vector<std::thread> threads;
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t tid = 0; tid < num_threads; ++tid) {
+      threads.emplace_back([&, tid]() {
+        std::mt19937_64 rng(tid);
+        std::vector<uint64_t> batch_keys(batch_size);
+        std::vector<float> values(batch_size * value_length);
+        std::vector<uint32_t> missing_indices(batch_size);
+        for (uint32_t batch = 0; batch < num_batches_per_thread; ++batch) {
+          for (auto& key : batch_keys) { key = keys.at(rng() % keys.size()); }
+          uint32_t n_missing = 0;
+          table->Get(batch_size, batch_keys.data(), values.data(), &n_missing,
+                     missing_indices.data());
+          ASSERT_EQ(n_missing, 0);
+        }
+      });
+    }
+    for (auto& thread : threads) { thread.join(); }
+    const double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << num_threads << "\t" << num_threads * num_batches_per_thread * batch_size / seconds
+              << std::endl;
+  }
+  table.reset();
+  PosixFile::RecursiveDelete(path);
+}
+
+#endif  // __linux__
+
+}  // namespace
+
+}  // namespace embedding
+
+}  // namespace oneflow
@@ -0,0 +1,278 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/embedding/tiny_lfu_cache.h"
+#include "oneflow/core/embedding/hash_functions.cuh"
+
+namespace oneflow {
+
+namespace embedding {
+
+namespace {
+
+constexpr uint32_t kSketchDepth = 4;
+constexpr uint64_t kSketchMinWidth = 1024;
+constexpr uint8_t kSketchMaxCount = 15;
+// The sketch is aged after recording this many samples per cache entry.
+constexpr uint64_t kSketchSampleFactor = 10;
+
+class CountMinSketch final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(CountMinSketch);
+  explicit CountMinSketch(uint64_t capacity)
+      : width_(kSketchMinWidth),
+        num_samples_(0),
+        sample_size_(std::max<uint64_t>(capacity, 1) * kSketchSampleFactor) {
+    while (width_ < capacity) { width_ *= 2; }
+    counters_.resize(kSketchDepth * width_);
+  }
+  ~CountMinSketch() = default;
+
+  void Increment(uint64_t key) {
+    const uint64_t hash = TinyLfuSketchHash()(key);
+    bool incremented = false;
+    for (uint32_t i = 0; i < kSketchDepth; ++i) {
+      uint8_t& counter = counters_[i * width_ + Index(hash, i)];
+      if (counter < kSketchMaxCount) {
+        counter += 1;
+        incremented = true;
+      }
+    }
+    if (incremented) {
+      num_samples_ += 1;
+      if (num_samples_ >= sample_size_) { Age(); }
+    }
+  }
+
+  uint32_t Estimate(uint64_t key) const {
+    const uint64_t hash = TinyLfuSketchHash()(key);
+    uint32_t estimate = kSketchMaxCount;
+    for (uint32_t i = 0; i < kSketchDepth; ++i) {
+      estimate = std::min<uint32_t>(estimate, counters_[i * width_ + Index(hash, i)]);
+    }
+    return estimate;
+  }
+
+  void Clear() {
+    std::fill(counters_.begin(), counters_.end(), 0);
+    num_samples_ = 0;
+  }
+
+ private:
+  uint64_t Index(uint64_t hash, uint32_t row) const {
+    return (hash + row * ((hash >> 32) | 1)) & (width_ - 1);
+  }
+
+  // Halves all counters, so that the sketch follows shifts of the key distribution.
+  void Age() {
+    for (uint8_t& counter : counters_) { counter >>= 1; }
+    num_samples_ /= 2;
+  }
+
+  uint64_t width_;
+  uint64_t num_samples_;
+  uint64_t sample_size_;
+  std::vector<uint8_t> counters_;
+};
+
+template<typename Key>
+class TinyLfuCache : public Cache {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(TinyLfuCache);
+  TinyLfuCache(std::unique_ptr<Cache>&& cache, const CacheOptions& options)
+      : cache_(std::move(cache)),
+        min_frequency_(options.admission_min_frequency),
+        sketch_(cache_->Capacity()),
+        num_admissions_(0),
+        num_rejections_(0) {
+    CHECK(cache_->Policy() != CacheOptions::Policy::kFull)
+        << "A full cache never evicts, there is nothing to admit";
+  }
+  ~TinyLfuCache() override = default;
+
+  uint32_t KeySize() const override { return cache_->KeySize(); }
+  uint32_t ValueSize() const override { return cache_->ValueSize(); }
+  uint32_t MaxQueryLength() const override { return cache_->MaxQueryLength(); }
+
+  void ReserveQueryLength(uint32_t query_length) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cache_->ReserveQueryLength(query_length);
+    if (query_length <= missing_keys_.size()) { return; }
+    missing_keys_.resize(query_length);
+    missing_indices_.resize(query_length);
+    rejected_.resize(query_length);
+    admitted_keys_.resize(query_length);
+    admitted_values_.resize(static_cast<size_t>(query_length) * cache_->ValueSize());
+  }
+
+  uint64_t Capacity() const override { return cache_->Capacity(); }
+  uint64_t DumpCapacity() const override { return cache_->DumpCapacity(); }
+  CacheOptions::Policy Policy() const override { return cache_->Policy(); }
+
+  void Test(ep::Stream* stream, uint32_t n_keys, const void* keys, uint32_t* n_missing,
+            void* missing_keys, uint32_t* missing_indices) override {
+    cache_->Test(stream, n_keys, keys, n_missing, missing_keys, missing_indices);
+  }
+
+  void Get(ep::Stream* stream, uint32_t n_keys, const void* keys, void* values, uint32_t* n_missing,
+           void* missing_keys, uint32_t* missing_indices) override {
+    CHECK_EQ(stream->device_type(), DeviceType::kCPU)
+        << "TinyLFU admission is only supported for caches queried from CPU streams";
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (uint32_t i = 0; i < n_keys; ++i) { sketch_.Increment(static_cast<const Key*>(keys)[i]); }
+    }
+    cache_->Get(stream, n_keys, keys, values, n_missing, missing_keys, missing_indices);
+  }
+
+  void Put(ep::Stream* stream, uint32_t n_keys, const void* keys, const void* values,
+           uint32_t* n_evicted, void* evicted_keys, void* evicted_values) override;
+  void PutWithAdmission(ep::Stream* stream, uint32_t n_keys, const void* keys, const void* values,
+                        uint32_t* n_evicted, void* evicted_keys, void* evicted_values,
+                        uint32_t* n_rejected, void* rejected_keys, void* rejected_values) override;
+
+  void Dump(ep::Stream* stream, uint64_t start_key_index, uint64_t end_key_index,
+            uint32_t* n_dumped, void* keys, void* values) override {
+    cache_->Dump(stream, start_key_index, end_key_index, n_dumped, keys, values);
+  }
+
+  void Clear() override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cache_->Clear();
+    sketch_.Clear();
+  }
+
+  void GetStatistics(CacheStatistics* statistics) override {
+    cache_->GetStatistics(statistics);
+    std::lock_guard<std::mutex> lock(mutex_);
+    statistics->num_admissions = num_admissions_;
+    statistics->num_rejections = num_rejections_;
+  }
+
+ private:
+  uint32_t Reject(ep::Stream* stream, uint32_t n_keys, const void* keys, const void* values,
+                  void* rejected_keys, void* rejected_values);
+  void PutAdmitted(ep::Stream* stream, uint32_t n_keys, const void* keys, const void* values,
+                   uint32_t n_rejected, uint32_t* n_evicted, void* evicted_keys,
+                   void* evicted_values);
+
+  std::unique_ptr<Cache> cache_;
+  uint32_t min_frequency_;
+  std::mutex mutex_;
+  CountMinSketch sketch_;
+  std::vector<Key> missing_keys_;
+  std::vector<uint32_t> missing_indices_;
+  std::vector<uint8_t> rejected_;
+  std::vector<Key> admitted_keys_;
+  std::vector<char> admitted_values_;
+  uint64_t num_admissions_;
+  uint64_t num_rejections_;
+};
+
+template<typename Key>
+void TinyLfuCache<Key>::Put(ep::Stream* stream, uint32_t n_keys, const void* keys,
+                            const void* values, uint32_t* n_evicted, void* evicted_keys,
+                            void* evicted_values) {
+  CHECK_EQ(stream->device_type(), DeviceType::kCPU)
+      << "TinyLFU admission is only supported for caches queried from CPU streams";
+  std::lock_guard<std::mutex> lock(mutex_);
+  const uint32_t n_rejected = Reject(stream, n_keys, keys, values, evicted_keys, evicted_values);
+  uint32_t n_cache_evicted = 0;
+  PutAdmitted(stream, n_keys, keys, values, n_rejected, &n_cache_evicted,
+              static_cast<Key*>(evicted_keys) + n_rejected,
+              static_cast<char*>(evicted_values) + n_rejected * cache_->ValueSize());
+  *n_evicted = n_rejected + n_cache_evicted;
+}
+
+template<typename Key>
+void TinyLfuCache<Key>::PutWithAdmission(ep::Stream* stream, uint32_t n_keys, const void* keys,
+                                         const void* values, uint32_t* n_evicted,
+                                         void* evicted_keys, void* evicted_values,
+                                         uint32_t* n_rejected, void* rejected_keys,
+                                         void* rejected_values) {
+  CHECK_EQ(stream->device_type(), DeviceType::kCPU)
+      << "TinyLFU admission is only supported for caches queried from CPU streams";
+  std::lock_guard<std::mutex> lock(mutex_);
+  *n_rejected = Reject(stream, n_keys, keys, values, rejected_keys, rejected_values);
+  PutAdmitted(stream, n_keys, keys, values, *n_rejected, n_evicted, evicted_keys, evicted_values);
+}
+
+// Marks the keys of a Put that are turned away in rejected_ and copies them out, returns their
+// number.
+template<typename Key>
+uint32_t TinyLfuCache<Key>::Reject(ep::Stream* stream, uint32_t n_keys, const void* keys,
+                                   const void* values, void* rejected_keys,
+                                   void* rejected_values) {
+  CHECK_LE(n_keys, missing_keys_.size());
+  const Key* put_keys = static_cast<const Key*>(keys);
+  const uint32_t value_size = cache_->ValueSize();
+  // Keys already cached are always written through, so that the cache never holds stale values.
+  uint32_t n_missing = 0;
+  cache_->Test(stream, n_keys, keys, &n_missing, missing_keys_.data(), missing_indices_.data());
+  std::fill(rejected_.begin(), rejected_.begin() + n_keys, 0);
+  uint32_t n_rejected = 0;
+  for (uint32_t i = 0; i < n_missing; ++i) {
+    const uint32_t index = missing_indices_.at(i);
+    if (sketch_.Estimate(put_keys[index]) >= min_frequency_) { continue; }
+    rejected_.at(index) = 1;
+    static_cast<Key*>(rejected_keys)[n_rejected] = put_keys[index];
+    std::memcpy(static_cast<char*>(rejected_values) + n_rejected * value_size,
+                static_cast<const char*>(values) + index * value_size, value_size);
+    n_rejected += 1;
+  }
+  num_admissions_ += n_missing - n_rejected;
+  num_rejections_ += n_rejected;
+  return n_rejected;
+}
+
+template<typename Key>
+void TinyLfuCache<Key>::PutAdmitted(ep::Stream* stream, uint32_t n_keys, const void* keys,
+                                    const void* values, uint32_t n_rejected, uint32_t* n_evicted,
+                                    void* evicted_keys, void* evicted_values) {
+  if (n_rejected == 0) {
+    cache_->Put(stream, n_keys, keys, values, n_evicted, evicted_keys, evicted_values);
+    return;
+  }
+  const Key* put_keys = static_cast<const Key*>(keys);
+  const uint32_t value_size = cache_->ValueSize();
+  uint32_t n_admitted = 0;
+  for (uint32_t i = 0; i < n_keys; ++i) {
+    if (rejected_.at(i)) { continue; }
+    admitted_keys_.at(n_admitted) = put_keys[i];
+    std::memcpy(admitted_values_.data() + n_admitted * value_size,
+                static_cast<const char*>(values) + i * value_size, value_size);
+    n_admitted += 1;
+  }
+  cache_->Put(stream, n_admitted, admitted_keys_.data(), admitted_values_.data(), n_evicted,
+              evicted_keys, evicted_values);
+}
+
+}  // namespace
+
+std::unique_ptr<Cache> NewTinyLfuCache(std::unique_ptr<Cache>&& cache,
+                                       const CacheOptions& options) {
+  if (cache->KeySize() == sizeof(uint32_t)) {
+    return std::unique_ptr<Cache>(new TinyLfuCache<uint32_t>(std::move(cache), options));
+  } else if (cache->KeySize() == sizeof(uint64_t)) {
+    return std::unique_ptr<Cache>(new TinyLfuCache<uint64_t>(std::move(cache), options));
+  } else {
+    UNIMPLEMENTED();
+    return nullptr;
+  }
+}
+
+}  // namespace embedding
+
+}  // namespace oneflow
@@ -0,0 +1,36 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_EMBEDDING_TINY_LFU_CACHE_H_
+#define ONEFLOW_CORE_EMBEDDING_TINY_LFU_CACHE_H_
+
+#include "oneflow/core/embedding/cache.h"
+
+namespace oneflow {
+
+namespace embedding {
+
+// Wraps a cache with a TinyLFU admission filter. Key frequencies are estimated by a count-min
+// sketch fed with every queried key. A Put of a key that is not cached yet is only forwarded to
+// the wrapped cache once the key has been seen admission_min_frequency times; otherwise the key
+// and its value are handed back, as rejected by PutWithAdmission and as evicted by Put.
+std::unique_ptr<Cache> NewTinyLfuCache(std::unique_ptr<Cache>&& cache,
+                                       const CacheOptions& options);
+
+}  // namespace embedding
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_EMBEDDING_TINY_LFU_CACHE_H_
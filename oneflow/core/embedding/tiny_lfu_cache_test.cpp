@@ -0,0 +1,149 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/embedding/tiny_lfu_cache.h"
+#include "oneflow/core/embedding/host_cache.h"
+#include <gtest/gtest.h>
+#include "oneflow/core/ep/include/device_manager_registry.h"
+
+namespace oneflow {
+
+namespace embedding {
+
+namespace {
+
+TEST(TinyLfuCache, Admission) {
+  std::unique_ptr<ep::DeviceManagerRegistry> device_manager_registry(
+      new ep::DeviceManagerRegistry());
+  auto device = device_manager_registry->GetDevice(DeviceType::kCPU, 0);
+  ep::Stream* stream = device->CreateStream();
+  const uint32_t line_size = 4;
+  const uint32_t n_keys = 256;
+  const uint32_t n_scans = 16;
+  CacheOptions options{};
+  options.policy = CacheOptions::Policy::kLRU;
+  options.value_size = line_size * sizeof(float);
+  options.capacity = 4096;
+  options.key_size = sizeof(int64_t);
+  options.value_memory_kind = CacheOptions::MemoryKind::kHost;
+  options.admission_policy = CacheOptions::AdmissionPolicy::kTinyLFU;
+  options.admission_min_frequency = 2;
+  std::unique_ptr<Cache> cache(NewTinyLfuCache(NewHostCache(options), options));
+  cache->ReserveQueryLength(n_keys);
+
+  std::vector<float> values(n_keys * line_size);
+  uint32_t n_missing = 0;
+  std::vector<int64_t> missing_keys(n_keys);
+  std::vector<uint32_t> missing_indices(n_keys);
+  uint32_t n_evicted = 0;
+  std::vector<int64_t> evicted_keys(n_keys);
+  std::vector<float> evicted_values(n_keys * line_size);
+  auto GetAndPut = [&](const std::vector<int64_t>& keys) {
+    cache->Get(stream, n_keys, keys.data(), values.data(), &n_missing, missing_keys.data(),
+               missing_indices.data());
+    for (size_t i = 0; i < n_keys; ++i) {
+      for (size_t j = 0; j < line_size; ++j) {
+        values[i * line_size + j] = static_cast<float>(keys[i] * line_size + j);
+      }
+    }
+    cache->Put(stream, n_keys, keys.data(), values.data(), &n_evicted, evicted_keys.data(),
+               evicted_values.data());
+  };
+
+  // Keys seen for the first time are handed back with their values instead of being cached.
+  std::vector<int64_t> hot_keys(n_keys);
+  std::iota(hot_keys.begin(), hot_keys.end(), 0);
+  GetAndPut(hot_keys);
+  ASSERT_EQ(n_evicted, n_keys);
+  for (size_t i = 0; i < n_evicted; ++i) {
+    for (size_t j = 0; j < line_size; ++j) {
+      ASSERT_EQ(evicted_values[i * line_size + j],
+                static_cast<float>(evicted_keys[i] * line_size + j));
+    }
+  }
+  cache->Test(stream, n_keys, hot_keys.data(), &n_missing, missing_keys.data(),
+              missing_indices.data());
+  ASSERT_EQ(n_missing, n_keys);
+
+  // Once seen often enough they are admitted.
+  GetAndPut(hot_keys);
+  ASSERT_EQ(n_evicted, 0);
+  cache->Test(stream, n_keys, hot_keys.data(), &n_missing, missing_keys.data(),
+              missing_indices.data());
+  ASSERT_EQ(n_missing, 0);
+
+  // Scans of one-hit-wonders are mostly rejected and never flush the hot keys.
+  std::vector<int64_t> scan_keys(n_keys);
+  for (uint32_t scan = 1; scan <= n_scans; ++scan) {
+    std::iota(scan_keys.begin(), scan_keys.end(), scan * n_keys);
+    GetAndPut(scan_keys);
+    GetAndPut(hot_keys);
+    ASSERT_EQ(n_missing, 0);
+  }
+  CacheStatistics statistics;
+  cache->GetStatistics(&statistics);
+  ASSERT_GT(statistics.num_rejections, (n_scans + 1) * n_keys * 9 / 10);
+  ASSERT_EQ(statistics.num_admissions + statistics.num_rejections, (n_scans + 2) * n_keys);
+  device->DestroyStream(stream);
+}
+
+TEST(TinyLfuCache, PutWithAdmission) {
+  std::unique_ptr<ep::DeviceManagerRegistry> device_manager_registry(
+      new ep::DeviceManagerRegistry());
+  auto device = device_manager_registry->GetDevice(DeviceType::kCPU, 0);
+  ep::Stream* stream = device->CreateStream();
+  const uint32_t line_size = 4;
+  const uint32_t n_keys = 256;
+  CacheOptions options{};
+  options.policy = CacheOptions::Policy::kLRU;
+  options.value_size = line_size * sizeof(float);
+  options.capacity = n_keys;
+  options.key_size = sizeof(int64_t);
+  options.value_memory_kind = CacheOptions::MemoryKind::kHost;
+  options.admission_policy = CacheOptions::AdmissionPolicy::kTinyLFU;
+  options.admission_min_frequency = 2;
+  std::unique_ptr<Cache> cache(NewTinyLfuCache(NewHostCache(options), options));
+  cache->ReserveQueryLength(n_keys);
+
+  std::vector<int64_t> keys(n_keys);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::vector<float> values(n_keys * line_size);
+  std::iota(values.begin(), values.end(), 0);
+  uint32_t n_evicted = 0;
+  std::vector<int64_t> evicted_keys(n_keys);
+  std::vector<float> evicted_values(n_keys * line_size);
+  uint32_t n_rejected = 0;
+  std::vector<int64_t> rejected_keys(n_keys);
+  std::vector<float> rejected_values(n_keys * line_size);
+  // The keys never queried are all rejected and none of them is reported as evicted.
+  cache->PutWithAdmission(stream, n_keys, keys.data(), values.data(), &n_evicted,
+                          evicted_keys.data(), evicted_values.data(), &n_rejected,
+                          rejected_keys.data(), rejected_values.data());
+  ASSERT_EQ(n_evicted, 0);
+  ASSERT_EQ(n_rejected, n_keys);
+  for (size_t i = 0; i < n_rejected; ++i) {
+    for (size_t j = 0; j < line_size; ++j) {
+      ASSERT_EQ(rejected_values[i * line_size + j],
+                static_cast<float>(rejected_keys[i] * line_size + j));
+    }
+  }
+  device->DestroyStream(stream);
+}
+
+}  // namespace
+
+}  // namespace embedding
+
+}  // namespace oneflow
@@ -0,0 +1,320 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/embedding/value_codec.h"
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define OF_VALUE_CODEC_X86
+#endif
+
+namespace oneflow {
+
+namespace embedding {
+
+namespace {
+
+constexpr float kInt8MaxValue = 127;
+constexpr uint32_t kSegmentAlignment = sizeof(float);
+
+inline uint32_t FloatBits(float f) {
+  uint32_t bits;
+  std::memcpy(&bits, &f, sizeof(bits));
+  return bits;
+}
+
+inline float BitsFloat(uint32_t bits) {
+  float f;
+  std::memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+// Rounds to nearest even, overflows to inf and keeps nan.
+inline uint16_t FloatToHalf(float f) {
+  uint32_t x = FloatBits(f);
+  const uint32_t sign = x & 0x80000000U;
+  x ^= sign;
+  uint32_t h = 0;
+  if (x >= 0x47800000U) {
+    h = x > 0x7F800000U ? 0x7E00 : 0x7C00;
+  } else if (x < 0x38800000U) {
+    // Subnormal results, aligns the mantissa with an addition and lets the FPU round it.
+    h = FloatBits(BitsFloat(x) + BitsFloat(0x3F000000U)) - 0x3F000000U;
+  } else {
+    const uint32_t mantissa_odd = (x >> 13) & 1;
+    x += (static_cast<uint32_t>(15 - 127) << 23) + 0xFFF + mantissa_odd;
+    h = x >> 13;
+  }
+  return static_cast<uint16_t>(h | (sign >> 16));
+}
+
+inline float HalfToFloat(uint16_t h) {
+  const uint32_t shifted_exponent = 0x7C00U << 13;
+  uint32_t x = (h & 0x7FFFU) << 13;
+  const uint32_t exponent = x & shifted_exponent;
+  x += static_cast<uint32_t>(127 - 15) << 23;
+  if (exponent == shifted_exponent) {
+    x += static_cast<uint32_t>(128 - 16) << 23;
+  } else if (exponent == 0) {
+    x += 1U << 23;
+    x = FloatBits(BitsFloat(x) - BitsFloat(113U << 23));
+  }
+  return BitsFloat(x | (static_cast<uint32_t>(h & 0x8000U) << 16));
+}
+
+void EncodeFloat16Scalar(uint32_t n, const float* src, uint16_t* dst) {
+  for (uint32_t i = 0; i < n; ++i) { dst[i] = FloatToHalf(src[i]); }
+}
+
+void DecodeFloat16Scalar(uint32_t n, const uint16_t* src, float* dst) {
+  for (uint32_t i = 0; i < n; ++i) { dst[i] = HalfToFloat(src[i]); }
+}
+
+float MaxAbsScalar(uint32_t n, const float* src) {
+  float max_abs = 0;
+  for (uint32_t i = 0; i < n; ++i) { max_abs = std::max(max_abs, std::abs(src[i])); }
+  return max_abs;
+}
+
+#if defined(OF_VALUE_CODEC_X86)
+
+// AVX and F16C are checked at runtime, so the build does not need to enable them.
+#if defined(__AVX__) && defined(__F16C__)
+#define OF_VALUE_CODEC_AVX_TARGET
+inline bool CpuHasAvxF16c() { return true; }
+#else
+#define OF_VALUE_CODEC_AVX_TARGET __attribute__((target("avx,f16c")))
+inline bool CpuHasAvxF16c() {
+  static const bool has_avx_f16c = []() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+  }();
+  return has_avx_f16c;
+}
+#endif
+
+OF_VALUE_CODEC_AVX_TARGET void EncodeFloat16Avx(uint32_t n, const float* src, uint16_t* dst) {
+  uint32_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), h);
+  }
+  for (; i < n; ++i) { dst[i] = FloatToHalf(src[i]); }
+}
+
+OF_VALUE_CODEC_AVX_TARGET void DecodeFloat16Avx(uint32_t n, const uint16_t* src, float* dst) {
+  uint32_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+  }
+  for (; i < n; ++i) { dst[i] = HalfToFloat(src[i]); }
+}
+
+OF_VALUE_CODEC_AVX_TARGET float MaxAbsAvx(uint32_t n, const float* src) {
+  uint32_t i = 0;
+  float max_abs = 0;
+  const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+  __m256 max_abs_v = _mm256_setzero_ps();
+  for (; i + 8 <= n; i += 8) {
+    max_abs_v = _mm256_max_ps(max_abs_v, _mm256_and_ps(_mm256_loadu_ps(src + i), abs_mask));
+  }
+  float lanes[8];
+  _mm256_storeu_ps(lanes, max_abs_v);
+  for (float lane : lanes) { max_abs = std::max(max_abs, lane); }
+  for (; i < n; ++i) { max_abs = std::max(max_abs, std::abs(src[i])); }
+  return max_abs;
+}
+
+#endif  // OF_VALUE_CODEC_X86
+
+void EncodeFloat16(uint32_t n, const float* src, uint16_t* dst) {
+  internal::EncodeFloat16(n, src, dst, /*simd=*/true);
+}
+
+void DecodeFloat16(uint32_t n, const uint16_t* src, float* dst) {
+  internal::DecodeFloat16(n, src, dst, /*simd=*/true);
+}
+
+float MaxAbs(uint32_t n, const float* src) { return internal::MaxAbs(n, src, /*simd=*/true); }
+
+// The bfloat16 and int8 loops below are branch free, so that the compiler vectorizes them.
+
+void EncodeBFloat16(uint32_t n, const float* src, uint16_t* dst) {
+  for (uint32_t i = 0; i < n; ++i) {
+    const uint32_t x = FloatBits(src[i]);
+    const uint32_t rounded = (x + 0x7FFFU + ((x >> 16) & 1)) >> 16;
+    const bool is_nan = (x & 0x7FFFFFFFU) > 0x7F800000U;
+    dst[i] = static_cast<uint16_t>(is_nan ? ((x >> 16) | 0x40U) : rounded);
+  }
+}
+
+void DecodeBFloat16(uint32_t n, const uint16_t* src, float* dst) {
+  for (uint32_t i = 0; i < n; ++i) { dst[i] = BitsFloat(static_cast<uint32_t>(src[i]) << 16); }
+}
+
+void EncodeInt8(uint32_t n, const float* src, char* dst) {
+  const float scale = MaxAbs(n, src) / kInt8MaxValue;
+  const float inv_scale = scale == 0 ? 0 : 1 / scale;
+  std::memcpy(dst, &scale, sizeof(scale));
+  int8_t* quantized = reinterpret_cast<int8_t*>(dst + sizeof(scale));
+  for (uint32_t i = 0; i < n; ++i) {
+    float q = src[i] * inv_scale;
+    q = std::min(std::max(q, -kInt8MaxValue), kInt8MaxValue);
+    quantized[i] = static_cast<int8_t>(static_cast<int32_t>(q + (q < 0 ? -0.5F : 0.5F)));
+  }
+}
+
+void DecodeInt8(uint32_t n, const char* src, float* dst) {
+  float scale;
+  std::memcpy(&scale, src, sizeof(scale));
+  const int8_t* quantized = reinterpret_cast<const int8_t*>(src + sizeof(scale));
+  for (uint32_t i = 0; i < n; ++i) { dst[i] = static_cast<float>(quantized[i]) * scale; }
+}
+
+uint32_t EncodedSegmentSize(ValueCodec codec, uint32_t length) {
+  if (codec == ValueCodec::kFloat32) {
+    return length * sizeof(float);
+  } else if (codec == ValueCodec::kFloat16 || codec == ValueCodec::kBFloat16) {
+    return RoundUp(length * sizeof(uint16_t), kSegmentAlignment);
+  } else if (codec == ValueCodec::kInt8) {
+    return RoundUp(sizeof(float) + length * sizeof(int8_t), kSegmentAlignment);
+  } else {
+    UNIMPLEMENTED();
+    return 0;
+  }
+}
+
+}  // namespace
+
+namespace internal {
+
+void EncodeFloat16(uint32_t n, const float* src, uint16_t* dst, bool simd) {
+#if defined(OF_VALUE_CODEC_X86)
+  if (simd && CpuHasAvxF16c()) { return EncodeFloat16Avx(n, src, dst); }
+#endif
+  EncodeFloat16Scalar(n, src, dst);
+}
+
+void DecodeFloat16(uint32_t n, const uint16_t* src, float* dst, bool simd) {
+#if defined(OF_VALUE_CODEC_X86)
+  if (simd && CpuHasAvxF16c()) { return DecodeFloat16Avx(n, src, dst); }
+#endif
+  DecodeFloat16Scalar(n, src, dst);
+}
+
+float MaxAbs(uint32_t n, const float* src, bool simd) {
+#if defined(OF_VALUE_CODEC_X86)
+  if (simd && CpuHasAvxF16c()) { return MaxAbsAvx(n, src); }
+#endif
+  return MaxAbsScalar(n, src);
+}
+
+}  // namespace internal
+
+ValueCodec ParseValueCodec(const std::string& name) {
+  if (name == "fp32") {
+    return ValueCodec::kFloat32;
+  } else if (name == "fp16") {
+    return ValueCodec::kFloat16;
+  } else if (name == "bf16") {
+    return ValueCodec::kBFloat16;
+  } else if (name == "int8") {
+    return ValueCodec::kInt8;
+  } else {
+    UNIMPLEMENTED() << "Unsupported value codec " << name;
+    return ValueCodec::kFloat32;
+  }
+}
+
+std::string ValueCodecsToString(const std::vector<ValueCodec>& codecs) {
+  std::string str;
+  for (const ValueCodec codec : codecs) {
+    if (!str.empty()) { str += ","; }
+    if (codec == ValueCodec::kFloat32) {
+      str += "fp32";
+    } else if (codec == ValueCodec::kFloat16) {
+      str += "fp16";
+    } else if (codec == ValueCodec::kBFloat16) {
+      str += "bf16";
+    } else if (codec == ValueCodec::kInt8) {
+      str += "int8";
+    } else {
+      UNIMPLEMENTED();
+    }
+  }
+  return str;
+}
+
+ValueCodecLayout::ValueCodecLayout(uint32_t value_size, const std::vector<ValueCodec>& codecs)
+    : value_size_(value_size), encoded_value_size_(0), codecs_(codecs) {
+  CHECK(!codecs_.empty());
+  CHECK_EQ(value_size_ % (codecs_.size() * sizeof(float)), 0)
+      << "Values must be fp32 and split into segments of equal length";
+  segment_length_ = value_size_ / sizeof(float) / codecs_.size();
+  for (const ValueCodec codec : codecs_) {
+    encoded_segment_offsets_.push_back(encoded_value_size_);
+    encoded_value_size_ += EncodedSegmentSize(codec, segment_length_);
+  }
+}
+
+void ValueCodecLayout::Encode(uint32_t num_values, const void* values, void* encoded) const {
+  for (uint32_t i = 0; i < num_values; ++i) {
+    const float* value = static_cast<const float*>(values) + i * codecs_.size() * segment_length_;
+    char* encoded_value = static_cast<char*>(encoded) + i * encoded_value_size_;
+    for (size_t s = 0; s < codecs_.size(); ++s) {
+      const float* src = value + s * segment_length_;
+      char* dst = encoded_value + encoded_segment_offsets_.at(s);
+      const ValueCodec codec = codecs_.at(s);
+      if (codec == ValueCodec::kFloat32) {
+        std::memcpy(dst, src, segment_length_ * sizeof(float));
+      } else if (codec == ValueCodec::kFloat16) {
+        EncodeFloat16(segment_length_, src, reinterpret_cast<uint16_t*>(dst));
+      } else if (codec == ValueCodec::kBFloat16) {
+        EncodeBFloat16(segment_length_, src, reinterpret_cast<uint16_t*>(dst));
+      } else if (codec == ValueCodec::kInt8) {
+        EncodeInt8(segment_length_, src, dst);
+      } else {
+        UNIMPLEMENTED();
+      }
+    }
+  }
+}
+
+void ValueCodecLayout::Decode(uint32_t num_values, const void* encoded, void* values) const {
+  for (uint32_t i = 0; i < num_values; ++i) {
+    const char* encoded_value = static_cast<const char*>(encoded) + i * encoded_value_size_;
+    float* value = static_cast<float*>(values) + i * codecs_.size() * segment_length_;
+    for (size_t s = 0; s < codecs_.size(); ++s) {
+      const char* src = encoded_value + encoded_segment_offsets_.at(s);
+      float* dst = value + s * segment_length_;
+      const ValueCodec codec = codecs_.at(s);
+      if (codec == ValueCodec::kFloat32) {
+        std::memcpy(dst, src, segment_length_ * sizeof(float));
+      } else if (codec == ValueCodec::kFloat16) {
+        DecodeFloat16(segment_length_, reinterpret_cast<const uint16_t*>(src), dst);
+      } else if (codec == ValueCodec::kBFloat16) {
+        DecodeBFloat16(segment_length_, reinterpret_cast<const uint16_t*>(src), dst);
+      } else if (codec == ValueCodec::kInt8) {
+        DecodeInt8(segment_length_, src, dst);
+      } else {
+        UNIMPLEMENTED();
+      }
+    }
+  }
+}
+
+}  // namespace embedding
+
+}  // namespace oneflow
@@ -0,0 +1,73 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_EMBEDDING_VALUE_CODEC_H_
+#define ONEFLOW_CORE_EMBEDDING_VALUE_CODEC_H_
+
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+namespace embedding {
+
+enum class ValueCodec {
+  kFloat32 = 0,
+  kFloat16 = 1,
+  kBFloat16 = 2,
+  // int8 with a fp32 scale per segment
+  kInt8 = 3,
+};
+
+ValueCodec ParseValueCodec(const std::string& name);
+
+std::string ValueCodecsToString(const std::vector<ValueCodec>& codecs);
+
+namespace internal {
+
+// The fp16 conversions and the int8 scale use AVX and F16C when the CPU has them, simd = false
+// forces the scalar code so that tests can compare both.
+void EncodeFloat16(uint32_t n, const float* src, uint16_t* dst, bool simd);
+void DecodeFloat16(uint32_t n, const uint16_t* src, float* dst, bool simd);
+float MaxAbs(uint32_t n, const float* src, bool simd);
+
+}  // namespace internal
+
+// Converts rows of fp32 values to and from their storage format. A row is split into as many
+// segments of equal length as there are codecs, e.g. the embedding followed by each optimizer
+// state, and every segment is stored with its own codec.
+class ValueCodecLayout final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ValueCodecLayout);
+  ValueCodecLayout(uint32_t value_size, const std::vector<ValueCodec>& codecs);
+  ~ValueCodecLayout() = default;
+
+  uint32_t ValueSize() const { return value_size_; }
+  uint32_t EncodedValueSize() const { return encoded_value_size_; }
+  void Encode(uint32_t num_values, const void* values, void* encoded) const;
+  void Decode(uint32_t num_values, const void* encoded, void* values) const;
+
+ private:
+  uint32_t value_size_;
+  uint32_t segment_length_;
+  uint32_t encoded_value_size_;
+  std::vector<ValueCodec> codecs_;
+  std::vector<uint32_t> encoded_segment_offsets_;
+};
+
+}  // namespace embedding
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_EMBEDDING_VALUE_CODEC_H_
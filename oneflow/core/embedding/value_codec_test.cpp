@@ -0,0 +1,166 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/embedding/value_codec.h"
+#include <gtest/gtest.h>
+
+namespace oneflow {
+
+namespace embedding {
+
+namespace {
+
+void TestRoundTrip(ValueCodec codec, uint32_t segment_length, float relative_error,
+                   float absolute_error) {
+  const uint32_t num_values = 128;
+  // The first segment is kept as fp32 so that segment offsets are exercised as well.
+  ValueCodecLayout layout(2 * segment_length * sizeof(float), {ValueCodec::kFloat32, codec});
+  std::vector<float> values(num_values * 2 * segment_length);
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<float> dist(-1, 1);
+  for (uint32_t i = 0; i < num_values; ++i) {
+    // Rows of very different magnitudes, like embeddings and second moments of Adam.
+    const float magnitude = std::pow(10.0F, static_cast<float>(i % 8) - 4);
+    for (uint32_t j = 0; j < 2 * segment_length; ++j) {
+      values.at(i * 2 * segment_length + j) = dist(rng) * magnitude;
+    }
+  }
+  std::vector<char> encoded(num_values * layout.EncodedValueSize());
+  std::vector<float> decoded(values.size());
+  layout.Encode(num_values, values.data(), encoded.data());
+  layout.Decode(num_values, encoded.data(), decoded.data());
+  for (uint32_t i = 0; i < num_values; ++i) {
+    float max_abs = 0;
+    for (uint32_t j = segment_length; j < 2 * segment_length; ++j) {
+      max_abs = std::max(max_abs, std::abs(values.at(i * 2 * segment_length + j)));
+    }
+    for (uint32_t j = 0; j < 2 * segment_length; ++j) {
+      const float value = values.at(i * 2 * segment_length + j);
+      const float result = decoded.at(i * 2 * segment_length + j);
+      if (j < segment_length) {
+        ASSERT_EQ(result, value);
+      } else if (codec == ValueCodec::kInt8) {
+        ASSERT_LE(std::abs(result - value), max_abs * relative_error + absolute_error);
+      } else {
+        ASSERT_LE(std::abs(result - value), std::abs(value) * relative_error + absolute_error);
+      }
+    }
+  }
+}
+
+TEST(ValueCodec, Float16) {
+  ValueCodecLayout layout(3 * 4 * sizeof(float),
+                          std::vector<ValueCodec>(3, ValueCodec::kFloat16));
+  ASSERT_EQ(layout.EncodedValueSize(), 3 * 4 * sizeof(uint16_t));
+  const std::vector<float> values = {1,     -2, 0.5, 65504, -65504, 1e-3, 0.1,  3.14159,
+                                     -1e-8, 2049, 0, 1e-4,  6e-5,   100,  70000};
+  const std::vector<float> expected = {1,
+                                       -2,
+                                       0.5,
+                                       65504,
+                                       -65504,
+                                       0.0010004044,
+                                       0.099975586,
+                                       3.140625,
+                                       -0.0,
+                                       2048,
+                                       0,
+                                       1.0001659e-4,
+                                       6.0022e-5,
+                                       100,
+                                       std::numeric_limits<float>::infinity()};
+  std::vector<uint16_t> encoded(values.size());
+  std::vector<float> decoded(values.size());
+  ValueCodecLayout row_layout(values.size() * sizeof(float), {ValueCodec::kFloat16});
+  row_layout.Encode(1, values.data(), encoded.data());
+  row_layout.Decode(1, encoded.data(), decoded.data());
+  for (size_t i = 0; i + 1 < values.size(); ++i) {
+    ASSERT_NEAR(decoded.at(i), expected.at(i), std::abs(expected.at(i)) * 1e-4) << i;
+  }
+  // Overflows to inf.
+  ASSERT_EQ(decoded.back(), expected.back());
+  // Half of the smallest subnormal step of fp16.
+  TestRoundTrip(ValueCodec::kFloat16, 13, 1.0F / 1024, std::ldexp(1.0F, -25));
+}
+
+TEST(ValueCodec, BFloat16) {
+  TestRoundTrip(ValueCodec::kBFloat16, 64, 1.0F / 256, 0);
+  TestRoundTrip(ValueCodec::kBFloat16, 7, 1.0F / 256, 0);
+}
+
+TEST(ValueCodec, Int8) {
+  ValueCodecLayout layout(3 * 10 * sizeof(float),
+                          std::vector<ValueCodec>(3, ValueCodec::kInt8));
+  // A fp32 scale and 10 int8 per segment, padded to 4 bytes.
+  ASSERT_EQ(layout.EncodedValueSize(), 3 * 16);
+  TestRoundTrip(ValueCodec::kInt8, 64, 0.5F / 127, 1e-9F);
+  TestRoundTrip(ValueCodec::kInt8, 9, 0.5F / 127, 1e-9F);
+  std::vector<float> zeros(10, 0);
+  std::vector<char> encoded(16);
+  std::vector<float> decoded(10, 1);
+  ValueCodecLayout row_layout(10 * sizeof(float), {ValueCodec::kInt8});
+  row_layout.Encode(1, zeros.data(), encoded.data());
+  row_layout.Decode(1, encoded.data(), decoded.data());
+  ASSERT_EQ(decoded, zeros);
+}
+
+TEST(ValueCodec, SimdMatchesScalar) {
+  // A length that is not a multiple of the vector width, so that the scalar tail runs as well.
+  const uint32_t n = 1021;
+  std::vector<float> values(n);
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<float> dist(-1, 1);
+  for (uint32_t i = 0; i < n; ++i) {
+    // Covers fp16 subnormals, normals and overflow to inf.
+    values.at(i) = std::ldexp(dist(rng), static_cast<int>(i % 48) - 30);
+  }
+  values.at(n / 2) = -std::numeric_limits<float>::infinity();
+  std::vector<uint16_t> simd_encoded(n);
+  std::vector<uint16_t> scalar_encoded(n);
+  internal::EncodeFloat16(n, values.data(), simd_encoded.data(), /*simd=*/true);
+  internal::EncodeFloat16(n, values.data(), scalar_encoded.data(), /*simd=*/false);
+  ASSERT_EQ(simd_encoded, scalar_encoded);
+  // Every bit pattern but nan, whose payload the hardware keeps.
+  std::vector<uint16_t> halves;
+  for (uint32_t h = 0; h <= 0xFFFF; ++h) {
+    if ((h & 0x7FFF) <= 0x7C00) { halves.push_back(static_cast<uint16_t>(h)); }
+  }
+  std::vector<float> simd_decoded(halves.size());
+  std::vector<float> scalar_decoded(halves.size());
+  internal::DecodeFloat16(halves.size(), halves.data(), simd_decoded.data(), /*simd=*/true);
+  internal::DecodeFloat16(halves.size(), halves.data(), scalar_decoded.data(), /*simd=*/false);
+  ASSERT_EQ(std::memcmp(simd_decoded.data(), scalar_decoded.data(),
+                        simd_decoded.size() * sizeof(float)),
+            0);
+  for (const uint32_t length : {0U, 7U, 8U, n}) {
+    ASSERT_EQ(internal::MaxAbs(length, values.data(), /*simd=*/true),
+              internal::MaxAbs(length, values.data(), /*simd=*/false));
+  }
+}
+
+TEST(ValueCodec, Parse) {
+  const std::vector<ValueCodec> codecs = {ValueCodec::kFloat16, ValueCodec::kFloat32,
+                                          ValueCodec::kBFloat16, ValueCodec::kInt8};
+  ASSERT_EQ(ValueCodecsToString(codecs), "fp16,fp32,bf16,int8");
+  for (const ValueCodec codec : codecs) {
+    ASSERT_EQ(ParseValueCodec(ValueCodecsToString({codec})), codec);
+  }
+}
+
+}  // namespace
+
+}  // namespace embedding
+
+}  // namespace oneflow
@@ -18,6 +18,10 @@ limitations under the License.
 
 #ifdef WITH_ONEDNN
 
+#include <map>
+#include <mutex>
+#include <oneapi/dnnl/dnnl.hpp>
+#include "oneflow/core/common/util.h"
 #include "oneflow/core/common/env_var/env_var.h"
 
 namespace oneflow {
@@ -29,6 +33,37 @@ namespace primitive {
 
 inline bool OneDnnIsEnabled() { return EnvBool<ONEFLOW_ENABLE_ONEDNN_OPTS>(); }
 
+// oneDNN primitives keyed by engine and shape. Creating the primitive descriptor and the primitive
+// costs much more than executing them on small inputs, so they are kept across launches. Kernels
+// usually create their ep primitive at every compute, so a cache should outlive the ep primitive,
+// e.g. a function local static per oneDNN primitive type and data type. Thread safe.
+template<typename OneDnnPrimitive>
+class OneDnnPrimitiveCache {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(OneDnnPrimitiveCache);
+  OneDnnPrimitiveCache() = default;
+  ~OneDnnPrimitiveCache() = default;
+
+  template<typename CreateFn>
+  OneDnnPrimitive GetOrCreate(const dnnl::engine& engine, const dnnl::memory::dims& dims,
+                              const CreateFn& create_fn) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto key = std::make_pair(engine.get(), dims);
+    auto it = primitives_.find(key);
+    if (it == primitives_.end()) {
+      // Dynamic shapes may create a primitive per launch, the cache is bounded by dropping all.
+      if (primitives_.size() >= kMaxCacheSize) { primitives_.clear(); }
+      it = primitives_.emplace(key, create_fn()).first;
+    }
+    return it->second;
+  }
+
+ private:
+  static constexpr size_t kMaxCacheSize = 64;
+  std::mutex mutex_;
+  std::map<std::pair<dnnl_engine_t, dnnl::memory::dims>, OneDnnPrimitive> primitives_;
+};
+
 }  // namespace primitive
 }  // namespace ep
 }  // namespace oneflow
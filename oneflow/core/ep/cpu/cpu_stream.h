@@ -18,6 +18,7 @@ limitations under the License.
 
 #include "oneflow/core/ep/include/stream.h"
 #include "oneflow/core/ep/cpu/cpu_device.h"
+#include "oneflow/core/ep/cpu/parallel_for_cost.h"
 
 #define OF_RUNTIME_SEQ 0u
 #define OF_RUNTIME_OMP 1u
@@ -102,7 +103,7 @@ class CpuStream : public Stream {
 
   template<typename F>
   void ParallelFor(int64_t begin, int64_t end, const F& func) {
-    ParallelFor(begin, end, func, kParallelForDefaultGrain);
+    ParallelFor(begin, end, func, kParallelForGrainCost);
   }
   template<typename F>
   void ParallelFor(int64_t begin, int64_t end, const F& func, size_t grain_size) {
@@ -150,7 +151,6 @@ class CpuStream : public Stream {
 
  private:
   CpuDevice* device_;
-  static constexpr size_t kParallelForDefaultGrain = 32768;
 #ifdef WITH_ONEDNN
   std::unique_ptr<ep::OneDnnExecutor> onednn_executor_;
 #endif
@@ -0,0 +1,62 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_EP_CPU_PARALLEL_FOR_COST_H_
+#define ONEFLOW_CORE_EP_CPU_PARALLEL_FOR_COST_H_
+
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+namespace ep {
+
+// Cost model of CpuStream::ParallelFor. Costs are in units of a simple operation on one element,
+// and the work is split so that every piece costs about kParallelForGrainCost, which amortizes
+// handing the piece to another thread. The number of threads is bounded by
+// CpuDevice::GetNumThreads.
+constexpr int64_t kParallelForGrainCost = 32768;
+
+namespace parallel_for_cost {
+
+// Add, multiply, copy or compare of one element.
+constexpr int64_t kElementwise = 1;
+// exp, log, tanh and other calls into libm.
+constexpr int64_t kTranscendental = 8;
+// Load or store of one element through a computed index, as in gather and scatter.
+constexpr int64_t kIndexed = 2;
+
+// Comparison sort of n elements.
+inline int64_t Sort(int64_t n) {
+  int64_t log_n = 1;
+  while ((int64_t{1} << log_n) < n) { ++log_n; }
+  return 2 * n * log_n;
+}
+
+// LSD radix sort of n keys of key_bytes bytes, which counts and scatters every key once per byte.
+inline int64_t RadixSort(int64_t n, int64_t key_bytes) { return key_bytes * 2 * kIndexed * n; }
+
+}  // namespace parallel_for_cost
+
+// Grain size of a ParallelFor whose items cost about cost_per_item each.
+inline size_t GetParallelForGrainSize(int64_t cost_per_item) {
+  return static_cast<size_t>(
+      std::max<int64_t>(kParallelForGrainCost / std::max<int64_t>(cost_per_item, 1), 1));
+}
+
+}  // namespace ep
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_EP_CPU_PARALLEL_FOR_COST_H_
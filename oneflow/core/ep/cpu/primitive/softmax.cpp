@@ -18,6 +18,7 @@ limitations under the License.
 #include "oneflow/core/ep/cpu/primitive/type_seq.h"
 #include "oneflow/core/ep/cpu/cpu_stream.h"
 #include "oneflow/core/ep/cpu/cpu_device.h"
+#include "oneflow/core/ep/cpu/primitive/vectorized_math.h"
 #include "oneflow/core/ep/common/primitive/util.h"
 #include "oneflow/core/ep/common/onednn.h"
 
@@ -34,35 +35,28 @@ enum class Algorithm {
 };
 
 template<Algorithm algorithm, typename T>
-void SoftmaxCpu(size_t rows, size_t cols, const T* x, T* y) {
-  for (size_t i = 0; i < rows; ++i) {
-    size_t row_offset = i * cols;
-    const T* row_x = x + row_offset;
-    T* row_y = y + row_offset;
-    const T row_max = *std::max_element(row_x, row_x + cols);
-    T row_sum = 0;
-    for (size_t j = 0; j < cols; ++j) {
-      if (algorithm == Algorithm::kSoftmax) {
-        T exp_x = std::exp(row_x[j] - row_max);
-        row_sum += exp_x;
-        row_y[j] = exp_x;
-      } else if (algorithm == Algorithm::kLogSoftmax) {
-        row_y[j] = row_x[j] - row_max;
-        row_sum += std::exp(row_y[j]);
-      } else {
-        UNIMPLEMENTED();
-      }
-    }
-    for (size_t j = 0; j < cols; ++j) {
-      if (algorithm == Algorithm::kSoftmax) {
-        row_y[j] /= row_sum;
-      } else if (algorithm == Algorithm::kLogSoftmax) {
-        row_y[j] -= std::log(row_sum);
-      } else {
-        UNIMPLEMENTED();
-      }
-    }
-  }
+void SoftmaxCpu(CpuStream* stream, size_t rows, size_t cols, const T* x, T* y) {
+  stream->ParallelFor(
+      0, rows,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+          size_t row_offset = i * cols;
+          const T* row_x = x + row_offset;
+          T* row_y = y + row_offset;
+          const T row_max = RowMax(row_x, cols);
+          if (algorithm == Algorithm::kSoftmax) {
+            const T row_sum = ExpAndSum(row_x, row_max, row_y, cols);
+            const T inv_row_sum = static_cast<T>(1) / row_sum;
+            for (size_t j = 0; j < cols; ++j) { row_y[j] *= inv_row_sum; }
+          } else if (algorithm == Algorithm::kLogSoftmax) {
+            const T log_row_sum = std::log(ExpAndSum<T>(row_x, row_max, nullptr, cols));
+            for (size_t j = 0; j < cols; ++j) { row_y[j] = row_x[j] - row_max - log_row_sum; }
+          } else {
+            UNIMPLEMENTED();
+          }
+        }
+      },
+      GetParallelForGrainSize(cols));
 }
 
 template<typename SoftmaxBase, Algorithm algorithm, typename T>
@@ -73,7 +67,8 @@ class SoftmaxImpl : public SoftmaxBase {
   ~SoftmaxImpl() override = default;
 
   void Launch(Stream* stream, size_t rows, size_t cols, const void* x, void* y) override {
-    SoftmaxCpu<algorithm, T>(rows, cols, reinterpret_cast<const T*>(x), reinterpret_cast<T*>(y));
+    SoftmaxCpu<algorithm, T>(stream->As<CpuStream>(), rows, cols, reinterpret_cast<const T*>(x),
+                             reinterpret_cast<T*>(y));
   }
 };
 
@@ -81,6 +76,9 @@ class SoftmaxImpl : public SoftmaxBase {
 
 template<class OneDnnSoftmax, dnnl::memory::data_type data_type>
 void SoftmaxOneDnn(Stream* stream, size_t rows, size_t cols, const void* x, void* y) {
+  // Kernels create a new primitive at every compute, so the oneDNN primitives are shared by the
+  // whole process.
+  static auto* primitive_cache = new OneDnnPrimitiveCache<OneDnnSoftmax>();
   stream->As<CpuStream>()->onednn_executor()->Launch(
       [&](dnnl::engine* onednn_engine, dnnl::stream* onednn_stream) {
         dnnl::memory::dims src_dims = {static_cast<dnnl::memory::dim>(rows),
@@ -89,9 +87,11 @@ void SoftmaxOneDnn(Stream* stream, size_t rows, size_t cols, const void* x, void
         auto src_md = dnnl::memory::desc(src_dims, data_type, dnnl::memory::format_tag::nc);
         auto src_mem = dnnl::memory(src_md, *onednn_engine, const_cast<void*>(x));
         auto dst_mem = dnnl::memory(src_md, *onednn_engine, y);
-        auto softmax_d = typename OneDnnSoftmax::desc(dnnl::prop_kind::forward, src_md, 1);
-        auto softmax_pd = typename OneDnnSoftmax::primitive_desc(softmax_d, *onednn_engine);
-        auto softmax_prim = OneDnnSoftmax(softmax_pd);
+        auto softmax_prim = primitive_cache->GetOrCreate(*onednn_engine, src_dims, [&]() {
+          auto softmax_d = typename OneDnnSoftmax::desc(dnnl::prop_kind::forward, src_md, 1);
+          auto softmax_pd = typename OneDnnSoftmax::primitive_desc(softmax_d, *onednn_engine);
+          return OneDnnSoftmax(softmax_pd);
+        });
 
         softmax_prim.execute(*onednn_stream, {{DNNL_ARG_SRC, src_mem}, {DNNL_ARG_DST, dst_mem}});
       });
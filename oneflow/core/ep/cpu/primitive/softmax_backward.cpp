@@ -18,6 +18,7 @@ limitations under the License.
 #include "oneflow/core/ep/cpu/primitive/type_seq.h"
 #include "oneflow/core/ep/cpu/cpu_stream.h"
 #include "oneflow/core/ep/cpu/cpu_device.h"
+#include "oneflow/core/ep/cpu/primitive/vectorized_math.h"
 #include "oneflow/core/ep/common/onednn.h"
 #include "oneflow/core/ep/common/primitive/util.h"
 
@@ -33,33 +34,38 @@ enum class Algorithm {
   kLogSoftmax,
 };
 
+// exp(y) of log softmax is computed into a buffer of this many elements, dx may be the same as dy.
+constexpr size_t kExpBufferSize = 256;
+
 template<Algorithm algorithm, typename T>
-void SoftmaxBackwardCpu(size_t rows, size_t cols, const T* y, const T* dy, T* dx) {
-  for (size_t i = 0; i < rows; ++i) {
-    size_t row_offset = i * cols;
-    const T* row_y = y + row_offset;
-    const T* row_dy = dy + row_offset;
-    T* row_dx = dx + row_offset;
-    T row_sum = 0;
-    for (size_t j = 0; j < cols; ++j) {
-      if (algorithm == Algorithm::kSoftmax) {
-        row_sum += row_y[j] * row_dy[j];
-      } else if (algorithm == Algorithm::kLogSoftmax) {
-        row_sum += row_dy[j];
-      } else {
-        UNIMPLEMENTED();
-      }
-    }
-    for (size_t j = 0; j < cols; ++j) {
-      if (algorithm == Algorithm::kSoftmax) {
-        row_dx[j] = (row_dy[j] - row_sum) * row_y[j];
-      } else if (algorithm == Algorithm::kLogSoftmax) {
-        row_dx[j] = row_dy[j] - std::exp(row_y[j]) * row_sum;
-      } else {
-        UNIMPLEMENTED();
-      }
-    }
-  }
+void SoftmaxBackwardCpu(CpuStream* stream, size_t rows, size_t cols, const T* y, const T* dy,
+                        T* dx) {
+  stream->ParallelFor(
+      0, rows,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+          size_t row_offset = i * cols;
+          const T* row_y = y + row_offset;
+          const T* row_dy = dy + row_offset;
+          T* row_dx = dx + row_offset;
+          if (algorithm == Algorithm::kSoftmax) {
+            const T row_sum = RowDot(row_y, row_dy, cols);
+            for (size_t j = 0; j < cols; ++j) { row_dx[j] = (row_dy[j] - row_sum) * row_y[j]; }
+          } else if (algorithm == Algorithm::kLogSoftmax) {
+            T row_sum = 0;
+            for (size_t j = 0; j < cols; ++j) { row_sum += row_dy[j]; }
+            T exp_y[kExpBufferSize];
+            for (size_t j = 0; j < cols; j += kExpBufferSize) {
+              const size_t n = std::min(kExpBufferSize, cols - j);
+              ExpAndSum<T>(row_y + j, 0, exp_y, n);
+              for (size_t k = 0; k < n; ++k) { row_dx[j + k] = row_dy[j + k] - exp_y[k] * row_sum; }
+            }
+          } else {
+            UNIMPLEMENTED();
+          }
+        }
+      },
+      GetParallelForGrainSize(cols));
 }
 
 template<typename SoftmaxBackwardBase, Algorithm algorithm, typename T>
@@ -71,8 +77,9 @@ class SoftmaxBackwardImpl : public SoftmaxBackwardBase {
 
   void Launch(Stream* stream, size_t rows, size_t cols, const void* y, const void* dy,
               void* dx) override {
-    SoftmaxBackwardCpu<algorithm, T>(rows, cols, reinterpret_cast<const T*>(y),
-                                     reinterpret_cast<const T*>(dy), reinterpret_cast<T*>(dx));
+    SoftmaxBackwardCpu<algorithm, T>(stream->As<CpuStream>(), rows, cols,
+                                     reinterpret_cast<const T*>(y), reinterpret_cast<const T*>(dy),
+                                     reinterpret_cast<T*>(dx));
   }
 };
 
@@ -81,6 +88,9 @@ class SoftmaxBackwardImpl : public SoftmaxBackwardBase {
 template<class OneDnnSoftmaxBackward, class OneDnnSoftmaxForward, dnnl::memory::data_type data_type>
 void SoftmaxBackwardOneDnn(Stream* stream, size_t rows, size_t cols, const void* y, const void* dy,
                            void* dx) {
+  // Kernels create a new primitive at every compute, so the oneDNN primitives are shared by the
+  // whole process.
+  static auto* primitive_cache = new OneDnnPrimitiveCache<OneDnnSoftmaxBackward>();
   stream->As<CpuStream>()->onednn_executor()->Launch([&](dnnl::engine* onednn_engine,
                                                          dnnl::stream* onednn_stream) {
     dnnl::memory::dims src_dims = {static_cast<dnnl::memory::dim>(rows),
@@ -90,16 +100,18 @@ void SoftmaxBackwardOneDnn(Stream* stream, size_t rows, size_t cols, const void*
     // Backward memory
     auto dst_mem = dnnl::memory(same_md, *onednn_engine, const_cast<void*>(y));
     auto diff_dst_mem = dnnl::memory(same_md, *onednn_engine, const_cast<void*>(dy));
-    // Forward primitive description
-    auto forward_desc = typename OneDnnSoftmaxForward::desc(dnnl::prop_kind::forward, same_md, 1);
-    auto forward_prim_desc =
-        typename OneDnnSoftmaxForward::primitive_desc(forward_desc, *onednn_engine);
-    // Backward primitive description
     auto diff_src_mem = dnnl::memory(same_md, *onednn_engine, dx);
-    auto backward_desc = typename OneDnnSoftmaxBackward::desc(same_md, same_md, 1);
-    auto backward_prim_desc = typename OneDnnSoftmaxBackward::primitive_desc(
-        backward_desc, *onednn_engine, forward_prim_desc);
-    auto backward_prim = OneDnnSoftmaxBackward(backward_prim_desc);
+    auto backward_prim = primitive_cache->GetOrCreate(*onednn_engine, src_dims, [&]() {
+      // Forward primitive description
+      auto forward_desc = typename OneDnnSoftmaxForward::desc(dnnl::prop_kind::forward, same_md, 1);
+      auto forward_prim_desc =
+          typename OneDnnSoftmaxForward::primitive_desc(forward_desc, *onednn_engine);
+      // Backward primitive description
+      auto backward_desc = typename OneDnnSoftmaxBackward::desc(same_md, same_md, 1);
+      auto backward_prim_desc = typename OneDnnSoftmaxBackward::primitive_desc(
+          backward_desc, *onednn_engine, forward_prim_desc);
+      return OneDnnSoftmaxBackward(backward_prim_desc);
+    });
 
     backward_prim.execute(*onednn_stream, {{DNNL_ARG_DIFF_DST, diff_dst_mem},
                                            {DNNL_ARG_DST, dst_mem},
@@ -0,0 +1,247 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_EP_CPU_PRIMITIVE_VECTORIZED_MATH_H_
+#define ONEFLOW_CORE_EP_CPU_PRIMITIVE_VECTORIZED_MATH_H_
+
+#include <cmath>
+#include <limits>
+#include "oneflow/core/common/util.h"
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__CUDACC__)
+#include <immintrin.h>
+#define OF_VECTORIZED_MATH_AVX2
+#endif
+
+namespace oneflow {
+
+namespace ep {
+namespace primitive {
+
+// Reductions and exp, sigmoid and tanh over a row of n values. The float versions are vectorized
+// with AVX2 on x86-64 cpus that support it, which is checked at runtime, so the build does not
+// need to enable AVX2. The others are plain loops.
+
+template<typename T>
+T RowMax(const T* x, size_t n) {
+  T max = -std::numeric_limits<T>::infinity();
+  for (size_t i = 0; i < n; ++i) { max = std::max(max, x[i]); }
+  return max;
+}
+
+// Returns the sum of exp(x[i] - shift) and stores the values to y if it is not null. x and y may be
+// the same.
+template<typename T>
+T ExpAndSum(const T* x, T shift, T* y, size_t n) {
+  T sum = 0;
+  for (size_t i = 0; i < n; ++i) {
+    const T exp = std::exp(x[i] - shift);
+    if (y != nullptr) { y[i] = exp; }
+    sum += exp;
+  }
+  return sum;
+}
+
+template<typename T>
+T RowDot(const T* a, const T* b, size_t n) {
+  T sum = 0;
+  for (size_t i = 0; i < n; ++i) { sum += a[i] * b[i]; }
+  return sum;
+}
+
+// Stores sigmoid(x[i]) and tanh(x[i]) to y, x and y may be the same.
+template<typename T>
+void RowSigmoid(const T* x, T* y, size_t n) {
+  for (size_t i = 0; i < n; ++i) { y[i] = 1 / (1 + std::exp(-x[i])); }
+}
+
+template<typename T>
+void RowTanh(const T* x, T* y, size_t n) {
+  for (size_t i = 0; i < n; ++i) { y[i] = std::tanh(x[i]); }
+}
+
+#if defined(OF_VECTORIZED_MATH_AVX2)
+
+namespace internal {
+
+#if defined(__AVX2__) && defined(__FMA__)
+#define OF_AVX2_FMA_TARGET
+inline bool CpuHasAvx2Fma() { return true; }
+#else
+#define OF_AVX2_FMA_TARGET __attribute__((target("avx2,fma")))
+inline bool CpuHasAvx2Fma() {
+  static const bool has_avx2_fma = []() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  }();
+  return has_avx2_fma;
+}
+#endif
+
+// exp with the range reduction and polynomial of cephes expf, the relative error is about 1e-7.
+// Inputs below -87.3 give 0, inputs above 88 are clamped to 88 and NaN is propagated.
+OF_AVX2_FMA_TARGET inline __m256 Exp(__m256 x) {
+  const __m256 underflow = _mm256_cmp_ps(x, _mm256_set1_ps(-87.33654f), _CMP_LT_OQ);
+  x = _mm256_max_ps(_mm256_set1_ps(-87.33654f), x);
+  x = _mm256_min_ps(_mm256_set1_ps(88.0f), x);
+  const __m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504088896341f)),
+                                   _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  __m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(0.693359375f), x);
+  r = _mm256_fnmadd_ps(n, _mm256_set1_ps(-2.12194440e-4f), r);
+  __m256 p = _mm256_set1_ps(1.9875691500e-4f);
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.3981999507e-3f));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(8.3334519073e-3f));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(4.1665795894e-2f));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.6666665459e-1f));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(5.0000001201e-1f));
+  p = _mm256_add_ps(_mm256_fmadd_ps(p, _mm256_mul_ps(r, r), r), _mm256_set1_ps(1.0f));
+  const __m256i exponent =
+      _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+  return _mm256_andnot_ps(underflow, _mm256_mul_ps(p, _mm256_castsi256_ps(exponent)));
+}
+
+OF_AVX2_FMA_TARGET inline float HorizontalSum(__m256 v) {
+  __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  sum = _mm_hadd_ps(sum, sum);
+  sum = _mm_hadd_ps(sum, sum);
+  return _mm_cvtss_f32(sum);
+}
+
+OF_AVX2_FMA_TARGET inline float HorizontalMax(__m256 v) {
+  __m128 max = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  max = _mm_max_ps(max, _mm_movehl_ps(max, max));
+  max = _mm_max_ss(max, _mm_movehdup_ps(max));
+  return _mm_cvtss_f32(max);
+}
+
+constexpr size_t kPackSize = 8;
+
+// The functions below process the leading whole packs of a row and return the number of values
+// they processed, the callers finish the row with plain loops.
+
+OF_AVX2_FMA_TARGET inline size_t RowMaxAvx2(const float* x, size_t n, float* max) {
+  size_t i = 0;
+  if (n >= kPackSize) {
+    __m256 pack_max = _mm256_set1_ps(*max);
+    for (; i + kPackSize <= n; i += kPackSize) {
+      pack_max = _mm256_max_ps(pack_max, _mm256_loadu_ps(x + i));
+    }
+    *max = HorizontalMax(pack_max);
+  }
+  return i;
+}
+
+OF_AVX2_FMA_TARGET inline size_t ExpAndSumAvx2(const float* x, float shift, float* y, size_t n,
+                                                float* sum) {
+  size_t i = 0;
+  if (n >= kPackSize) {
+    const __m256 pack_shift = _mm256_set1_ps(shift);
+    __m256 pack_sum = _mm256_setzero_ps();
+    for (; i + kPackSize <= n; i += kPackSize) {
+      const __m256 exp = Exp(_mm256_sub_ps(_mm256_loadu_ps(x + i), pack_shift));
+      if (y != nullptr) { _mm256_storeu_ps(y + i, exp); }
+      pack_sum = _mm256_add_ps(pack_sum, exp);
+    }
+    *sum = HorizontalSum(pack_sum);
+  }
+  return i;
+}
+
+OF_AVX2_FMA_TARGET inline size_t RowDotAvx2(const float* a, const float* b, size_t n,
+                                             float* sum) {
+  size_t i = 0;
+  if (n >= kPackSize) {
+    __m256 pack_sum = _mm256_setzero_ps();
+    for (; i + kPackSize <= n; i += kPackSize) {
+      pack_sum = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), pack_sum);
+    }
+    *sum = HorizontalSum(pack_sum);
+  }
+  return i;
+}
+
+OF_AVX2_FMA_TARGET inline size_t RowSigmoidAvx2(const float* x, float* y, size_t n) {
+  size_t i = 0;
+  const __m256 one = _mm256_set1_ps(1.0f);
+  for (; i + kPackSize <= n; i += kPackSize) {
+    const __m256 exp = Exp(_mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(x + i)));
+    _mm256_storeu_ps(y + i, _mm256_div_ps(one, _mm256_add_ps(one, exp)));
+  }
+  return i;
+}
+
+// tanh(x) = 2 / (1 + exp(-2x)) - 1
+OF_AVX2_FMA_TARGET inline size_t RowTanhAvx2(const float* x, float* y, size_t n) {
+  size_t i = 0;
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 two = _mm256_set1_ps(2.0f);
+  for (; i + kPackSize <= n; i += kPackSize) {
+    const __m256 exp = Exp(_mm256_mul_ps(_mm256_set1_ps(-2.0f), _mm256_loadu_ps(x + i)));
+    _mm256_storeu_ps(y + i, _mm256_sub_ps(_mm256_div_ps(two, _mm256_add_ps(one, exp)), one));
+  }
+  return i;
+}
+
+#undef OF_AVX2_FMA_TARGET
+
+}  // namespace internal
+
+template<>
+inline float RowMax<float>(const float* x, size_t n) {
+  float max = -std::numeric_limits<float>::infinity();
+  size_t i = internal::CpuHasAvx2Fma() ? internal::RowMaxAvx2(x, n, &max) : 0;
+  for (; i < n; ++i) { max = std::max(max, x[i]); }
+  return max;
+}
+
+template<>
+inline float ExpAndSum<float>(const float* x, float shift, float* y, size_t n) {
+  float sum = 0;
+  size_t i = internal::CpuHasAvx2Fma() ? internal::ExpAndSumAvx2(x, shift, y, n, &sum) : 0;
+  for (; i < n; ++i) {
+    const float exp = std::exp(x[i] - shift);
+    if (y != nullptr) { y[i] = exp; }
+    sum += exp;
+  }
+  return sum;
+}
+
+template<>
+inline float RowDot<float>(const float* a, const float* b, size_t n) {
+  float sum = 0;
+  size_t i = internal::CpuHasAvx2Fma() ? internal::RowDotAvx2(a, b, n, &sum) : 0;
+  for (; i < n; ++i) { sum += a[i] * b[i]; }
+  return sum;
+}
+
+template<>
+inline void RowSigmoid<float>(const float* x, float* y, size_t n) {
+  size_t i = internal::CpuHasAvx2Fma() ? internal::RowSigmoidAvx2(x, y, n) : 0;
+  for (; i < n; ++i) { y[i] = 1.0f / (1.0f + std::exp(-x[i])); }
+}
+
+template<>
+inline void RowTanh<float>(const float* x, float* y, size_t n) {
+  size_t i = internal::CpuHasAvx2Fma() ? internal::RowTanhAvx2(x, y, n) : 0;
+  for (; i < n; ++i) { y[i] = std::tanh(x[i]); }
+}
+
+#endif  // defined(OF_VECTORIZED_MATH_AVX2)
+
+}  // namespace primitive
+}  // namespace ep
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_EP_CPU_PRIMITIVE_VECTORIZED_MATH_H_
@@ -473,7 +473,6 @@ class TensorDotFunctor {
 class FusedMLPFunctor {
  public:
   FusedMLPFunctor() {
-#if CUDA_VERSION >= 11060
     fused_op_.resize(kMaxInputCount /*the maximum number of inputs*/);
     for (int n = 1; n < fused_op_.size(); ++n) {
       fused_op_[n] = CHECK_JUST(one::OpBuilder("cublas_fused_mlp")
@@ -485,7 +484,6 @@ class FusedMLPFunctor {
                                     .Output("hidden", n)
                                     .Build());
     }
-#endif
   }
   Maybe<Tensor> operator()(const std::shared_ptr<one::Tensor>& x, const TensorTuple& weights,
                            const TensorTuple& biases, bool skip_final_activation) const {
@@ -523,7 +521,6 @@ class FusedMLPFunctor {
       k = n;
     }
 
-#if CUDA_VERSION >= 11060
     DeviceType device_type{};
     if (x->is_consistent()) {
       device_type = JUST(x->parallel_desc())->device_type();
@@ -531,7 +528,16 @@ class FusedMLPFunctor {
       device_type = JUST(x->device())->enum_type();
     }
 
-    if ((device_type == DeviceType::kCUDA) && (weight_size <= kMaxInputCount)
+    // The cpu kernel supports float and double.
+    const DataType data_type = x->dtype()->data_type();
+    bool fused_kernel_available =
+        device_type == DeviceType::kCPU
+        && (data_type == DataType::kFloat || data_type == DataType::kDouble);
+#if CUDA_VERSION >= 11060
+    fused_kernel_available = fused_kernel_available || device_type == DeviceType::kCUDA;
+#endif  // CUDA_VERSION >= 11060
+
+    if (fused_kernel_available && (weight_size <= kMaxInputCount)
         && (!ParseBooleanFromEnv("ONEFLOW_FUNCTOR_DISABLE_FUSED_MLP", false))) {
       TensorTuple input(2 * weight_size + 1);
       input[0] = x;
@@ -542,7 +548,6 @@ class FusedMLPFunctor {
       JUST(attrs.SetAttr<bool>("skip_final_activation", skip_final_activation));
       return OpInterpUtil::Dispatch<Tensor>(*fused_op_[weight_size], input, attrs);
     }
-#endif  // CUDA_VERSION >= 11060
 
     // Fall back to Naive matmul + bias_add + relu
     std::shared_ptr<one::Tensor> out = x;
@@ -2750,6 +2755,40 @@ class FusedScaleMaskSoftmaxDropoutFunctor {
   std::shared_ptr<OpExpr> fused_scale_mask_softmax_dropout_op_;
 };
 
+class FusedMultiHeadAttentionInferenceFunctor {
+ public:
+  FusedMultiHeadAttentionInferenceFunctor() {
+    op_ = CHECK_JUST(one::OpBuilder("fused_multi_head_attention_inference")
+                         .Input("query")
+                         .Input("key")
+                         .Input("value")
+                         .Output("out")
+                         .Build());
+  }
+  Maybe<Tensor> operator()(const std::shared_ptr<one::Tensor>& query,
+                           const std::shared_ptr<one::Tensor>& key,
+                           const std::shared_ptr<one::Tensor>& value, const int64_t& num_heads,
+                           const bool& causal, const Optional<double>& scale) const {
+    CHECK_EQ_OR_RETURN(query->ndim(), 3)
+        << Error::RuntimeError() << "query should be a 3D tensor (batch, seq_len, hidden)";
+    CHECK_GT_OR_RETURN(num_heads, 0) << Error::RuntimeError() << "num_heads should be positive";
+    const int64_t hidden_size = query->shape()->At(2);
+    CHECK_EQ_OR_RETURN(hidden_size % num_heads, 0)
+        << Error::RuntimeError() << "hidden size of query " << hidden_size
+        << " is not divisible by num_heads " << num_heads;
+    MutableAttrMap attrs;
+    JUST(attrs.SetAttr<int64_t>("num_heads", num_heads));
+    JUST(attrs.SetAttr<bool>("causal", causal));
+    // defaults to 1 / sqrt(head_size)
+    JUST(attrs.SetAttr<double>(
+        "scale", scale.value_or(1.0 / std::sqrt(static_cast<double>(hidden_size / num_heads)))));
+    return OpInterpUtil::Dispatch<Tensor>(*op_, {query, key, value}, attrs);
+  }
+
+ private:
+  std::shared_ptr<OpExpr> op_;
+};
+
 class CtcGreedyDecoderFunctor {
  public:
   CtcGreedyDecoderFunctor() {
@@ -3433,6 +3472,7 @@ ONEFLOW_FUNCTION_LIBRARY(m) {
   m.add_functor<impl::FusedBiasAddDropoutFunctor>("FusedBiasAddDropout");
   m.add_functor<impl::FusedScaleMaskSoftmaxFunctor>("FusedScaleMaskSoftmax");
   m.add_functor<impl::FusedScaleMaskSoftmaxDropoutFunctor>("FusedScaleMaskSoftmaxDropout");
+  m.add_functor<impl::FusedMultiHeadAttentionInferenceFunctor>("FusedMultiHeadAttentionInference");
   m.add_functor<impl::FusedScaleTrilSoftmaxMaskScaleFunctor>("FusedScaleTrilSoftmaxMaskScale");
   m.add_functor<impl::FusedScaleTrilFunctor>("FusedScaleTril");
   m.add_functor<impl::CtcGreedyDecoderFunctor>("CtcGreedyDecoder");
@@ -57,6 +57,13 @@ struct relu_f {
   }
 };
 
+// The fused cell kernels run on CUDA, and on CPU for float and double only.
+bool use_fused_rnn_cell(DeviceType device_type, DataType data_type, bool pre_compute_input) {
+  if (device_type == DeviceType::kCUDA) { return true; }
+  return device_type == DeviceType::kCPU && !pre_compute_input
+         && (data_type == DataType::kFloat || data_type == DataType::kDouble);
+}
+
 Maybe<void> check_rnn_cell_forward_input(const std::shared_ptr<one::Tensor>& input,
                                          int64_t input_size) {
   CHECK_OR_RETURN(input->shape()->At(1) == input_size)
@@ -231,7 +238,7 @@ struct GRUCell {
       input_device = JUST(input->device())->enum_type();
     }
 
-    if (input_device == DeviceType::kCUDA) {
+    if (use_fused_rnn_cell(input_device, input->dtype()->data_type(), pre_compute_input)) {
       CHECK_OR_RETURN(!pre_compute_input);
 
       std::shared_ptr<one::Tensor> igates = JUST(params.matmul_ih(input));
@@ -284,7 +291,7 @@ struct LSTMCell {
       input_device = JUST(input->device())->enum_type();
     }
 
-    if (input_device == DeviceType::kCUDA) {
+    if (use_fused_rnn_cell(input_device, input->dtype()->data_type(), pre_compute_input)) {
       CHECK_OR_RETURN(!pre_compute_input);
 
       std::shared_ptr<one::Tensor> igates = JUST(params.matmul_ih(input));
@@ -0,0 +1,346 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/persistence/checkpoint_container.h"
+#include "oneflow/core/persistence/checkpoint_container.pb.h"
+#include "oneflow/core/common/data_type.h"
+#include "oneflow/core/common/shape.pb.h"
+#include "oneflow/core/common/str_util.h"
+#include "oneflow/core/thread/thread_manager.h"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace oneflow {
+
+namespace {
+
+constexpr uint64_t kCheckpointContainerVersion = 1;
+constexpr uint64_t kDataOffset = 4096;
+constexpr size_t kMaxWritePieceSize = 16 * 1024 * 1024;
+constexpr char kCheckpointContainerMagic[8] = {'O', 'F', 'C', 'K', 'P', 'T', '\0', '\0'};
+
+struct CheckpointContainerHeader {
+  char magic[8];
+  uint64_t version;
+  uint64_t table_offset;
+  uint64_t table_size;
+  uint64_t reserved[4];
+};
+
+static_assert(sizeof(CheckpointContainerHeader) == 64, "");
+
+std::string GetShardPath(const std::string& path, int64_t shard_index, int64_t num_shards) {
+  if (num_shards == 1) { return path; }
+  char suffix[32];
+  snprintf(suffix, sizeof(suffix), "-%05ld-of-%05ld", static_cast<long>(shard_index),
+           static_cast<long>(num_shards));
+  return path + suffix;
+}
+
+bool IsDecimal(const std::string& str, size_t pos, size_t len) {
+  for (size_t i = pos; i < pos + len; ++i) {
+    if (str.at(i) < '0' || str.at(i) > '9') { return false; }
+  }
+  return true;
+}
+
+struct ContainerFile {
+  std::string path;
+  int64_t shard_index;
+  int64_t num_shards;
+};
+
+// Lists the files of the containers at `path`. Next to the current container there may be the
+// files of an older one written with another number of shards.
+Maybe<std::vector<ContainerFile>> ListContainerFiles(const std::string& path) {
+  std::vector<ContainerFile> files;
+  const std::string dir_name = Dirname(path);
+  const std::string base = Basename(path);
+  DIR* dir = opendir(dir_name.empty() ? "." : dir_name.c_str());
+  if (dir == nullptr) { return files; }
+  struct dirent* ent = nullptr;
+  while ((ent = readdir(dir)) != nullptr) {
+    const std::string name = ent->d_name;
+    if (name == base) {
+      if (IsRegularFile(path)) { files.push_back(ContainerFile{path, 0, 1}); }
+      continue;
+    }
+    // <base>-00000-of-00004
+    const size_t pos = base.size();
+    if (name.size() != pos + 15 || name.compare(0, pos, base) != 0 || name.at(pos) != '-'
+        || name.compare(pos + 6, 4, "-of-") != 0 || !IsDecimal(name, pos + 1, 5)
+        || !IsDecimal(name, pos + 10, 5)) {
+      continue;
+    }
+    files.push_back(ContainerFile{JoinPath(dir_name, name),
+                                  std::strtol(name.c_str() + pos + 1, nullptr, 10),
+                                  std::strtol(name.c_str() + pos + 10, nullptr, 10)});
+  }
+  CHECK_OR_RETURN(closedir(dir) == 0)
+      << Error::RuntimeError() << "fail to close directory " << dir_name << ": "
+      << strerror(errno);
+  return files;
+}
+
+// Returns 0 if there is no container at `path`.
+Maybe<int64_t> FindNumShards(const std::string& path) {
+  const auto& files = JUST(ListContainerFiles(path));
+  if (files.empty()) { return 0; }
+  const int64_t num_shards = files->front().num_shards;
+  for (const ContainerFile& file : *files) {
+    CHECK_EQ_OR_RETURN(file.num_shards, num_shards)
+        << Error::RuntimeError() << "checkpoint container " << path
+        << " has files of different numbers of shards";
+    CHECK_LT_OR_RETURN(file.shard_index, num_shards)
+        << Error::RuntimeError() << "invalid shard file " << file.path;
+  }
+  CHECK_EQ_OR_RETURN(static_cast<int64_t>(files->size()), num_shards)
+      << Error::RuntimeError() << "checkpoint container " << path << " is missing shards";
+  return num_shards;
+}
+
+// Returns 0 or the errno of the failed write.
+int PwriteFully(int fd, const char* data, size_t n, uint64_t offset) {
+  while (n > 0) {
+    const ssize_t r = pwrite(fd, data, n, static_cast<off_t>(offset));
+    if (r < 0 && errno == EINTR) { continue; }
+    if (r < 0) { return errno; }
+    if (r == 0) { return EIO; }
+    data += r;
+    n -= r;
+    offset += r;
+  }
+  return 0;
+}
+
+// Closes the temporary shard files and removes the ones not renamed yet, so that a failed write
+// leaves nothing behind.
+struct TmpShardFiles {
+  std::vector<std::string> paths;
+  std::vector<int> fds;
+
+  ~TmpShardFiles() {
+    for (size_t i = 0; i < paths.size(); ++i) {
+      if (fds.at(i) >= 0) { close(fds.at(i)); }
+      unlink(paths.at(i).c_str());
+    }
+  }
+};
+
+}  // namespace
+
+Maybe<void> WriteCheckpointContainer(const std::string& path,
+                                     const std::vector<CheckpointTensor>& tensors,
+                                     int64_t num_shards) {
+  CHECK_GT_OR_RETURN(num_shards, 0) << "num_shards must be positive";
+  // Hand the tensors, largest first, to the shard with the fewest bytes so far, and keep their
+  // original order within a shard.
+  std::vector<size_t> sizes(tensors.size());
+  std::vector<size_t> order(tensors.size());
+  HashSet<std::string> names;
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    const CheckpointTensor& tensor = tensors.at(i);
+    CHECK_OR_RETURN(names.insert(tensor.name).second)
+        << "duplicated tensor name " << tensor.name << " in checkpoint container " << path;
+    sizes.at(i) = tensor.shape.elem_cnt() * GetSizeOfDataType(tensor.data_type);
+    order.at(i) = i;
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&](size_t a, size_t b) { return sizes.at(a) > sizes.at(b); });
+  std::vector<int64_t> shard_of_tensor(tensors.size());
+  std::vector<uint64_t> shard_bytes(num_shards, 0);
+  for (size_t i : order) {
+    const int64_t shard = std::min_element(shard_bytes.begin(), shard_bytes.end())
+                          - shard_bytes.begin();
+    shard_of_tensor.at(i) = shard;
+    shard_bytes.at(shard) += RoundUp(sizes.at(i), kCheckpointTensorAlignment);
+  }
+
+  struct WritePiece {
+    int64_t shard;
+    const char* data;
+    uint64_t offset;
+    size_t size;
+  };
+  std::vector<CheckpointContainerTable> tables(num_shards);
+  std::vector<uint64_t> data_end(num_shards, kDataOffset);
+  std::vector<WritePiece> pieces;
+  for (int64_t shard = 0; shard < num_shards; ++shard) {
+    tables.at(shard).set_shard_index(shard);
+    tables.at(shard).set_num_shards(num_shards);
+  }
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    const CheckpointTensor& tensor = tensors.at(i);
+    const int64_t shard = shard_of_tensor.at(i);
+    const uint64_t offset = data_end.at(shard);
+    CheckpointContainerEntry* entry = tables.at(shard).add_entry();
+    entry->set_name(tensor.name);
+    tensor.shape.ToProto(entry->mutable_shape());
+    entry->set_data_type(tensor.data_type);
+    entry->set_offset(offset);
+    entry->set_size(sizes.at(i));
+    const char* data = static_cast<const char*>(tensor.data);
+    for (size_t pos = 0; pos < sizes.at(i); pos += kMaxWritePieceSize) {
+      const size_t piece_size = std::min(kMaxWritePieceSize, sizes.at(i) - pos);
+      pieces.push_back(WritePiece{shard, data + pos, offset + pos, piece_size});
+    }
+    data_end.at(shard) = RoundUp(offset + sizes.at(i), kCheckpointTensorAlignment);
+  }
+
+  TmpShardFiles tmp_files;
+  tmp_files.paths.resize(num_shards);
+  tmp_files.fds.resize(num_shards, -1);
+  for (int64_t shard = 0; shard < num_shards; ++shard) {
+    const std::string& tmp_path = tmp_files.paths.at(shard) =
+        GetShardPath(path, shard, num_shards) + ".tmp";
+    tmp_files.fds.at(shard) = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    CHECK_OR_RETURN(tmp_files.fds.at(shard) >= 0)
+        << Error::RuntimeError() << "fail to open file " << tmp_path << ": " << strerror(errno);
+  }
+  std::atomic<int> write_errno(0);
+  MultiThreadLoop(pieces.size(), [&](size_t i) {
+    const WritePiece& piece = pieces.at(i);
+    const int err =
+        PwriteFully(tmp_files.fds.at(piece.shard), piece.data, piece.size, piece.offset);
+    if (err != 0) { write_errno = err; }
+  });
+  CHECK_EQ_OR_RETURN(write_errno.load(), 0)
+      << Error::RuntimeError() << "fail to write checkpoint container " << path << ": "
+      << strerror(write_errno.load());
+  for (int64_t shard = 0; shard < num_shards; ++shard) {
+    std::string table;
+    CHECK_OR_RETURN(tables.at(shard).SerializeToString(&table));
+    CheckpointContainerHeader header{};
+    std::memcpy(header.magic, kCheckpointContainerMagic, sizeof(header.magic));
+    header.version = kCheckpointContainerVersion;
+    header.table_offset = data_end.at(shard);
+    header.table_size = table.size();
+    int& fd = tmp_files.fds.at(shard);
+    const std::string& tmp_path = tmp_files.paths.at(shard);
+    int err = PwriteFully(fd, table.data(), table.size(), header.table_offset);
+    if (err == 0) {
+      err = PwriteFully(fd, reinterpret_cast<const char*>(&header), sizeof(header), 0);
+    }
+    CHECK_EQ_OR_RETURN(err, 0) << Error::RuntimeError() << "fail to write file " << tmp_path
+                               << ": " << strerror(err);
+    const int close_ret = close(fd);
+    fd = -1;
+    CHECK_EQ_OR_RETURN(close_ret, 0)
+        << Error::RuntimeError() << "fail to close file " << tmp_path << ": " << strerror(errno);
+  }
+  // Files of an earlier container at `path` with the same number of shards are replaced by the
+  // renames, the ones of another number of shards are removed first.
+  for (const ContainerFile& file : *JUST(ListContainerFiles(path))) {
+    if (file.num_shards == num_shards) { continue; }
+    CHECK_OR_RETURN(unlink(file.path.c_str()) == 0 || errno == ENOENT)
+        << Error::RuntimeError() << "fail to remove stale checkpoint container file " << file.path
+        << ": " << strerror(errno);
+  }
+  for (int64_t shard = 0; shard < num_shards; ++shard) {
+    const std::string& tmp_path = tmp_files.paths.at(shard);
+    const std::string shard_path = GetShardPath(path, shard, num_shards);
+    CHECK_OR_RETURN(rename(tmp_path.c_str(), shard_path.c_str()) == 0)
+        << Error::RuntimeError() << "fail to rename " << tmp_path << " to " << shard_path << ": "
+        << strerror(errno);
+  }
+  return Maybe<void>::Ok();
+}
+
+bool CheckpointContainerExists(const std::string& path) {
+  return !CHECK_JUST(ListContainerFiles(path))->empty();
+}
+
+CheckpointContainer::~CheckpointContainer() {
+  for (const auto& mapping : mappings_) { PCHECK(munmap(mapping.first, mapping.second) == 0); }
+}
+
+Maybe<CheckpointContainer> CheckpointContainer::Open(const std::string& path) {
+  const int64_t num_shards = JUST(FindNumShards(path));
+  CHECK_GT_OR_RETURN(num_shards, 0) << "checkpoint container " << path << " does not exist";
+  std::shared_ptr<CheckpointContainer> container(new CheckpointContainer());
+  for (int64_t shard = 0; shard < num_shards; ++shard) {
+    const std::string shard_path = GetShardPath(path, shard, num_shards);
+    const int fd = open(shard_path.c_str(), O_RDONLY);
+    CHECK_OR_RETURN(fd >= 0) << Error::RuntimeError() << "fail to open checkpoint container file "
+                             << shard_path << ": " << strerror(errno);
+    struct stat st {};
+    const bool stat_ok = fstat(fd, &st) == 0;
+    const size_t file_size = stat_ok ? st.st_size : 0;
+    void* ptr = MAP_FAILED;
+    if (stat_ok && file_size >= sizeof(CheckpointContainerHeader)) {
+      ptr = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    const int err = errno;
+    close(fd);
+    CHECK_OR_RETURN(stat_ok) << Error::RuntimeError() << "fail to stat file " << shard_path
+                             << ": " << strerror(err);
+    CHECK_GE_OR_RETURN(file_size, sizeof(CheckpointContainerHeader))
+        << Error::RuntimeError() << shard_path << " is not a checkpoint container file";
+    CHECK_OR_RETURN(ptr != MAP_FAILED)
+        << Error::RuntimeError() << "fail to map file " << shard_path << ": " << strerror(err);
+    container->mappings_.emplace_back(ptr, file_size);
+    // Start paging in the whole shard in the background
+    CHECK_OR_RETURN(madvise(ptr, file_size, MADV_WILLNEED) == 0)
+        << Error::RuntimeError() << "fail to advise the mapping of " << shard_path << ": "
+        << strerror(errno);
+    char* base = static_cast<char*>(ptr);
+
+    CheckpointContainerHeader header{};
+    std::memcpy(&header, base, sizeof(header));
+    CHECK_OR_RETURN(std::memcmp(header.magic, kCheckpointContainerMagic, sizeof(header.magic)) == 0)
+        << shard_path << " is not a checkpoint container file";
+    CHECK_EQ_OR_RETURN(header.version, kCheckpointContainerVersion)
+        << "unsupported version of checkpoint container file " << shard_path;
+    CHECK_LE_OR_RETURN(header.table_offset + header.table_size, file_size)
+        << "checkpoint container file " << shard_path << " is truncated";
+    CheckpointContainerTable table;
+    CHECK_OR_RETURN(table.ParseFromArray(base + header.table_offset, header.table_size))
+        << "fail to parse the table of checkpoint container file " << shard_path;
+    CHECK_EQ_OR_RETURN(table.shard_index(), shard);
+    CHECK_EQ_OR_RETURN(table.num_shards(), num_shards);
+    for (const CheckpointContainerEntry& entry : table.entry()) {
+      Tensor tensor;
+      tensor.name = entry.name();
+      tensor.data_type = entry.data_type();
+      tensor.shape = Shape(entry.shape());
+      tensor.data = base + entry.offset();
+      tensor.size = entry.size();
+      CHECK_EQ_OR_RETURN(tensor.size,
+                         tensor.shape.elem_cnt() * GetSizeOfDataType(tensor.data_type))
+          << "size mismatch of tensor " << tensor.name << " in " << shard_path;
+      CHECK_LE_OR_RETURN(entry.offset() + entry.size(), header.table_offset)
+          << "tensor " << tensor.name << " is out of the data of " << shard_path;
+      CHECK_OR_RETURN(
+          container->name2index_.emplace(tensor.name, container->tensors_.size()).second)
+          << "duplicated tensor name " << tensor.name << " in checkpoint container " << path;
+      container->tensors_.emplace_back(std::move(tensor));
+    }
+  }
+  return container;
+}
+
+const CheckpointContainer::Tensor* CheckpointContainer::Find(const std::string& name) const {
+  const auto it = name2index_.find(name);
+  if (it == name2index_.end()) { return nullptr; }
+  return &tensors_.at(it->second);
+}
+
+}  // namespace oneflow
@@ -0,0 +1,89 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_PERSISTENCE_CHECKPOINT_CONTAINER_H_
+#define ONEFLOW_CORE_PERSISTENCE_CHECKPOINT_CONTAINER_H_
+
+#include "oneflow/core/common/maybe.h"
+#include "oneflow/core/common/shape.h"
+#include "oneflow/core/common/data_type.pb.h"
+#include <unordered_map>
+
+namespace oneflow {
+
+// A checkpoint container stores many tensors in one file, or in num_shards files named
+// <path>-00000-of-00004 and so on. A shard file is laid out as
+//
+//   header | data of the tensors, each aligned to kCheckpointTensorAlignment | table
+//
+// where the header holds a magic, the format version and the position of the table, and the
+// table is a serialized CheckpointContainerTable with the name, shape, data type and offset of
+// every tensor of the shard. The data starts at a page boundary, so a mapped shard can be used
+// as tensor memory directly.
+
+constexpr char const* kCheckpointContainerFileName = "tensors";
+constexpr size_t kCheckpointTensorAlignment = 64;
+
+struct CheckpointTensor {
+  std::string name;
+  DataType data_type;
+  Shape shape;
+  // elem_cnt * sizeof(data_type) bytes
+  const void* data;
+};
+
+// Writes `tensors` into a container at `path`, spreading them over num_shards files of about the
+// same size. The data is written by the threads of the global ThreadPool, and every file is
+// written under a temporary name and renamed when complete. The files of an older container at
+// `path` with another number of shards are removed before the renames.
+Maybe<void> WriteCheckpointContainer(const std::string& path,
+                                     const std::vector<CheckpointTensor>& tensors,
+                                     int64_t num_shards);
+
+bool CheckpointContainerExists(const std::string& path);
+
+// A container opened for reading. The shard files are mapped copy-on-write, so the tensor data
+// can be read and modified in place without touching the files and is paged in on first access.
+// The mappings live as long as the container.
+class CheckpointContainer final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(CheckpointContainer);
+  ~CheckpointContainer();
+
+  static Maybe<CheckpointContainer> Open(const std::string& path);
+
+  struct Tensor {
+    std::string name;
+    DataType data_type;
+    Shape shape;
+    char* data;
+    size_t size;
+  };
+
+  const std::vector<Tensor>& tensors() const { return tensors_; }
+  // Returns nullptr if the container has no tensor of `name`.
+  const Tensor* Find(const std::string& name) const;
+
+ private:
+  CheckpointContainer() = default;
+
+  std::vector<std::pair<void*, size_t>> mappings_;
+  std::vector<Tensor> tensors_;
+  std::unordered_map<std::string, size_t> name2index_;
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_PERSISTENCE_CHECKPOINT_CONTAINER_H_
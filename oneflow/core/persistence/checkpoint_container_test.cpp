@@ -0,0 +1,110 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <gtest/gtest.h>
+#include <cstring>
+#include "oneflow/core/common/data_type.h"
+#include "oneflow/core/common/process_state.h"
+#include "oneflow/core/common/str_util.h"
+#include "oneflow/core/persistence/checkpoint_container.h"
+#include "oneflow/core/persistence/posix/posix_file_system.h"
+
+namespace oneflow {
+
+namespace {
+
+void TestCheckpointContainer(int64_t num_shards) {
+  std::string current_dir = GetCwd();
+  StringReplace(&current_dir, '\\', '/');
+  const std::string path = JoinPath(current_dir, "/tmp_test_checkpoint_container");
+  std::vector<float> weight(33 * 1029);
+  for (size_t i = 0; i < weight.size(); ++i) { weight.at(i) = static_cast<float>(i) * 0.5f; }
+  std::vector<int64_t> step = {42};
+  std::vector<double> bias(7, 1.25);
+  const std::vector<CheckpointTensor> tensors = {
+      {"weight", DataType::kFloat, Shape({33, 1029}), weight.data()},
+      {"step", DataType::kInt64, Shape({}), step.data()},
+      {"bias", DataType::kDouble, Shape({7}), bias.data()},
+      {"empty", DataType::kFloat, Shape({0, 3}), nullptr},
+  };
+  ASSERT_FALSE(CheckpointContainerExists(path));
+  CHECK_JUST(WriteCheckpointContainer(path, tensors, num_shards));
+  ASSERT_TRUE(CheckpointContainerExists(path));
+  {
+    const auto& container = CHECK_JUST(CheckpointContainer::Open(path));
+    ASSERT_EQ(container->tensors().size(), tensors.size());
+    ASSERT_EQ(container->Find("missing"), nullptr);
+    for (const CheckpointTensor& tensor : tensors) {
+      const CheckpointContainer::Tensor* loaded = container->Find(tensor.name);
+      ASSERT_NE(loaded, nullptr);
+      ASSERT_EQ(loaded->data_type, tensor.data_type);
+      ASSERT_EQ(loaded->shape, tensor.shape);
+      ASSERT_EQ(reinterpret_cast<uintptr_t>(loaded->data) % kCheckpointTensorAlignment, 0);
+      ASSERT_EQ(loaded->size, tensor.shape.elem_cnt() * GetSizeOfDataType(tensor.data_type));
+      if (loaded->size > 0) { ASSERT_EQ(std::memcmp(loaded->data, tensor.data, loaded->size), 0); }
+    }
+    // the mapping is private, writes do not reach the file
+    *reinterpret_cast<int64_t*>(container->Find("step")->data) = 0;
+  }
+  const auto& container = CHECK_JUST(CheckpointContainer::Open(path));
+  ASSERT_EQ(*reinterpret_cast<const int64_t*>(container->Find("step")->data), 42);
+  fs::PosixFileSystem file_system;
+  for (const std::string& name : file_system.ListDir(current_dir)) {
+    if (name.find("tmp_test_checkpoint_container") == 0) {
+      file_system.DelFile(JoinPath(current_dir, name));
+    }
+  }
+}
+
+size_t CountContainerFiles(const std::string& dir) {
+  fs::PosixFileSystem file_system;
+  size_t count = 0;
+  for (const std::string& name : file_system.ListDir(dir)) {
+    if (name.find("tmp_test_checkpoint_container") == 0) { count += 1; }
+  }
+  return count;
+}
+
+}  // namespace
+
+TEST(CheckpointContainer, SingleFile) { TestCheckpointContainer(1); }
+
+TEST(CheckpointContainer, Sharded) { TestCheckpointContainer(3); }
+
+TEST(CheckpointContainer, Rewrite) {
+  std::string current_dir = GetCwd();
+  StringReplace(&current_dir, '\\', '/');
+  const std::string path = JoinPath(current_dir, "/tmp_test_checkpoint_container");
+  std::vector<int64_t> step = {0};
+  const std::vector<CheckpointTensor> tensors = {
+      {"step", DataType::kInt64, Shape({}), step.data()},
+  };
+  for (int64_t num_shards : {3, 1, 2, 2}) {
+    step.at(0) = num_shards;
+    CHECK_JUST(WriteCheckpointContainer(path, tensors, num_shards));
+    // the files of the container written before are gone
+    ASSERT_EQ(CountContainerFiles(current_dir), static_cast<size_t>(num_shards));
+    const auto& container = CHECK_JUST(CheckpointContainer::Open(path));
+    ASSERT_EQ(*reinterpret_cast<const int64_t*>(container->Find("step")->data), num_shards);
+  }
+  fs::PosixFileSystem file_system;
+  for (const std::string& name : file_system.ListDir(current_dir)) {
+    if (name.find("tmp_test_checkpoint_container") == 0) {
+      file_system.DelFile(JoinPath(current_dir, name));
+    }
+  }
+}
+
+}  // namespace oneflow
@@ -26,6 +26,12 @@ namespace oneflow {
 
 namespace fs {
 
+void RandomAccessFile::ReadBatch(const std::vector<FileReadRequest>& requests) const {
+  for (const FileReadRequest& request : requests) {
+    Read(request.offset, request.n, request.result);
+  }
+}
+
 std::string FileSystem::SplitRecursiveDir(const std::string& dirname,
                                           std::vector<std::string>& sub_dirs) {
   std::string remaining_dir = dirname;
@@ -23,6 +23,13 @@ namespace oneflow {
 
 namespace fs {
 
+// A read of `n` bytes at `offset` into `result`, see RandomAccessFile::ReadBatch.
+struct FileReadRequest {
+  uint64_t offset;
+  size_t n;
+  char* result;
+};
+
 // A file abstraction for randomly reading the contents of a file.
 class RandomAccessFile {
  public:
@@ -36,6 +43,12 @@ class RandomAccessFile {
   // Safe for concurrent use by multiple threads.
   virtual void Read(uint64_t offset, size_t n, char* result) const = 0;
 
+  // Performs all the `requests` and returns once every one of them is done. Implementations may
+  // keep several of the reads in flight at once, the default one calls Read for each in order.
+  //
+  // Safe for concurrent use by multiple threads.
+  virtual void ReadBatch(const std::vector<FileReadRequest>& requests) const;
+
  private:
 };
 
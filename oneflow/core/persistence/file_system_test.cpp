@@ -14,9 +14,11 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include <gtest/gtest.h>
+#include <random>
 #include "oneflow/core/common/process_state.h"
 #include "oneflow/core/common/str_util.h"
 #include "oneflow/core/persistence/posix/posix_file_system.h"
+#include "oneflow/core/persistence/posix/async_binary_in_stream.h"
 
 namespace oneflow {
 
@@ -99,12 +101,87 @@ void TestMultiThreadsDirOperation(FileSystem* file_system) {
   ASSERT_TRUE(file_system->IsDirectory(test_root_path));
 }
 
+std::string WriteRandomFile(FileSystem* file_system, const std::string& file_name, size_t size) {
+  std::mt19937 engine(size);
+  std::string content(size, '\0');
+  for (char& c : content) { c = static_cast<char>(engine()); }
+  std::unique_ptr<WritableFile> writable_file;
+  file_system->NewWritableFile(file_name, &writable_file);
+  writable_file->Append(content.data(), content.size());
+  writable_file->Close();
+  return content;
+}
+
+void TestReadBatch(FileSystem* file_system) {
+  std::string current_dir = GetCwd();
+  StringReplace(&current_dir, '\\', '/');
+  std::string file_name = JoinPath(current_dir, "/tmp_test_read_batch_file");
+  const size_t file_size = 40 * 1024 * 1024 + 7;
+  const std::string content = WriteRandomFile(file_system, file_name, file_size);
+  std::unique_ptr<RandomAccessFile> random_access_file;
+  file_system->NewRandomAccessFile(file_name, &random_access_file);
+  const std::vector<std::pair<uint64_t, size_t>> ranges = {
+      {0, 1}, {3, 4096}, {1024 * 1024 + 5, 123}, {0, file_size}, {file_size - 7, 7}, {100, 0}};
+  std::vector<std::string> results(ranges.size());
+  std::vector<FileReadRequest> requests;
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    results.at(i).resize(ranges.at(i).second);
+    requests.push_back(
+        FileReadRequest{ranges.at(i).first, ranges.at(i).second, &results.at(i)[0]});
+  }
+  random_access_file->ReadBatch(requests);
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    ASSERT_EQ(results.at(i), content.substr(ranges.at(i).first, ranges.at(i).second));
+  }
+  random_access_file.reset();
+  file_system->DelFile(file_name);
+}
+
 void TestFileSystem(FileSystem* file_system) {
   TestFileOperation(file_system);
   TestDirOperation(file_system);
   TestMultiThreadsDirOperation(file_system);
+  TestReadBatch(file_system);
 }
 
+#ifdef __linux__
+
+void TestAsyncBinaryInStream(FileSystem* file_system, bool direct_io) {
+  std::string current_dir = GetCwd();
+  StringReplace(&current_dir, '\\', '/');
+  std::string file_name = JoinPath(current_dir, "/tmp_test_async_binary_in_stream_file");
+  const size_t file_size = 3 * 1000 * 1000 + 17;
+  const std::string content = WriteRandomFile(file_system, file_name, file_size);
+  AsyncReadOptions options;
+  options.chunk_size = 100 * 1000;
+  options.num_readahead_chunks = 3;
+  options.direct_io = direct_io;
+  AsyncBinaryInStream stream(file_system, file_name, options);
+  ASSERT_EQ(stream.file_size(), file_size);
+  std::mt19937 engine(0);
+  std::string result(file_size, '\0');
+  // sequential reads of random sizes
+  for (size_t pos = 0; pos < file_size;) {
+    const size_t n = std::min<size_t>(engine() % 70000 + 1, file_size - pos);
+    ASSERT_EQ(stream.Read(&result[pos], n), 0);
+    pos += n;
+  }
+  ASSERT_TRUE(stream.IsEof());
+  ASSERT_EQ(stream.Read(&result[0], 1), -1);
+  ASSERT_EQ(result, content);
+  // seeks in and out of the readahead window
+  for (int i = 0; i < 100; ++i) {
+    const size_t pos = engine() % file_size;
+    const size_t n = std::min<size_t>(engine() % 300000 + 1, file_size - pos);
+    stream.set_cur_file_pos(pos);
+    ASSERT_EQ(stream.Read(&result[0], n), 0);
+    ASSERT_EQ(result.substr(0, n), content.substr(pos, n));
+  }
+  file_system->DelFile(file_name);
+}
+
+#endif  // __linux__
+
 }  // namespace fs
 
 TEST(file_system, write_and_read) {
@@ -114,4 +191,14 @@ TEST(file_system, write_and_read) {
 #endif
 }
 
+#ifdef __linux__
+
+TEST(file_system, async_binary_in_stream) {
+  fs::PosixFileSystem file_system;
+  fs::TestAsyncBinaryInStream(&file_system, false);
+  fs::TestAsyncBinaryInStream(&file_system, true);
+}
+
+#endif  // __linux__
+
 }  // namespace oneflow
@@ -16,6 +16,8 @@ limitations under the License.
 #include "oneflow/core/persistence/persistent_in_stream.h"
 #include "oneflow/core/persistence/binary_in_stream_with_local_copy.h"
 #include "oneflow/core/persistence/binary_in_stream_without_local_copy.h"
+#include "oneflow/core/persistence/posix/async_binary_in_stream.h"
+#include "oneflow/core/persistence/posix/posix_file_system.h"
 #include "oneflow/core/job/job_set.pb.h"
 #include <cstring>
 #include "oneflow/core/common/constant.h"
@@ -41,6 +43,25 @@ size_t GetBufferSize() {
   return kDefaultBufferSize;
 }
 
+#ifdef __linux__
+
+bool IsAsyncReadEnabled(fs::FileSystem* fs) {
+  return ParseBooleanFromEnv("ONEFLOW_PERSISTENT_IN_STREAM_ASYNC_READ", false)
+         && dynamic_cast<fs::PosixFileSystem*>(fs) != nullptr;
+}
+
+AsyncReadOptions GetAsyncReadOptions() {
+  AsyncReadOptions options;
+  options.chunk_size = ParseIntegerFromEnv(
+      "ONEFLOW_PERSISTENT_IN_STREAM_READAHEAD_CHUNK_SIZE_BYTES", options.chunk_size);
+  options.num_readahead_chunks = ParseIntegerFromEnv(
+      "ONEFLOW_PERSISTENT_IN_STREAM_NUM_READAHEAD_CHUNKS", options.num_readahead_chunks);
+  options.direct_io = ParseBooleanFromEnv("ONEFLOW_PERSISTENT_IN_STREAM_DIRECT_IO", false);
+  return options;
+}
+
+#endif  // __linux__
+
 }  // namespace
 
 PersistentInStream::PersistentInStream(fs::FileSystem* fs,
@@ -53,9 +74,17 @@ PersistentInStream::PersistentInStream(int64_t session_id, fs::FileSystem* fs,
                                        bool cyclic, bool with_local_copy) {
   if (with_local_copy) { CHECK_EQ(offset, 0); }
   std::vector<std::shared_ptr<BinaryInStream>> streams;
+#ifdef __linux__
+  const bool async_read = !with_local_copy && IsAsyncReadEnabled(fs);
+  const AsyncReadOptions async_read_options = GetAsyncReadOptions();
+#endif  // __linux__
   for (auto& file_path : file_paths) {
     if (with_local_copy) {
       streams.emplace_back(new BinaryInStreamWithLocalCopy(fs, file_path));
+#ifdef __linux__
+    } else if (async_read) {
+      streams.emplace_back(new AsyncBinaryInStream(fs, file_path, async_read_options));
+#endif  // __linux__
     } else {
       streams.emplace_back(new BinaryInStreamWithoutLocalCopy(fs, file_path));
     }
@@ -0,0 +1,135 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/persistence/posix/async_binary_in_stream.h"
+
+#ifdef __linux__
+
+#include "oneflow/core/persistence/posix/io_engine.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace oneflow {
+
+namespace {
+
+constexpr size_t kDirectIOAlignment = 4096;
+
+}  // namespace
+
+AsyncBinaryInStream::AsyncBinaryInStream(fs::FileSystem* fs, const std::string& file_path,
+                                         const AsyncReadOptions& options)
+    : file_path_(file_path),
+      fd_(-1),
+      direct_io_(options.direct_io),
+      chunk_size_(options.chunk_size),
+      num_readahead_chunks_(options.num_readahead_chunks),
+      file_size_(0),
+      cur_file_pos_(0),
+      buffer_(nullptr, std::free),
+      ready_{},
+      inflight_{} {
+  CHECK_GT(chunk_size_, 0);
+  CHECK_GT(num_readahead_chunks_, 0);
+  const std::string translated_path = fs->TranslateName(file_path);
+  if (direct_io_) {
+    fd_ = open(translated_path.c_str(), O_RDONLY | O_DIRECT);
+    if (fd_ < 0 && errno == EINVAL) {
+      LOG(WARNING) << "O_DIRECT is not supported for file " << file_path
+                   << ", fall back to buffered reads";
+      direct_io_ = false;
+    }
+  }
+  if (!direct_io_) { fd_ = open(translated_path.c_str(), O_RDONLY); }
+  PCHECK(fd_ >= 0) << "Fail to open file " << file_path << ", errno is " << errno;
+  struct stat st {};
+  PCHECK(fstat(fd_, &st) == 0) << "Fail to stat file " << file_path;
+  file_size_ = st.st_size;
+  if (direct_io_) { chunk_size_ = RoundUp(chunk_size_, kDirectIOAlignment); }
+}
+
+AsyncBinaryInStream::~AsyncBinaryInStream() {
+  Release();
+  PCHECK(close(fd_) == 0);
+}
+
+int32_t AsyncBinaryInStream::Read(char* s, size_t n) {
+  if (IsEof()) { return -1; }
+  CHECK_LE(cur_file_pos_ + n, file_size_);
+  while (n > 0) {
+    MakeReady(cur_file_pos_);
+    const size_t copy_size = std::min<uint64_t>(n, ready_.end - cur_file_pos_);
+    std::memcpy(s, ready_.buffer + (cur_file_pos_ - ready_.begin), copy_size);
+    s += copy_size;
+    n -= copy_size;
+    cur_file_pos_ += copy_size;
+  }
+  if (IsEof()) { Release(); }
+  return 0;
+}
+
+void AsyncBinaryInStream::MakeReady(uint64_t pos) {
+  if (ready_.begin <= pos && pos < ready_.end) { return; }
+  const size_t window_size = chunk_size_ * num_readahead_chunks_;
+  if (!engine_) {
+    engine_ = fs::NewIoEngine();
+    buffer_.reset(static_cast<char*>(
+        aligned_alloc(kDirectIOAlignment, RoundUp(2 * window_size, kDirectIOAlignment))));
+    CHECK(buffer_) << "Fail to allocate the readahead buffer of file " << file_path_;
+    ready_ = Window{buffer_.get(), 0, 0};
+    inflight_ = Window{buffer_.get() + window_size, 0, 0};
+  }
+  engine_->WaitUntilDone();
+  if (inflight_.begin <= pos && pos < inflight_.end) {
+    std::swap(ready_, inflight_);
+  } else {
+    Fetch(&ready_, pos / chunk_size_ * chunk_size_);
+    engine_->WaitUntilDone();
+  }
+  if (ready_.end < file_size_) {
+    Fetch(&inflight_, ready_.end);
+  } else {
+    inflight_.begin = 0;
+    inflight_.end = 0;
+  }
+}
+
+void AsyncBinaryInStream::Fetch(Window* window, uint64_t begin) {
+  window->begin = begin;
+  window->end = std::min<uint64_t>(begin + chunk_size_ * num_readahead_chunks_, file_size_);
+  for (uint64_t offset = begin; offset < window->end; offset += chunk_size_) {
+    const size_t size = std::min<uint64_t>(chunk_size_, window->end - offset);
+    // O_DIRECT needs whole blocks, the read of the last one stops short at the end of the file
+    const size_t read_size = direct_io_ ? RoundUp(size, kDirectIOAlignment) : size;
+    engine_->AsyncPread(fd_, window->buffer + (offset - begin), read_size, offset, size);
+  }
+  engine_->Submit();
+}
+
+void AsyncBinaryInStream::Release() {
+  if (engine_) {
+    engine_->WaitUntilDone();
+    engine_.reset();
+  }
+  buffer_.reset();
+  ready_ = Window{};
+  inflight_ = Window{};
+}
+
+}  // namespace oneflow
+
+#endif  // __linux__
@@ -0,0 +1,91 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_PERSISTENCE_POSIX_ASYNC_BINARY_IN_STREAM_H_
+#define ONEFLOW_CORE_PERSISTENCE_POSIX_ASYNC_BINARY_IN_STREAM_H_
+
+#include "oneflow/core/persistence/binary_in_stream.h"
+#include "oneflow/core/persistence/file_system.h"
+
+#ifdef __linux__
+
+namespace oneflow {
+
+namespace fs {
+
+class IoEngine;
+
+}  // namespace fs
+
+struct AsyncReadOptions {
+  // Size of a single in-flight read, rounded up to the block alignment with direct_io.
+  size_t chunk_size = 512 * 1024;
+  // Number of chunks read ahead of the one being consumed.
+  size_t num_readahead_chunks = 4;
+  // Opens the file with O_DIRECT to bypass the page cache. Falls back to buffered reads when the
+  // file system does not support it.
+  bool direct_io = false;
+};
+
+// A BinaryInStream of a local file that keeps num_readahead_chunks reads in flight on an
+// io_uring or aio engine while the caller consumes the chunks read before them. Sequential reads
+// never wait for the disk once the readahead has caught up; a seek outside of the buffered window
+// restarts the readahead at the new position.
+class AsyncBinaryInStream final : public BinaryInStream {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(AsyncBinaryInStream);
+  AsyncBinaryInStream() = delete;
+  ~AsyncBinaryInStream() override;
+
+  AsyncBinaryInStream(fs::FileSystem* fs, const std::string& file_path,
+                      const AsyncReadOptions& options);
+  int32_t Read(char* s, size_t n) override;
+
+  uint64_t file_size() const override { return file_size_; }
+  uint64_t cur_file_pos() const override { return cur_file_pos_; }
+  void set_cur_file_pos(uint64_t val) override { cur_file_pos_ = val; }
+  bool IsEof() const override { return cur_file_pos_ == file_size_; }
+
+ private:
+  struct Window {
+    char* buffer;
+    uint64_t begin;
+    uint64_t end;
+  };
+
+  void MakeReady(uint64_t pos);
+  void Fetch(Window* window, uint64_t begin);
+  void Release();
+
+  std::string file_path_;
+  int fd_;
+  bool direct_io_;
+  size_t chunk_size_;
+  size_t num_readahead_chunks_;
+  uint64_t file_size_;
+  uint64_t cur_file_pos_;
+  // The engine and the buffers only live while the file is being read, so that the streams of a
+  // PersistentInStream waiting for their turn hold no resources.
+  std::unique_ptr<fs::IoEngine> engine_;
+  std::unique_ptr<char, void (*)(void*)> buffer_;
+  Window ready_;
+  Window inflight_;
+};
+
+}  // namespace oneflow
+
+#endif  // __linux__
+
+#endif  // ONEFLOW_CORE_PERSISTENCE_POSIX_ASYNC_BINARY_IN_STREAM_H_
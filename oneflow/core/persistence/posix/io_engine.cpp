@@ -0,0 +1,72 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/persistence/posix/io_engine.h"
+
+#ifdef __linux__
+
+namespace oneflow {
+
+namespace fs {
+
+namespace {
+
+template<typename Engine>
+class IoEngineImpl final : public IoEngine {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(IoEngineImpl);
+  IoEngineImpl() = default;
+  ~IoEngineImpl() override = default;
+
+  using IoEngine::AsyncPread;
+  void AsyncPread(int fd, void* buf, size_t count, off_t offset, size_t min_count) override {
+    engine_.AsyncPread(fd, buf, count, offset, min_count);
+  }
+  void Submit() override { engine_.Submit(); }
+  void WaitUntilDone() override { engine_.WaitUntilDone(); }
+
+ private:
+  Engine engine_;
+};
+
+}  // namespace
+
+bool IsRingIOSupported() {
+#ifdef WITH_LIBURING
+  struct io_uring ring {};
+  if (io_uring_queue_init(1, &ring, 0) == 0) {
+    io_uring_queue_exit(&ring);
+    return true;
+  } else {
+    return false;
+  }
+#else
+  return false;
+#endif
+}
+
+std::unique_ptr<IoEngine> NewIoEngine() {
+#ifdef WITH_LIBURING
+  static bool ring_io_supported = IsRingIOSupported();
+  if (ring_io_supported) { return std::make_unique<IoEngineImpl<RingEngine>>(); }
+#endif  // WITH_LIBURING
+  return std::make_unique<IoEngineImpl<AioEngine>>();
+}
+
+}  // namespace fs
+
+}  // namespace oneflow
+
+#endif  // __linux__
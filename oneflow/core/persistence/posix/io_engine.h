@@ -0,0 +1,245 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_PERSISTENCE_POSIX_IO_ENGINE_H_
+#define ONEFLOW_CORE_PERSISTENCE_POSIX_IO_ENGINE_H_
+
+#include "oneflow/core/common/util.h"
+
+#ifdef __linux__
+
+#include <sys/syscall.h>
+#include <linux/aio_abi.h>
+#include <unistd.h>
+#include <cstring>
+#ifdef WITH_LIBURING
+#include <liburing.h>
+#endif  // WITH_LIBURING
+
+namespace oneflow {
+
+namespace fs {
+
+constexpr uint32_t kRingQueueDepth = 128;
+constexpr uint32_t kRingSubmitBatch = 32;
+constexpr uint32_t kAioQueueDepth = 128;
+
+// The engines below keep up to a queue depth of preads in flight. AsyncPread may return before
+// the read is handed to the kernel, Submit hands over everything queued so far and WaitUntilDone
+// blocks until all the reads issued by this engine have completed. An engine is not thread safe.
+//
+// A pread may return fewer bytes than asked for, the engines then issue the rest of the read
+// again. A read ends early only at the end of the file, after at least min_count bytes, which lets
+// O_DIRECT callers round the last block up past the end of the file.
+
+struct PreadRequest {
+  int fd;
+  char* buf;
+  size_t count;
+  off_t offset;
+  size_t min_count;
+
+  // Accounts for a completed pread of res bytes, returns whether the request is done.
+  bool Advance(int64_t res) {
+    CHECK_GE(res, 0) << "pread failed: " << strerror(static_cast<int>(-res));
+    CHECK_LE(static_cast<size_t>(res), count);
+    const size_t n = static_cast<size_t>(res);
+    if (n == count || n >= min_count) { return true; }
+    CHECK_GT(n, 0) << "pread reached the end of the file " << min_count << " bytes early";
+    buf += n;
+    count -= n;
+    offset += static_cast<off_t>(n);
+    min_count -= n;
+    return false;
+  }
+};
+
+#ifdef WITH_LIBURING
+
+class RingEngine final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(RingEngine);
+  RingEngine() : ring_{}, pending_submit_(0), num_readings_(0) {
+    PCHECK(io_uring_queue_init(kRingQueueDepth, &ring_, 0) == 0);
+    requests_.resize(kRingQueueDepth);
+    free_slots_.resize(kRingQueueDepth);
+    for (uint32_t i = 0; i < kRingQueueDepth; ++i) { free_slots_[i] = kRingQueueDepth - 1 - i; }
+  }
+  ~RingEngine() {
+    WaitUntilDone();
+    io_uring_queue_exit(&ring_);
+  }
+
+  void AsyncPread(int fd, void* buf, size_t count, off_t offset) {
+    AsyncPread(fd, buf, count, offset, count);
+  }
+
+  void AsyncPread(int fd, void* buf, size_t count, off_t offset, size_t min_count) {
+    while (num_readings_ == kRingQueueDepth) { WaitOne(); }
+    const uint32_t slot = free_slots_.back();
+    free_slots_.pop_back();
+    requests_.at(slot) = PreadRequest{fd, static_cast<char*>(buf), count, offset, min_count};
+    num_readings_ += 1;
+    Prepare(slot);
+  }
+
+  void Submit() {
+    if (pending_submit_ > 0) {
+      PCHECK(io_uring_submit(&ring_) == pending_submit_);
+      pending_submit_ = 0;
+    }
+  }
+
+  void WaitUntilDone() {
+    while (num_readings_ != 0) { WaitOne(); }
+  }
+
+ private:
+  void Prepare(uint32_t slot) {
+    const PreadRequest& request = requests_.at(slot);
+    io_uring_sqe* sqe = CHECK_NOTNULL(io_uring_get_sqe(&ring_));
+    io_uring_prep_read(sqe, request.fd, request.buf, request.count, request.offset);
+    io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(static_cast<uintptr_t>(slot)));
+    pending_submit_ += 1;
+    if (pending_submit_ == kRingSubmitBatch) { Submit(); }
+  }
+
+  // Reaps one completion, a short read is queued again and keeps its slot.
+  void WaitOne() {
+    Submit();
+    struct io_uring_cqe* cqe = nullptr;
+    PCHECK(io_uring_wait_cqe(&ring_, &cqe) == 0);
+    const uint32_t slot =
+        static_cast<uint32_t>(reinterpret_cast<uintptr_t>(io_uring_cqe_get_data(cqe)));
+    const int32_t res = cqe->res;
+    io_uring_cqe_seen(&ring_, cqe);
+    if (requests_.at(slot).Advance(res)) {
+      free_slots_.push_back(slot);
+      num_readings_ -= 1;
+    } else {
+      Prepare(slot);
+    }
+  }
+
+  io_uring ring_;
+  uint32_t pending_submit_;
+  uint32_t num_readings_;
+  std::vector<PreadRequest> requests_;
+  std::vector<uint32_t> free_slots_;
+};
+
+#endif  // WITH_LIBURING
+
+class AioEngine final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(AioEngine);
+  AioEngine() : ctx_{}, num_readings_(0) {
+    PCHECK(syscall(__NR_io_setup, kAioQueueDepth, &ctx_) >= 0);
+    cbs_.resize(kAioQueueDepth);
+    cbs_ptr_.resize(kAioQueueDepth);
+    for (uint32_t i = 0; i < kAioQueueDepth; ++i) { cbs_ptr_[i] = &cbs_[i]; }
+    requests_.resize(kAioQueueDepth);
+    events_.resize(kAioQueueDepth);
+  }
+  ~AioEngine() {
+    WaitUntilDone();
+    PCHECK(syscall(__NR_io_destroy, ctx_) >= 0);
+  }
+
+  void AsyncPread(int fd, void* buf, size_t count, off_t offset) {
+    AsyncPread(fd, buf, count, offset, count);
+  }
+
+  void AsyncPread(int fd, void* buf, size_t count, off_t offset, size_t min_count) {
+    if (num_readings_ == kAioQueueDepth) { WaitUntilDone(); }
+    requests_.at(num_readings_) =
+        PreadRequest{fd, static_cast<char*>(buf), count, offset, min_count};
+    SubmitSlot(num_readings_);
+    num_readings_ += 1;
+  }
+
+  // io_submit is called per read, nothing is left queued
+  void Submit() {}
+
+  void WaitUntilDone() {
+    long num_pending = num_readings_;
+    while (num_pending != 0) {
+      const long num_events =
+          syscall(__NR_io_getevents, ctx_, 1, num_pending, events_.data(), nullptr);
+      PCHECK(num_events >= 0 || errno == EINTR);
+      for (long i = 0; i < num_events; ++i) {
+        const uint32_t slot = static_cast<uint32_t>(events_.at(i).data);
+        if (requests_.at(slot).Advance(events_.at(i).res)) {
+          num_pending -= 1;
+        } else {
+          SubmitSlot(slot);
+        }
+      }
+    }
+    num_readings_ = 0;
+  }
+
+ private:
+  void SubmitSlot(uint32_t slot) {
+    const PreadRequest& request = requests_.at(slot);
+    struct iocb* cb = &cbs_.at(slot);
+    *cb = iocb{};
+    cb->aio_data = slot;
+    cb->aio_fildes = request.fd;
+    cb->aio_lio_opcode = IOCB_CMD_PREAD;
+    cb->aio_reqprio = 0;
+    cb->aio_buf = reinterpret_cast<uintptr_t>(request.buf);
+    cb->aio_nbytes = request.count;
+    cb->aio_offset = request.offset;
+    const long nr = 1;
+    PCHECK(syscall(__NR_io_submit, ctx_, nr, &cbs_ptr_.at(slot)) >= 0);
+  }
+
+  aio_context_t ctx_;
+  long num_readings_;
+  std::vector<struct iocb> cbs_;
+  std::vector<struct iocb*> cbs_ptr_;
+  std::vector<PreadRequest> requests_;
+  std::vector<struct io_event> events_;
+};
+
+// Type-erased engine for callers that pick the engine at runtime.
+class IoEngine {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(IoEngine);
+  IoEngine() = default;
+  virtual ~IoEngine() = default;
+
+  void AsyncPread(int fd, void* buf, size_t count, off_t offset) {
+    AsyncPread(fd, buf, count, offset, count);
+  }
+  virtual void AsyncPread(int fd, void* buf, size_t count, off_t offset, size_t min_count) = 0;
+  virtual void Submit() = 0;
+  virtual void WaitUntilDone() = 0;
+};
+
+bool IsRingIOSupported();
+
+// Returns a RingEngine when io_uring is built in and supported by the kernel, otherwise an
+// AioEngine.
+std::unique_ptr<IoEngine> NewIoEngine();
+
+}  // namespace fs
+
+}  // namespace oneflow
+
+#endif  // __linux__
+
+#endif  // ONEFLOW_CORE_PERSISTENCE_POSIX_IO_ENGINE_H_
@@ -17,6 +17,7 @@ limitations under the License.
 
 #ifdef OF_PLATFORM_POSIX
 
+#include "oneflow/core/persistence/posix/io_engine.h"
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -32,6 +33,13 @@ namespace oneflow {
 
 namespace fs {
 
+namespace {
+
+// Large reads are split so that the pieces of a single request are read in parallel too.
+constexpr size_t kMaxBatchReadPieceSize = 16 * 1024 * 1024;
+
+}  // namespace
+
 class PosixRandomAccessFile : public RandomAccessFile {
  private:
   std::string fname_;
@@ -60,6 +68,31 @@ class PosixRandomAccessFile : public RandomAccessFile {
       }
     }
   }
+
+#ifdef __linux__
+  void ReadBatch(const std::vector<FileReadRequest>& requests) const override {
+    if (requests.size() == 1 && requests.front().n <= kMaxBatchReadPieceSize) {
+      const FileReadRequest& request = requests.front();
+      Read(request.offset, request.n, request.result);
+      return;
+    }
+    // A read that stops early at the end of the file fails a CHECK in the engine, which does not
+    // know the file, so out of range requests are rejected here with its name.
+    struct stat st {};
+    PCHECK(fstat(fd_, &st) == 0) << "Fail to stat file " << fname_;
+    static thread_local std::unique_ptr<IoEngine> engine = NewIoEngine();
+    for (const FileReadRequest& request : requests) {
+      CHECK_LE(request.offset + request.n, static_cast<uint64_t>(st.st_size))
+          << "Read EOF of file " << fname_;
+      for (size_t pos = 0; pos < request.n; pos += kMaxBatchReadPieceSize) {
+        const size_t piece_size = std::min(kMaxBatchReadPieceSize, request.n - pos);
+        engine->AsyncPread(fd_, request.result + pos, piece_size,
+                           static_cast<off_t>(request.offset + pos));
+      }
+    }
+    engine->WaitUntilDone();
+  }
+#endif  // __linux__
 };
 
 class PosixWritableFile : public WritableFile {
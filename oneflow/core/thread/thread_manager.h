@@ -57,20 +57,12 @@ void MultiThreadLoop(size_t num, const DoEachT& DoEach) {
     SingleThreadLoop(num, DoEach);
     return;
   }
-  size_t thread_num = Global<ThreadPool>::Get()->thread_num();
-  thread_num = std::min(num, thread_num);
-  BalancedSplitter bs(num, thread_num);
-  BlockingCounter bc(thread_num);
-  FOR_RANGE(size_t, range_id, 0, thread_num) {
-    Global<ThreadPool>::Get()->AddWork([&bc, &bs, range_id, DoEach] {
-      size_t start = bs.At(range_id).begin();
-      size_t end = bs.At(range_id).end();
-      FOR_RANGE(size_t, i, start, end) { DoEach(i); }
-      bc.Decrease();
-    });
-  }
-  // buzy loop wait.
-  bc.WaitForeverUntilCntEqualZero();
+  // Idle workers steal the remaining ranges, so uneven iterations no longer wait for the slowest
+  // fixed split.
+  const auto DoRange = [&DoEach](int64_t start, int64_t end) {
+    FOR_RANGE(int64_t, i, start, end) { DoEach(i); }
+  };
+  Global<ThreadPool>::Get()->ParallelFor(0, num, DoRange, 1);
 }
 
 }  // namespace oneflow
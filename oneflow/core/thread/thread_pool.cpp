@@ -14,31 +14,291 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/core/thread/thread_pool.h"
+#include <deque>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif  // __linux__
 
 namespace oneflow {
 
-ThreadPool::ThreadPool(int32_t thread_num)
-    : work_chans_(thread_num), threads_(thread_num), work_cnt_(0) {
+namespace {
+
+using Task = std::function<void()>;
+
+constexpr int64_t kDequeCapacity = 4096;
+constexpr int32_t kNumSpinsBeforeSleep = 64;
+// ParallelFor cuts a range into this many pieces per worker at most, so that workers finishing
+// early can pick up the rest.
+constexpr int64_t kParallelForRangesPerWorker = 4;
+
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local int32_t current_worker_id = -1;
+
+// The Chase-Lev deque, see "Correct and Efficient Work-Stealing for Weak Memory Models". The owner
+// pushes and pops at the bottom, thieves steal from the top.
+class WorkStealingDeque final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(WorkStealingDeque);
+  WorkStealingDeque() : top_(0), bottom_(0), buffer_(kDequeCapacity) {}
+  ~WorkStealingDeque() = default;
+
+  // Returns false when the deque is full.
+  bool Push(Task* task) {
+    const int64_t b = bottom_.load(std::memory_order_relaxed);
+    const int64_t t = top_.load(std::memory_order_acquire);
+    if (b - t >= kDequeCapacity) { return false; }
+    buffer_[b & (kDequeCapacity - 1)].store(task, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  Task* Pop() {
+    const int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    if (t > b) {
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    Task* task = buffer_[b & (kDequeCapacity - 1)].load(std::memory_order_relaxed);
+    if (t == b) {
+      // The last task, race against thieves for it.
+      if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                        std::memory_order_relaxed)) {
+        task = nullptr;
+      }
+      bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+    return task;
+  }
+
+  Task* Steal() {
+    int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t b = bottom_.load(std::memory_order_acquire);
+    if (t >= b) { return nullptr; }
+    Task* task = buffer_[t & (kDequeCapacity - 1)].load(std::memory_order_relaxed);
+    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      return nullptr;
+    }
+    return task;
+  }
+
+ private:
+  static_assert((kDequeCapacity & (kDequeCapacity - 1)) == 0, "");
+  std::atomic<int64_t> top_;
+  std::atomic<int64_t> bottom_;
+  std::vector<std::atomic<Task*>> buffer_;
+};
+
+std::vector<int32_t> ParseCpuList(const std::string& cpu_list) {
+  std::vector<int32_t> cpus;
+  std::stringstream ss(cpu_list);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    if (item.empty() || item == "\n") { continue; }
+    const size_t dash = item.find('-');
+    const int32_t first = std::stoi(item.substr(0, dash));
+    const int32_t last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+    for (int32_t cpu = first; cpu <= last; ++cpu) { cpus.push_back(cpu); }
+  }
+  return cpus;
+}
+
+std::vector<int32_t> GetNumaNodeCpus(int32_t numa_node) {
+  std::ifstream ifs("/sys/devices/system/node/node" + std::to_string(numa_node) + "/cpulist");
+  CHECK(ifs.is_open()) << "NUMA node " << numa_node << " not found";
+  std::string cpu_list;
+  std::getline(ifs, cpu_list);
+  return ParseCpuList(cpu_list);
+}
+
+void SetCurrentThreadAffinity(const std::vector<int32_t>& cpus) {
+  if (cpus.empty()) { return; }
+#ifdef __linux__
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (const int32_t cpu : cpus) { CPU_SET(cpu, &cpu_set); }
+  const int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+  if (ret != 0) { LOG(WARNING) << "Failed to set thread affinity, error: " << ret; }
+#else
+  LOG(WARNING) << "Thread affinity is only supported on Linux";
+#endif  // __linux__
+}
+
+}  // namespace
+
+struct ThreadPool::Worker {
+  WorkStealingDeque deque;
+  // Work added from outside of the pool, or to a worker other than the current one.
+  std::mutex inbox_mutex;
+  std::deque<Task*> inbox;
+  std::atomic<int64_t> inbox_size{0};
+
+  Task* PopInbox() {
+    if (inbox_size.load(std::memory_order_acquire) == 0) { return nullptr; }
+    std::lock_guard<std::mutex> lock(inbox_mutex);
+    if (inbox.empty()) { return nullptr; }
+    Task* task = inbox.front();
+    inbox.pop_front();
+    inbox_size.fetch_sub(1, std::memory_order_release);
+    return task;
+  }
+};
+
+ThreadPool::ThreadPool(int32_t thread_num) : ThreadPool(thread_num, ThreadPoolOptions()) {}
+
+ThreadPool::ThreadPool(int32_t thread_num, const ThreadPoolOptions& options)
+    : threads_(thread_num), work_cnt_(0), num_pending_(0), num_sleeping_(0), shutdown_(false) {
+  CHECK_GT(thread_num, 0);
+  std::vector<int32_t> numa_node_cpus;
+  if (options.cpus.empty() && options.numa_node >= 0) {
+    numa_node_cpus = GetNumaNodeCpus(options.numa_node);
+  }
+  FOR_RANGE(int32_t, i, 0, thread_num) { workers_.emplace_back(new Worker()); }
   FOR_RANGE(int32_t, i, 0, thread_num) {
-    Channel<std::function<void()>>* chan = &(work_chans_.at(i));
-    threads_[i] = std::thread([chan]() {
-      std::function<void()> work;
-      while (chan->Receive(&work) == kChannelStatusSuccess) { work(); }
-    });
+    std::vector<int32_t> cpus;
+    if (!options.cpus.empty()) {
+      cpus.push_back(options.cpus.at(i % options.cpus.size()));
+    } else {
+      cpus = numa_node_cpus;
+    }
+    threads_[i] = std::thread(&ThreadPool::WorkerLoop, this, i, cpus);
   }
 }
 
 ThreadPool::~ThreadPool() {
-  FOR_RANGE(int32_t, i, 0, work_chans_.size()) {
-    work_chans_.at(i).Close();
-    threads_.at(i).join();
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    shutdown_ = true;
   }
+  sleep_cond_.notify_all();
+  // Workers only exit once all queued work, including work added by that work, has run.
+  for (std::thread& thread : threads_) { thread.join(); }
 }
 
-void ThreadPool::AddWork(const std::function<void()>& work) {
-  const size_t cur_chan_idx =
-      work_cnt_.fetch_add(1, std::memory_order_relaxed) % work_chans_.size();
-  work_chans_.at(cur_chan_idx).Send(work);
+void ThreadPool::AddWork(const std::function<void()>& work) { Push(new Task(work), -1); }
+
+void ThreadPool::AddWork(const std::function<void()>& work, int32_t preferred_worker) {
+  CHECK_GE(preferred_worker, 0);
+  Push(new Task(work), preferred_worker % thread_num());
+}
+
+void ThreadPool::Push(std::function<void()>* task, int32_t preferred_worker) {
+  // Counted before it becomes visible, so that a worker taking it never sees the count negative.
+  num_pending_.fetch_add(1, std::memory_order_seq_cst);
+  const bool on_worker = current_pool == this;
+  bool pushed = false;
+  if (on_worker && (preferred_worker < 0 || preferred_worker == current_worker_id)) {
+    pushed = workers_.at(current_worker_id)->deque.Push(task);
+  }
+  if (!pushed) {
+    if (preferred_worker < 0) {
+      preferred_worker = on_worker ? current_worker_id : work_cnt_++ % thread_num();
+    }
+    Worker* worker = workers_.at(preferred_worker).get();
+    std::lock_guard<std::mutex> lock(worker->inbox_mutex);
+    worker->inbox.push_back(task);
+    worker->inbox_size.fetch_add(1, std::memory_order_release);
+  }
+  if (num_sleeping_.load(std::memory_order_seq_cst) > 0) {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    sleep_cond_.notify_one();
+  }
+}
+
+std::function<void()>* ThreadPool::Take(int32_t worker_id, uint64_t* rng) {
+  Worker* self = workers_.at(worker_id).get();
+  Task* task = self->deque.Pop();
+  if (task == nullptr) { task = self->PopInbox(); }
+  if (task == nullptr) {
+    *rng = *rng * 6364136223846793005ULL + 1442695040888963407ULL;
+    const int32_t start = static_cast<int32_t>((*rng >> 33) % workers_.size());
+    for (int32_t i = 0; i < workers_.size() && task == nullptr; ++i) {
+      const int32_t victim_id = (start + i) % workers_.size();
+      if (victim_id == worker_id) { continue; }
+      Worker* victim = workers_.at(victim_id).get();
+      task = victim->deque.Steal();
+      if (task == nullptr) { task = victim->PopInbox(); }
+    }
+  }
+  if (task != nullptr) { num_pending_.fetch_sub(1, std::memory_order_seq_cst); }
+  return task;
+}
+
+void ThreadPool::WorkerLoop(int32_t worker_id, const std::vector<int32_t>& cpus) {
+  SetCurrentThreadAffinity(cpus);
+  current_pool = this;
+  current_worker_id = worker_id;
+  uint64_t rng = worker_id + 1;
+  while (true) {
+    Task* task = Take(worker_id, &rng);
+    if (task != nullptr) {
+      (*task)();
+      delete task;
+      continue;
+    }
+    bool has_pending = false;
+    for (int32_t i = 0; i < kNumSpinsBeforeSleep && !has_pending; ++i) {
+      std::this_thread::yield();
+      has_pending = num_pending_.load(std::memory_order_relaxed) > 0;
+    }
+    if (has_pending) { continue; }
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    num_sleeping_.fetch_add(1, std::memory_order_seq_cst);
+    sleep_cond_.wait(lock, [&]() {
+      return num_pending_.load(std::memory_order_seq_cst) > 0 || shutdown_;
+    });
+    num_sleeping_.fetch_sub(1, std::memory_order_seq_cst);
+    if (shutdown_ && num_pending_.load(std::memory_order_seq_cst) == 0) { break; }
+  }
+  current_pool = nullptr;
+  current_worker_id = -1;
+}
+
+void ThreadPool::ParallelFor(int64_t begin, int64_t end,
+                             const std::function<void(int64_t, int64_t)>& func,
+                             int64_t grain_size) {
+  if (end <= begin) { return; }
+  const int64_t total = end - begin;
+  grain_size = std::max<int64_t>(grain_size, 1);
+  const int64_t num_ranges = std::min<int64_t>(
+      (total + grain_size - 1) / grain_size, thread_num() * kParallelForRangesPerWorker);
+  if (num_ranges <= 1) {
+    func(begin, end);
+    return;
+  }
+  struct State {
+    std::atomic<int64_t> next_range{0};
+    std::atomic<int64_t> num_done_ranges{0};
+    std::mutex mutex;
+    std::condition_variable cond;
+  };
+  // Helpers may start after all ranges are done and the caller has returned, they only touch the
+  // shared state then.
+  auto state = std::make_shared<State>();
+  auto RunRanges = [state, begin, total, num_ranges, &func]() {
+    while (true) {
+      const int64_t range = state->next_range.fetch_add(1, std::memory_order_relaxed);
+      if (range >= num_ranges) { break; }
+      func(begin + total * range / num_ranges, begin + total * (range + 1) / num_ranges);
+      if (state->num_done_ranges.fetch_add(1, std::memory_order_acq_rel) + 1 == num_ranges) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->cond.notify_all();
+      }
+    }
+  };
+  const int64_t num_helpers = std::min<int64_t>(num_ranges - 1, thread_num());
+  FOR_RANGE(int64_t, i, 0, num_helpers) { AddWork(RunRanges); }
+  RunRanges();
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->cond.wait(lock, [&]() {
+    return state->num_done_ranges.load(std::memory_order_acquire) == num_ranges;
+  });
 }
 
 }  // namespace oneflow
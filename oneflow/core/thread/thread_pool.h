@@ -16,28 +16,70 @@ limitations under the License.
 #ifndef ONEFLOW_CORE_THREAD_THREAD_POOL_H_
 #define ONEFLOW_CORE_THREAD_THREAD_POOL_H_
 
+#include <future>
 #include "oneflow/core/common/util.h"
-#include "oneflow/core/common/channel.h"
 
 namespace oneflow {
 
+struct ThreadPoolOptions {
+  // Worker i is pinned to cpus[i % cpus.size()]. Not pinned when empty.
+  std::vector<int32_t> cpus;
+  // Workers are restricted to the cpus of this NUMA node, unless cpus is set. -1 for any node.
+  int32_t numa_node = -1;
+};
+
+// Every worker owns a deque. Work added from a worker is pushed to its own deque, work added from
+// other threads goes to the inbox of a worker. Idle workers steal from the others, so a long job
+// only delays the work that nobody else is free to take.
 class ThreadPool final {
  public:
   OF_DISALLOW_COPY_AND_MOVE(ThreadPool);
   ThreadPool() = delete;
   ThreadPool(int32_t thread_num);
+  ThreadPool(int32_t thread_num, const ThreadPoolOptions& options);
   ~ThreadPool();
 
   int32_t thread_num() const { return threads_.size(); }
   void AddWork(const std::function<void()>& work);
+  // Queues the work on the given worker, other workers only take it when they run out of work.
+  void AddWork(const std::function<void()>& work, int32_t preferred_worker);
+
+  // Waiting on the returned future from a worker of the same pool may deadlock, use ParallelFor
+  // for nested parallelism.
+  template<typename F>
+  auto Submit(F&& f) -> std::future<decltype(f())>;
+
+  // Splits [begin, end) into ranges of at least grain_size and runs them on the pool. The caller
+  // runs ranges as well, so it is safe to call from a worker.
+  void ParallelFor(int64_t begin, int64_t end, const std::function<void(int64_t, int64_t)>& func,
+                   int64_t grain_size);
 
  private:
-  std::vector<Channel<std::function<void()>>> work_chans_;
-  std::vector<std::thread> threads_;
+  struct Worker;
+
+  void Push(std::function<void()>* task, int32_t preferred_worker);
+  std::function<void()>* Take(int32_t worker_id, uint64_t* rng);
+  void WorkerLoop(int32_t worker_id, const std::vector<int32_t>& cpus);
 
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<std::thread> threads_;
   std::atomic<size_t> work_cnt_;
+  std::atomic<int64_t> num_pending_;
+  std::atomic<int32_t> num_sleeping_;
+  std::mutex sleep_mutex_;
+  std::condition_variable sleep_cond_;
+  bool shutdown_;
 };
 
+template<typename F>
+auto ThreadPool::Submit(F&& f) -> std::future<decltype(f())> {
+  using R = decltype(f());
+  auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+  std::future<R> future = task->get_future();
+  AddWork([task]() { (*task)(); });
+  return future;
+}
+
 }  // namespace oneflow
 
 #endif  // ONEFLOW_CORE_THREAD_THREAD_POOL_H_
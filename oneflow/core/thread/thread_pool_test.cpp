@@ -0,0 +1,181 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "gtest/gtest.h"
+#include "oneflow/core/thread/thread_pool.h"
+#include "oneflow/core/common/channel.h"
+#include "oneflow/core/common/blocking_counter.h"
+
+namespace oneflow {
+
+namespace {
+
+// The previous pool, one channel per worker and work assigned round robin.
+class RoundRobinThreadPool final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(RoundRobinThreadPool);
+  explicit RoundRobinThreadPool(int32_t thread_num)
+      : work_chans_(thread_num), threads_(thread_num), work_cnt_(0) {
+    FOR_RANGE(int32_t, i, 0, thread_num) {
+      Channel<std::function<void()>>* chan = &(work_chans_.at(i));
+      threads_[i] = std::thread([chan]() {
+        std::function<void()> work;
+        while (chan->Receive(&work) == kChannelStatusSuccess) { work(); }
+      });
+    }
+  }
+  ~RoundRobinThreadPool() {
+    for (auto& chan : work_chans_) { chan.Close(); }
+    for (auto& thread : threads_) { thread.join(); }
+  }
+
+  void AddWork(const std::function<void()>& work) {
+    const size_t cur_chan_idx = work_cnt_.fetch_add(1) % work_chans_.size();
+    work_chans_.at(cur_chan_idx).Send(work);
+  }
+
+ private:
+  std::vector<Channel<std::function<void()>>> work_chans_;
+  std::vector<std::thread> threads_;
+  std::atomic<size_t> work_cnt_;
+};
+
+void BusyWait(int64_t us) {
+  const auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(us);
+  while (std::chrono::steady_clock::now() < end) {}
+}
+
+// Every num_threads-th task is 16x longer, so round robin puts all of them on the same worker.
+int64_t SkewedTaskMicroseconds(int64_t i, int32_t num_threads) {
+  return i % num_threads == 0 ? 800 : 50;
+}
+
+template<typename Pool>
+double RunSkewedTasks(Pool* pool, int32_t num_threads, int64_t num_tasks) {
+  BlockingCounter bc(num_tasks);
+  const auto start = std::chrono::steady_clock::now();
+  FOR_RANGE(int64_t, i, 0, num_tasks) {
+    pool->AddWork([&bc, i, num_threads]() {
+      BusyWait(SkewedTaskMicroseconds(i, num_threads));
+      bc.Decrease();
+    });
+  }
+  bc.WaitForeverUntilCntEqualZero();
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+}  // namespace
+
+TEST(ThreadPool, AddWork) {
+  std::atomic<int64_t> sum(0);
+  {
+    ThreadPool pool(4);
+    FOR_RANGE(int64_t, i, 0, 10000) {
+      pool.AddWork([&sum, i]() { sum += i; });
+    }
+    FOR_RANGE(int64_t, i, 0, 100) {
+      pool.AddWork([&sum, i]() { sum += i; }, i);
+    }
+    // Work added from workers, including after the destructor started.
+    FOR_RANGE(int64_t, i, 0, 100) {
+      pool.AddWork([&pool, &sum, i]() {
+        FOR_RANGE(int64_t, j, 0, 10) {
+          pool.AddWork([&sum, j]() { sum += j; });
+        }
+        sum += i;
+      });
+    }
+  }
+  ASSERT_EQ(sum, 10000 * 9999 / 2 + 2 * (100 * 99 / 2) + 100 * 45);
+}
+
+TEST(ThreadPool, Submit) {
+  ThreadPool pool(2);
+  std::vector<std::future<int64_t>> futures;
+  FOR_RANGE(int64_t, i, 0, 100) {
+    futures.emplace_back(pool.Submit([i]() { return i * i; }));
+  }
+  FOR_RANGE(int64_t, i, 0, 100) { ASSERT_EQ(futures.at(i).get(), i * i); }
+  std::future<void> error = pool.Submit([]() { throw std::runtime_error("error"); });
+  ASSERT_THROW(error.get(), std::runtime_error);
+}
+
+TEST(ThreadPool, ParallelFor) {
+  ThreadPool pool(4);
+  for (const int64_t grain_size : {1, 7, 1000, 100000}) {
+    std::vector<std::atomic<int32_t>> visits(10000);
+    for (auto& visit : visits) { visit = 0; }
+    pool.ParallelFor(
+        100, 10000,
+        [&](int64_t begin, int64_t end) {
+          ASSERT_LT(begin, end);
+          FOR_RANGE(int64_t, i, begin, end) { visits.at(i) += 1; }
+        },
+        grain_size);
+    FOR_RANGE(int64_t, i, 0, visits.size()) { ASSERT_EQ(visits.at(i), i < 100 ? 0 : 1); }
+  }
+  pool.ParallelFor(
+      5, 5, [](int64_t begin, int64_t end) { FAIL(); }, 1);
+}
+
+TEST(ThreadPool, NestedParallelFor) {
+  ThreadPool pool(2);
+  std::atomic<int64_t> sum(0);
+  pool.ParallelFor(
+      0, 64,
+      [&](int64_t begin, int64_t end) {
+        FOR_RANGE(int64_t, i, begin, end) {
+          pool.ParallelFor(
+              0, 64,
+              [&](int64_t inner_begin, int64_t inner_end) {
+                FOR_RANGE(int64_t, j, inner_begin, inner_end) { sum += j; }
+              },
+              1);
+        }
+      },
+      1);
+  ASSERT_EQ(sum, 64 * (64 * 63 / 2));
+}
+
+TEST(ThreadPool, Affinity) {
+  ThreadPoolOptions options;
+  options.cpus = {0};
+  ThreadPool pool(2, options);
+  std::atomic<int64_t> cnt(0);
+  pool.ParallelFor(
+      0, 100, [&](int64_t begin, int64_t end) { cnt += end - begin; }, 1);
+  ASSERT_EQ(cnt, 100);
+}
+
+TEST(ThreadPool, SkewedWorkBenchmark) {
+  const int32_t num_threads = std::max<int32_t>(std::thread::hardware_concurrency() / 2, 2);
+  const int64_t num_tasks = 64 * num_threads;
+  double round_robin_ms = 0;
+  {
+    RoundRobinThreadPool pool(num_threads);
+    round_robin_ms = RunSkewedTasks(&pool, num_threads, num_tasks);
+  }
+  double work_stealing_ms = 0;
+  {
+    ThreadPool pool(num_threads);
+    work_stealing_ms = RunSkewedTasks(&pool, num_threads, num_tasks);
+  }
+  LOG(INFO) << "threads: " << num_threads << ", tasks: " << num_tasks
+            << ", round robin: " << round_robin_ms << " ms, work stealing: " << work_stealing_ms
+            << " ms";
+}
+
+}  // namespace oneflow
@@ -16,7 +16,6 @@ limitations under the License.
 #include "oneflow/user/data/coco_dataset.h"
 #include "oneflow/user/data/coco_data_reader.h"
 #include "oneflow/core/persistence/file_system.h"
-#include "oneflow/core/persistence/persistent_in_stream.h"
 
 namespace oneflow {
 namespace data {
@@ -30,10 +29,12 @@ COCODataset::BatchType COCODataset::At(int64_t index) const {
   sample.height = meta_->GetImageHeight(index);
   sample.width = meta_->GetImageWidth(index);
   const std::string& image_file_path = meta_->GetImageFilePath(index);
-  PersistentInStream in_stream(session_id_, DataFS(), image_file_path);
+  std::unique_ptr<fs::RandomAccessFile> file;
+  DataFS()->NewRandomAccessFile(image_file_path, &file);
   int64_t file_size = DataFS()->GetFileSize(image_file_path);
   sample.data.Resize(Shape({file_size}), DataType::kChar);
-  CHECK_EQ(in_stream.ReadFully(sample.data.mut_data<char>(), sample.data.nbytes()), 0);
+  // Reads the image straight into the sample, large files are read in parallel pieces.
+  file->ReadBatch({{0, sample.data.nbytes(), sample.data.mut_data<char>()}});
   return batch;
 }
 
@@ -39,7 +39,7 @@ class COCODataset final : public RandomAccessDataset<COCOImage> {
   using BatchType = typename Base::BatchType;
 
   COCODataset(user_op::KernelInitContext* ctx, const std::shared_ptr<const COCOMeta>& meta)
-      : meta_(meta), session_id_(ctx->Attr<int64_t>("session_id")) {}
+      : meta_(meta) {}
   ~COCODataset() = default;
 
   BatchType At(int64_t index) const override;
@@ -47,7 +47,6 @@ class COCODataset final : public RandomAccessDataset<COCOImage> {
 
  private:
   std::shared_ptr<const COCOMeta> meta_;
-  int64_t session_id_;
 };
 
 }  // namespace data
@@ -18,7 +18,7 @@ limitations under the License.
 
 #include "oneflow/user/data/dataset.h"
 #include "oneflow/user/data/parser.h"
-#include "oneflow/core/common/buffer.h"
+#include "oneflow/core/common/bounded_channel.h"
 
 namespace oneflow {
 
@@ -33,7 +33,10 @@ class DataReader {
   using BatchType = std::vector<SampleType>;
 
   DataReader(user_op::KernelInitContext* ctx)
-      : is_closed_(false), batch_buffer_(kDataReaderBatchBufferSize) {}
+      : DataReader(ctx, kDataReaderBatchBufferSize) {}
+  // Loads up to batch_buffer_size batches ahead of Read.
+  DataReader(user_op::KernelInitContext* ctx, size_t batch_buffer_size)
+      : is_closed_(false), batch_buffer_(batch_buffer_size, ChannelWaitStrategy::kSpinThenPark) {}
 
   virtual ~DataReader() {
     Close();
@@ -67,17 +70,17 @@ class DataReader {
  private:
   BatchType FetchBatchData() {
     BatchType batch;
-    CHECK_EQ(batch_buffer_.Pull(&batch), BufferStatus::kBufferStatusSuccess);
+    CHECK_EQ(batch_buffer_.Receive(&batch), kChannelStatusSuccess);
     return batch;
   }
 
   bool LoadBatch() {
     BatchType batch = loader_->Next();
-    return batch_buffer_.Push(std::move(batch)) == BufferStatus::kBufferStatusSuccess;
+    return batch_buffer_.Send(std::move(batch)) == kChannelStatusSuccess;
   }
 
   std::atomic<bool> is_closed_;
-  Buffer<BatchType> batch_buffer_;
+  BoundedChannel<BatchType> batch_buffer_;
   std::thread load_thrd_;
 };
 
@@ -129,8 +129,11 @@ MappedBuffer::MappedBuffer(const std::string& filename) : mapped_(nullptr), size
   CHECK(fstat(fd, &s) != -1) << "stat " << filename << " failed: " << strerror(errno);
   size_ = s.st_size;
 
-  mapped_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
-  CHECK(mapped_ != MAP_FAILED) << "mmap " << filename << " failed: " << strerror(errno);
+  // mmap rejects a zero length, an empty file (e.g. an empty OFRecord part) is an empty buffer
+  if (size_ > 0) {
+    mapped_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    CHECK(mapped_ != MAP_FAILED) << "mmap " << filename << " failed: " << strerror(errno);
+  }
 
   close(fd);
 #endif
@@ -138,7 +141,7 @@ MappedBuffer::MappedBuffer(const std::string& filename) : mapped_(nullptr), size
 
 MappedBuffer::~MappedBuffer() {
 #ifdef __linux__
-  CHECK(munmap(mapped_, size_) == 0) << "munmap failed";
+  if (mapped_ != nullptr) { CHECK(munmap(mapped_, size_) == 0) << "munmap failed"; }
 #endif
 }
 
@@ -0,0 +1,104 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_DATA_INDEXED_OFRECORD_DATASET_H_
+#define ONEFLOW_USER_DATA_INDEXED_OFRECORD_DATASET_H_
+
+#include "oneflow/core/common/balanced_splitter.h"
+#include "oneflow/user/data/dataset.h"
+#include "oneflow/user/data/ofrecord_dataset.h"
+#include "oneflow/user/data/ofrecord_index.h"
+
+namespace oneflow {
+namespace data {
+
+// OFRecords of mapped and indexed part files, read in place.
+//
+// The samples of all part files are numbered in the order of the parts, and every epoch the
+// parallel_id-th of parallel_num balanced ranges of them is read, in order or through a
+// permutation of all samples seeded by seed + epoch. Since the order of an epoch only depends on
+// the epoch, the reader resumes exactly from start_sample_offset, the number of samples this rank
+// had read.
+class IndexedOFRecordDataset final : public Dataset<OFRecordSlice> {
+ public:
+  using Base = Dataset<OFRecordSlice>;
+  using SampleType = typename Base::SampleType;
+  using BatchType = typename Base::BatchType;
+
+  OF_DISALLOW_COPY_AND_MOVE(IndexedOFRecordDataset);
+
+  explicit IndexedOFRecordDataset(user_op::KernelInitContext* ctx) : permutation_epoch_(-1) {
+    int32_t parallel_id = 0;
+    int32_t parallel_num = 0;
+    std::tie(parallel_id, parallel_num) = GetOFRecordReaderParallelIdAndNum(ctx);
+    part_begins_.push_back(0);
+    for (const std::string& path : GetOFRecordPartFilePaths(ctx)) {
+      parts_.emplace_back(new OFRecordIndex(path));
+      part_begins_.push_back(part_begins_.back() + parts_.back()->num_records());
+    }
+    num_samples_ = part_begins_.back();
+    CHECK_GE(num_samples_, parallel_num) << "fewer OFRecords than ranks";
+    range_ = BalancedSplitter(num_samples_, parallel_num).At(parallel_id);
+    random_shuffle_ = ctx->Attr<bool>("random_shuffle");
+    shuffle_after_epoch_ = ctx->Attr<bool>("shuffle_after_epoch");
+    // all ranks must permute alike, so there is no random default seed
+    seed_ = ctx->Attr<int64_t>("seed");
+    if (seed_ == -1) { seed_ = kOneflowDatasetSeed; }
+    position_ = ctx->Attr<int64_t>("start_sample_offset");
+    CHECK_GE(position_, 0);
+  }
+  ~IndexedOFRecordDataset() = default;
+
+  BatchType Next() override {
+    const int64_t epoch = position_ / range_.size();
+    int64_t sample = range_.begin() + position_ % range_.size();
+    position_ += 1;
+    if (random_shuffle_ || (shuffle_after_epoch_ && epoch > 0)) {
+      if (epoch != permutation_epoch_) { InitPermutation(epoch); }
+      sample = permutation_[sample];
+    }
+    const int64_t part = std::upper_bound(part_begins_.begin(), part_begins_.end(), sample)
+                         - part_begins_.begin() - 1;
+    BatchType batch;
+    batch.push_back(parts_[part]->record(sample - part_begins_[part]));
+    return batch;
+  }
+
+ private:
+  void InitPermutation(int64_t epoch) {
+    permutation_.resize(num_samples_);
+    std::iota(permutation_.begin(), permutation_.end(), 0);
+    std::mt19937_64 g(static_cast<uint64_t>(seed_) + epoch);
+    std::shuffle(permutation_.begin(), permutation_.end(), g);
+    permutation_epoch_ = epoch;
+  }
+
+  std::vector<std::unique_ptr<const OFRecordIndex>> parts_;
+  // the number of samples before every part, and the number of all samples
+  std::vector<int64_t> part_begins_;
+  int64_t num_samples_;
+  Range range_;
+  bool random_shuffle_;
+  bool shuffle_after_epoch_;
+  int64_t seed_;
+  int64_t position_;
+  std::vector<int64_t> permutation_;
+  int64_t permutation_epoch_;
+};
+
+}  // namespace data
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_DATA_INDEXED_OFRECORD_DATASET_H_
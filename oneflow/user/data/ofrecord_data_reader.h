@@ -27,10 +27,15 @@ namespace data {
 
 class OFRecordDataReader final : public DataReader<TensorBuffer> {
  public:
-  OFRecordDataReader(user_op::KernelInitContext* ctx) : DataReader<TensorBuffer>(ctx) {
+  OFRecordDataReader(user_op::KernelInitContext* ctx)
+      : DataReader<TensorBuffer>(ctx, ctx->Attr<int32_t>("prefetch_buffer_size")) {
     batch_size_ = ctx->TensorDesc4ArgNameAndIndex("out", 0)->shape().elem_cnt();
-    if (auto* pool = TensorBufferPool::TryGet()) { pool->IncreasePoolSizeByBase(batch_size_); }
-    loader_.reset(new OFRecordDataset(ctx));
+    const int32_t num_readers = ctx->Attr<int32_t>("num_reader_threads");
+    // the readers keep about one more batch of records in flight, read into pooled buffers
+    const size_t reader_buffer_size = RoundUp(batch_size_, num_readers) / num_readers;
+    pool_size_base_ = batch_size_ + (num_readers > 1 ? batch_size_ : 0);
+    if (auto* pool = TensorBufferPool::TryGet()) { pool->IncreasePoolSizeByBase(pool_size_base_); }
+    loader_.reset(new OFRecordDataset(ctx, num_readers, reader_buffer_size));
     if (ctx->Attr<bool>("random_shuffle")) {
       loader_.reset(new RandomShuffleDataset<TensorBuffer>(ctx, std::move(loader_)));
     }
@@ -40,7 +45,7 @@ class OFRecordDataReader final : public DataReader<TensorBuffer> {
   }
 
   ~OFRecordDataReader() override {
-    if (auto* pool = TensorBufferPool::TryGet()) { pool->DecreasePoolSizeByBase(batch_size_); }
+    if (auto* pool = TensorBufferPool::TryGet()) { pool->DecreasePoolSizeByBase(pool_size_base_); }
   }
 
  protected:
@@ -49,6 +54,7 @@ class OFRecordDataReader final : public DataReader<TensorBuffer> {
 
  private:
   size_t batch_size_;
+  size_t pool_size_base_;
 };
 
 }  // namespace data
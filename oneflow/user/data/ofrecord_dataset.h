@@ -18,6 +18,7 @@ limitations under the License.
 
 #include "oneflow/core/common/balanced_splitter.h"
 #include "oneflow/core/common/str_util.h"
+#include "oneflow/core/common/bounded_channel.h"
 #include "oneflow/core/framework/op_kernel.h"
 #include "oneflow/core/persistence/persistent_in_stream.h"
 #include "oneflow/core/job/job_set.pb.h"
@@ -28,6 +29,40 @@ limitations under the License.
 namespace oneflow {
 namespace data {
 
+// The paths of the data_part_num part files named by the attrs of an OFRecord reader op.
+inline std::vector<std::string> GetOFRecordPartFilePaths(user_op::KernelInitContext* ctx) {
+  const int32_t data_part_num = ctx->Attr<int32_t>("data_part_num");
+  std::string data_dir = ctx->Attr<std::string>("data_dir");
+  std::string part_name_prefix = ctx->Attr<std::string>("part_name_prefix");
+  int32_t part_name_suffix_length = ctx->Attr<int32_t>("part_name_suffix_length");
+  std::vector<std::string> paths;
+  for (int i = 0; i < data_part_num; ++i) {
+    std::string num = std::to_string(i);
+    int32_t zero_count = std::max(part_name_suffix_length - static_cast<int32_t>(num.length()), 0);
+    paths.emplace_back(JoinPath(data_dir, part_name_prefix + std::string(zero_count, '0') + num));
+  }
+  return paths;
+}
+
+// The parallel id and parallel num among which an OFRecord reader op splits the samples.
+inline std::pair<int32_t, int32_t> GetOFRecordReaderParallelIdAndNum(
+    user_op::KernelInitContext* ctx) {
+  bool is_local = false;
+  // NOTE(zwx): OFRecordDataset is used by OFRecordDataReader and
+  // OFRecordImageClassificationDataReader both, the latter has no attr nd_sbp,
+  // so it couldn't work in DDP for now. The If condition here could be removed when
+  // OFRecordImageClassificationDataReader had supported DDP (add attr nd_sbp)
+  // or been deprecated.
+  if (ctx->op_type_name() == "OFRecordReader") {
+    auto nd_sbp_str_vec = ctx->Attr<std::vector<std::string>>("nd_sbp");
+    // NOTE(zwx): OFRecordDataset is not consistent since attr nd_sbp is empty,
+    // we assume that it works in DDP
+    if (nd_sbp_str_vec.empty()) { is_local = true; }
+  }
+  if (is_local) { return {GlobalProcessCtx::Rank(), GlobalProcessCtx::WorldSize()}; }
+  return {ctx->parallel_ctx().parallel_id(), ctx->parallel_ctx().parallel_num()};
+}
+
 class OFRecordDataset final : public Dataset<TensorBuffer> {
  public:
   using Base = Dataset<TensorBuffer>;
@@ -36,60 +71,126 @@ class OFRecordDataset final : public Dataset<TensorBuffer> {
 
   OF_DISALLOW_COPY_AND_MOVE(OFRecordDataset);
 
-  OFRecordDataset(user_op::KernelInitContext* ctx) {
+  // With num_readers > 1 the local part files are split among num_readers threads, each reading
+  // its files in order and keeping at most reader_buffer_size records ahead, and Next interleaves
+  // the records of the readers one by one.
+  OFRecordDataset(user_op::KernelInitContext* ctx, int32_t num_readers = 1,
+                  size_t reader_buffer_size = 1) {
     current_epoch_ = 0;
     shuffle_after_epoch_ = ctx->Attr<bool>("shuffle_after_epoch");
 
     // in stream
     data_part_num_ = ctx->Attr<int32_t>("data_part_num");
-    std::string data_dir = ctx->Attr<std::string>("data_dir");
-    std::string part_name_prefix = ctx->Attr<std::string>("part_name_prefix");
-    int32_t part_name_suffix_length = ctx->Attr<int32_t>("part_name_suffix_length");
-
-    for (int i = 0; i < data_part_num_; ++i) {
-      std::string num = std::to_string(i);
-      int32_t zero_count =
-          std::max(part_name_suffix_length - static_cast<int32_t>(num.length()), 0);
-      data_file_paths_.emplace_back(
-          JoinPath(data_dir, part_name_prefix + std::string(zero_count, '0') + num));
-    }
-
-    bool is_local = false;
-    // NOTE(zwx): OFRecordDataset is used by OFRecordDataReader and
-    // OFRecordImageClassificationDataReader both, the latter has no attr nd_sbp,
-    // so it couldn't work in DDP for now. The If condition here could be removed when
-    // OFRecordImageClassificationDataReader had supported DDP (add attr nd_sbp)
-    // or been deprecated.
-    if (ctx->op_type_name() == "OFRecordReader") {
-      auto nd_sbp_str_vec = ctx->Attr<std::vector<std::string>>("nd_sbp");
-      // NOTE(zwx): OFRecordDataset is not consistent since attr nd_sbp is empty,
-      // we assume that it works in DDP
-      if (nd_sbp_str_vec.empty()) { is_local = true; }
-    }
-    if (is_local) {
-      parallel_id_ = GlobalProcessCtx::Rank();
-      parallel_num_ = GlobalProcessCtx::WorldSize();
-    } else {
-      parallel_id_ = ctx->parallel_ctx().parallel_id();
-      parallel_num_ = ctx->parallel_ctx().parallel_num();
-    }
+    data_file_paths_ = GetOFRecordPartFilePaths(ctx);
+    std::tie(parallel_id_, parallel_num_) = GetOFRecordReaderParallelIdAndNum(ctx);
     CHECK_LE(parallel_num_, data_part_num_);
     BalancedSplitter bs(data_part_num_, parallel_num_);
     range_ = bs.At(parallel_id_);
     std::vector<std::string> local_file_paths = GetLocalFilePaths();
-    in_stream_.reset(
-        new PersistentInStream(DataFS(), local_file_paths, !shuffle_after_epoch_, false));
+    num_readers = std::min<int32_t>(num_readers, local_file_paths.size());
+    if (num_readers > 1) {
+      CHECK_GT(reader_buffer_size, 0);
+      readers_.resize(num_readers);
+      for (int32_t i = 0; i < num_readers; ++i) {
+        readers_[i].reset(new Reader(reader_buffer_size));
+        readers_[i]->thread = std::thread([this, i] { ReaderLoop(i); });
+      }
+    } else {
+      in_stream_.reset(
+          new PersistentInStream(DataFS(), local_file_paths, !shuffle_after_epoch_, false));
+    }
+  }
+  ~OFRecordDataset() {
+    for (auto& reader : readers_) { reader->records.Close(); }
+    for (auto& reader : readers_) { reader->thread.join(); }
   }
-  ~OFRecordDataset() = default;
 
   BatchType Next() override {
     BatchType batch;
     batch.push_back(TensorBuffer());
-    ReadSample(batch.back());
+    if (readers_.empty()) {
+      ReadSample(batch.back());
+    } else {
+      ReceiveSample(batch.back());
+    }
     return batch;
   }
 
  private:
+  // A record read by a reader thread, or the end of the epoch of the reader when !has_record.
+  struct ReaderRecord {
+    bool has_record;
+    TensorBuffer record;
+  };
+
+  struct Reader {
+    explicit Reader(size_t buffer_size)
+        : records(buffer_size, ChannelWaitStrategy::kSpinThenPark), epoch_done(false) {}
+    BoundedChannel<ReaderRecord> records;
+    bool epoch_done;
+    std::thread thread;
+  };
+
+  // Reads the local files with index % num_readers == reader_id, epoch after epoch. The paths are
+  // shuffled with the same seeds as ShuffleAfterEpoch, so all readers agree on the files of an
+  // epoch without synchronizing.
+  void ReaderLoop(int32_t reader_id) {
+    const int32_t num_readers = readers_.size();
+    BoundedChannel<ReaderRecord>* records = &readers_[reader_id]->records;
+    std::vector<std::string> file_paths = data_file_paths_;
+    for (int32_t epoch = 0;; ++epoch) {
+      if (epoch > 0 && shuffle_after_epoch_) {
+        std::mt19937 g(kOneflowDatasetSeed + epoch);
+        std::shuffle(file_paths.begin(), file_paths.end(), g);
+      }
+      std::vector<std::string> reader_file_paths;
+      for (int64_t i = range_.begin() + reader_id; i < range_.end(); i += num_readers) {
+        reader_file_paths.emplace_back(file_paths.at(i));
+      }
+      PersistentInStream in_stream(DataFS(), reader_file_paths, false, false);
+      while (true) {
+        int64_t record_size = -1;
+        if (in_stream.ReadFully(reinterpret_cast<char*>(&record_size), sizeof(int64_t)) != 0) {
+          break;
+        }
+        CHECK_GT(record_size, 0);
+        ReaderRecord item{true, TensorBuffer()};
+        item.record.Resize(Shape({record_size}), DataType::kChar);
+        CHECK_EQ(in_stream.ReadFully(item.record.mut_data<char>(), record_size), 0);
+        if (records->Send(std::move(item)) != kChannelStatusSuccess) { return; }
+      }
+      if (records->Send(ReaderRecord{false, TensorBuffer()}) != kChannelStatusSuccess) { return; }
+    }
+  }
+
+  // Takes the next record from the readers in turn, skipping the readers which have finished the
+  // epoch until all of them have.
+  void ReceiveSample(TensorBuffer& tensor) {
+    size_t num_done = 0;
+    for (const auto& reader : readers_) { num_done += reader->epoch_done; }
+    bool epoch_has_record = true;
+    while (true) {
+      if (num_done == readers_.size()) {
+        CHECK(epoch_has_record) << "no OFRecord in the data parts";
+        for (auto& reader : readers_) { reader->epoch_done = false; }
+        num_done = 0;
+        epoch_has_record = false;
+        current_epoch_++;
+      }
+      Reader* reader = readers_.at(next_reader_).get();
+      next_reader_ = (next_reader_ + 1) % readers_.size();
+      if (reader->epoch_done) { continue; }
+      ReaderRecord item{false, TensorBuffer()};
+      CHECK_EQ(reader->records.Receive(&item), kChannelStatusSuccess);
+      if (item.has_record) {
+        tensor = std::move(item.record);
+        return;
+      }
+      reader->epoch_done = true;
+      num_done += 1;
+    }
+  }
+
   void ReadSample(TensorBuffer& tensor) {
     int64_t OFRecord_size = -1;
     char* size_ptr = reinterpret_cast<char*>(&OFRecord_size);
@@ -128,6 +229,8 @@ class OFRecordDataset final : public Dataset<TensorBuffer> {
   Range range_;
   std::vector<std::string> data_file_paths_;
   std::unique_ptr<PersistentInStream> in_stream_;
+  std::vector<std::unique_ptr<Reader>> readers_;
+  size_t next_reader_ = 0;
 };
 
 }  // namespace data
@@ -0,0 +1,94 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/data/ofrecord_index.h"
+#include <sys/stat.h>
+
+namespace oneflow {
+
+namespace data {
+
+namespace {
+
+constexpr size_t kIndexHeaderSize = OFRecordIndex::kMagicCodeLen + 3 * sizeof(uint64_t);
+
+uint64_t ReadUInt64(const char* ptr) {
+  uint64_t value = 0;
+  std::memcpy(&value, ptr, sizeof(uint64_t));
+  return value;
+}
+
+bool FileExists(const std::string& path) {
+  struct stat s;
+  return stat(path.c_str(), &s) == 0;
+}
+
+}  // namespace
+
+constexpr char OFRecordIndex::kMagicCode[];
+
+OFRecordIndex::OFRecordIndex(const std::string& part_file_path)
+    : offsets_(nullptr), num_records_(0) {
+  data_ = std::make_unique<const MappedBuffer>(part_file_path);
+  const std::string index_file_path = IndexFilePath(part_file_path);
+  if (!FileExists(index_file_path)) {
+    BuildOffsets();
+    VLOG(2) << "No index file of OFRecord part " << part_file_path << ", built an index of "
+            << num_records_ << " records";
+    return;
+  }
+  index_ = std::make_unique<const MappedBuffer>(index_file_path);
+  const char* index_ptr = static_cast<const char*>(index_->ptr());
+  CHECK_GE(index_->size(), kIndexHeaderSize) << "truncated index file " << index_file_path;
+  CHECK_EQ(std::memcmp(index_ptr, kMagicCode, kMagicCodeLen), 0)
+      << index_file_path << " is not an OFRecord index file";
+  index_ptr += kMagicCodeLen;
+  CHECK_EQ(ReadUInt64(index_ptr), kVersion) << "unsupported version of " << index_file_path;
+  index_ptr += sizeof(uint64_t);
+  CHECK_EQ(ReadUInt64(index_ptr), data_->size())
+      << index_file_path << " does not index the current " << part_file_path;
+  index_ptr += sizeof(uint64_t);
+  num_records_ = ReadUInt64(index_ptr);
+  index_ptr += sizeof(uint64_t);
+  CHECK_EQ(index_->size(), kIndexHeaderSize + num_records_ * sizeof(int64_t))
+      << "truncated index file " << index_file_path;
+  // the header keeps the offsets 8 bytes aligned in the page aligned mapping
+  offsets_ = reinterpret_cast<const int64_t*>(index_ptr);
+  if (num_records_ > 0) {
+    CHECK_LE(offsets_[num_records_ - 1] + record_size(num_records_ - 1) + sizeof(int64_t),
+             data_->size())
+        << index_file_path << " points past the end of " << part_file_path;
+  }
+}
+
+void OFRecordIndex::BuildOffsets() {
+  const int64_t data_size = data_->size();
+  int64_t offset = 0;
+  while (offset < data_size) {
+    CHECK_LE(offset + static_cast<int64_t>(sizeof(int64_t)), data_size) << "truncated OFRecord";
+    built_offsets_.push_back(offset);
+    int64_t size = 0;
+    std::memcpy(&size, data_ptr() + offset, sizeof(int64_t));
+    CHECK_GT(size, 0);
+    offset += sizeof(int64_t) + size;
+  }
+  CHECK_EQ(offset, data_size) << "truncated OFRecord";
+  offsets_ = built_offsets_.data();
+  num_records_ = built_offsets_.size();
+}
+
+}  // namespace data
+
+}  // namespace oneflow
@@ -0,0 +1,89 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_DATA_OFRECORD_INDEX_H_
+#define ONEFLOW_USER_DATA_OFRECORD_INDEX_H_
+
+#include "oneflow/core/common/util.h"
+#include "oneflow/user/data/gpt_dataset.h"
+
+namespace oneflow {
+
+namespace data {
+
+// A serialized OFRecord in a mapped part file.
+struct OFRecordSlice {
+  const char* data;
+  int64_t size;
+};
+
+// The records of an OFRecord part file, mapped into memory.
+//
+// A part file is a sequence of records, each an int64 length followed by that many bytes of
+// serialized OFRecord. The index of a part is read from the sidecar file <part>.idx when it
+// exists, otherwise it is built by walking the length prefixes of the mapped part. The sidecar
+// holds, all integers little endian:
+//
+//   char[8]  magic code "OFRIDX\0\0"
+//   uint64   version, 1
+//   uint64   size of the part file in bytes
+//   uint64   number of records
+//   int64    offset of the length prefix of every record in the part file
+class OFRecordIndex final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(OFRecordIndex);
+  explicit OFRecordIndex(const std::string& part_file_path);
+  ~OFRecordIndex() = default;
+
+  static constexpr char kMagicCode[] = "OFRIDX\x00\x00";
+  static constexpr size_t kMagicCodeLen = sizeof(kMagicCode) - 1;
+  static constexpr uint64_t kVersion = 1;
+
+  static std::string IndexFilePath(const std::string& part_file_path) {
+    return part_file_path + ".idx";
+  }
+
+  size_t num_records() const { return num_records_; }
+
+  // The serialized OFRecord of record index, which points into the mapped part file.
+  OFRecordSlice record(size_t index) const {
+    return OFRecordSlice{data_ptr() + offset(index) + sizeof(int64_t), record_size(index)};
+  }
+  int64_t record_size(size_t index) const {
+    int64_t size = 0;
+    std::memcpy(&size, data_ptr() + offset(index), sizeof(int64_t));
+    return size;
+  }
+
+ private:
+  const char* data_ptr() const { return static_cast<const char*>(data_->ptr()); }
+  int64_t offset(size_t index) const {
+    CHECK_LT(index, num_records_);
+    return offsets_[index];
+  }
+  void BuildOffsets();
+
+  std::unique_ptr<const MappedBuffer> data_;
+  std::unique_ptr<const MappedBuffer> index_;
+  std::vector<int64_t> built_offsets_;
+  const int64_t* offsets_;
+  size_t num_records_;
+};
+
+}  // namespace data
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_DATA_OFRECORD_INDEX_H_
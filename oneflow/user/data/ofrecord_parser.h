@@ -17,6 +17,7 @@ limitations under the License.
 #define ONEFLOW_USER_DATA_OFRECORD_PARSER_H_
 
 #include "oneflow/user/data/parser.h"
+#include "oneflow/user/data/ofrecord_index.h"
 #include "oneflow/core/common/tensor_buffer.h"
 #include "oneflow/core/record/record.pb.h"
 #include "oneflow/core/thread/thread_manager.h"
@@ -47,6 +48,27 @@ class OFRecordParser final : public Parser<TensorBuffer> {
   }
 };
 
+// Parses the OFRecords straight from the mapped part files.
+class OFRecordSliceParser final : public Parser<OFRecordSlice> {
+ public:
+  using Base = Parser<OFRecordSlice>;
+  using SampleType = typename Base::SampleType;
+  using BatchType = typename Base::BatchType;
+
+  OFRecordSliceParser() = default;
+  ~OFRecordSliceParser() = default;
+
+  void Parse(BatchType& batch_data, user_op::KernelComputeContext* ctx) override {
+    user_op::Tensor* out_tensor = ctx->Tensor4ArgNameAndIndex("out", 0);
+    CHECK_EQ(batch_data.size(), out_tensor->shape_view().elem_cnt());
+    OFRecord* dptr = out_tensor->mut_dptr<OFRecord>();
+    MultiThreadLoop(batch_data.size(), [&](size_t i) {
+      const OFRecordSlice& sample = batch_data[i];
+      CHECK(dptr[i].ParseFromArray(sample.data, sample.size));
+    });
+  }
+};
+
 }  // namespace data
 }  // namespace oneflow
 
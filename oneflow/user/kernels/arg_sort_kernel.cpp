@@ -15,6 +15,8 @@ limitations under the License.
 */
 #include "oneflow/core/framework/framework.h"
 #include "oneflow/core/kernel/new_kernel_util.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/user/kernels/radix_sort_cpu_util.h"
 
 namespace oneflow {
 
@@ -34,36 +36,74 @@ class CpuArgSortKernel final : public user_op::OpKernel {
     const std::string& direction = ctx->Attr<std::string>("direction");
     const bool is_ascending = direction == "ASCENDING";
     const bool is_descending = direction == "DESCENDING";
-    FOR_RANGE(int32_t, i, 0, instance_num) {
-      const T* in_ptr_i = in->dptr<T>() + i * instance_size;
-      int32_t* out_ptr_i = out->mut_dptr<int32_t>() + i * instance_size;
-      std::iota(out_ptr_i, out_ptr_i + instance_size, 0);
-      auto comp = [&](const int32_t lhs, const int32_t rhs) {
-        const T l = in_ptr_i[lhs];
-        const T r = in_ptr_i[rhs];
-        if (l == r) {
-          return lhs < rhs;
-        } else {
-          if (is_ascending) {
-            return l < r;
-          } else if (is_descending) {
-            return l > r;
-          } else {
-            UNIMPLEMENTED();
-          }
-        }
-      };
-      std::sort(out_ptr_i, out_ptr_i + instance_size, comp);
+    CHECK(is_ascending || is_descending);
+    auto* stream = ctx->stream()->As<ep::CpuStream>();
+    if (instance_size >= radix_sort_cpu::kMinInstanceSize) {
+      using RadixKey = radix_sort_cpu::RadixKey<T>;
+      using Bits = typename RadixKey::Bits;
+      user_op::Tensor* tmp_buffer = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
+      const int64_t elem_cnt = in->shape_view().elem_cnt();
+      const size_t keys_size = radix_sort_cpu::GetKeysTmpSize<T>(in->shape_view());
+      char* tmp_ptr = tmp_buffer->mut_dptr<char>();
+      Bits* keys = reinterpret_cast<Bits*>(tmp_ptr);
+      Bits* keys_tmp = reinterpret_cast<Bits*>(tmp_ptr + keys_size);
+      int32_t* indices_tmp = reinterpret_cast<int32_t*>(tmp_ptr + 2 * keys_size);
+      // descending order is the ascending order of the inverted bits, equal keys keep the order of
+      // their indices as the radix sort is stable
+      const Bits flip = is_descending ? static_cast<Bits>(~Bits{0}) : Bits{0};
+      const T* in_ptr = in->dptr<T>();
+      int32_t* out_ptr = out->mut_dptr<int32_t>();
+      stream->ParallelFor(
+          0, elem_cnt,
+          [&](int64_t begin, int64_t end) {
+            FOR_RANGE(int64_t, i, begin, end) {
+              // -0.0 and 0.0 are equal keys, so they must have the same bits
+              const T x = in_ptr[i] == static_cast<T>(0) ? static_cast<T>(0) : in_ptr[i];
+              keys[i] = RadixKey::ToBits(x) ^ flip;
+              out_ptr[i] = i % instance_size;
+            }
+          },
+          ep::GetParallelForGrainSize(ep::parallel_for_cost::kElementwise));
+      radix_sort_cpu::RadixSortRows(stream, instance_num, instance_size, keys, out_ptr, keys_tmp,
+                                    indices_tmp);
+      return;
     }
+    stream->ParallelFor(
+        0, instance_num,
+        [&](int64_t begin, int64_t end) {
+          FOR_RANGE(int64_t, i, begin, end) {
+            const T* in_ptr_i = in->dptr<T>() + i * instance_size;
+            int32_t* out_ptr_i = out->mut_dptr<int32_t>() + i * instance_size;
+            std::iota(out_ptr_i, out_ptr_i + instance_size, 0);
+            auto comp = [&](const int32_t lhs, const int32_t rhs) {
+              const T l = in_ptr_i[lhs];
+              const T r = in_ptr_i[rhs];
+              if (l == r) {
+                return lhs < rhs;
+              } else {
+                return is_ascending ? l < r : l > r;
+              }
+            };
+            std::sort(out_ptr_i, out_ptr_i + instance_size, comp);
+          }
+        },
+        ep::GetParallelForGrainSize(ep::parallel_for_cost::Sort(instance_size)));
   }
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
 };
 
-#define REGISTER_CPU_ARG_SORT_KERNEL(dtype)                           \
-  REGISTER_USER_KERNEL("arg_sort")                                    \
-      .SetCreateFn<CpuArgSortKernel<dtype>>()                         \
-      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU) \
-                       && (user_op::HobDataType("in", 0) == GetDataType<dtype>::value));
+#define REGISTER_CPU_ARG_SORT_KERNEL(dtype)                                               \
+  REGISTER_USER_KERNEL("arg_sort")                                                        \
+      .SetCreateFn<CpuArgSortKernel<dtype>>()                                             \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                     \
+                       && (user_op::HobDataType("in", 0) == GetDataType<dtype>::value))   \
+      .SetInferTmpSizeFn([](user_op::InferContext* ctx) -> size_t {                       \
+        const Shape& in_shape = ctx->InputShape("in", 0);                                 \
+        const size_t keys_size = radix_sort_cpu::GetKeysTmpSize<dtype>(in_shape);         \
+        if (keys_size == 0) { return 0; }                                                 \
+        /* keys, temporary keys and temporary indices of the radix sort */                \
+        return 2 * keys_size + GetCudaAlignedSize(in_shape.elem_cnt() * sizeof(int32_t)); \
+      });
 
 REGISTER_CPU_ARG_SORT_KERNEL(float)
 REGISTER_CPU_ARG_SORT_KERNEL(double)
@@ -0,0 +1,398 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/conv_cpu_kernel_util.h"
+#include "oneflow/user/kernels/simd_pack.h"
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/core/kernel/new_kernel_util.h"
+
+namespace oneflow {
+
+namespace {
+
+// Output channels computed together by the direct algorithm, each input row loaded is used for all
+// of them.
+constexpr int64_t kDirectBlockSize = 8;
+// im2col + GEMM is bound by writing the column buffer when the reduce dim of the GEMM is small.
+constexpr int64_t kDirectMaxReduceSize = 256;
+// The transforms of winograd only pay off when there are enough channels to reuse them.
+constexpr int64_t kWinogradMinChannels = 16;
+// Tiles transformed and multiplied together by winograd, which bounds its workspace.
+constexpr int64_t kWinogradTileBlockSize = 128;
+constexpr int64_t kWinogradTileElemCnt = 16;
+
+bool IsWinogradSupported(const ConvCpuParams& params) {
+  return params.kernel_height == 3 && params.kernel_width == 3 && params.stride_height == 1
+         && params.stride_width == 1 && params.dilation_height == 1 && params.dilation_width == 1;
+}
+
+const std::string& GetConvCpuAlgoFromEnv() {
+  static const std::string algo = GetStringFromEnv("ONEFLOW_KERNEL_CPU_CONV_ALGO", "auto");
+  CHECK(algo == "auto" || algo == "im2col" || algo == "direct" || algo == "winograd")
+      << "invalid ONEFLOW_KERNEL_CPU_CONV_ALGO: " << algo;
+  return algo;
+}
+
+int64_t DivUp(int64_t x, int64_t y) { return (x + y - 1) / y; }
+
+// Range [begin, end) of the output positions o that read the input position o * stride + offset
+// within [0, in_size).
+void GetValidOutputRange(int64_t in_size, int64_t out_size, int64_t stride, int64_t offset,
+                         int64_t* begin, int64_t* end) {
+  *begin = offset >= 0 ? 0 : DivUp(-offset, stride);
+  *end = in_size - 1 - offset < 0 ? 0 : std::min((in_size - 1 - offset) / stride + 1, out_size);
+}
+
+template<typename T>
+void WinogradTransformWeight(const T* g, T* u, int64_t stride) {
+  // u = G * g * G(T), G = [[1, 0, 0], [1/2, 1/2, 1/2], [1/2, -1/2, 1/2], [0, 0, 1]]
+  T gg[4][3];
+  for (int j = 0; j < 3; ++j) {
+    gg[0][j] = g[j];
+    gg[1][j] = (g[j] + g[3 + j] + g[6 + j]) / 2;
+    gg[2][j] = (g[j] - g[3 + j] + g[6 + j]) / 2;
+    gg[3][j] = g[6 + j];
+  }
+  for (int i = 0; i < 4; ++i) {
+    u[(i * 4 + 0) * stride] = gg[i][0];
+    u[(i * 4 + 1) * stride] = (gg[i][0] + gg[i][1] + gg[i][2]) / 2;
+    u[(i * 4 + 2) * stride] = (gg[i][0] - gg[i][1] + gg[i][2]) / 2;
+    u[(i * 4 + 3) * stride] = gg[i][2];
+  }
+}
+
+template<typename T>
+void WinogradTransformInput(const T (&d)[4][4], T* v, int64_t stride) {
+  // v = B(T) * d * B, B(T) = [[1, 0, -1, 0], [0, 1, 1, 0], [0, -1, 1, 0], [0, 1, 0, -1]]
+  T bd[4][4];
+  for (int j = 0; j < 4; ++j) {
+    bd[0][j] = d[0][j] - d[2][j];
+    bd[1][j] = d[1][j] + d[2][j];
+    bd[2][j] = d[2][j] - d[1][j];
+    bd[3][j] = d[1][j] - d[3][j];
+  }
+  for (int i = 0; i < 4; ++i) {
+    v[(i * 4 + 0) * stride] = bd[i][0] - bd[i][2];
+    v[(i * 4 + 1) * stride] = bd[i][1] + bd[i][2];
+    v[(i * 4 + 2) * stride] = bd[i][2] - bd[i][1];
+    v[(i * 4 + 3) * stride] = bd[i][1] - bd[i][3];
+  }
+}
+
+template<typename T>
+void WinogradTransformOutput(const T* m, int64_t stride, T (&y)[2][2]) {
+  // y = A(T) * m * A, A(T) = [[1, 1, 1, 0], [0, 1, -1, -1]]
+  T am[2][4];
+  for (int j = 0; j < 4; ++j) {
+    am[0][j] = m[j * stride] + m[(4 + j) * stride] + m[(8 + j) * stride];
+    am[1][j] = m[(4 + j) * stride] - m[(8 + j) * stride] - m[(12 + j) * stride];
+  }
+  for (int i = 0; i < 2; ++i) {
+    y[i][0] = am[i][0] + am[i][1] + am[i][2];
+    y[i][1] = am[i][1] - am[i][2] - am[i][3];
+  }
+}
+
+}  // namespace
+
+bool MakeConvCpuParams(const std::string& data_format, const ShapeView& x_shape,
+                       const ShapeView& weight_shape, const ShapeView& y_shape,
+                       const std::vector<int32_t>& strides,
+                       const std::vector<int32_t>& dilation_rate,
+                       const std::vector<int32_t>& padding_before, ConvCpuParams* params) {
+  const int64_t num_axes = x_shape.NumAxes();
+  if (data_format != "channels_first" || (num_axes != 3 && num_axes != 4)) { return false; }
+  const bool is_2d = num_axes == 4;
+  params->batch_size = x_shape.At(0);
+  params->in_channels = x_shape.At(1);
+  params->in_height = is_2d ? x_shape.At(2) : 1;
+  params->in_width = x_shape.At(num_axes - 1);
+  params->out_channels = y_shape.At(1);
+  params->out_height = is_2d ? y_shape.At(2) : 1;
+  params->out_width = y_shape.At(num_axes - 1);
+  params->kernel_height = is_2d ? weight_shape.At(2) : 1;
+  params->kernel_width = weight_shape.At(num_axes - 1);
+  params->stride_height = is_2d ? strides.at(0) : 1;
+  params->stride_width = strides.back();
+  params->dilation_height = is_2d ? dilation_rate.at(0) : 1;
+  params->dilation_width = dilation_rate.back();
+  params->padding_height = is_2d ? padding_before.at(0) : 0;
+  params->padding_width = padding_before.back();
+  return true;
+}
+
+ConvCpuAlgo GetConvCpuAlgo(const ConvCpuParams& params) {
+  const std::string& algo = GetConvCpuAlgoFromEnv();
+  if (algo == "im2col") { return ConvCpuAlgo::kIm2ColGemm; }
+  if (algo == "direct") { return ConvCpuAlgo::kDirect; }
+  if (algo == "winograd") {
+    return IsWinogradSupported(params) ? ConvCpuAlgo::kWinograd : ConvCpuAlgo::kIm2ColGemm;
+  }
+  if (IsWinogradSupported(params) && params.in_channels >= kWinogradMinChannels
+      && params.out_channels >= kWinogradMinChannels) {
+    return ConvCpuAlgo::kWinograd;
+  }
+  if (params.in_channels * params.kernel_height * params.kernel_width <= kDirectMaxReduceSize) {
+    return ConvCpuAlgo::kDirect;
+  }
+  return ConvCpuAlgo::kIm2ColGemm;
+}
+
+ConvCpuAlgo GetDeconvCpuAlgo(const ConvCpuParams& params) {
+  const std::string& algo = GetConvCpuAlgoFromEnv();
+  if (algo == "direct") { return ConvCpuAlgo::kDirect; }
+  if (algo == "auto"
+      && params.out_channels * params.kernel_height * params.kernel_width
+             <= kDirectMaxReduceSize) {
+    return ConvCpuAlgo::kDirect;
+  }
+  return ConvCpuAlgo::kIm2ColGemm;
+}
+
+size_t GetConvCpuWorkspaceSize(ConvCpuAlgo algo, const ConvCpuParams& params, size_t elem_size) {
+  if (algo == ConvCpuAlgo::kDirect) {
+    return RoundUp(params.out_channels, kDirectBlockSize) * params.in_channels
+           * params.kernel_height * params.kernel_width * elem_size;
+  } else if (algo == ConvCpuAlgo::kWinograd) {
+    const int64_t num_tiles =
+        params.batch_size * DivUp(params.out_height, 2) * DivUp(params.out_width, 2);
+    const int64_t tile_block_size = std::min(num_tiles, kWinogradTileBlockSize);
+    return kWinogradTileElemCnt
+           * (params.out_channels * params.in_channels
+              + (params.in_channels + params.out_channels) * tile_block_size)
+           * elem_size;
+  } else {
+    return 0;
+  }
+}
+
+template<typename T>
+void ConvCpuKernelUtil<T>::DirectForward(ep::Stream* stream, const ConvCpuParams& params,
+                                         const T* x, const T* weight, const T* bias, T* y,
+                                         void* workspace) {
+  auto* cpu_stream = stream->As<ep::CpuStream>();
+  const int64_t channels = params.in_channels;
+  const int64_t kernel_size = params.kernel_height * params.kernel_width;
+  const int64_t num_blocks = DivUp(params.out_channels, kDirectBlockSize);
+  // weight (K, C, KH, KW) is packed to (K / kDirectBlockSize, C, KH, KW, kDirectBlockSize) with
+  // zeros for the channels past K.
+  T* packed_weight = reinterpret_cast<T*>(workspace);
+  cpu_stream->ParallelFor(0, num_blocks, [&](int64_t begin, int64_t end) {
+    for (int64_t block = begin; block < end; ++block) {
+      for (int64_t c = 0; c < channels; ++c) {
+        for (int64_t r = 0; r < kernel_size; ++r) {
+          T* packed = packed_weight + ((block * channels + c) * kernel_size + r) * kDirectBlockSize;
+          for (int64_t j = 0; j < kDirectBlockSize; ++j) {
+            const int64_t k = block * kDirectBlockSize + j;
+            packed[j] = k < params.out_channels ? weight[(k * channels + c) * kernel_size + r] : 0;
+          }
+        }
+      }
+    }
+  });
+  // Every item computes a row of y for a block of output channels.
+  const int64_t num_items = params.batch_size * num_blocks * params.out_height;
+  const int64_t cost_per_item = channels * kernel_size * params.out_width * kDirectBlockSize;
+  cpu_stream->ParallelFor(
+      0, num_items,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t item = begin; item < end; ++item) {
+          const int64_t oh = item % params.out_height;
+          const int64_t block = item / params.out_height % num_blocks;
+          const int64_t n = item / params.out_height / num_blocks;
+          const int64_t k_begin = block * kDirectBlockSize;
+          const int64_t block_size = std::min(kDirectBlockSize, params.out_channels - k_begin);
+          T* y_rows[kDirectBlockSize];
+          for (int64_t j = 0; j < block_size; ++j) {
+            y_rows[j] =
+                y + ((n * params.out_channels + k_begin + j) * params.out_height + oh)
+                        * params.out_width;
+            std::fill(y_rows[j], y_rows[j] + params.out_width,
+                      bias == nullptr ? static_cast<T>(0) : bias[k_begin + j]);
+          }
+          for (int64_t c = 0; c < channels; ++c) {
+            for (int64_t kh = 0; kh < params.kernel_height; ++kh) {
+              const int64_t ih =
+                  oh * params.stride_height - params.padding_height + kh * params.dilation_height;
+              if (ih < 0 || ih >= params.in_height) { continue; }
+              const T* x_row = x + ((n * channels + c) * params.in_height + ih) * params.in_width;
+              for (int64_t kw = 0; kw < params.kernel_width; ++kw) {
+                const T* w =
+                    packed_weight
+                    + ((block * channels + c) * kernel_size + kh * params.kernel_width + kw)
+                          * kDirectBlockSize;
+                const int64_t offset = kw * params.dilation_width - params.padding_width;
+                int64_t ow_begin = 0;
+                int64_t ow_end = 0;
+                GetValidOutputRange(params.in_width, params.out_width, params.stride_width,
+                                    offset, &ow_begin, &ow_end);
+                if (ow_begin >= ow_end) { continue; }
+                if (params.stride_width == 1) {
+                  for (int64_t j = 0; j < block_size; ++j) {
+                    SimdAxpy(ow_end - ow_begin, w[j], x_row + ow_begin + offset,
+                             y_rows[j] + ow_begin);
+                  }
+                } else {
+                  for (int64_t ow = ow_begin; ow < ow_end; ++ow) {
+                    const T x_val = x_row[ow * params.stride_width + offset];
+                    for (int64_t j = 0; j < block_size; ++j) { y_rows[j][ow] += w[j] * x_val; }
+                  }
+                }
+              }
+            }
+          }
+        }
+      },
+      ep::GetParallelForGrainSize(cost_per_item));
+}
+
+template<typename T>
+void ConvCpuKernelUtil<T>::WinogradForward(ep::Stream* stream, const ConvCpuParams& params,
+                                           const T* x, const T* weight, const T* bias, T* y,
+                                           void* workspace) {
+  auto* cpu_stream = stream->As<ep::CpuStream>();
+  const int64_t channels = params.in_channels;
+  const int64_t filters = params.out_channels;
+  const int64_t tiles_h = DivUp(params.out_height, 2);
+  const int64_t tiles_w = DivUp(params.out_width, 2);
+  const int64_t num_tiles = params.batch_size * tiles_h * tiles_w;
+  const int64_t tile_block_size = std::min(num_tiles, kWinogradTileBlockSize);
+  // u (16, K, C), v (16, C, tiles) and m (16, K, tiles), where every element of the 4x4 tiles is a
+  // GEMM of m = u * v.
+  T* u = reinterpret_cast<T*>(workspace);
+  T* v = u + kWinogradTileElemCnt * filters * channels;
+  T* m = v + kWinogradTileElemCnt * channels * tile_block_size;
+  cpu_stream->ParallelFor(
+      0, filters * channels,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+          WinogradTransformWeight(weight + i * 9, u + i, filters * channels);
+        }
+      },
+      ep::GetParallelForGrainSize(kWinogradTileElemCnt * 4));
+  for (int64_t tile_begin = 0; tile_begin < num_tiles; tile_begin += tile_block_size) {
+    const int64_t block_tiles = std::min(tile_block_size, num_tiles - tile_begin);
+    cpu_stream->ParallelFor(
+        0, channels,
+        [&](int64_t begin, int64_t end) {
+          for (int64_t c = begin; c < end; ++c) {
+            for (int64_t t = 0; t < block_tiles; ++t) {
+              const int64_t tile = tile_begin + t;
+              const int64_t n = tile / (tiles_h * tiles_w);
+              const int64_t ih_begin = tile / tiles_w % tiles_h * 2 - params.padding_height;
+              const int64_t iw_begin = tile % tiles_w * 2 - params.padding_width;
+              const T* x_plane = x + (n * channels + c) * params.in_height * params.in_width;
+              T d[4][4];
+              for (int64_t i = 0; i < 4; ++i) {
+                const int64_t ih = ih_begin + i;
+                for (int64_t j = 0; j < 4; ++j) {
+                  const int64_t iw = iw_begin + j;
+                  d[i][j] = (ih >= 0 && ih < params.in_height && iw >= 0 && iw < params.in_width)
+                                ? x_plane[ih * params.in_width + iw]
+                                : static_cast<T>(0);
+                }
+              }
+              WinogradTransformInput(d, v + c * block_tiles + t, channels * block_tiles);
+            }
+          }
+        },
+        ep::GetParallelForGrainSize(block_tiles * kWinogradTileElemCnt * 4));
+    for (int64_t e = 0; e < kWinogradTileElemCnt; ++e) {
+      NewKernelUtil<DeviceType::kCPU>::OFGemm(
+          stream, CblasNoTrans, CblasNoTrans, filters, block_tiles, channels, static_cast<T>(1),
+          u + e * filters * channels, v + e * channels * block_tiles, static_cast<T>(0),
+          m + e * filters * block_tiles);
+    }
+    cpu_stream->ParallelFor(
+        0, filters,
+        [&](int64_t begin, int64_t end) {
+          for (int64_t k = begin; k < end; ++k) {
+            const T bias_val = bias == nullptr ? static_cast<T>(0) : bias[k];
+            for (int64_t t = 0; t < block_tiles; ++t) {
+              const int64_t tile = tile_begin + t;
+              const int64_t n = tile / (tiles_h * tiles_w);
+              const int64_t oh_begin = tile / tiles_w % tiles_h * 2;
+              const int64_t ow_begin = tile % tiles_w * 2;
+              T out[2][2];
+              WinogradTransformOutput(m + k * block_tiles + t, filters * block_tiles, out);
+              T* y_plane = y + (n * filters + k) * params.out_height * params.out_width;
+              for (int64_t i = 0; i < 2 && oh_begin + i < params.out_height; ++i) {
+                for (int64_t j = 0; j < 2 && ow_begin + j < params.out_width; ++j) {
+                  y_plane[(oh_begin + i) * params.out_width + ow_begin + j] = out[i][j] + bias_val;
+                }
+              }
+            }
+          }
+        },
+        ep::GetParallelForGrainSize(block_tiles * kWinogradTileElemCnt * 2));
+  }
+}
+
+template<typename T>
+void ConvCpuKernelUtil<T>::DirectBackwardData(ep::Stream* stream, const ConvCpuParams& params,
+                                              const T* dy, const T* weight, T* dx) {
+  const int64_t channels = params.in_channels;
+  const int64_t kernel_size = params.kernel_height * params.kernel_width;
+  // Every item computes a row of dx from the rows of dy that read it.
+  const int64_t num_items = params.batch_size * channels * params.in_height;
+  const int64_t cost_per_item =
+      params.out_channels * kernel_size * params.out_width / params.stride_height;
+  stream->As<ep::CpuStream>()->ParallelFor(
+      0, num_items,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t item = begin; item < end; ++item) {
+          const int64_t ih = item % params.in_height;
+          const int64_t c = item / params.in_height % channels;
+          const int64_t n = item / params.in_height / channels;
+          T* dx_row = dx + item * params.in_width;
+          std::fill(dx_row, dx_row + params.in_width, static_cast<T>(0));
+          for (int64_t k = 0; k < params.out_channels; ++k) {
+            for (int64_t kh = 0; kh < params.kernel_height; ++kh) {
+              const int64_t oh_stride = ih + params.padding_height - kh * params.dilation_height;
+              if (oh_stride < 0 || oh_stride % params.stride_height != 0) { continue; }
+              const int64_t oh = oh_stride / params.stride_height;
+              if (oh >= params.out_height) { continue; }
+              const T* dy_row =
+                  dy + ((n * params.out_channels + k) * params.out_height + oh) * params.out_width;
+              const T* w = weight + ((k * channels + c) * params.kernel_height + kh)
+                                        * params.kernel_width;
+              for (int64_t kw = 0; kw < params.kernel_width; ++kw) {
+                const int64_t offset = kw * params.dilation_width - params.padding_width;
+                int64_t ow_begin = 0;
+                int64_t ow_end = 0;
+                GetValidOutputRange(params.in_width, params.out_width, params.stride_width,
+                                    offset, &ow_begin, &ow_end);
+                if (ow_begin >= ow_end) { continue; }
+                if (params.stride_width == 1) {
+                  SimdAxpy(ow_end - ow_begin, w[kw], dy_row + ow_begin,
+                           dx_row + ow_begin + offset);
+                } else {
+                  for (int64_t ow = ow_begin; ow < ow_end; ++ow) {
+                    dx_row[ow * params.stride_width + offset] += w[kw] * dy_row[ow];
+                  }
+                }
+              }
+            }
+          }
+        }
+      },
+      ep::GetParallelForGrainSize(cost_per_item));
+}
+
+template struct ConvCpuKernelUtil<float>;
+template struct ConvCpuKernelUtil<double>;
+
+}  // namespace oneflow
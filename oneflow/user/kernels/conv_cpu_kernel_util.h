@@ -0,0 +1,87 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_CONV_CPU_KERNEL_UTIL_H_
+#define ONEFLOW_USER_KERNELS_CONV_CPU_KERNEL_UTIL_H_
+
+#include "oneflow/core/common/shape_view.h"
+#include "oneflow/core/ep/include/stream.h"
+
+namespace oneflow {
+
+// Algorithms of the cpu conv and deconv kernels besides im2col + GEMM. The direct and winograd
+// algorithms run the whole batch in parallel and do not need a column buffer.
+enum class ConvCpuAlgo {
+  kIm2ColGemm,
+  // Direct convolution of output channel blocks, with the weight packed block by block.
+  kDirect,
+  // Winograd F(2x2, 3x3), for 3x3 kernels of stride 1 and dilation 1.
+  kWinograd,
+};
+
+// A channels first 1d or 2d conv of x (N, C, H, W) and weight (K, C, KH, KW) to y (N, K, OH, OW).
+// 1d convs have H = OH = KH = 1. A deconv is the data grad of the conv with the same params, where
+// the input of the deconv is y and its output is x.
+struct ConvCpuParams {
+  int64_t batch_size;
+  int64_t in_channels;
+  int64_t in_height;
+  int64_t in_width;
+  int64_t out_channels;
+  int64_t out_height;
+  int64_t out_width;
+  int64_t kernel_height;
+  int64_t kernel_width;
+  int64_t stride_height;
+  int64_t stride_width;
+  int64_t dilation_height;
+  int64_t dilation_width;
+  int64_t padding_height;
+  int64_t padding_width;
+};
+
+// Returns false if only im2col + GEMM supports the conv, that is, it is not a channels first 1d or
+// 2d conv.
+bool MakeConvCpuParams(const std::string& data_format, const ShapeView& x_shape,
+                       const ShapeView& weight_shape, const ShapeView& y_shape,
+                       const std::vector<int32_t>& strides,
+                       const std::vector<int32_t>& dilation_rate,
+                       const std::vector<int32_t>& padding_before, ConvCpuParams* params);
+
+// The algorithm is chosen by the shapes only, so that the tmp buffer size inferred for a kernel
+// matches its compute. ONEFLOW_KERNEL_CPU_CONV_ALGO=im2col|direct|winograd overrides the choice,
+// winograd falls back to im2col for the convs it does not support.
+ConvCpuAlgo GetConvCpuAlgo(const ConvCpuParams& params);
+// Deconv supports kIm2ColGemm and kDirect.
+ConvCpuAlgo GetDeconvCpuAlgo(const ConvCpuParams& params);
+
+// Size in bytes of the workspace of the direct and winograd algorithms.
+size_t GetConvCpuWorkspaceSize(ConvCpuAlgo algo, const ConvCpuParams& params, size_t elem_size);
+
+template<typename T>
+struct ConvCpuKernelUtil {
+  // y = conv(x, weight) + bias, bias may be null.
+  static void DirectForward(ep::Stream* stream, const ConvCpuParams& params, const T* x,
+                            const T* weight, const T* bias, T* y, void* workspace);
+  static void WinogradForward(ep::Stream* stream, const ConvCpuParams& params, const T* x,
+                              const T* weight, const T* bias, T* y, void* workspace);
+  // dx = conv_data_grad(dy, weight), which is the deconv of dy.
+  static void DirectBackwardData(ep::Stream* stream, const ConvCpuParams& params, const T* dy,
+                                 const T* weight, T* dx);
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_CONV_CPU_KERNEL_UTIL_H_
@@ -18,6 +18,7 @@ limitations under the License.
 #include "oneflow/core/kernel/new_kernel_util.h"
 #include "oneflow/core/kernel/kernel_util.h"
 #include "oneflow/core/ep/include/primitive/add.h"
+#include "oneflow/user/kernels/conv_cpu_kernel_util.h"
 
 namespace oneflow {
 
@@ -369,6 +370,18 @@ std::shared_ptr<ConvOpKernelCache<T>> CreateConvOpKernelCache(user_op::KernelCac
   return cache;
 }
 
+template<typename Context>
+ConvCpuAlgo InferConvCpuAlgo(Context* ctx, const ShapeView& in_shape, const ShapeView& weight_shape,
+                             const ShapeView& out_shape, ConvCpuParams* params) {
+  if (!MakeConvCpuParams(ctx->template Attr<std::string>("data_format"), in_shape, weight_shape,
+                         out_shape, ctx->template Attr<std::vector<int32_t>>("strides"),
+                         ctx->template Attr<std::vector<int32_t>>("dilation_rate"),
+                         ctx->template Attr<std::vector<int32_t>>("padding_before"), params)) {
+    return ConvCpuAlgo::kIm2ColGemm;
+  }
+  return GetConvCpuAlgo(*params);
+}
+
 template<typename T>
 void InitBiasMulBuf(T* dptr, int64_t num) {
   for (int64_t i = 0; i < num; ++i) { dptr[i] = 1; }
@@ -397,6 +410,23 @@ class ConvCpuKernel final : public user_op::OpKernel {
     const user_op::Tensor* weight = ctx->Tensor4ArgNameAndIndex("weight", 0);
     user_op::Tensor* tmp_buffer = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
     user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
+    const user_op::Tensor* bias = ctx->Tensor4ArgNameAndIndex("bias", 0);
+
+    ConvCpuParams params{};
+    const ConvCpuAlgo algo = InferConvCpuAlgo(ctx, in->shape_view(), weight->shape_view(),
+                                              out->shape_view(), &params);
+    if (algo == ConvCpuAlgo::kDirect) {
+      ConvCpuKernelUtil<T>::DirectForward(ctx->stream(), params, in->dptr<T>(), weight->dptr<T>(),
+                                          bias == nullptr ? nullptr : bias->dptr<T>(),
+                                          out->mut_dptr<T>(), tmp_buffer->mut_dptr());
+      return;
+    } else if (algo == ConvCpuAlgo::kWinograd) {
+      ConvCpuKernelUtil<T>::WinogradForward(ctx->stream(), params, in->dptr<T>(),
+                                            weight->dptr<T>(),
+                                            bias == nullptr ? nullptr : bias->dptr<T>(),
+                                            out->mut_dptr<T>(), tmp_buffer->mut_dptr());
+      return;
+    }
 
     T* col_buf_dptr = tmp_buffer->mut_dptr<T>();
 
@@ -419,7 +449,6 @@ class ConvCpuKernel final : public user_op::OpKernel {
           static_cast<T>(1), weight->dptr<T>(), col_buf_dptr, static_cast<T>(0),
           GetImgMutDptr<T>(out, i));
 
-      const user_op::Tensor* bias = ctx->Tensor4ArgNameAndIndex("bias", 0);
       if (bias != nullptr) {
         int64_t num_of_col_buf =
             CalcElemNumOfColBuf(out->shape_view(), weight->shape_view(), idx_offset);
@@ -456,6 +485,13 @@ class ConvCpuKernel final : public user_op::OpKernel {
         size_t tmp_buffer_size = 0;                                                         \
         const auto& out_shape = ctx->OutputTensorDesc("out", 0)->shape();                   \
         const auto& weight_shape = ctx->InputTensorDesc("weight", 0).shape();               \
+        ConvCpuParams params{};                                                             \
+        const ConvCpuAlgo algo =                                                            \
+            InferConvCpuAlgo(ctx, ShapeView(ctx->InputTensorDesc("in", 0).shape()),         \
+                             ShapeView(weight_shape), ShapeView(out_shape), &params);       \
+        if (algo != ConvCpuAlgo::kIm2ColGemm) {                                             \
+          return GetConvCpuWorkspaceSize(algo, params, sizeof(dtype));                      \
+        }                                                                                   \
                                                                                             \
         int64_t idx_offset = IdxOffset(ctx->Attr<std::string>("data_format"));              \
         tmp_buffer_size +=                                                                  \
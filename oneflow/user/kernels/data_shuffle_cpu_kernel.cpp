@@ -0,0 +1,401 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/core/embedding/hash_functions.cuh"
+#include <robin_hood.h>
+
+namespace oneflow {
+
+namespace {
+
+// The ids of a unique are split into shards by hash, every shard is deduplicated by one thread
+// with its own hash table, so no table is shared between threads. Smaller inputs are deduplicated
+// by a single table.
+constexpr int64_t kMinIdsPerShard = 4096;
+
+// Table id of the i-th id, generated as i % num_tables when the ids come without table ids.
+template<typename U>
+struct TableIdGetter {
+  const U* table_ids;
+  int32_t num_tables;
+
+  U operator()(int64_t i) const {
+    return table_ids != nullptr ? table_ids[i] : static_cast<U>(i % num_tables);
+  }
+};
+
+template<typename K, typename U, typename IDX>
+void UniqueShard(int64_t num_positions, const IDX* positions, const K* ids,
+                 const TableIdGetter<U>& get_table_id, bool need_process_table_ids,
+                 K* unique_ids, U* unique_table_ids, IDX* inverse_indices, IDX* num_unique) {
+  robin_hood::unordered_flat_map<K, IDX> unique_index;
+  unique_index.reserve(num_positions);
+  IDX count = 0;
+  for (int64_t j = 0; j < num_positions; ++j) {
+    const int64_t i = positions == nullptr ? j : positions[j];
+    auto it = unique_index.emplace(ids[i], count);
+    if (it.second) {
+      unique_ids[count] = ids[i];
+      if (need_process_table_ids) { unique_table_ids[count] = get_table_id(i); }
+      count += 1;
+    }
+    inverse_indices[i] = it.first->second;
+  }
+  *num_unique = count;
+}
+
+// Deduplicates num_ids ids, unique_ids[inverse_indices[i]] == ids[i]. The unique table id of an id
+// is the table id of its first occurrence in its shard.
+template<typename K, typename U, typename IDX>
+void UniqueIds(ep::CpuStream* stream, int64_t num_ids, const K* ids,
+               const TableIdGetter<U>& get_table_id, bool need_process_table_ids, IDX* num_unique,
+               K* unique_ids, U* unique_table_ids, IDX* inverse_indices) {
+  const int64_t num_shards = std::max<int64_t>(
+      std::min<int64_t>(stream->device()->GetNumThreads(), num_ids / kMinIdsPerShard), 1);
+  if (num_shards == 1) {
+    UniqueShard<K, U, IDX>(num_ids, nullptr, ids, get_table_id, need_process_table_ids,
+                           unique_ids, unique_table_ids, inverse_indices, num_unique);
+    return;
+  }
+  // Counts the ids of every (chunk, shard), then scatters the positions of the ids to their shards
+  // in the order of the ids, chunk by chunk.
+  const int64_t chunk_size = (num_ids + num_shards - 1) / num_shards;
+  std::vector<int32_t> shard_of(num_ids);
+  std::vector<int64_t> offsets(num_shards * num_shards);
+  auto ForEachChunk = [&](const std::function<void(int64_t, int64_t, int64_t)>& f) {
+    stream->ParallelFor(
+        0, num_shards,
+        [&](int64_t begin, int64_t end) {
+          for (int64_t chunk = begin; chunk < end; ++chunk) {
+            f(chunk, std::min(chunk * chunk_size, num_ids),
+              std::min((chunk + 1) * chunk_size, num_ids));
+          }
+        },
+        1);
+  };
+  ForEachChunk([&](int64_t chunk, int64_t begin, int64_t end) {
+    int64_t* count = offsets.data() + chunk * num_shards;
+    for (int64_t i = begin; i < end; ++i) {
+      const uint64_t hash = embedding::GlobalUniqueHash()(static_cast<uint64_t>(ids[i]));
+      const int32_t shard = static_cast<int32_t>(hash % num_shards);
+      shard_of[i] = shard;
+      count[shard] += 1;
+    }
+  });
+  std::vector<int64_t> shard_begin(num_shards + 1);
+  int64_t sum = 0;
+  for (int64_t shard = 0; shard < num_shards; ++shard) {
+    shard_begin[shard] = sum;
+    for (int64_t chunk = 0; chunk < num_shards; ++chunk) {
+      const int64_t count = offsets[chunk * num_shards + shard];
+      offsets[chunk * num_shards + shard] = sum;
+      sum += count;
+    }
+  }
+  shard_begin[num_shards] = sum;
+  std::vector<IDX> positions(num_ids);
+  ForEachChunk([&](int64_t chunk, int64_t begin, int64_t end) {
+    int64_t* offset = offsets.data() + chunk * num_shards;
+    for (int64_t i = begin; i < end; ++i) { positions[offset[shard_of[i]]++] = i; }
+  });
+  // Every shard writes its unique ids from the position of its first id, then the shards are
+  // compacted and the inverse indices are moved by the number of unique ids of the shards before.
+  std::vector<IDX> shard_num_unique(num_shards);
+  stream->ParallelFor(
+      0, num_shards,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t shard = begin; shard < end; ++shard) {
+          const int64_t offset = shard_begin[shard];
+          UniqueShard<K, U, IDX>(shard_begin[shard + 1] - offset, positions.data() + offset, ids,
+                                 get_table_id, need_process_table_ids, unique_ids + offset,
+                                 unique_table_ids + offset, inverse_indices,
+                                 &shard_num_unique[shard]);
+        }
+      },
+      1);
+  std::vector<IDX> unique_offset(num_shards);
+  IDX total = 0;
+  for (int64_t shard = 0; shard < num_shards; ++shard) {
+    unique_offset[shard] = total;
+    const IDX count = shard_num_unique[shard];
+    const int64_t src = shard_begin[shard];
+    if (src != total) {
+      std::copy(unique_ids + src, unique_ids + src + count, unique_ids + total);
+      if (need_process_table_ids) {
+        std::copy(unique_table_ids + src, unique_table_ids + src + count, unique_table_ids + total);
+      }
+    }
+    total += count;
+  }
+  ForEachChunk([&](int64_t chunk, int64_t begin, int64_t end) {
+    for (int64_t i = begin; i < end; ++i) { inverse_indices[i] += unique_offset[shard_of[i]]; }
+  });
+  *num_unique = total;
+}
+
+template<typename K, typename V, typename IDX>
+class UniqueKeyValuePairCpuKernel final : public user_op::OpKernel {
+ public:
+  UniqueKeyValuePairCpuKernel() = default;
+  ~UniqueKeyValuePairCpuKernel() override = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* keys = ctx->Tensor4ArgNameAndIndex("keys", 0);
+    user_op::Tensor* num_unique = ctx->Tensor4ArgNameAndIndex("num_unique", 0);
+    user_op::Tensor* unique_keys = ctx->Tensor4ArgNameAndIndex("unique_keys", 0);
+    user_op::Tensor* unique_values = ctx->Tensor4ArgNameAndIndex("unique_values", 0);
+    user_op::Tensor* inverse_indices = ctx->Tensor4ArgNameAndIndex("inverse_indices", 0);
+    const int32_t num_tables = ctx->Attr<int32_t>("num_tables");
+    const bool has_values = ctx->has_input("values", 0);
+    const bool need_process_table_ids = (has_values || num_tables > 1);
+    TableIdGetter<V> get_table_id{nullptr, num_tables};
+    if (has_values) {
+      get_table_id.table_ids = ctx->Tensor4ArgNameAndIndex("values", 0)->dptr<V>();
+    }
+    UniqueIds<K, V, IDX>(ctx->stream()->As<ep::CpuStream>(), keys->shape_view().elem_cnt(),
+                         keys->dptr<K>(), get_table_id, need_process_table_ids,
+                         num_unique->mut_dptr<IDX>(), unique_keys->mut_dptr<K>(),
+                         unique_values->mut_dptr<V>(), inverse_indices->mut_dptr<IDX>());
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+// The CPU shuffles serve a single rank, which owns all of its unique ids, so the exchange of ids
+// and embeddings between ranks of the CUDA kernels reduces to a unique and gathers.
+template<typename K, typename U, typename IDX>
+class IdShuffleCpuKernel final : public user_op::OpKernel {
+ public:
+  IdShuffleCpuKernel() = default;
+  ~IdShuffleCpuKernel() override = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    CHECK_EQ(ctx->parallel_ctx().parallel_num(), 1) << "id_shuffle on CPU supports one rank only";
+    const user_op::Tensor* ids = ctx->Tensor4ArgNameAndIndex("ids", 0);
+    user_op::Tensor* num_unique_matrix = ctx->Tensor4ArgNameAndIndex("num_unique_matrix", 0);
+    user_op::Tensor* inverse_unique_partition_indices =
+        ctx->Tensor4ArgNameAndIndex("inverse_unique_partition_indices", 0);
+    user_op::Tensor* cur_rank_num_unique = ctx->Tensor4ArgNameAndIndex("cur_rank_num_unique", 0);
+    user_op::Tensor* cur_rank_unique_ids = ctx->Tensor4ArgNameAndIndex("cur_rank_unique_ids", 0);
+    user_op::Tensor* cur_rank_unique_table_ids =
+        ctx->Tensor4ArgNameAndIndex("cur_rank_unique_table_ids", 0);
+    user_op::Tensor* cur_rank_inverse_indices =
+        ctx->Tensor4ArgNameAndIndex("cur_rank_inverse_indices", 0);
+    const int32_t num_tables = ctx->Attr<int32_t>("num_tables");
+    const bool has_table_ids = ctx->has_input("table_ids", 0);
+    const bool need_process_table_ids = (has_table_ids || num_tables > 1);
+    const int64_t num_ids = ids->shape_view().elem_cnt();
+    TableIdGetter<U> get_table_id{nullptr, num_tables};
+    if (has_table_ids) {
+      get_table_id.table_ids = ctx->Tensor4ArgNameAndIndex("table_ids", 0)->dptr<U>();
+    }
+    ep::CpuStream* stream = ctx->stream()->As<ep::CpuStream>();
+    IDX* num_unique = cur_rank_num_unique->mut_dptr<IDX>();
+    U* unique_table_ids = cur_rank_unique_table_ids->mut_dptr<U>();
+    UniqueIds<K, U, IDX>(stream, num_ids, ids->dptr<K>(), get_table_id, need_process_table_ids,
+                         num_unique, cur_rank_unique_ids->mut_dptr<K>(), unique_table_ids,
+                         inverse_unique_partition_indices->mut_dptr<IDX>());
+    *num_unique_matrix->mut_dptr<IDX>() = *num_unique;
+    if (!need_process_table_ids) { std::fill(unique_table_ids, unique_table_ids + num_ids, 0); }
+    IDX* cur_rank_inverse_indices_ptr = cur_rank_inverse_indices->mut_dptr<IDX>();
+    for (IDX i = 0; i < *num_unique; ++i) { cur_rank_inverse_indices_ptr[i] = i; }
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+template<typename T, typename IDX>
+class EmbeddingShuffleCpuKernel final : public user_op::OpKernel {
+ public:
+  EmbeddingShuffleCpuKernel() = default;
+  ~EmbeddingShuffleCpuKernel() override = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    CHECK_EQ(ctx->parallel_ctx().parallel_num(), 1)
+        << "embedding_shuffle on CPU supports one rank only";
+    const user_op::Tensor* cur_rank_embeddings =
+        ctx->Tensor4ArgNameAndIndex("cur_rank_embeddings", 0);
+    const user_op::Tensor* cur_rank_inverse_indices =
+        ctx->Tensor4ArgNameAndIndex("cur_rank_inverse_indices", 0);
+    const user_op::Tensor* inverse_unique_partition_indices =
+        ctx->Tensor4ArgNameAndIndex("inverse_unique_partition_indices", 0);
+    user_op::Tensor* embeddings = ctx->Tensor4ArgNameAndIndex("embeddings", 0);
+    const int64_t embedding_size = cur_rank_embeddings->shape_view().At(1);
+    const int64_t num_ids = inverse_unique_partition_indices->shape_view().elem_cnt();
+    CHECK_EQ(num_ids * embedding_size, cur_rank_embeddings->shape_view().elem_cnt());
+    const T* cur_rank_embeddings_ptr = cur_rank_embeddings->dptr<T>();
+    const IDX* cur_rank_inverse_indices_ptr = cur_rank_inverse_indices->dptr<IDX>();
+    const IDX* inverse_indices_ptr = inverse_unique_partition_indices->dptr<IDX>();
+    T* embeddings_ptr = embeddings->mut_dptr<T>();
+    ctx->stream()->As<ep::CpuStream>()->ParallelFor(
+        0, num_ids,
+        [&](int64_t begin, int64_t end) {
+          for (int64_t i = begin; i < end; ++i) {
+            const T* src = cur_rank_embeddings_ptr
+                           + cur_rank_inverse_indices_ptr[inverse_indices_ptr[i]] * embedding_size;
+            std::copy(src, src + embedding_size, embeddings_ptr + i * embedding_size);
+          }
+        },
+        ep::GetParallelForGrainSize(embedding_size * ep::parallel_for_cost::kIndexed));
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+template<typename T, typename IDX>
+class EmbeddingGradientShuffleCpuKernel final : public user_op::OpKernel {
+ public:
+  EmbeddingGradientShuffleCpuKernel() = default;
+  ~EmbeddingGradientShuffleCpuKernel() override = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    CHECK_EQ(ctx->parallel_ctx().parallel_num(), 1)
+        << "embedding_gradient_shuffle on CPU supports one rank only";
+    const user_op::Tensor* embedding_grad = ctx->Tensor4ArgNameAndIndex("embedding_grad", 0);
+    const user_op::Tensor* num_unique_matrix = ctx->Tensor4ArgNameAndIndex("num_unique_matrix", 0);
+    const user_op::Tensor* cur_rank_inverse_indices =
+        ctx->Tensor4ArgNameAndIndex("cur_rank_inverse_indices", 0);
+    const user_op::Tensor* inverse_unique_partition_indices =
+        ctx->Tensor4ArgNameAndIndex("inverse_unique_partition_indices", 0);
+    user_op::Tensor* cur_rank_unique_embedding_grad =
+        ctx->Tensor4ArgNameAndIndex("cur_rank_unique_embedding_grad", 0);
+    const int64_t embedding_size = cur_rank_unique_embedding_grad->shape_view().At(1);
+    const int64_t num_ids = inverse_unique_partition_indices->shape_view().elem_cnt();
+    const int64_t num_unique = *num_unique_matrix->dptr<IDX>();
+    const IDX* cur_rank_inverse_indices_ptr = cur_rank_inverse_indices->dptr<IDX>();
+    const IDX* inverse_indices_ptr = inverse_unique_partition_indices->dptr<IDX>();
+    // Groups the ids by their unique id in the order of the ids, so every unique row is summed by
+    // one thread in a fixed order and the result does not depend on the number of threads.
+    std::vector<int64_t> row_begin(num_unique + 1, 0);
+    std::vector<IDX> row_of(num_ids);
+    for (int64_t i = 0; i < num_ids; ++i) {
+      row_of[i] = cur_rank_inverse_indices_ptr[inverse_indices_ptr[i]];
+      row_begin[row_of[i] + 1] += 1;
+    }
+    for (int64_t row = 0; row < num_unique; ++row) { row_begin[row + 1] += row_begin[row]; }
+    std::vector<int64_t> ids_of_row(num_ids);
+    {
+      std::vector<int64_t> offset(row_begin.begin(), row_begin.end() - 1);
+      for (int64_t i = 0; i < num_ids; ++i) { ids_of_row[offset[row_of[i]]++] = i; }
+    }
+    // float16 gradients are summed in float.
+    using ComputeType = typename std::conditional<std::is_same<T, float16>::value, float, T>::type;
+    const T* grad_ptr = embedding_grad->dptr<T>();
+    T* out_ptr = cur_rank_unique_embedding_grad->mut_dptr<T>();
+    ctx->stream()->As<ep::CpuStream>()->ParallelFor(
+        0, num_unique,
+        [&](int64_t begin, int64_t end) {
+          std::vector<ComputeType> sum(embedding_size);
+          for (int64_t row = begin; row < end; ++row) {
+            std::fill(sum.begin(), sum.end(), static_cast<ComputeType>(0));
+            for (int64_t j = row_begin[row]; j < row_begin[row + 1]; ++j) {
+              const T* grad = grad_ptr + ids_of_row[j] * embedding_size;
+              for (int64_t col = 0; col < embedding_size; ++col) {
+                sum[col] += static_cast<ComputeType>(grad[col]);
+              }
+            }
+            T* out = out_ptr + row * embedding_size;
+            for (int64_t col = 0; col < embedding_size; ++col) {
+              out[col] = static_cast<T>(sum[col]);
+            }
+          }
+        },
+        ep::GetParallelForGrainSize(std::max<int64_t>(num_ids / std::max<int64_t>(num_unique, 1), 1)
+                                    * embedding_size * ep::parallel_for_cost::kElementwise));
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+}  // namespace
+
+#define ID_DATA_TYPE_SEQ                            \
+  OF_PP_MAKE_TUPLE_SEQ(uint32_t, DataType::kUInt32) \
+  OF_PP_MAKE_TUPLE_SEQ(uint64_t, DataType::kUInt64) \
+  OF_PP_MAKE_TUPLE_SEQ(int32_t, DataType::kInt32)   \
+  OF_PP_MAKE_TUPLE_SEQ(int64_t, DataType::kInt64)
+
+#define TABLE_ID_DATA_TYPE_SEQ                      \
+  OF_PP_MAKE_TUPLE_SEQ(uint8_t, DataType::kUInt8)   \
+  OF_PP_MAKE_TUPLE_SEQ(uint32_t, DataType::kUInt32) \
+  OF_PP_MAKE_TUPLE_SEQ(uint64_t, DataType::kUInt64) \
+  OF_PP_MAKE_TUPLE_SEQ(int8_t, DataType::kInt8)     \
+  OF_PP_MAKE_TUPLE_SEQ(int32_t, DataType::kInt32)   \
+  OF_PP_MAKE_TUPLE_SEQ(int64_t, DataType::kInt64)
+
+#define IDX_DATA_TYPE_SEQ                           \
+  OF_PP_MAKE_TUPLE_SEQ(uint32_t, DataType::kUInt32) \
+  OF_PP_MAKE_TUPLE_SEQ(int32_t, DataType::kInt32)
+
+#define REGISTER_CPU_ID_SHUFFLE_KERNEL(k_dtype_pair, table_id_dtype_pair, idx_dtype_pair)         \
+  REGISTER_USER_KERNEL("id_shuffle")                                                              \
+      .SetCreateFn<IdShuffleCpuKernel<OF_PP_PAIR_FIRST(k_dtype_pair),                             \
+                                      OF_PP_PAIR_FIRST(table_id_dtype_pair),                      \
+                                      OF_PP_PAIR_FIRST(idx_dtype_pair)>>()                        \
+      .SetIsMatchedHob(                                                                           \
+          (user_op::HobDeviceType() == DeviceType::kCPU)                                          \
+          && (user_op::HobDataType("ids", 0) == OF_PP_PAIR_SECOND(k_dtype_pair))                  \
+          && (user_op::HobDataType("cur_rank_unique_table_ids", 0)                                \
+              == OF_PP_PAIR_SECOND(table_id_dtype_pair))                                          \
+          && (user_op::HobDataType("num_unique_matrix", 0) == OF_PP_PAIR_SECOND(idx_dtype_pair)));
+
+OF_PP_SEQ_PRODUCT_FOR_EACH_TUPLE(REGISTER_CPU_ID_SHUFFLE_KERNEL, ID_DATA_TYPE_SEQ,
+                                 TABLE_ID_DATA_TYPE_SEQ, IDX_DATA_TYPE_SEQ)
+
+#define REGISTER_CPU_EMBEDDING_SHUFFLE_KERNEL(t_dtype_pair, idx_dtype_pair)                       \
+  REGISTER_USER_KERNEL("embedding_shuffle")                                                       \
+      .SetCreateFn<EmbeddingShuffleCpuKernel<OF_PP_PAIR_FIRST(t_dtype_pair),                      \
+                                             OF_PP_PAIR_FIRST(idx_dtype_pair)>>()                 \
+      .SetIsMatchedHob(                                                                           \
+          (user_op::HobDeviceType() == DeviceType::kCPU)                                          \
+          && (user_op::HobDataType("cur_rank_embeddings", 0) == OF_PP_PAIR_SECOND(t_dtype_pair))  \
+          && (user_op::HobDataType("num_unique_matrix", 0) == OF_PP_PAIR_SECOND(idx_dtype_pair)));
+
+OF_PP_SEQ_PRODUCT_FOR_EACH_TUPLE(REGISTER_CPU_EMBEDDING_SHUFFLE_KERNEL,
+                                 FLOATING_DATA_TYPE_SEQ FLOAT16_DATA_TYPE_SEQ, IDX_DATA_TYPE_SEQ)
+
+#define REGISTER_CPU_EMBEDDING_GRADIENT_SHUFFLE_KERNEL(t_dtype_pair, idx_dtype_pair)              \
+  REGISTER_USER_KERNEL("embedding_gradient_shuffle")                                              \
+      .SetCreateFn<EmbeddingGradientShuffleCpuKernel<OF_PP_PAIR_FIRST(t_dtype_pair),              \
+                                                     OF_PP_PAIR_FIRST(idx_dtype_pair)>>()         \
+      .SetIsMatchedHob(                                                                           \
+          (user_op::HobDeviceType() == DeviceType::kCPU)                                          \
+          && (user_op::HobDataType("embedding_grad", 0) == OF_PP_PAIR_SECOND(t_dtype_pair))       \
+          && (user_op::HobDataType("num_unique_matrix", 0) == OF_PP_PAIR_SECOND(idx_dtype_pair)));
+
+OF_PP_SEQ_PRODUCT_FOR_EACH_TUPLE(REGISTER_CPU_EMBEDDING_GRADIENT_SHUFFLE_KERNEL,
+                                 FLOATING_DATA_TYPE_SEQ FLOAT16_DATA_TYPE_SEQ, IDX_DATA_TYPE_SEQ)
+
+#define REGISTER_CPU_UNIQUE_KEY_VALUE_PAIR_KERNEL(k_dtype_pair, value_dtype_pair, idx_dtype_pair) \
+  REGISTER_USER_KERNEL("unique_key_value_pair")                                                   \
+      .SetCreateFn<UniqueKeyValuePairCpuKernel<OF_PP_PAIR_FIRST(k_dtype_pair),                    \
+                                               OF_PP_PAIR_FIRST(value_dtype_pair),                \
+                                               OF_PP_PAIR_FIRST(idx_dtype_pair)>>()               \
+      .SetIsMatchedHob(                                                                           \
+          (user_op::HobDeviceType() == DeviceType::kCPU)                                          \
+          && (user_op::HobDataType("keys", 0) == OF_PP_PAIR_SECOND(k_dtype_pair))                 \
+          && (user_op::HobDataType("inverse_indices", 0) == OF_PP_PAIR_SECOND(idx_dtype_pair))    \
+          && (user_op::HobDataType("unique_values", 0) == OF_PP_PAIR_SECOND(value_dtype_pair)));
+
+OF_PP_SEQ_PRODUCT_FOR_EACH_TUPLE(REGISTER_CPU_UNIQUE_KEY_VALUE_PAIR_KERNEL, ID_DATA_TYPE_SEQ,
+                                 ID_DATA_TYPE_SEQ, IDX_DATA_TYPE_SEQ)
+
+}  // namespace oneflow
@@ -18,6 +18,7 @@ limitations under the License.
 #include "oneflow/user/ops/nn_util.h"
 #include "oneflow/core/kernel/new_kernel_util.h"
 #include "oneflow/core/kernel/kernel_util.h"
+#include "oneflow/user/kernels/conv_cpu_kernel_util.h"
 
 namespace oneflow {
 
@@ -317,6 +318,20 @@ std::shared_ptr<DeconvOpKernelCache<T>> CreateDeconvOpKernelCache(user_op::Kerne
   return cache;
 }
 
+// The deconv of in to out is the data grad of the conv of out to in.
+template<typename Context>
+ConvCpuAlgo InferDeconvCpuAlgo(Context* ctx, const ShapeView& in_shape,
+                               const ShapeView& weight_shape, const ShapeView& out_shape,
+                               ConvCpuParams* params) {
+  if (!MakeConvCpuParams(ctx->template Attr<std::string>("data_format"), out_shape, weight_shape,
+                         in_shape, ctx->template Attr<std::vector<int32_t>>("strides"),
+                         ctx->template Attr<std::vector<int32_t>>("dilation_rate"),
+                         ctx->template Attr<std::vector<int32_t>>("padding_before"), params)) {
+    return ConvCpuAlgo::kIm2ColGemm;
+  }
+  return GetDeconvCpuAlgo(*params);
+}
+
 template<typename T>
 class DeconvCpuKernel final : public user_op::OpKernel {
  public:
@@ -348,6 +363,14 @@ class DeconvCpuKernel final : public user_op::OpKernel {
     user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
     user_op::Tensor* col_buf = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
 
+    ConvCpuParams params{};
+    if (InferDeconvCpuAlgo(ctx, in->shape_view(), weight->shape_view(), out->shape_view(), &params)
+        == ConvCpuAlgo::kDirect) {
+      ConvCpuKernelUtil<T>::DirectBackwardData(ctx->stream(), params, in->dptr<T>(),
+                                               weight->dptr<T>(), out->mut_dptr<T>());
+      return;
+    }
+
     Memset<DeviceType::kCPU>(ctx->stream(), out->mut_dptr<T>(), 0,
                              out->shape_view().elem_cnt() * sizeof(T));
 
@@ -383,6 +406,13 @@ class DeconvCpuKernel final : public user_op::OpKernel {
         size_t tmp_buffer_size = 0;                                                      \
         const auto& in_shape = ctx->InputTensorDesc("in", 0).shape();                    \
         const auto& weight_shape = ctx->InputTensorDesc("weight", 0).shape();            \
+        ConvCpuParams params{};                                                          \
+        if (InferDeconvCpuAlgo(ctx, ShapeView(in_shape), ShapeView(weight_shape),        \
+                               ShapeView(ctx->OutputTensorDesc("out", 0)->shape()),      \
+                               &params)                                                  \
+            == ConvCpuAlgo::kDirect) {                                                   \
+          return 0;                                                                      \
+        }                                                                                \
                                                                                          \
         int64_t idx_offset = IdxOffset(ctx->Attr<std::string>("data_format"));           \
         tmp_buffer_size +=                                                               \
@@ -0,0 +1,380 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/ep/include/primitive/matmul.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/core/ep/cpu/cpu_device.h"
+#include "oneflow/user/kernels/simd_pack.h"
+
+namespace oneflow {
+
+namespace {
+
+std::unique_ptr<ep::primitive::Matmul> NewMatmulPrimitive(DataType data_type, bool transpose_a,
+                                                          bool transpose_b) {
+  const auto trans_a =
+      transpose_a ? ep::primitive::BlasTransposeType::T : ep::primitive::BlasTransposeType::N;
+  const auto trans_b =
+      transpose_b ? ep::primitive::BlasTransposeType::T : ep::primitive::BlasTransposeType::N;
+  return ep::primitive::NewPrimitive<ep::primitive::MatmulFactory>(DeviceType::kCPU, data_type,
+                                                                   trans_a, trans_b);
+}
+
+auto MatmulPrimitiveExists() {
+  return hob::make_custom("MatmulPrimitiveExists", [](const user_op::KernelRegContext& ctx) {
+    const DataType data_type = ctx.TensorDesc4ArgNameAndIndex("x", 0)->data_type();
+    // x * weight^T in the forward, dmatmul_result0 * weight and dmatmul_result0^T * x in the v2
+    // backward.
+    return NewMatmulPrimitive(data_type, /*transpose_a=*/false, /*transpose_b=*/true) != nullptr
+           && NewMatmulPrimitive(data_type, /*transpose_a=*/false, /*transpose_b=*/false) != nullptr
+           && NewMatmulPrimitive(data_type, /*transpose_a=*/true, /*transpose_b=*/false) != nullptr;
+  });
+}
+
+// Column sums of a rows x cols matrix. Columns are split among threads, so no reduction across
+// threads is needed.
+template<typename T>
+void ColumnSum(ep::CpuStream* stream, int64_t rows, int64_t cols, const T* in, T* out) {
+  using P = SimdPack<T>;
+  const size_t grain_size = RoundUp(ep::GetParallelForGrainSize(rows), P::kSize);
+  stream->ParallelFor(
+      0, cols,
+      [&](int64_t begin, int64_t end) {
+        std::fill(out + begin, out + end, static_cast<T>(0));
+        for (int64_t row = 0; row < rows; ++row) {
+          const T* in_row = in + row * cols;
+          int64_t col = begin;
+          for (; col + P::kSize <= end; col += P::kSize) {
+            (P::Load(out + col) + P::Load(in_row + col)).Store(out + col);
+          }
+          for (; col < end; ++col) { out[col] += in_row[col]; }
+        }
+      },
+      grain_size);
+}
+
+// Vector mode, the weight is a single row, so x * weight^T is a dot product per row and is fused
+// with the rest: out = x0 * matmul_result + bias + x.
+template<typename T>
+void CrossInteractionVector(ep::CpuStream* stream, int64_t batch_size, int64_t hidden_size,
+                            const T* x, const T* weight, const T* x0, const T* bias,
+                            T* matmul_result, T* out) {
+  using P = SimdPack<T>;
+  const size_t grain_size = ep::GetParallelForGrainSize(hidden_size);
+  stream->ParallelFor(
+      0, batch_size,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t row = begin; row < end; ++row) {
+          const int64_t offset = row * hidden_size;
+          const T scale = SimdDot<T>(x + offset, weight, hidden_size);
+          matmul_result[row] = scale;
+          const P pack_scale = P::Broadcast(scale);
+          int64_t col = 0;
+          for (; col + P::kSize <= hidden_size; col += P::kSize) {
+            P::Fma(P::Load(x0 + offset + col), pack_scale,
+                   P::Load(bias + col) + P::Load(x + offset + col))
+                .Store(out + offset + col);
+          }
+          for (; col < hidden_size; ++col) {
+            out[offset + col] = x0[offset + col] * scale + bias[col] + x[offset + col];
+          }
+        }
+      },
+      grain_size);
+}
+
+// Matrix mode, out = (matmul_result + bias) * x0 + x.
+template<typename T>
+void CrossInteractionMatrixEpilogue(ep::CpuStream* stream, int64_t batch_size,
+                                    int64_t hidden_size, const T* matmul_result, const T* x,
+                                    const T* x0, const T* bias, T* out) {
+  using P = SimdPack<T>;
+  const size_t grain_size = ep::GetParallelForGrainSize(hidden_size);
+  stream->ParallelFor(
+      0, batch_size,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t row = begin; row < end; ++row) {
+          const int64_t offset = row * hidden_size;
+          int64_t col = 0;
+          for (; col + P::kSize <= hidden_size; col += P::kSize) {
+            P::Fma(P::Load(matmul_result + offset + col) + P::Load(bias + col),
+                   P::Load(x0 + offset + col), P::Load(x + offset + col))
+                .Store(out + offset + col);
+          }
+          for (; col < hidden_size; ++col) {
+            out[offset + col] =
+                (matmul_result[offset + col] + bias[col]) * x0[offset + col] + x[offset + col];
+          }
+        }
+      },
+      grain_size);
+}
+
+// v1 backward, per row: dmatmul_result0 = sum(dy * x0), dx = dmatmul_result0 * weight + dy and
+// dx0 = dy * matmul_result.
+template<typename T>
+void CrossInteractionV1GradRows(ep::CpuStream* stream, int64_t batch_size, int64_t hidden_size,
+                                const T* dy, const T* weight, const T* x0, const T* matmul_result,
+                                T* dmatmul_result0, T* dx, T* dx0) {
+  using P = SimdPack<T>;
+  const size_t grain_size = ep::GetParallelForGrainSize(hidden_size);
+  stream->ParallelFor(
+      0, batch_size,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t row = begin; row < end; ++row) {
+          const int64_t offset = row * hidden_size;
+          const T dscale = SimdDot<T>(dy + offset, x0 + offset, hidden_size);
+          dmatmul_result0[row] = dscale;
+          const P pack_dscale = P::Broadcast(dscale);
+          const P pack_scale = P::Broadcast(matmul_result[row]);
+          int64_t col = 0;
+          for (; col + P::kSize <= hidden_size; col += P::kSize) {
+            const P pack_dy = P::Load(dy + offset + col);
+            P::Fma(pack_dscale, P::Load(weight + col), pack_dy).Store(dx + offset + col);
+            (pack_dy * pack_scale).Store(dx0 + offset + col);
+          }
+          for (; col < hidden_size; ++col) {
+            dx[offset + col] = dscale * weight[col] + dy[offset + col];
+            dx0[offset + col] = dy[offset + col] * matmul_result[row];
+          }
+        }
+      },
+      grain_size);
+}
+
+// v1 backward, per column: dw = dmatmul_result0^T * x and dbias = sum(dy) over the batch.
+template<typename T>
+void CrossInteractionV1ParamGrad(ep::CpuStream* stream, int64_t batch_size, int64_t hidden_size,
+                                 const T* dy, const T* x, const T* dmatmul_result0, T* dw,
+                                 T* dbias) {
+  using P = SimdPack<T>;
+  const size_t grain_size = RoundUp(ep::GetParallelForGrainSize(batch_size), P::kSize);
+  stream->ParallelFor(
+      0, hidden_size,
+      [&](int64_t begin, int64_t end) {
+        std::fill(dw + begin, dw + end, static_cast<T>(0));
+        std::fill(dbias + begin, dbias + end, static_cast<T>(0));
+        for (int64_t row = 0; row < batch_size; ++row) {
+          const int64_t offset = row * hidden_size;
+          const P pack_dscale = P::Broadcast(dmatmul_result0[row]);
+          int64_t col = begin;
+          for (; col + P::kSize <= end; col += P::kSize) {
+            P::Fma(pack_dscale, P::Load(x + offset + col), P::Load(dw + col)).Store(dw + col);
+            (P::Load(dbias + col) + P::Load(dy + offset + col)).Store(dbias + col);
+          }
+          for (; col < end; ++col) {
+            dw[col] += dmatmul_result0[row] * x[offset + col];
+            dbias[col] += dy[offset + col];
+          }
+        }
+      },
+      grain_size);
+}
+
+// v2 backward, per row: dx0 = (matmul_result + bias) * dy, dmatmul_result0 = dy * x0, and dx is
+// initialized with dy, the matmul adds dmatmul_result0 * weight to it.
+template<typename T>
+void CrossInteractionV2GradRows(ep::CpuStream* stream, int64_t batch_size, int64_t hidden_size,
+                                const T* dy, const T* bias, const T* x0, const T* matmul_result,
+                                T* dmatmul_result0, T* dx, T* dx0) {
+  using P = SimdPack<T>;
+  const size_t grain_size = ep::GetParallelForGrainSize(hidden_size);
+  stream->ParallelFor(
+      0, batch_size,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t row = begin; row < end; ++row) {
+          const int64_t offset = row * hidden_size;
+          int64_t col = 0;
+          for (; col + P::kSize <= hidden_size; col += P::kSize) {
+            const P pack_dy = P::Load(dy + offset + col);
+            ((P::Load(matmul_result + offset + col) + P::Load(bias + col)) * pack_dy)
+                .Store(dx0 + offset + col);
+            (pack_dy * P::Load(x0 + offset + col)).Store(dmatmul_result0 + offset + col);
+            pack_dy.Store(dx + offset + col);
+          }
+          for (; col < hidden_size; ++col) {
+            const T dy_val = dy[offset + col];
+            dx0[offset + col] = (matmul_result[offset + col] + bias[col]) * dy_val;
+            dmatmul_result0[offset + col] = dy_val * x0[offset + col];
+            dx[offset + col] = dy_val;
+          }
+        }
+      },
+      grain_size);
+}
+
+}  // namespace
+
+template<typename T>
+class FusedCrossFeatureInteractionCpuKernel final : public user_op::OpKernel {
+ public:
+  FusedCrossFeatureInteractionCpuKernel() = default;
+  ~FusedCrossFeatureInteractionCpuKernel() override = default;
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    const user_op::Tensor* weight = ctx->Tensor4ArgNameAndIndex("weight", 0);
+    const user_op::Tensor* x0 = ctx->Tensor4ArgNameAndIndex("x0", 0);
+    const user_op::Tensor* bias = ctx->Tensor4ArgNameAndIndex("bias", 0);
+    user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
+    user_op::Tensor* matmul_result = ctx->Tensor4ArgNameAndIndex("matmul_result", 0);
+    CHECK_EQ(out->shape_view().NumAxes(), 2);
+    const int64_t batch_size = out->shape_view().At(0);
+    const int64_t hidden_size = out->shape_view().At(1);
+    const int64_t in_size = x->shape_view().At(1);
+    const int64_t out_size = weight->shape_view().At(0);
+    ep::CpuStream* stream = ctx->stream()->As<ep::CpuStream>();
+    if (ctx->Attr<std::string>("interaction_mode") == "vector") {
+      CHECK_EQ(out_size, 1);
+      CHECK_EQ(in_size, hidden_size);
+      CrossInteractionVector<T>(stream, batch_size, hidden_size, x->dptr<T>(), weight->dptr<T>(),
+                                x0->dptr<T>(), bias->dptr<T>(), matmul_result->mut_dptr<T>(),
+                                out->mut_dptr<T>());
+    } else {
+      CHECK_EQ(out_size, hidden_size);
+      auto matmul = NewMatmulPrimitive(x->data_type(), /*transpose_a=*/false,
+                                       /*transpose_b=*/true);
+      CHECK(matmul);
+      matmul->Launch(stream, batch_size, out_size, in_size, 1.0, x->dptr(), weight->dptr(), 0.0,
+                     matmul_result->mut_dptr());
+      CrossInteractionMatrixEpilogue<T>(stream, batch_size, hidden_size, matmul_result->dptr<T>(),
+                                        x->dptr<T>(), x0->dptr<T>(), bias->dptr<T>(),
+                                        out->mut_dptr<T>());
+    }
+  }
+};
+
+#define REGISTER_FUSED_CROSS_FEATURE_INTERACTION_CPU_KERNEL(dtype)                    \
+  REGISTER_USER_KERNEL("fused_cross_feature_interaction")                             \
+      .SetCreateFn<FusedCrossFeatureInteractionCpuKernel<dtype>>()                    \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                 \
+                       && (user_op::HobDataType("x", 0) == GetDataType<dtype>::value) \
+                       && MatmulPrimitiveExists());
+
+REGISTER_FUSED_CROSS_FEATURE_INTERACTION_CPU_KERNEL(float)
+REGISTER_FUSED_CROSS_FEATURE_INTERACTION_CPU_KERNEL(double)
+
+template<typename T>
+class FusedCrossFeatureInteractionV1GradCpuKernel final : public user_op::OpKernel {
+ public:
+  FusedCrossFeatureInteractionV1GradCpuKernel() = default;
+  ~FusedCrossFeatureInteractionV1GradCpuKernel() override = default;
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* dy = ctx->Tensor4ArgNameAndIndex("dy", 0);
+    const user_op::Tensor* weight = ctx->Tensor4ArgNameAndIndex("weight", 0);
+    const user_op::Tensor* x0 = ctx->Tensor4ArgNameAndIndex("x0", 0);
+    const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    const user_op::Tensor* matmul_result = ctx->Tensor4ArgNameAndIndex("matmul_result", 0);
+    user_op::Tensor* dx0 = ctx->Tensor4ArgNameAndIndex("dx0", 0);
+    user_op::Tensor* dw = ctx->Tensor4ArgNameAndIndex("dw", 0);
+    user_op::Tensor* dx = ctx->Tensor4ArgNameAndIndex("dx", 0);
+    user_op::Tensor* dbias = ctx->Tensor4ArgNameAndIndex("dbias", 0);
+    user_op::Tensor* tmp_buffer = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
+    const int64_t batch_size = dy->shape_view().At(0);
+    const int64_t hidden_size = dy->shape_view().At(1);
+    CHECK_EQ(weight->shape_view().elem_cnt(), hidden_size);
+    CHECK_GE(tmp_buffer->shape_view().elem_cnt(), batch_size * sizeof(T));
+    T* dmatmul_result0 = tmp_buffer->mut_dptr<T>();
+    ep::CpuStream* stream = ctx->stream()->As<ep::CpuStream>();
+    CrossInteractionV1GradRows<T>(stream, batch_size, hidden_size, dy->dptr<T>(),
+                                  weight->dptr<T>(), x0->dptr<T>(), matmul_result->dptr<T>(),
+                                  dmatmul_result0, dx->mut_dptr<T>(), dx0->mut_dptr<T>());
+    CrossInteractionV1ParamGrad<T>(stream, batch_size, hidden_size, dy->dptr<T>(), x->dptr<T>(),
+                                   dmatmul_result0, dw->mut_dptr<T>(), dbias->mut_dptr<T>());
+  }
+};
+
+#define REGISTER_FUSED_CROSS_FEATURE_INTERACTION_V1_GRAD_CPU_KERNEL(dtype)              \
+  REGISTER_USER_KERNEL("fused_cross_feature_interaction_v1_grad")                       \
+      .SetCreateFn<FusedCrossFeatureInteractionV1GradCpuKernel<dtype>>()                \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                   \
+                       && (user_op::HobDataType("dy", 0) == GetDataType<dtype>::value)) \
+      .SetInferTmpSizeFn([](user_op::InferContext* ctx) {                               \
+        return ctx->InputShape("dy", 0).At(0) * sizeof(dtype);                          \
+      });
+
+REGISTER_FUSED_CROSS_FEATURE_INTERACTION_V1_GRAD_CPU_KERNEL(float)
+REGISTER_FUSED_CROSS_FEATURE_INTERACTION_V1_GRAD_CPU_KERNEL(double)
+
+template<typename T>
+class FusedCrossFeatureInteractionV2GradCpuKernel final : public user_op::OpKernel {
+ public:
+  FusedCrossFeatureInteractionV2GradCpuKernel() = default;
+  ~FusedCrossFeatureInteractionV2GradCpuKernel() override = default;
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* dy = ctx->Tensor4ArgNameAndIndex("dy", 0);
+    const user_op::Tensor* weight = ctx->Tensor4ArgNameAndIndex("weight", 0);
+    const user_op::Tensor* bias = ctx->Tensor4ArgNameAndIndex("bias", 0);
+    const user_op::Tensor* x0 = ctx->Tensor4ArgNameAndIndex("x0", 0);
+    const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    const user_op::Tensor* matmul_result = ctx->Tensor4ArgNameAndIndex("matmul_result", 0);
+    user_op::Tensor* dx0 = ctx->Tensor4ArgNameAndIndex("dx0", 0);
+    user_op::Tensor* dw = ctx->Tensor4ArgNameAndIndex("dw", 0);
+    user_op::Tensor* dx = ctx->Tensor4ArgNameAndIndex("dx", 0);
+    user_op::Tensor* dbias = ctx->Tensor4ArgNameAndIndex("dbias", 0);
+    user_op::Tensor* tmp_buffer = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
+    const int64_t batch_size = dy->shape_view().At(0);
+    const int64_t hidden_size = dy->shape_view().At(1);
+    const int64_t in_size = weight->shape_view().At(1);
+    CHECK_EQ(weight->shape_view().At(0), hidden_size);
+    CHECK_EQ(in_size, hidden_size);
+    CHECK_GE(tmp_buffer->shape_view().elem_cnt(), dy->shape_view().elem_cnt() * sizeof(T));
+    T* dmatmul_result0 = tmp_buffer->mut_dptr<T>();
+    ep::CpuStream* stream = ctx->stream()->As<ep::CpuStream>();
+    CrossInteractionV2GradRows<T>(stream, batch_size, hidden_size, dy->dptr<T>(), bias->dptr<T>(),
+                                  x0->dptr<T>(), matmul_result->dptr<T>(), dmatmul_result0,
+                                  dx->mut_dptr<T>(), dx0->mut_dptr<T>());
+    // dx += dmatmul_result0 * weight
+    auto dx_matmul = NewMatmulPrimitive(dy->data_type(), /*transpose_a=*/false,
+                                        /*transpose_b=*/false);
+    CHECK(dx_matmul);
+    dx_matmul->Launch(stream, batch_size, in_size, hidden_size, 1.0, dmatmul_result0,
+                      weight->dptr(), 1.0, dx->mut_dptr());
+    // dw = dmatmul_result0^T * x
+    auto dw_matmul = NewMatmulPrimitive(dy->data_type(), /*transpose_a=*/true,
+                                        /*transpose_b=*/false);
+    CHECK(dw_matmul);
+    dw_matmul->Launch(stream, hidden_size, in_size, batch_size, 1.0, dmatmul_result0, x->dptr(),
+                      0.0, dw->mut_dptr());
+    ColumnSum<T>(stream, batch_size, hidden_size, dmatmul_result0, dbias->mut_dptr<T>());
+  }
+};
+
+#define REGISTER_FUSED_CROSS_FEATURE_INTERACTION_V2_GRAD_CPU_KERNEL(dtype)             \
+  REGISTER_USER_KERNEL("fused_cross_feature_interaction_v2_grad")                      \
+      .SetCreateFn<FusedCrossFeatureInteractionV2GradCpuKernel<dtype>>()               \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                  \
+                       && (user_op::HobDataType("dy", 0) == GetDataType<dtype>::value) \
+                       && MatmulPrimitiveExists())                                     \
+      .SetInferTmpSizeFn([](user_op::InferContext* ctx) {                              \
+        return ctx->InputShape("dy", 0).elem_cnt() * sizeof(dtype);                    \
+      });
+
+REGISTER_FUSED_CROSS_FEATURE_INTERACTION_V2_GRAD_CPU_KERNEL(float)
+REGISTER_FUSED_CROSS_FEATURE_INTERACTION_V2_GRAD_CPU_KERNEL(double)
+
+}  // namespace oneflow
@@ -0,0 +1,395 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/core/ep/cpu/cpu_device.h"
+#include "oneflow/user/kernels/simd_pack.h"
+
+namespace oneflow {
+
+namespace {
+
+// The features of a batch row are F vectors of vector_size values, a few KB that stay in L1 while
+// the row is processed, so every row is done at once and no concatenated copy is materialized.
+template<typename T>
+struct Features {
+  std::vector<T*> ptrs;
+  std::vector<int64_t> feature_dims;
+  int64_t num_features = 0;
+  int64_t vector_size = 0;
+
+  void Add(T* ptr, const ShapeView& shape) {
+    ptrs.push_back(ptr);
+    feature_dims.push_back(shape.At(1));
+    num_features += shape.At(1);
+    vector_size = shape.At(2);
+  }
+
+  // Points rows[k] at the k-th feature vector of the batch row.
+  void GetRows(int64_t batch_idx, T** rows) const {
+    int64_t k = 0;
+    for (size_t i = 0; i < ptrs.size(); ++i) {
+      T* batch_ptr = ptrs[i] + batch_idx * feature_dims[i] * vector_size;
+      for (int64_t j = 0; j < feature_dims[i]; ++j) { rows[k++] = batch_ptr + j * vector_size; }
+    }
+  }
+};
+
+template<typename T>
+Features<const T> GetFeatures(user_op::KernelComputeContext* ctx) {
+  Features<const T> features;
+  for (int64_t i = 0; i < ctx->input_size("features"); ++i) {
+    const user_op::Tensor* feature = ctx->Tensor4ArgNameAndIndex("features", i);
+    features.Add(feature->dptr<T>(), feature->shape_view());
+  }
+  return features;
+}
+
+template<typename T>
+Features<T> GetFeaturesGrad(user_op::KernelComputeContext* ctx) {
+  Features<T> features_grad;
+  for (int64_t i = 0; i < ctx->output_size("features_grad"); ++i) {
+    user_op::Tensor* feature_grad = ctx->Tensor4ArgNameAndIndex("features_grad", i);
+    features_grad.Add(feature_grad->mut_dptr<T>(), feature_grad->shape_view());
+  }
+  return features_grad;
+}
+
+// out[j] = dot(a, b[j]) for j in [0, 4), a is loaded once for all four dot products.
+template<typename T>
+void SimdDot4(const T* a, const T* const* b, int64_t n, T* out) {
+  using P = SimdPack<T>;
+  P sum0 = P::Broadcast(0);
+  P sum1 = P::Broadcast(0);
+  P sum2 = P::Broadcast(0);
+  P sum3 = P::Broadcast(0);
+  int64_t i = 0;
+  for (; i + P::kSize <= n; i += P::kSize) {
+    const P pack_a = P::Load(a + i);
+    sum0 = P::Fma(pack_a, P::Load(b[0] + i), sum0);
+    sum1 = P::Fma(pack_a, P::Load(b[1] + i), sum1);
+    sum2 = P::Fma(pack_a, P::Load(b[2] + i), sum2);
+    sum3 = P::Fma(pack_a, P::Load(b[3] + i), sum3);
+  }
+  out[0] = ReduceSum(sum0);
+  out[1] = ReduceSum(sum1);
+  out[2] = ReduceSum(sum2);
+  out[3] = ReduceSum(sum3);
+  for (; i < n; ++i) {
+    out[0] += a[i] * b[0][i];
+    out[1] += a[i] * b[1][i];
+    out[2] += a[i] * b[2][i];
+    out[3] += a[i] * b[3][i];
+  }
+}
+
+// y = sum(coeff[j] * x[j]) over num vectors of n values. Four packs of y are accumulated at a
+// time to hide the latency of the fma chain.
+template<typename T>
+void SimdLinearCombination(int64_t num, const T* coeff, const T* const* x, int64_t n, T* y) {
+  using P = SimdPack<T>;
+  constexpr int64_t kBlockSize = 4 * P::kSize;
+  int64_t i = 0;
+  for (; i + kBlockSize <= n; i += kBlockSize) {
+    P sum0 = P::Broadcast(0);
+    P sum1 = P::Broadcast(0);
+    P sum2 = P::Broadcast(0);
+    P sum3 = P::Broadcast(0);
+    for (int64_t j = 0; j < num; ++j) {
+      const P pack_coeff = P::Broadcast(coeff[j]);
+      sum0 = P::Fma(pack_coeff, P::Load(x[j] + i), sum0);
+      sum1 = P::Fma(pack_coeff, P::Load(x[j] + i + P::kSize), sum1);
+      sum2 = P::Fma(pack_coeff, P::Load(x[j] + i + 2 * P::kSize), sum2);
+      sum3 = P::Fma(pack_coeff, P::Load(x[j] + i + 3 * P::kSize), sum3);
+    }
+    sum0.Store(y + i);
+    sum1.Store(y + i + P::kSize);
+    sum2.Store(y + i + 2 * P::kSize);
+    sum3.Store(y + i + 3 * P::kSize);
+  }
+  for (; i + P::kSize <= n; i += P::kSize) {
+    P sum = P::Broadcast(0);
+    for (int64_t j = 0; j < num; ++j) {
+      sum = P::Fma(P::Broadcast(coeff[j]), P::Load(x[j] + i), sum);
+    }
+    sum.Store(y + i);
+  }
+  for (; i < n; ++i) {
+    T sum = 0;
+    for (int64_t j = 0; j < num; ++j) { sum += coeff[j] * x[j][i]; }
+    y[i] = sum;
+  }
+}
+
+// Index of the dot product of feature i and feature j (j <= i) in the interaction output, which
+// holds the lower triangle of the dot product matrix row by row, including the diagonal if offset
+// is 1.
+inline int64_t GetInteractionIndex(int64_t i, int64_t j, int64_t offset) {
+  return i * (i - 1 + 2 * offset) / 2 + j;
+}
+
+template<typename T>
+void DotFeatureInteraction(ep::CpuStream* stream, const Features<const T>& features,
+                           int64_t batch_size, bool self_interaction, int64_t output_concat_dim,
+                           const T* output_concat, int64_t out_dim, T* out) {
+  const int64_t num_features = features.num_features;
+  const int64_t vector_size = features.vector_size;
+  const int64_t offset = self_interaction ? 1 : 0;
+  const size_t grain_size =
+      ep::GetParallelForGrainSize(num_features * (num_features + offset) / 2 * vector_size);
+  stream->ParallelFor(
+      0, batch_size,
+      [&](int64_t begin, int64_t end) {
+        std::vector<const T*> rows(num_features);
+        for (int64_t batch_idx = begin; batch_idx < end; ++batch_idx) {
+          features.GetRows(batch_idx, rows.data());
+          T* out_row = out + batch_idx * out_dim;
+          std::copy(output_concat + batch_idx * output_concat_dim,
+                    output_concat + (batch_idx + 1) * output_concat_dim, out_row);
+          T* interaction = out_row + output_concat_dim;
+          for (int64_t i = 0; i < num_features; ++i) {
+            const int64_t num_cols = i + offset;
+            int64_t j = 0;
+            for (; j + 4 <= num_cols; j += 4) {
+              SimdDot4<T>(rows[i], rows.data() + j, vector_size, interaction + j);
+            }
+            for (; j < num_cols; ++j) {
+              interaction[j] = SimdDot<T>(rows[i], rows[j], vector_size);
+            }
+            interaction += num_cols;
+          }
+          std::fill(interaction, out_row + out_dim, static_cast<T>(0));
+        }
+      },
+      grain_size);
+}
+
+// The dot product matrix Z = X * X^T is symmetric, so dX = (dZ + dZ^T) * X, where dZ is dy
+// scattered to the lower triangle. Row i of dX is a linear combination of the feature vectors with
+// the i-th row of dZ + dZ^T as coefficients.
+template<typename T>
+void DotFeatureInteractionGrad(ep::CpuStream* stream, const Features<const T>& features,
+                               const Features<T>& features_grad, int64_t batch_size,
+                               bool self_interaction, int64_t dy_dim, const T* dy,
+                               int64_t output_concat_grad_dim, T* output_concat_grad) {
+  const int64_t num_features = features.num_features;
+  const int64_t vector_size = features.vector_size;
+  const int64_t offset = self_interaction ? 1 : 0;
+  const size_t grain_size = ep::GetParallelForGrainSize(num_features * num_features * vector_size);
+  stream->ParallelFor(
+      0, batch_size,
+      [&](int64_t begin, int64_t end) {
+        std::vector<const T*> rows(num_features);
+        std::vector<T*> grad_rows(num_features);
+        std::vector<T> coeff(num_features);
+        for (int64_t batch_idx = begin; batch_idx < end; ++batch_idx) {
+          features.GetRows(batch_idx, rows.data());
+          features_grad.GetRows(batch_idx, grad_rows.data());
+          const T* dy_row = dy + batch_idx * dy_dim;
+          if (output_concat_grad != nullptr) {
+            std::copy(dy_row, dy_row + output_concat_grad_dim,
+                      output_concat_grad + batch_idx * output_concat_grad_dim);
+          }
+          const T* interaction_grad = dy_row + output_concat_grad_dim;
+          for (int64_t i = 0; i < num_features; ++i) {
+            for (int64_t j = 0; j < i; ++j) {
+              coeff[j] = interaction_grad[GetInteractionIndex(i, j, offset)];
+            }
+            coeff[i] = self_interaction
+                           ? 2 * interaction_grad[GetInteractionIndex(i, i, offset)]
+                           : static_cast<T>(0);
+            for (int64_t j = i + 1; j < num_features; ++j) {
+              coeff[j] = interaction_grad[GetInteractionIndex(j, i, offset)];
+            }
+            SimdLinearCombination<T>(num_features, coeff.data(), rows.data(), vector_size,
+                                     grad_rows[i]);
+          }
+        }
+      },
+      grain_size);
+}
+
+// out = ((sum x)^2 - sum x^2) / 2 over the features, column by column.
+template<typename T>
+void DotFeatureInteractionPoolingSum(ep::CpuStream* stream, const Features<const T>& features,
+                                     int64_t batch_size, T* out) {
+  using P = SimdPack<T>;
+  const int64_t num_features = features.num_features;
+  const int64_t vector_size = features.vector_size;
+  const size_t grain_size = ep::GetParallelForGrainSize(num_features * vector_size);
+  stream->ParallelFor(
+      0, batch_size,
+      [&](int64_t begin, int64_t end) {
+        std::vector<const T*> rows(num_features);
+        const P pack_half = P::Broadcast(static_cast<T>(0.5));
+        for (int64_t batch_idx = begin; batch_idx < end; ++batch_idx) {
+          features.GetRows(batch_idx, rows.data());
+          T* out_row = out + batch_idx * vector_size;
+          int64_t col = 0;
+          for (; col + P::kSize <= vector_size; col += P::kSize) {
+            P sum = P::Broadcast(0);
+            P square_sum = P::Broadcast(0);
+            for (int64_t k = 0; k < num_features; ++k) {
+              const P value = P::Load(rows[k] + col);
+              sum = sum + value;
+              square_sum = P::Fma(value, value, square_sum);
+            }
+            (P::Fma(sum, sum, P::Broadcast(0) - square_sum) * pack_half).Store(out_row + col);
+          }
+          for (; col < vector_size; ++col) {
+            T sum = 0;
+            T square_sum = 0;
+            for (int64_t k = 0; k < num_features; ++k) {
+              sum += rows[k][col];
+              square_sum += rows[k][col] * rows[k][col];
+            }
+            out_row[col] = (sum * sum - square_sum) * static_cast<T>(0.5);
+          }
+        }
+      },
+      grain_size);
+}
+
+// dx_k = dy * (sum x - x_k)
+template<typename T>
+void DotFeatureInteractionPoolingSumGrad(ep::CpuStream* stream, const Features<const T>& features,
+                                         const Features<T>& features_grad, int64_t batch_size,
+                                         const T* dy) {
+  using P = SimdPack<T>;
+  const int64_t num_features = features.num_features;
+  const int64_t vector_size = features.vector_size;
+  const size_t grain_size = ep::GetParallelForGrainSize(num_features * vector_size);
+  stream->ParallelFor(
+      0, batch_size,
+      [&](int64_t begin, int64_t end) {
+        std::vector<const T*> rows(num_features);
+        std::vector<T*> grad_rows(num_features);
+        for (int64_t batch_idx = begin; batch_idx < end; ++batch_idx) {
+          features.GetRows(batch_idx, rows.data());
+          features_grad.GetRows(batch_idx, grad_rows.data());
+          const T* dy_row = dy + batch_idx * vector_size;
+          int64_t col = 0;
+          for (; col + P::kSize <= vector_size; col += P::kSize) {
+            P sum = P::Broadcast(0);
+            for (int64_t k = 0; k < num_features; ++k) { sum = sum + P::Load(rows[k] + col); }
+            const P pack_dy = P::Load(dy_row + col);
+            for (int64_t k = 0; k < num_features; ++k) {
+              (pack_dy * (sum - P::Load(rows[k] + col))).Store(grad_rows[k] + col);
+            }
+          }
+          for (; col < vector_size; ++col) {
+            T sum = 0;
+            for (int64_t k = 0; k < num_features; ++k) { sum += rows[k][col]; }
+            for (int64_t k = 0; k < num_features; ++k) {
+              grad_rows[k][col] = dy_row[col] * (sum - rows[k][col]);
+            }
+          }
+        }
+      },
+      grain_size);
+}
+
+}  // namespace
+
+template<typename T>
+class FusedDotFeatureInteractionCpuKernel final : public user_op::OpKernel {
+ public:
+  FusedDotFeatureInteractionCpuKernel() = default;
+  ~FusedDotFeatureInteractionCpuKernel() override = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
+    const int64_t batch_size = out->shape_view().At(0);
+    const Features<const T> features = GetFeatures<T>(ctx);
+    ep::CpuStream* stream = ctx->stream()->As<ep::CpuStream>();
+    if (ctx->Attr<std::string>("pooling") == "sum") {
+      DotFeatureInteractionPoolingSum<T>(stream, features, batch_size, out->mut_dptr<T>());
+      return;
+    }
+    const bool self_interaction = ctx->Attr<bool>("self_interaction");
+    const int64_t num_features = features.num_features;
+    const int64_t interaction_dim = self_interaction ? num_features * (num_features + 1) / 2
+                                                     : num_features * (num_features - 1) / 2;
+    int64_t output_concat_dim = 0;
+    const T* output_concat_ptr = nullptr;
+    if (ctx->has_input("output_concat", 0)) {
+      const user_op::Tensor* output_concat = ctx->Tensor4ArgNameAndIndex("output_concat", 0);
+      output_concat_dim = output_concat->shape_view().At(1);
+      output_concat_ptr = output_concat->dptr<T>();
+    }
+    const int64_t out_dim = out->shape_view().At(1);
+    CHECK_EQ(out_dim - ctx->Attr<int32_t>("output_padding"), output_concat_dim + interaction_dim);
+    DotFeatureInteraction<T>(stream, features, batch_size, self_interaction, output_concat_dim,
+                             output_concat_ptr, out_dim, out->mut_dptr<T>());
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+#define REGISTER_FUSED_DOT_FEATURE_INTERACTION_CPU_KERNEL(dtype)      \
+  REGISTER_USER_KERNEL("fused_dot_feature_interaction")               \
+      .SetCreateFn<FusedDotFeatureInteractionCpuKernel<dtype>>()      \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU) \
+                       && (user_op::HobDataType("out", 0) == GetDataType<dtype>::value));
+
+REGISTER_FUSED_DOT_FEATURE_INTERACTION_CPU_KERNEL(float)
+REGISTER_FUSED_DOT_FEATURE_INTERACTION_CPU_KERNEL(double)
+
+template<typename T>
+class FusedDotFeatureInteractionGradCpuKernel final : public user_op::OpKernel {
+ public:
+  FusedDotFeatureInteractionGradCpuKernel() = default;
+  ~FusedDotFeatureInteractionGradCpuKernel() override = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* dy = ctx->Tensor4ArgNameAndIndex("dy", 0);
+    const int64_t batch_size = dy->shape_view().At(0);
+    const Features<const T> features = GetFeatures<T>(ctx);
+    const Features<T> features_grad = GetFeaturesGrad<T>(ctx);
+    CHECK_EQ(features.num_features, features_grad.num_features);
+    ep::CpuStream* stream = ctx->stream()->As<ep::CpuStream>();
+    if (ctx->Attr<std::string>("pooling") == "sum") {
+      DotFeatureInteractionPoolingSumGrad<T>(stream, features, features_grad, batch_size,
+                                             dy->dptr<T>());
+      return;
+    }
+    T* output_concat_grad_ptr = nullptr;
+    int64_t output_concat_grad_dim = 0;
+    if (ctx->has_output("output_concat_grad", 0)) {
+      user_op::Tensor* output_concat_grad = ctx->Tensor4ArgNameAndIndex("output_concat_grad", 0);
+      output_concat_grad_ptr = output_concat_grad->mut_dptr<T>();
+      output_concat_grad_dim = output_concat_grad->shape_view().At(1);
+    }
+    DotFeatureInteractionGrad<T>(stream, features, features_grad, batch_size,
+                                 ctx->Attr<bool>("self_interaction"), dy->shape_view().At(1),
+                                 dy->dptr<T>(), output_concat_grad_dim, output_concat_grad_ptr);
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+#define REGISTER_FUSED_DOT_FEATURE_INTERACTION_GRAD_CPU_KERNEL(dtype) \
+  REGISTER_USER_KERNEL("fused_dot_feature_interaction_grad")          \
+      .SetCreateFn<FusedDotFeatureInteractionGradCpuKernel<dtype>>()  \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU) \
+                       && (user_op::HobDataType("dy", 0) == GetDataType<dtype>::value));
+
+REGISTER_FUSED_DOT_FEATURE_INTERACTION_GRAD_CPU_KERNEL(float)
+REGISTER_FUSED_DOT_FEATURE_INTERACTION_GRAD_CPU_KERNEL(double)
+
+}  // namespace oneflow
@@ -0,0 +1,391 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/ep/include/primitive/matmul.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/core/ep/cpu/cpu_device.h"
+#include "oneflow/user/kernels/simd_pack.h"
+
+namespace oneflow {
+
+namespace {
+
+// The relu mask of a layer has one bit per output feature, bit j % 32 of word j / 32 of the row,
+// the same layout as the aux output of the cublasLt epilogue.
+constexpr int64_t kAuxBitsPerWord = 32;
+
+// Register tile of the gemm, kMr rows of x times kNr output features.
+template<typename T>
+struct GemmTile {
+  static constexpr int64_t kMr = 4;
+  static constexpr int64_t kNr = 2 * SimdPack<T>::kSize;
+};
+
+// Rows of x computed by a task. The packed panels of the task are reused for all of its rows.
+constexpr int64_t kRowsPerTask = 64;
+
+int64_t GetNumPanels(int64_t n, int64_t nr) { return (n + nr - 1) / nr; }
+
+// The weight (n, k) is packed into panels of kNr output features, each panel is stored k-major,
+// so that the micro kernel loads the kNr weights of one k with contiguous loads. The last panel is
+// padded with zeros.
+template<typename T>
+void PackWeight(ep::CpuStream* stream, int64_t n, int64_t k, const T* weight, T* packed) {
+  constexpr int64_t kNr = GemmTile<T>::kNr;
+  stream->ParallelFor(
+      0, GetNumPanels(n, kNr),
+      [&](int64_t begin, int64_t end) {
+        for (int64_t panel = begin; panel < end; ++panel) {
+          T* packed_panel = packed + panel * k * kNr;
+          for (int64_t j = 0; j < kNr; ++j) {
+            const int64_t row = panel * kNr + j;
+            if (row < n) {
+              const T* weight_row = weight + row * k;
+              for (int64_t kk = 0; kk < k; ++kk) { packed_panel[kk * kNr + j] = weight_row[kk]; }
+            } else {
+              for (int64_t kk = 0; kk < k; ++kk) { packed_panel[kk * kNr + j] = 0; }
+            }
+          }
+        }
+      },
+      ep::GetParallelForGrainSize(k * kNr));
+}
+
+// y = relu(x * panel + bias) for a tile of rows x kNr. Bias add and activation are done on the
+// accumulators, before the tile leaves the registers.
+template<typename T, int64_t rows, bool relu>
+void MicroKernel(int64_t k, const T* x, int64_t ldx, const T* panel, const T* bias,
+                 int64_t valid_cols, T* y, int64_t ldy) {
+  using P = SimdPack<T>;
+  constexpr int64_t kNr = GemmTile<T>::kNr;
+  P acc[rows][2];
+  for (int64_t r = 0; r < rows; ++r) {
+    acc[r][0] = P::Broadcast(0);
+    acc[r][1] = P::Broadcast(0);
+  }
+  for (int64_t kk = 0; kk < k; ++kk) {
+    const P b0 = P::Load(panel + kk * kNr);
+    const P b1 = P::Load(panel + kk * kNr + P::kSize);
+    for (int64_t r = 0; r < rows; ++r) {
+      const P a = P::Broadcast(x[r * ldx + kk]);
+      acc[r][0] = P::Fma(a, b0, acc[r][0]);
+      acc[r][1] = P::Fma(a, b1, acc[r][1]);
+    }
+  }
+  const P bias0 = P::Load(bias);
+  const P bias1 = P::Load(bias + P::kSize);
+  const P zero = P::Broadcast(0);
+  for (int64_t r = 0; r < rows; ++r) {
+    P out0 = acc[r][0] + bias0;
+    P out1 = acc[r][1] + bias1;
+    if (relu) {
+      out0 = P::Max(out0, zero);
+      out1 = P::Max(out1, zero);
+    }
+    T* y_row = y + r * ldy;
+    if (valid_cols == kNr) {
+      out0.Store(y_row);
+      out1.Store(y_row + P::kSize);
+    } else {
+      T lanes[kNr];
+      out0.Store(lanes);
+      out1.Store(lanes + P::kSize);
+      std::copy(lanes, lanes + valid_cols, y_row);
+    }
+  }
+}
+
+template<typename T, bool relu>
+void LaunchMicroKernel(int64_t rows, int64_t k, const T* x, int64_t ldx, const T* panel,
+                       const T* bias, int64_t valid_cols, T* y, int64_t ldy) {
+  static_assert(GemmTile<T>::kMr == 4, "");
+  if (rows == 4) {
+    MicroKernel<T, 4, relu>(k, x, ldx, panel, bias, valid_cols, y, ldy);
+  } else if (rows == 3) {
+    MicroKernel<T, 3, relu>(k, x, ldx, panel, bias, valid_cols, y, ldy);
+  } else if (rows == 2) {
+    MicroKernel<T, 2, relu>(k, x, ldx, panel, bias, valid_cols, y, ldy);
+  } else {
+    CHECK_EQ(rows, 1);
+    MicroKernel<T, 1, relu>(k, x, ldx, panel, bias, valid_cols, y, ldy);
+  }
+}
+
+// y = x * weight^T + bias, with relu if aux is not null. A task computes kRowsPerTask rows of x
+// times the output features of one aux word, so that tasks never write to the same aux word.
+template<typename T, bool relu>
+void DenseLayer(ep::CpuStream* stream, int64_t m, int64_t n, int64_t k, const T* x,
+                const T* packed_weight, const T* bias, T* y, int32_t* aux, int64_t aux_ld) {
+  constexpr int64_t kMr = GemmTile<T>::kMr;
+  constexpr int64_t kNr = GemmTile<T>::kNr;
+  static_assert(kAuxBitsPerWord % kNr == 0, "");
+  const int64_t num_row_blocks = (m + kRowsPerTask - 1) / kRowsPerTask;
+  const int64_t num_col_blocks = (n + kAuxBitsPerWord - 1) / kAuxBitsPerWord;
+  const int64_t num_panels = GetNumPanels(n, kNr);
+  const int64_t task_cost = std::min(m, kRowsPerTask) * std::min(n, kAuxBitsPerWord) * k;
+  stream->ParallelFor(
+      0, num_row_blocks * num_col_blocks,
+      [&](int64_t begin, int64_t end) {
+        T padded_bias[kNr];
+        for (int64_t task = begin; task < end; ++task) {
+          const int64_t row_begin = task / num_col_blocks * kRowsPerTask;
+          const int64_t row_end = std::min(row_begin + kRowsPerTask, m);
+          const int64_t col_block = task % num_col_blocks;
+          const int64_t panel_begin = col_block * kAuxBitsPerWord / kNr;
+          const int64_t panel_end = std::min(panel_begin + kAuxBitsPerWord / kNr, num_panels);
+          for (int64_t panel = panel_begin; panel < panel_end; ++panel) {
+            const int64_t col = panel * kNr;
+            const int64_t valid_cols = std::min(kNr, n - col);
+            const T* panel_bias = bias + col;
+            if (valid_cols < kNr) {
+              std::fill(padded_bias, padded_bias + kNr, static_cast<T>(0));
+              std::copy(bias + col, bias + n, padded_bias);
+              panel_bias = padded_bias;
+            }
+            for (int64_t row = row_begin; row < row_end; row += kMr) {
+              LaunchMicroKernel<T, relu>(std::min(kMr, row_end - row), k, x + row * k, k,
+                                         packed_weight + panel * k * kNr, panel_bias, valid_cols,
+                                         y + row * n + col, n);
+            }
+          }
+          if (aux != nullptr) {
+            const int64_t col_begin = col_block * kAuxBitsPerWord;
+            const int64_t col_end = std::min(col_begin + kAuxBitsPerWord, n);
+            for (int64_t row = row_begin; row < row_end; ++row) {
+              const T* y_row = y + row * n;
+              uint32_t bits = 0;
+              for (int64_t col = col_begin; col < col_end; ++col) {
+                if (y_row[col] > 0) { bits |= 1U << (col - col_begin); }
+              }
+              aux[row * aux_ld + col_block] = static_cast<int32_t>(bits);
+            }
+          }
+        }
+      },
+      ep::GetParallelForGrainSize(task_cost));
+}
+
+// Fingerprint of the bytes of a tensor. Every 8 bytes go through a bijective mix of one of four
+// lanes, so a change of a single word always changes the fingerprint.
+uint64_t Fingerprint(const void* data, size_t size) {
+  const char* bytes = static_cast<const char*>(data);
+  constexpr size_t kNumLanes = 4;
+  uint64_t lanes[kNumLanes] = {1, 2, 3, 4};
+  auto Mix = [](uint64_t lane, uint64_t word) {
+    lane = (lane ^ word) * 0x9E3779B97F4A7C15ULL;
+    return lane ^ (lane >> 29);
+  };
+  size_t offset = 0;
+  for (; offset + kNumLanes * sizeof(uint64_t) <= size; offset += kNumLanes * sizeof(uint64_t)) {
+    for (size_t i = 0; i < kNumLanes; ++i) {
+      uint64_t word = 0;
+      std::memcpy(&word, bytes + offset + i * sizeof(uint64_t), sizeof(uint64_t));
+      lanes[i] = Mix(lanes[i], word);
+    }
+  }
+  for (; offset < size; ++offset) { lanes[0] = Mix(lanes[0], static_cast<uint8_t>(bytes[offset])); }
+  size_t fingerprint = size;
+  for (size_t i = 0; i < kNumLanes; ++i) { HashCombine(&fingerprint, lanes[i]); }
+  return fingerprint;
+}
+
+// Weights packed for the gemm. By default a weight is packed again at every compute, because it
+// may be updated in place. For inference, ONEFLOW_KERNEL_CPU_FUSED_MLP_CONSTANT_WEIGHTS keeps a
+// packed weight as long as the pointer, the shape and the fingerprint of the weight are the same,
+// the fingerprint is a sequential read of the weight, which is much cheaper than packing it.
+template<typename T>
+class FusedMLPCpuKernelCache final : public user_op::OpKernelCache {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(FusedMLPCpuKernelCache);
+  FusedMLPCpuKernelCache()
+      : constant_weights_(
+          ParseBooleanFromEnv("ONEFLOW_KERNEL_CPU_FUSED_MLP_CONSTANT_WEIGHTS", false)) {}
+  ~FusedMLPCpuKernelCache() override = default;
+
+  const T* GetPackedWeight(ep::CpuStream* stream, int32_t idx,
+                           const user_op::Tensor* weight) const {
+    if (packed_weights_.size() <= static_cast<size_t>(idx)) { packed_weights_.resize(idx + 1); }
+    const int64_t n = weight->shape_view().At(0);
+    const int64_t k = weight->shape_view().At(1);
+    PackedWeight* packed = &packed_weights_.at(idx);
+    if (constant_weights_) {
+      const uint64_t fingerprint = Fingerprint(weight->dptr(), n * k * sizeof(T));
+      if (packed->weight_ptr == weight->dptr() && packed->n == n && packed->k == k
+          && packed->fingerprint == fingerprint) {
+        return packed->values.data();
+      }
+      packed->weight_ptr = weight->dptr();
+      packed->n = n;
+      packed->k = k;
+      packed->fingerprint = fingerprint;
+    }
+    packed->values.resize(GetNumPanels(n, GemmTile<T>::kNr) * k * GemmTile<T>::kNr);
+    PackWeight<T>(stream, n, k, weight->dptr<T>(), packed->values.data());
+    return packed->values.data();
+  }
+
+ private:
+  struct PackedWeight {
+    std::vector<T> values;
+    const void* weight_ptr = nullptr;
+    int64_t n = 0;
+    int64_t k = 0;
+    uint64_t fingerprint = 0;
+  };
+
+  bool constant_weights_;
+  mutable std::vector<PackedWeight> packed_weights_;
+};
+
+}  // namespace
+
+template<typename T>
+class FusedMLPCpuKernel final : public user_op::OpKernel {
+ public:
+  FusedMLPCpuKernel() = default;
+  ~FusedMLPCpuKernel() override = default;
+
+  void InitOpKernelCacheWithFlags(
+      user_op::KernelCacheContext* ctx, int8_t flag,
+      std::shared_ptr<user_op::OpKernelCache>* cache_ptr) const override {
+    // Packed weights are validated at every compute, so the cache is kept across shape changes.
+    if (*cache_ptr == nullptr) { *cache_ptr = std::make_shared<FusedMLPCpuKernelCache<T>>(); }
+  }
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx, user_op::OpKernelState*,
+               const user_op::OpKernelCache* cache) const override {
+    const int32_t weight_size = ctx->input_size("weights");
+    CHECK_EQ(weight_size, ctx->input_size("biases"))
+        << "The number of weight and bias is not equal!. ";
+    const auto* mlp_cache = CHECK_NOTNULL(dynamic_cast<const FusedMLPCpuKernelCache<T>*>(cache));
+    ep::CpuStream* stream = ctx->stream()->As<ep::CpuStream>();
+    const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    const bool skip_final_activation = ctx->Attr<bool>("skip_final_activation");
+    const int64_t m = x->shape_view().At(0);
+    int64_t k = x->shape_view().At(1);
+    const T* in_ptr = x->dptr<T>();
+    for (int32_t idx = 0; idx < weight_size; ++idx) {
+      const user_op::Tensor* weight = ctx->Tensor4ArgNameAndIndex("weights", idx);
+      const user_op::Tensor* bias = ctx->Tensor4ArgNameAndIndex("biases", idx);
+      user_op::Tensor* aux = ctx->Tensor4ArgNameAndIndex("cublas_aux", idx);
+      const int64_t n = weight->shape_view().At(0);
+      CHECK_EQ(weight->shape_view().At(1), k);
+      const T* packed_weight = mlp_cache->GetPackedWeight(stream, idx, weight);
+      const bool is_last_layer = idx == weight_size - 1;
+      T* y_ptr = is_last_layer ? ctx->Tensor4ArgNameAndIndex("out", 0)->mut_dptr<T>()
+                               : ctx->Tensor4ArgNameAndIndex("hidden", idx)->mut_dptr<T>();
+      if (is_last_layer && skip_final_activation) {
+        DenseLayer<T, false>(stream, m, n, k, in_ptr, packed_weight, bias->dptr<T>(), y_ptr,
+                             nullptr, 0);
+      } else {
+        const int64_t aux_ld = aux->shape_view().At(1);
+        CHECK_GE(aux_ld * kAuxBitsPerWord, n);
+        DenseLayer<T, true>(stream, m, n, k, in_ptr, packed_weight, bias->dptr<T>(), y_ptr,
+                            aux->mut_dptr<int32_t>(), aux_ld);
+      }
+      in_ptr = y_ptr;
+      k = n;
+    }
+  }
+
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+#define REGISTER_FUSED_MLP_CPU_KERNEL(dtype)                          \
+  REGISTER_USER_KERNEL("cublas_fused_mlp")                            \
+      .SetCreateFn<FusedMLPCpuKernel<dtype>>()                        \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU) \
+                       && (user_op::HobDataType("out", 0) == GetDataType<dtype>::value));
+
+REGISTER_FUSED_MLP_CPU_KERNEL(float)
+REGISTER_FUSED_MLP_CPU_KERNEL(double)
+
+// d_grad = relu_grad(alpha * dy * weight, aux), d_bias = sum(d_grad) over the batch.
+template<typename T>
+class BiasAddReluMatmulGradCpuKernel final : public user_op::OpKernel {
+ public:
+  BiasAddReluMatmulGradCpuKernel() = default;
+  ~BiasAddReluMatmulGradCpuKernel() override = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* dy = ctx->Tensor4ArgNameAndIndex("dy", 0);
+    const user_op::Tensor* weight = ctx->Tensor4ArgNameAndIndex("weight", 0);
+    const user_op::Tensor* aux = ctx->Tensor4ArgNameAndIndex("aux", 0);
+    user_op::Tensor* d_grad = ctx->Tensor4ArgNameAndIndex("d_grad", 0);
+    user_op::Tensor* d_bias = ctx->Tensor4ArgNameAndIndex("d_bias", 0);
+    const int64_t m = dy->shape_view().At(0);
+    const int64_t n = dy->shape_view().At(1);
+    const int64_t k = weight->shape_view().At(1);
+    const int64_t aux_ld = aux->shape_view().At(1);
+    CHECK_GE(aux_ld * kAuxBitsPerWord, k);
+    ep::CpuStream* stream = ctx->stream()->As<ep::CpuStream>();
+    auto matmul = ep::primitive::NewPrimitive<ep::primitive::MatmulFactory>(
+        DeviceType::kCPU, dy->data_type(), ep::primitive::BlasTransposeType::N,
+        ep::primitive::BlasTransposeType::N);
+    CHECK(matmul);
+    matmul->Launch(stream, m, k, n, ctx->Attr<double>("alpha"), dy->dptr(), weight->dptr(), 0.0,
+                   d_grad->mut_dptr());
+    const int32_t* aux_ptr = aux->dptr<int32_t>();
+    T* d_grad_ptr = d_grad->mut_dptr<T>();
+    stream->ParallelFor(
+        0, m,
+        [&](int64_t begin, int64_t end) {
+          for (int64_t row = begin; row < end; ++row) {
+            T* d_grad_row = d_grad_ptr + row * k;
+            const int32_t* aux_row = aux_ptr + row * aux_ld;
+            for (int64_t col = 0; col < k; ++col) {
+              if (((aux_row[col / kAuxBitsPerWord] >> (col % kAuxBitsPerWord)) & 1) == 0) {
+                d_grad_row[col] = 0;
+              }
+            }
+          }
+        },
+        ep::GetParallelForGrainSize(k));
+    T* d_bias_ptr = d_bias->mut_dptr<T>();
+    using P = SimdPack<T>;
+    stream->ParallelFor(
+        0, k,
+        [&](int64_t begin, int64_t end) {
+          std::fill(d_bias_ptr + begin, d_bias_ptr + end, static_cast<T>(0));
+          for (int64_t row = 0; row < m; ++row) {
+            const T* d_grad_row = d_grad_ptr + row * k;
+            int64_t col = begin;
+            for (; col + P::kSize <= end; col += P::kSize) {
+              (P::Load(d_bias_ptr + col) + P::Load(d_grad_row + col)).Store(d_bias_ptr + col);
+            }
+            for (; col < end; ++col) { d_bias_ptr[col] += d_grad_row[col]; }
+          }
+        },
+        RoundUp(ep::GetParallelForGrainSize(m), P::kSize));
+  }
+
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+#define REGISTER_BIAS_ADD_RELU_MATMUL_GRAD_CPU_KERNEL(dtype)          \
+  REGISTER_USER_KERNEL("cublas_bias_add_relu_matmul_grad")            \
+      .SetCreateFn<BiasAddReluMatmulGradCpuKernel<dtype>>()           \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU) \
+                       && (user_op::HobDataType("weight", 0) == GetDataType<dtype>::value));
+
+REGISTER_BIAS_ADD_RELU_MATMUL_GRAD_CPU_KERNEL(float)
+REGISTER_BIAS_ADD_RELU_MATMUL_GRAD_CPU_KERNEL(double)
+
+}  // namespace oneflow
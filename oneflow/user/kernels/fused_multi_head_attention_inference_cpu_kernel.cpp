@@ -0,0 +1,161 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/core/ep/cpu/primitive/vectorized_math.h"
+#include "oneflow/user/kernels/simd_pack.h"
+
+namespace oneflow {
+
+namespace {
+
+// A block of query rows is attended to one block of keys at a time, so the keys and values of a
+// block stay in cache while every row of the query block uses them.
+constexpr int64_t kQueryBlockSize = 32;
+constexpr int64_t kKeyBlockSize = 128;
+
+struct AttentionParams {
+  int64_t batch_size;
+  int64_t num_heads;
+  int64_t query_seq_len;
+  int64_t kv_seq_len;
+  int64_t head_size;
+  int64_t value_head_size;
+  bool causal;
+};
+
+// Attention of the rows [row_begin, row_end) of one (batch, head) with online softmax: every row
+// keeps the running max, the running sum of exp and the unnormalized output, which are rescaled
+// whenever a key block raises the max, so no row ever holds its full row of scores.
+template<typename T>
+void AttentionQueryBlock(const AttentionParams& params, T scale, const T* query, const T* key,
+                         const T* value, T* out, int64_t row_begin, int64_t row_end, T* scores,
+                         T* row_max, T* row_sum, T* acc) {
+  const int64_t num_rows = row_end - row_begin;
+  const int64_t query_stride = params.num_heads * params.head_size;
+  const int64_t value_stride = params.num_heads * params.value_head_size;
+  const int64_t value_head_size = params.value_head_size;
+  std::fill(row_max, row_max + num_rows, -std::numeric_limits<T>::infinity());
+  std::fill(row_sum, row_sum + num_rows, static_cast<T>(0));
+  std::fill(acc, acc + num_rows * value_head_size, static_cast<T>(0));
+  // The causal mask is aligned to the bottom right, the queries are the last query_seq_len
+  // positions of the keys, so row i attends to the keys j <= i + kv_seq_len - query_seq_len.
+  const int64_t causal_offset = params.kv_seq_len - params.query_seq_len;
+  for (int64_t key_begin = 0; key_begin < params.kv_seq_len; key_begin += kKeyBlockSize) {
+    if (params.causal && key_begin >= row_end + causal_offset) { break; }
+    const int64_t key_end = std::min(key_begin + kKeyBlockSize, params.kv_seq_len);
+    for (int64_t r = 0; r < num_rows; ++r) {
+      const int64_t row = row_begin + r;
+      const int64_t valid_key_end =
+          params.causal ? std::min(key_end, row + 1 + causal_offset) : key_end;
+      const int64_t num_keys = valid_key_end - key_begin;
+      if (num_keys <= 0) { continue; }
+      const T* q = query + row * query_stride;
+      for (int64_t j = 0; j < num_keys; ++j) {
+        scores[j] = scale * SimdDot(q, key + (key_begin + j) * query_stride, params.head_size);
+      }
+      const T max = std::max(row_max[r], ep::primitive::RowMax(scores, num_keys));
+      const T correction = std::exp(row_max[r] - max);
+      row_max[r] = max;
+      row_sum[r] =
+          row_sum[r] * correction + ep::primitive::ExpAndSum(scores, max, scores, num_keys);
+      T* acc_row = acc + r * value_head_size;
+      for (int64_t d = 0; d < value_head_size; ++d) { acc_row[d] *= correction; }
+      for (int64_t j = 0; j < num_keys; ++j) {
+        SimdAxpy(value_head_size, scores[j], value + (key_begin + j) * value_stride, acc_row);
+      }
+    }
+  }
+  for (int64_t r = 0; r < num_rows; ++r) {
+    // rows without any unmasked key output zeros
+    const T inv_sum = row_sum[r] > 0 ? 1 / row_sum[r] : static_cast<T>(0);
+    const T* acc_row = acc + r * value_head_size;
+    T* out_row = out + (row_begin + r) * value_stride;
+    for (int64_t d = 0; d < value_head_size; ++d) { out_row[d] = acc_row[d] * inv_sum; }
+  }
+}
+
+template<typename T>
+class FusedMultiHeadAttentionInferenceCpuKernel final : public user_op::OpKernel {
+ public:
+  FusedMultiHeadAttentionInferenceCpuKernel() = default;
+  ~FusedMultiHeadAttentionInferenceCpuKernel() override = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* query = ctx->Tensor4ArgNameAndIndex("query", 0);
+    const user_op::Tensor* key = ctx->Tensor4ArgNameAndIndex("key", 0);
+    const user_op::Tensor* value = ctx->Tensor4ArgNameAndIndex("value", 0);
+    user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
+    AttentionParams params{};
+    params.batch_size = query->shape_view().At(0);
+    params.num_heads = ctx->Attr<int64_t>("num_heads");
+    params.query_seq_len = query->shape_view().At(1);
+    params.kv_seq_len = key->shape_view().At(1);
+    params.head_size = query->shape_view().At(2) / params.num_heads;
+    params.value_head_size = value->shape_view().At(2) / params.num_heads;
+    params.causal = ctx->Attr<bool>("causal");
+    const T scale = static_cast<T>(ctx->Attr<double>("scale"));
+    const int64_t num_query_blocks =
+        RoundUp(params.query_seq_len, kQueryBlockSize) / kQueryBlockSize;
+    const int64_t query_stride = params.num_heads * params.head_size;
+    const int64_t value_stride = params.num_heads * params.value_head_size;
+    const T* query_ptr = query->dptr<T>();
+    const T* key_ptr = key->dptr<T>();
+    const T* value_ptr = value->dptr<T>();
+    T* out_ptr = out->mut_dptr<T>();
+    ctx->stream()->As<ep::CpuStream>()->ParallelFor(
+        0, params.batch_size * params.num_heads * num_query_blocks,
+        [&](int64_t begin, int64_t end) {
+          std::vector<T> scores(kKeyBlockSize);
+          std::vector<T> row_max(kQueryBlockSize);
+          std::vector<T> row_sum(kQueryBlockSize);
+          std::vector<T> acc(kQueryBlockSize * params.value_head_size);
+          for (int64_t i = begin; i < end; ++i) {
+            const int64_t query_block = i % num_query_blocks;
+            const int64_t h = i / num_query_blocks % params.num_heads;
+            const int64_t b = i / num_query_blocks / params.num_heads;
+            const int64_t row_begin = query_block * kQueryBlockSize;
+            const int64_t row_end = std::min(row_begin + kQueryBlockSize, params.query_seq_len);
+            AttentionQueryBlock<T>(
+                params, scale,
+                query_ptr + b * params.query_seq_len * query_stride + h * params.head_size,
+                key_ptr + b * params.kv_seq_len * query_stride + h * params.head_size,
+                value_ptr + b * params.kv_seq_len * value_stride + h * params.value_head_size,
+                out_ptr + b * params.query_seq_len * value_stride + h * params.value_head_size,
+                row_begin, row_end, scores.data(), row_max.data(), row_sum.data(), acc.data());
+          }
+        },
+        ep::GetParallelForGrainSize(kQueryBlockSize * params.kv_seq_len
+                                    * (params.head_size + params.value_head_size)
+                                    * ep::parallel_for_cost::kElementwise));
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+}  // namespace
+
+#define REGISTER_FUSED_MULTI_HEAD_ATTENTION_INFERENCE_CPU_KERNEL(dtype) \
+  REGISTER_USER_KERNEL("fused_multi_head_attention_inference")          \
+      .SetCreateFn<FusedMultiHeadAttentionInferenceCpuKernel<dtype>>()  \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)   \
+                       && (user_op::HobDataType("out", 0) == GetDataType<dtype>::value));
+
+REGISTER_FUSED_MULTI_HEAD_ATTENTION_INFERENCE_CPU_KERNEL(float)
+REGISTER_FUSED_MULTI_HEAD_ATTENTION_INFERENCE_CPU_KERNEL(double)
+
+}  // namespace oneflow
@@ -0,0 +1,357 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/core/ep/cpu/primitive/vectorized_math.h"
+
+// CPU versions of fused_lstm_cell and fused_gru_cell, see fused_lstm_cell_kernel.cu and
+// fused_gru_cell_kernel.cu for the layouts of the gates and of the workspace. Every batch row is
+// computed in one pass: the gate pre-activations are summed into the workspace row, activated there
+// with the vectorized sigmoid and tanh, and the states are updated from it.
+
+namespace oneflow {
+
+namespace {
+
+// Sum of the gates and the biases of a row, x = a + b + bias_a + bias_b.
+template<typename T>
+void AddGates(const T* a, const T* b, const T* bias_a, const T* bias_b, T* x, int64_t n) {
+  if (bias_a != nullptr) {
+    for (int64_t i = 0; i < n; ++i) { x[i] = a[i] + b[i] + bias_a[i] + bias_b[i]; }
+  } else {
+    for (int64_t i = 0; i < n; ++i) { x[i] = a[i] + b[i]; }
+  }
+}
+
+// Sums the rows of x (rows, cols) to y (cols), which is the grad of a bias broadcast to the rows.
+template<typename T>
+void SumRows(ep::Stream* stream, const T* x, int64_t rows, int64_t cols, T* y) {
+  stream->As<ep::CpuStream>()->ParallelFor(
+      0, cols,
+      [&](int64_t begin, int64_t end) {
+        std::fill(y + begin, y + end, static_cast<T>(0));
+        for (int64_t row = 0; row < rows; ++row) {
+          const T* x_row = x + row * cols;
+          for (int64_t col = begin; col < end; ++col) { y[col] += x_row[col]; }
+        }
+      },
+      ep::GetParallelForGrainSize(rows * ep::parallel_for_cost::kElementwise));
+}
+
+template<typename T>
+class CpuFusedLstmCellKernel final : public user_op::OpKernel {
+ public:
+  CpuFusedLstmCellKernel() = default;
+  ~CpuFusedLstmCellKernel() = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* input_gates = ctx->Tensor4ArgNameAndIndex("input_gates", 0);
+    const user_op::Tensor* hidden_gates = ctx->Tensor4ArgNameAndIndex("hidden_gates", 0);
+    const user_op::Tensor* cx = ctx->Tensor4ArgNameAndIndex("cx", 0);
+    user_op::Tensor* hy = ctx->Tensor4ArgNameAndIndex("hy", 0);
+    user_op::Tensor* cy = ctx->Tensor4ArgNameAndIndex("cy", 0);
+    user_op::Tensor* workspace = ctx->Tensor4ArgNameAndIndex("workspace", 0);
+
+    const T* input_bias_ptr = nullptr;
+    const T* hidden_bias_ptr = nullptr;
+    if (ctx->has_input("input_bias", 0)) {
+      CHECK(ctx->has_input("hidden_bias", 0));
+      input_bias_ptr = ctx->Tensor4ArgNameAndIndex("input_bias", 0)->dptr<T>();
+      hidden_bias_ptr = ctx->Tensor4ArgNameAndIndex("hidden_bias", 0)->dptr<T>();
+    }
+    const T* input_gates_ptr = input_gates->dptr<T>();
+    const T* hidden_gates_ptr = hidden_gates->dptr<T>();
+    const T* cx_ptr = cx->dptr<T>();
+    T* hy_ptr = hy->mut_dptr<T>();
+    T* cy_ptr = cy->mut_dptr<T>();
+    T* workspace_ptr = workspace->mut_dptr<T>();
+    const int64_t hidden_size = cx->shape_view().At(cx->shape_view().NumAxes() - 1);
+    const int64_t batch_size = cx->shape_view().elem_cnt() / hidden_size;
+    ctx->stream()->As<ep::CpuStream>()->ParallelFor(
+        0, batch_size,
+        [&](int64_t begin, int64_t end) {
+          for (int64_t row = begin; row < end; ++row) {
+            const int64_t gates_offset = row * 4 * hidden_size;
+            // workspace (ig, fg, cg, og)
+            T* gates = workspace_ptr + gates_offset;
+            AddGates(input_gates_ptr + gates_offset, hidden_gates_ptr + gates_offset,
+                     input_bias_ptr, hidden_bias_ptr, gates, 4 * hidden_size);
+            ep::primitive::RowSigmoid(gates, gates, 2 * hidden_size);
+            ep::primitive::RowTanh(gates + 2 * hidden_size, gates + 2 * hidden_size, hidden_size);
+            ep::primitive::RowSigmoid(gates + 3 * hidden_size, gates + 3 * hidden_size,
+                                      hidden_size);
+            const T* ig = gates;
+            const T* fg = gates + hidden_size;
+            const T* cg = gates + 2 * hidden_size;
+            const T* og = gates + 3 * hidden_size;
+            const T* cx_row = cx_ptr + row * hidden_size;
+            T* cy_row = cy_ptr + row * hidden_size;
+            T* hy_row = hy_ptr + row * hidden_size;
+            for (int64_t j = 0; j < hidden_size; ++j) {
+              cy_row[j] = fg[j] * cx_row[j] + ig[j] * cg[j];
+            }
+            ep::primitive::RowTanh(cy_row, hy_row, hidden_size);
+            for (int64_t j = 0; j < hidden_size; ++j) { hy_row[j] *= og[j]; }
+          }
+        },
+        ep::GetParallelForGrainSize(4 * hidden_size * ep::parallel_for_cost::kTranscendental));
+  }
+
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+template<typename T>
+class CpuFusedLstmCellGradKernel final : public user_op::OpKernel {
+ public:
+  CpuFusedLstmCellGradKernel() = default;
+  ~CpuFusedLstmCellGradKernel() = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* grad_hy = ctx->Tensor4ArgNameAndIndex("grad_hy", 0);
+    const user_op::Tensor* grad_cy = ctx->Tensor4ArgNameAndIndex("grad_cy", 0);
+    const user_op::Tensor* cx = ctx->Tensor4ArgNameAndIndex("cx", 0);
+    const user_op::Tensor* cy = ctx->Tensor4ArgNameAndIndex("cy", 0);
+    const user_op::Tensor* workspace = ctx->Tensor4ArgNameAndIndex("workspace", 0);
+    user_op::Tensor* grad_gates = ctx->Tensor4ArgNameAndIndex("grad_gates", 0);
+
+    const T* grad_hy_ptr = grad_hy->dptr<T>();
+    const T* grad_cy_ptr = grad_cy->dptr<T>();
+    const T* cx_ptr = cx->dptr<T>();
+    const T* cy_ptr = cy->dptr<T>();
+    const T* workspace_ptr = workspace->dptr<T>();
+    T* grad_gates_ptr = grad_gates->mut_dptr<T>();
+    T* grad_cx_ptr = nullptr;
+    if (ctx->has_output("grad_cx", 0)) {
+      grad_cx_ptr = ctx->Tensor4ArgNameAndIndex("grad_cx", 0)->mut_dptr<T>();
+    }
+    const int64_t hidden_size = cx->shape_view().At(cx->shape_view().NumAxes() - 1);
+    const int64_t batch_size = cx->shape_view().elem_cnt() / hidden_size;
+    ctx->stream()->As<ep::CpuStream>()->ParallelFor(
+        0, batch_size,
+        [&](int64_t begin, int64_t end) {
+          for (int64_t row = begin; row < end; ++row) {
+            const int64_t offset = row * hidden_size;
+            const T* ig = workspace_ptr + 4 * offset;
+            const T* fg = ig + hidden_size;
+            const T* cg = ig + 2 * hidden_size;
+            const T* og = ig + 3 * hidden_size;
+            T* gig = grad_gates_ptr + 4 * offset;
+            T* gfg = gig + hidden_size;
+            T* gcg = gig + 2 * hidden_size;
+            T* gog = gig + 3 * hidden_size;
+            // tanh(cy) is kept in the slot of the grad of og until it is used
+            ep::primitive::RowTanh(cy_ptr + offset, gog, hidden_size);
+            for (int64_t j = 0; j < hidden_size; ++j) {
+              const T go = grad_hy_ptr[offset + j];
+              const T tanh_cy = gog[j];
+              const T gcx = go * og[j] * (1 - tanh_cy * tanh_cy) + grad_cy_ptr[offset + j];
+              gig[j] = gcx * cg[j] * (1 - ig[j]) * ig[j];
+              gfg[j] = gcx * cx_ptr[offset + j] * (1 - fg[j]) * fg[j];
+              gcg[j] = gcx * ig[j] * (1 - cg[j] * cg[j]);
+              gog[j] = go * tanh_cy * (1 - og[j]) * og[j];
+              if (grad_cx_ptr != nullptr) { grad_cx_ptr[offset + j] = gcx * fg[j]; }
+            }
+          }
+        },
+        ep::GetParallelForGrainSize(4 * hidden_size * ep::parallel_for_cost::kElementwise));
+
+    if (ctx->has_output("grad_bias", 0)) {
+      SumRows(ctx->stream(), grad_gates_ptr, batch_size, 4 * hidden_size,
+              ctx->Tensor4ArgNameAndIndex("grad_bias", 0)->mut_dptr<T>());
+    }
+  }
+
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+template<typename T>
+class CpuFusedGruCellKernel final : public user_op::OpKernel {
+ public:
+  CpuFusedGruCellKernel() = default;
+  ~CpuFusedGruCellKernel() = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* input_gates = ctx->Tensor4ArgNameAndIndex("input_gates", 0);
+    const user_op::Tensor* hidden_gates = ctx->Tensor4ArgNameAndIndex("hidden_gates", 0);
+    const user_op::Tensor* hx = ctx->Tensor4ArgNameAndIndex("hx", 0);
+    user_op::Tensor* hy = ctx->Tensor4ArgNameAndIndex("hy", 0);
+    user_op::Tensor* workspace = ctx->Tensor4ArgNameAndIndex("workspace", 0);
+
+    const T* input_bias_ptr = nullptr;
+    const T* hidden_bias_ptr = nullptr;
+    if (ctx->has_input("input_bias", 0)) {
+      CHECK(ctx->has_input("hidden_bias", 0));
+      input_bias_ptr = ctx->Tensor4ArgNameAndIndex("input_bias", 0)->dptr<T>();
+      hidden_bias_ptr = ctx->Tensor4ArgNameAndIndex("hidden_bias", 0)->dptr<T>();
+    }
+    const T* input_gates_ptr = input_gates->dptr<T>();
+    const T* hidden_gates_ptr = hidden_gates->dptr<T>();
+    const T* hx_ptr = hx->dptr<T>();
+    T* hy_ptr = hy->mut_dptr<T>();
+    T* workspace_ptr = workspace->mut_dptr<T>();
+    const int64_t hidden_size = hx->shape_view().At(hx->shape_view().NumAxes() - 1);
+    const int64_t batch_size = hx->shape_view().elem_cnt() / hidden_size;
+    ctx->stream()->As<ep::CpuStream>()->ParallelFor(
+        0, batch_size,
+        [&](int64_t begin, int64_t end) {
+          for (int64_t row = begin; row < end; ++row) {
+            const int64_t offset = row * hidden_size;
+            const T* input_gates_row = input_gates_ptr + 3 * offset;
+            const T* hidden_gates_row = hidden_gates_ptr + 3 * offset;
+            // workspace (rg, ig, ng, hx, hn + b2n)
+            T* rg = workspace_ptr + 5 * offset;
+            T* ig = rg + hidden_size;
+            T* ng = rg + 2 * hidden_size;
+            T* ws_hx = rg + 3 * hidden_size;
+            T* ws_hn = rg + 4 * hidden_size;
+            AddGates(input_gates_row, hidden_gates_row, input_bias_ptr, hidden_bias_ptr, rg,
+                     2 * hidden_size);
+            ep::primitive::RowSigmoid(rg, rg, 2 * hidden_size);
+            const T* in = input_gates_row + 2 * hidden_size;
+            const T* hn = hidden_gates_row + 2 * hidden_size;
+            for (int64_t j = 0; j < hidden_size; ++j) {
+              const T b1n = input_bias_ptr != nullptr ? input_bias_ptr[2 * hidden_size + j] : 0;
+              const T b2n = hidden_bias_ptr != nullptr ? hidden_bias_ptr[2 * hidden_size + j] : 0;
+              ws_hn[j] = hn[j] + b2n;
+              ng[j] = in[j] + b1n + rg[j] * ws_hn[j];
+            }
+            ep::primitive::RowTanh(ng, ng, hidden_size);
+            const T* hx_row = hx_ptr + offset;
+            T* hy_row = hy_ptr + offset;
+            for (int64_t j = 0; j < hidden_size; ++j) {
+              ws_hx[j] = hx_row[j];
+              hy_row[j] = ng[j] + ig[j] * (hx_row[j] - ng[j]);
+            }
+          }
+        },
+        ep::GetParallelForGrainSize(3 * hidden_size * ep::parallel_for_cost::kTranscendental));
+  }
+
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+template<typename T>
+class CpuFusedGruCellGradKernel final : public user_op::OpKernel {
+ public:
+  CpuFusedGruCellGradKernel() = default;
+  ~CpuFusedGruCellGradKernel() = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* grad_hy = ctx->Tensor4ArgNameAndIndex("grad_hy", 0);
+    const user_op::Tensor* workspace = ctx->Tensor4ArgNameAndIndex("workspace", 0);
+    user_op::Tensor* grad_input_gates = ctx->Tensor4ArgNameAndIndex("grad_input_gates", 0);
+    user_op::Tensor* grad_hidden_gates = ctx->Tensor4ArgNameAndIndex("grad_hidden_gates", 0);
+
+    const T* grad_hy_ptr = grad_hy->dptr<T>();
+    const T* workspace_ptr = workspace->dptr<T>();
+    T* grad_input_gates_ptr = grad_input_gates->mut_dptr<T>();
+    T* grad_hidden_gates_ptr = grad_hidden_gates->mut_dptr<T>();
+    T* grad_hx_ptr = nullptr;
+    if (ctx->has_output("grad_hx", 0)) {
+      grad_hx_ptr = ctx->Tensor4ArgNameAndIndex("grad_hx", 0)->mut_dptr<T>();
+    }
+    const int64_t hidden_size = grad_hy->shape_view().At(grad_hy->shape_view().NumAxes() - 1);
+    const int64_t batch_size = grad_hy->shape_view().elem_cnt() / hidden_size;
+    ctx->stream()->As<ep::CpuStream>()->ParallelFor(
+        0, batch_size,
+        [&](int64_t begin, int64_t end) {
+          for (int64_t row = begin; row < end; ++row) {
+            const int64_t offset = row * hidden_size;
+            const T* rg = workspace_ptr + 5 * offset;
+            const T* ig = rg + hidden_size;
+            const T* ng = rg + 2 * hidden_size;
+            const T* hx = rg + 3 * hidden_size;
+            const T* hn = rg + 4 * hidden_size;
+            T* grad_input_gates_row = grad_input_gates_ptr + 3 * offset;
+            T* grad_hidden_gates_row = grad_hidden_gates_ptr + 3 * offset;
+            for (int64_t j = 0; j < hidden_size; ++j) {
+              const T go = grad_hy_ptr[offset + j];
+              const T gig = go * (hx[j] - ng[j]) * (1 - ig[j]) * ig[j];
+              const T gin = go * (1 - ig[j]) * (1 - ng[j] * ng[j]);
+              const T grg = gin * hn[j] * (1 - rg[j]) * rg[j];
+              grad_input_gates_row[j] = grg;
+              grad_input_gates_row[hidden_size + j] = gig;
+              grad_input_gates_row[2 * hidden_size + j] = gin;
+              grad_hidden_gates_row[j] = grg;
+              grad_hidden_gates_row[hidden_size + j] = gig;
+              grad_hidden_gates_row[2 * hidden_size + j] = gin * rg[j];
+              if (grad_hx_ptr != nullptr) { grad_hx_ptr[offset + j] = go * ig[j]; }
+            }
+          }
+        },
+        ep::GetParallelForGrainSize(6 * hidden_size * ep::parallel_for_cost::kElementwise));
+
+    if (ctx->has_output("grad_input_bias", 0) && ctx->has_output("grad_hidden_bias", 0)) {
+      SumRows(ctx->stream(), grad_input_gates_ptr, batch_size, 3 * hidden_size,
+              ctx->Tensor4ArgNameAndIndex("grad_input_bias", 0)->mut_dptr<T>());
+      SumRows(ctx->stream(), grad_hidden_gates_ptr, batch_size, 3 * hidden_size,
+              ctx->Tensor4ArgNameAndIndex("grad_hidden_bias", 0)->mut_dptr<T>());
+    }
+  }
+
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+}  // namespace
+
+#define REGISTER_FUSED_LSTM_CELL_CPU_KERNEL(dtype)                                              \
+  REGISTER_USER_KERNEL("fused_lstm_cell")                                                       \
+      .SetCreateFn<CpuFusedLstmCellKernel<dtype>>()                                             \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                           \
+                       && (user_op::HobDataType("cx", 0) == GetDataType<dtype>::value)          \
+                       && (user_op::HobDataType("input_gates", 0) == GetDataType<dtype>::value) \
+                       && (user_op::HobDataType("hidden_gates", 0) == GetDataType<dtype>::value))
+
+#define REGISTER_FUSED_LSTM_CELL_GRAD_CPU_KERNEL(dtype)                                     \
+  REGISTER_USER_KERNEL("fused_lstm_cell_grad")                                              \
+      .SetCreateFn<CpuFusedLstmCellGradKernel<dtype>>()                                     \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                       \
+                       && (user_op::HobDataType("grad_hy", 0) == GetDataType<dtype>::value) \
+                       && (user_op::HobDataType("workspace", 0) == GetDataType<dtype>::value))
+
+#define REGISTER_FUSED_GRU_CELL_CPU_KERNEL(dtype)                                               \
+  REGISTER_USER_KERNEL("fused_gru_cell")                                                        \
+      .SetCreateFn<CpuFusedGruCellKernel<dtype>>()                                              \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                           \
+                       && (user_op::HobDataType("hx", 0) == GetDataType<dtype>::value)          \
+                       && (user_op::HobDataType("input_gates", 0) == GetDataType<dtype>::value) \
+                       && (user_op::HobDataType("hidden_gates", 0) == GetDataType<dtype>::value))
+
+#define REGISTER_FUSED_GRU_CELL_GRAD_CPU_KERNEL(dtype)                                      \
+  REGISTER_USER_KERNEL("fused_gru_cell_grad")                                               \
+      .SetCreateFn<CpuFusedGruCellGradKernel<dtype>>()                                      \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                       \
+                       && (user_op::HobDataType("grad_hy", 0) == GetDataType<dtype>::value) \
+                       && (user_op::HobDataType("workspace", 0) == GetDataType<dtype>::value))
+
+REGISTER_FUSED_LSTM_CELL_CPU_KERNEL(float);
+REGISTER_FUSED_LSTM_CELL_CPU_KERNEL(double);
+REGISTER_FUSED_LSTM_CELL_GRAD_CPU_KERNEL(float);
+REGISTER_FUSED_LSTM_CELL_GRAD_CPU_KERNEL(double);
+REGISTER_FUSED_GRU_CELL_CPU_KERNEL(float);
+REGISTER_FUSED_GRU_CELL_CPU_KERNEL(double);
+REGISTER_FUSED_GRU_CELL_GRAD_CPU_KERNEL(float);
+REGISTER_FUSED_GRU_CELL_GRAD_CPU_KERNEL(double);
+
+}  // namespace oneflow
@@ -0,0 +1,239 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/user/kernels/fused_softmax_cpu_util.h"
+
+namespace oneflow {
+
+namespace {
+
+// Writes mask ? x * scale : fill of a row.
+template<typename T, typename MASK>
+struct ScaleMaskLoad {
+  const T* x;
+  const MASK* mask;
+  fused_softmax::BroadcastMaskRowOffset mask_row_offset;
+  int64_t cols;
+  T fill;
+  T scale;
+
+  void operator()(int64_t row, T* dst) const {
+    const T* x_row = x + row * cols;
+    const MASK* mask_row = mask + mask_row_offset(row);
+    for (int64_t col = 0; col < cols; ++col) {
+      dst[col] = mask_row[col] ? x_row[col] * scale : fill;
+    }
+  }
+};
+
+// Stores mask ? src * scale : 0 of a row.
+template<typename T, typename MASK>
+struct ScaleMaskStore {
+  T* dx;
+  const MASK* mask;
+  fused_softmax::BroadcastMaskRowOffset mask_row_offset;
+  int64_t cols;
+  T scale;
+
+  void operator()(int64_t row, const T* src) const {
+    T* dx_row = dx + row * cols;
+    const MASK* mask_row = mask + mask_row_offset(row);
+    for (int64_t col = 0; col < cols; ++col) {
+      dx_row[col] = mask_row[col] ? src[col] * scale : static_cast<T>(0);
+    }
+  }
+};
+
+// Writes src * dropout_mask * dropout_scale of a row.
+template<typename T>
+struct DropoutLoad {
+  const T* src;
+  const bool* dropout_mask;
+  int64_t cols;
+  T dropout_scale;
+
+  void operator()(int64_t row, T* dst) const {
+    const int64_t offset = row * cols;
+    for (int64_t col = 0; col < cols; ++col) {
+      dst[col] = dropout_mask[offset + col] ? src[offset + col] * dropout_scale : static_cast<T>(0);
+    }
+  }
+};
+
+// Stores the softmax of a row and its dropout.
+template<typename T>
+struct DropoutStore {
+  T* y;
+  T* softmax_y;
+  const bool* dropout_mask;
+  int64_t cols;
+  T dropout_scale;
+
+  void operator()(int64_t row, const T* src) const {
+    const int64_t offset = row * cols;
+    for (int64_t col = 0; col < cols; ++col) {
+      softmax_y[offset + col] = src[col];
+      y[offset + col] = dropout_mask[offset + col] ? src[col] * dropout_scale : static_cast<T>(0);
+    }
+  }
+};
+
+template<typename T, typename MASK>
+class FusedScaleMaskSoftmaxCpuKernel final : public user_op::OpKernel {
+ public:
+  FusedScaleMaskSoftmaxCpuKernel() = default;
+  ~FusedScaleMaskSoftmaxCpuKernel() override = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    const user_op::Tensor* mask = ctx->Tensor4ArgNameAndIndex("mask", 0);
+    user_op::Tensor* y = ctx->Tensor4ArgNameAndIndex("y", 0);
+    const ShapeView& x_shape = x->shape_view();
+    CHECK_GE(x_shape.NumAxes(), 2);
+    const int64_t cols = x_shape.At(x_shape.NumAxes() - 1);
+    const int64_t rows = x_shape.Count(0, x_shape.NumAxes() - 1);
+    ScaleMaskLoad<T, MASK> load{x->dptr<T>(),
+                                mask->dptr<MASK>(),
+                                fused_softmax::BroadcastMaskRowOffset(x_shape, mask->shape_view()),
+                                cols,
+                                static_cast<T>(ctx->Attr<float>("mask_fill_value")),
+                                static_cast<T>(ctx->Attr<float>("scale_value"))};
+    fused_softmax::DirectStore<T> store{y->mut_dptr<T>(), cols};
+    fused_softmax::SoftmaxRows<T>(ctx->stream(), rows, cols, load, store);
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+template<typename T, typename MASK>
+class FusedScaleMaskSoftmaxGradCpuKernel final : public user_op::OpKernel {
+ public:
+  FusedScaleMaskSoftmaxGradCpuKernel() = default;
+  ~FusedScaleMaskSoftmaxGradCpuKernel() override = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* y = ctx->Tensor4ArgNameAndIndex("y", 0);
+    const user_op::Tensor* dy = ctx->Tensor4ArgNameAndIndex("dy", 0);
+    const user_op::Tensor* mask = ctx->Tensor4ArgNameAndIndex("mask", 0);
+    user_op::Tensor* dx = ctx->Tensor4ArgNameAndIndex("dx", 0);
+    const ShapeView& dy_shape = dy->shape_view();
+    CHECK_GE(dy_shape.NumAxes(), 2);
+    const int64_t cols = dy_shape.At(dy_shape.NumAxes() - 1);
+    const int64_t rows = dy_shape.Count(0, dy_shape.NumAxes() - 1);
+    fused_softmax::DirectLoad<T> load_y{y->dptr<T>(), cols};
+    fused_softmax::DirectLoad<T> load_dy{dy->dptr<T>(), cols};
+    ScaleMaskStore<T, MASK> store{
+        dx->mut_dptr<T>(), mask->dptr<MASK>(),
+        fused_softmax::BroadcastMaskRowOffset(dy_shape, mask->shape_view()), cols,
+        static_cast<T>(ctx->Attr<float>("scale_value"))};
+    fused_softmax::SoftmaxGradRows<T>(ctx->stream(), rows, cols, load_y, load_dy, store);
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+template<typename T, typename MASK>
+class FusedScaleMaskSoftmaxDropoutCpuKernel final : public user_op::OpKernel {
+ public:
+  FusedScaleMaskSoftmaxDropoutCpuKernel() = default;
+  ~FusedScaleMaskSoftmaxDropoutCpuKernel() override = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    const user_op::Tensor* mask = ctx->Tensor4ArgNameAndIndex("mask", 0);
+    const user_op::Tensor* dropout_mask = ctx->Tensor4ArgNameAndIndex("dropout_mask", 0);
+    user_op::Tensor* y = ctx->Tensor4ArgNameAndIndex("y", 0);
+    user_op::Tensor* softmax_y = ctx->Tensor4ArgNameAndIndex("softmax_y", 0);
+    const ShapeView& x_shape = x->shape_view();
+    CHECK_GE(x_shape.NumAxes(), 2);
+    const int64_t cols = x_shape.At(x_shape.NumAxes() - 1);
+    const int64_t rows = x_shape.Count(0, x_shape.NumAxes() - 1);
+    ScaleMaskLoad<T, MASK> load{x->dptr<T>(),
+                                mask->dptr<MASK>(),
+                                fused_softmax::BroadcastMaskRowOffset(x_shape, mask->shape_view()),
+                                cols,
+                                static_cast<T>(ctx->Attr<float>("mask_fill_value")),
+                                static_cast<T>(ctx->Attr<float>("scale_value"))};
+    DropoutStore<T> store{y->mut_dptr<T>(), softmax_y->mut_dptr<T>(), dropout_mask->dptr<bool>(),
+                          cols, static_cast<T>(ctx->Attr<float>("dropout_scale_value"))};
+    fused_softmax::SoftmaxRows<T>(ctx->stream(), rows, cols, load, store);
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+template<typename T, typename MASK>
+class FusedScaleMaskSoftmaxDropoutGradCpuKernel final : public user_op::OpKernel {
+ public:
+  FusedScaleMaskSoftmaxDropoutGradCpuKernel() = default;
+  ~FusedScaleMaskSoftmaxDropoutGradCpuKernel() override = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* softmax_y = ctx->Tensor4ArgNameAndIndex("softmax_y", 0);
+    const user_op::Tensor* dy = ctx->Tensor4ArgNameAndIndex("dy", 0);
+    const user_op::Tensor* mask = ctx->Tensor4ArgNameAndIndex("mask", 0);
+    const user_op::Tensor* dropout_mask = ctx->Tensor4ArgNameAndIndex("dropout_mask", 0);
+    user_op::Tensor* dx = ctx->Tensor4ArgNameAndIndex("dx", 0);
+    const ShapeView& dy_shape = dy->shape_view();
+    CHECK_GE(dy_shape.NumAxes(), 2);
+    const int64_t cols = dy_shape.At(dy_shape.NumAxes() - 1);
+    const int64_t rows = dy_shape.Count(0, dy_shape.NumAxes() - 1);
+    fused_softmax::DirectLoad<T> load_softmax_y{softmax_y->dptr<T>(), cols};
+    DropoutLoad<T> load_dy{dy->dptr<T>(), dropout_mask->dptr<bool>(), cols,
+                           static_cast<T>(ctx->Attr<float>("dropout_scale_value"))};
+    ScaleMaskStore<T, MASK> store{
+        dx->mut_dptr<T>(), mask->dptr<MASK>(),
+        fused_softmax::BroadcastMaskRowOffset(dy_shape, mask->shape_view()), cols,
+        static_cast<T>(ctx->Attr<float>("scale_value"))};
+    fused_softmax::SoftmaxGradRows<T>(ctx->stream(), rows, cols, load_softmax_y, load_dy, store);
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+}  // namespace
+
+#define REGISTER_FUSED_SCALE_MASK_SOFTMAX_CPU_KERNEL(dtype, mask_dtype)                         \
+  REGISTER_USER_KERNEL("fused_scale_mask_softmax")                                              \
+      .SetCreateFn<FusedScaleMaskSoftmaxCpuKernel<dtype, mask_dtype>>()                         \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                           \
+                       && (user_op::HobDataType("x", 0) == GetDataType<dtype>::value)           \
+                       && (user_op::HobDataType("mask", 0) == GetDataType<mask_dtype>::value)); \
+  REGISTER_USER_KERNEL("fused_scale_mask_softmax_grad")                                         \
+      .SetCreateFn<FusedScaleMaskSoftmaxGradCpuKernel<dtype, mask_dtype>>()                     \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                           \
+                       && (user_op::HobDataType("dy", 0) == GetDataType<dtype>::value)          \
+                       && (user_op::HobDataType("mask", 0) == GetDataType<mask_dtype>::value)); \
+  REGISTER_USER_KERNEL("fused_scale_mask_softmax_dropout")                                      \
+      .SetCreateFn<FusedScaleMaskSoftmaxDropoutCpuKernel<dtype, mask_dtype>>()                  \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                           \
+                       && (user_op::HobDataType("x", 0) == GetDataType<dtype>::value)           \
+                       && (user_op::HobDataType("mask", 0) == GetDataType<mask_dtype>::value)); \
+  REGISTER_USER_KERNEL("fused_scale_mask_softmax_dropout_grad")                                 \
+      .SetCreateFn<FusedScaleMaskSoftmaxDropoutGradCpuKernel<dtype, mask_dtype>>()              \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                           \
+                       && (user_op::HobDataType("dx", 0) == GetDataType<dtype>::value)          \
+                       && (user_op::HobDataType("mask", 0) == GetDataType<mask_dtype>::value));
+
+REGISTER_FUSED_SCALE_MASK_SOFTMAX_CPU_KERNEL(float, bool)
+REGISTER_FUSED_SCALE_MASK_SOFTMAX_CPU_KERNEL(double, bool)
+#undef REGISTER_FUSED_SCALE_MASK_SOFTMAX_CPU_KERNEL
+
+}  // namespace oneflow
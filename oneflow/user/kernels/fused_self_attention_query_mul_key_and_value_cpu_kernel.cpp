@@ -0,0 +1,157 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/user/kernels/simd_pack.h"
+
+namespace oneflow {
+
+namespace {
+
+// hidden_states is laid out as (s, b, n, 3, h), every task below owns one (b, n, s) row of q, k
+// and v, so the kernels need no transposed copies of them.
+struct HiddenStatesIndexer {
+  int64_t batch_size;
+  int64_t num_heads;
+  int64_t head_size;
+
+  // Offset of the q of (b, n, s), k and v follow it at head_size and 2 * head_size.
+  int64_t operator()(int64_t b, int64_t n, int64_t s) const {
+    return ((s * batch_size + b) * num_heads + n) * 3 * head_size;
+  }
+};
+
+template<typename T>
+class FusedSelfAttentionQueryMulKeyAndValueCpuKernel final : public user_op::OpKernel {
+ public:
+  FusedSelfAttentionQueryMulKeyAndValueCpuKernel() = default;
+  ~FusedSelfAttentionQueryMulKeyAndValueCpuKernel() override = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* h_tensor = ctx->Tensor4ArgNameAndIndex("hidden_states", 0);
+    user_op::Tensor* qmk_tensor = ctx->Tensor4ArgNameAndIndex("query_mul_key", 0);
+    user_op::Tensor* v_tensor = ctx->Tensor4ArgNameAndIndex("value", 0);
+    const int64_t seq_len = h_tensor->shape_view().At(0);
+    const int64_t batch_size = h_tensor->shape_view().At(1);
+    const int64_t hidden_size = h_tensor->shape_view().At(2);
+    const int64_t head_size = ctx->Attr<int64_t>("head_size");
+    const int64_t num_heads = hidden_size / (3 * head_size);
+    const T alpha = static_cast<T>(ctx->Attr<float>("alpha"));
+    const HiddenStatesIndexer indexer{batch_size, num_heads, head_size};
+    const T* h_ptr = h_tensor->dptr<T>();
+    T* qmk_ptr = qmk_tensor->mut_dptr<T>();
+    T* v_ptr = v_tensor->mut_dptr<T>();
+    // query_mul_key (b, n, sq, sk) and value (b, n, s, h), one (b, n, s) row per task
+    ctx->stream()->As<ep::CpuStream>()->ParallelFor(
+        0, batch_size * num_heads * seq_len,
+        [&](int64_t begin, int64_t end) {
+          for (int64_t row = begin; row < end; ++row) {
+            const int64_t i = row % seq_len;
+            const int64_t n = row / seq_len % num_heads;
+            const int64_t b = row / seq_len / num_heads;
+            const T* q = h_ptr + indexer(b, n, i);
+            T* qmk_row = qmk_ptr + row * seq_len;
+            for (int64_t j = 0; j < seq_len; ++j) {
+              qmk_row[j] = alpha * SimdDot(q, h_ptr + indexer(b, n, j) + head_size, head_size);
+            }
+            const T* v = q + 2 * head_size;
+            std::copy(v, v + head_size, v_ptr + row * head_size);
+          }
+        },
+        ep::GetParallelForGrainSize((seq_len + 1) * head_size
+                                    * ep::parallel_for_cost::kElementwise));
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+template<typename T>
+class FusedSelfAttentionQueryMulKeyAndValueGradCpuKernel final : public user_op::OpKernel {
+ public:
+  FusedSelfAttentionQueryMulKeyAndValueGradCpuKernel() = default;
+  ~FusedSelfAttentionQueryMulKeyAndValueGradCpuKernel() override = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* v_grad_tensor = ctx->Tensor4ArgNameAndIndex("value_grad", 0);
+    const user_op::Tensor* qmk_grad_tensor = ctx->Tensor4ArgNameAndIndex("query_mul_key_grad", 0);
+    const user_op::Tensor* h_tensor = ctx->Tensor4ArgNameAndIndex("hidden_states", 0);
+    user_op::Tensor* h_grad_tensor = ctx->Tensor4ArgNameAndIndex("hidden_states_grad", 0);
+    const T alpha = static_cast<T>(ctx->Attr<float>("alpha"));
+    const int64_t seq_len = h_grad_tensor->shape_view().At(0);
+    const int64_t batch_size = h_grad_tensor->shape_view().At(1);
+    const int64_t hidden_size = h_grad_tensor->shape_view().At(2);
+    const int64_t num_heads = v_grad_tensor->shape_view().At(1);
+    const int64_t head_size = v_grad_tensor->shape_view().At(3);
+    CHECK_EQ(hidden_size, num_heads * 3 * head_size);
+    const HiddenStatesIndexer indexer{batch_size, num_heads, head_size};
+    const T* h_ptr = h_tensor->dptr<T>();
+    const T* v_grad_ptr = v_grad_tensor->dptr<T>();
+    const T* qmk_grad_ptr = qmk_grad_tensor->dptr<T>();
+    T* h_grad_ptr = h_grad_tensor->mut_dptr<T>();
+    // The task of row s of (b, n) writes grad_q of s from row s of grad_qmk, grad_k of s from
+    // column s of grad_qmk and grad_v of s, so every task owns the rows it writes.
+    ctx->stream()->As<ep::CpuStream>()->ParallelFor(
+        0, batch_size * num_heads * seq_len,
+        [&](int64_t begin, int64_t end) {
+          for (int64_t row = begin; row < end; ++row) {
+            const int64_t s = row % seq_len;
+            const int64_t n = row / seq_len % num_heads;
+            const int64_t b = row / seq_len / num_heads;
+            const T* qmk_grad = qmk_grad_ptr + (row - s) * seq_len;
+            T* grad_q = h_grad_ptr + indexer(b, n, s);
+            T* grad_k = grad_q + head_size;
+            T* grad_v = grad_q + 2 * head_size;
+            std::fill(grad_q, grad_q + 2 * head_size, static_cast<T>(0));
+            for (int64_t j = 0; j < seq_len; ++j) {
+              const T* h = h_ptr + indexer(b, n, j);
+              // grad_q = alpha * grad_qmk * k
+              SimdAxpy(head_size, alpha * qmk_grad[s * seq_len + j], h + head_size, grad_q);
+              // grad_k = alpha * grad_qmk^T * q
+              SimdAxpy(head_size, alpha * qmk_grad[j * seq_len + s], h, grad_k);
+            }
+            const T* v_grad = v_grad_ptr + row * head_size;
+            std::copy(v_grad, v_grad + head_size, grad_v);
+          }
+        },
+        ep::GetParallelForGrainSize((2 * seq_len + 1) * head_size
+                                    * ep::parallel_for_cost::kElementwise));
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+}  // namespace
+
+#define REGISTER_FUSED_SELF_ATTENTION_QUERY_MUL_KEY_AND_VALUE_CPU_KERNEL(dtype) \
+  REGISTER_USER_KERNEL("fused_self_attention_query_mul_key_and_value")          \
+      .SetCreateFn<FusedSelfAttentionQueryMulKeyAndValueCpuKernel<dtype>>()     \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)           \
+                       && (user_op::HobDataType("hidden_states", 0) == GetDataType<dtype>::value));
+
+#define REGISTER_FUSED_SELF_ATTENTION_QUERY_MUL_KEY_AND_VALUE_GRAD_CPU_KERNEL(dtype) \
+  REGISTER_USER_KERNEL("fused_self_attention_query_mul_key_and_value_grad")          \
+      .SetCreateFn<FusedSelfAttentionQueryMulKeyAndValueGradCpuKernel<dtype>>()      \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                \
+                       && (user_op::HobDataType("hidden_states", 0) == GetDataType<dtype>::value));
+
+REGISTER_FUSED_SELF_ATTENTION_QUERY_MUL_KEY_AND_VALUE_CPU_KERNEL(float)
+REGISTER_FUSED_SELF_ATTENTION_QUERY_MUL_KEY_AND_VALUE_CPU_KERNEL(double)
+REGISTER_FUSED_SELF_ATTENTION_QUERY_MUL_KEY_AND_VALUE_GRAD_CPU_KERNEL(float)
+REGISTER_FUSED_SELF_ATTENTION_QUERY_MUL_KEY_AND_VALUE_GRAD_CPU_KERNEL(double)
+
+}  // namespace oneflow
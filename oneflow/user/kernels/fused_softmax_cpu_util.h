@@ -0,0 +1,124 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_FUSED_SOFTMAX_CPU_UTIL_H_
+#define ONEFLOW_USER_KERNELS_FUSED_SOFTMAX_CPU_UTIL_H_
+
+#include "oneflow/core/common/shape_view.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/core/ep/cpu/primitive/vectorized_math.h"
+
+namespace oneflow {
+
+namespace fused_softmax {
+
+// Offset of the mask row of every row of x, where the mask is broadcast to x on all axes but the
+// last one, as in fused_scale_mask_softmax.
+class BroadcastMaskRowOffset {
+ public:
+  BroadcastMaskRowOffset(const ShapeView& x_shape, const ShapeView& mask_shape) {
+    const int64_t num_axes = x_shape.NumAxes();
+    const int64_t num_padding_axes = num_axes - mask_shape.NumAxes();
+    CHECK_GE(num_padding_axes, 0);
+    int64_t mask_stride = mask_shape.At(mask_shape.NumAxes() - 1);
+    for (int64_t axis = num_axes - 2; axis >= 0; --axis) {
+      const int64_t mask_dim = axis < num_padding_axes ? 1 : mask_shape.At(axis - num_padding_axes);
+      CHECK(mask_dim == 1 || mask_dim == x_shape.At(axis));
+      x_dims_.insert(x_dims_.begin(), x_shape.At(axis));
+      mask_strides_.insert(mask_strides_.begin(), mask_dim == 1 ? 0 : mask_stride);
+      mask_stride *= mask_dim;
+    }
+  }
+
+  int64_t operator()(int64_t row) const {
+    int64_t offset = 0;
+    for (int64_t i = static_cast<int64_t>(x_dims_.size()) - 1; i >= 0; --i) {
+      offset += row % x_dims_[i] * mask_strides_[i];
+      row /= x_dims_[i];
+    }
+    return offset;
+  }
+
+ private:
+  std::vector<int64_t> x_dims_;
+  std::vector<int64_t> mask_strides_;
+};
+
+// Loads and stores of rows of a contiguous (rows, cols) tensor, for SoftmaxRows and
+// SoftmaxGradRows.
+template<typename T>
+struct DirectLoad {
+  const T* src;
+  int64_t cols;
+
+  void operator()(int64_t row, T* dst) const {
+    std::copy(src + row * cols, src + (row + 1) * cols, dst);
+  }
+};
+
+template<typename T>
+struct DirectStore {
+  T* dst;
+  int64_t cols;
+
+  void operator()(int64_t row, const T* src) const { std::copy(src, src + cols, dst + row * cols); }
+};
+
+// Softmax of rows of cols values. load(row, x) writes the input of the row to x and
+// store(row, y) consumes its softmax.
+template<typename T, typename Load, typename Store>
+void SoftmaxRows(ep::Stream* stream, int64_t rows, int64_t cols, const Load& load,
+                 const Store& store) {
+  stream->As<ep::CpuStream>()->ParallelFor(
+      0, rows,
+      [&](int64_t begin, int64_t end) {
+        std::vector<T> buf(cols);
+        for (int64_t row = begin; row < end; ++row) {
+          load(row, buf.data());
+          const T max = ep::primitive::RowMax(buf.data(), cols);
+          const T inv_sum = 1 / ep::primitive::ExpAndSum(buf.data(), max, buf.data(), cols);
+          for (int64_t col = 0; col < cols; ++col) { buf[col] *= inv_sum; }
+          store(row, buf.data());
+        }
+      },
+      ep::GetParallelForGrainSize(cols * ep::parallel_for_cost::kTranscendental));
+}
+
+// Softmax grad of rows, dx = y * (dy - sum(y * dy)). load_y(row, y) and load_dy(row, dy) write the
+// inputs of the row, store(row, dx) consumes its grad.
+template<typename T, typename LoadY, typename LoadDy, typename Store>
+void SoftmaxGradRows(ep::Stream* stream, int64_t rows, int64_t cols, const LoadY& load_y,
+                     const LoadDy& load_dy, const Store& store) {
+  stream->As<ep::CpuStream>()->ParallelFor(
+      0, rows,
+      [&](int64_t begin, int64_t end) {
+        std::vector<T> y(cols);
+        std::vector<T> dy(cols);
+        for (int64_t row = begin; row < end; ++row) {
+          load_y(row, y.data());
+          load_dy(row, dy.data());
+          const T dot = ep::primitive::RowDot(y.data(), dy.data(), cols);
+          for (int64_t col = 0; col < cols; ++col) { dy[col] = y[col] * (dy[col] - dot); }
+          store(row, dy.data());
+        }
+      },
+      ep::GetParallelForGrainSize(cols * 3 * ep::parallel_for_cost::kElementwise));
+}
+
+}  // namespace fused_softmax
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_FUSED_SOFTMAX_CPU_UTIL_H_
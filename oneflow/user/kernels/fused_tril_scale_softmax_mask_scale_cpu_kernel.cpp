@@ -0,0 +1,170 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/user/kernels/fused_softmax_cpu_util.h"
+
+namespace oneflow {
+
+namespace {
+
+// Writes col > tril_row + diagonal ? fill : x * scale of a row.
+template<typename T>
+struct TrilScaleLoad {
+  const T* x;
+  int64_t tril_num_rows;
+  int64_t cols;
+  int64_t diagonal;
+  T fill;
+  T scale;
+
+  void operator()(int64_t row, T* dst) const {
+    const T* x_row = x + row * cols;
+    const int64_t num_valid =
+        std::max<int64_t>(std::min<int64_t>(row % tril_num_rows + diagonal + 1, cols), 0);
+    for (int64_t col = 0; col < num_valid; ++col) { dst[col] = x_row[col] * scale; }
+    std::fill(dst + num_valid, dst + cols, fill);
+  }
+};
+
+// Stores col > tril_row + diagonal ? 0 : src * scale of a row.
+template<typename T>
+struct TrilScaleStore {
+  T* dx;
+  int64_t tril_num_rows;
+  int64_t cols;
+  int64_t diagonal;
+  T scale;
+
+  void operator()(int64_t row, const T* src) const {
+    T* dx_row = dx + row * cols;
+    const int64_t num_valid =
+        std::max<int64_t>(std::min<int64_t>(row % tril_num_rows + diagonal + 1, cols), 0);
+    for (int64_t col = 0; col < num_valid; ++col) { dx_row[col] = src[col] * scale; }
+    std::fill(dx_row + num_valid, dx_row + cols, static_cast<T>(0));
+  }
+};
+
+// Writes src * mask * scale of a row.
+template<typename T>
+struct MaskAndScaleLoad {
+  const T* src;
+  const bool* mask;
+  int64_t cols;
+  T scale;
+
+  void operator()(int64_t row, T* dst) const {
+    const int64_t offset = row * cols;
+    for (int64_t col = 0; col < cols; ++col) {
+      dst[col] = mask[offset + col] ? src[offset + col] * scale : static_cast<T>(0);
+    }
+  }
+};
+
+// Stores the softmax of a row and its product with mask * scale.
+template<typename T>
+struct MaskAndScaleStore {
+  T* y;
+  T* softmax_y;
+  const bool* mask;
+  int64_t cols;
+  T scale;
+
+  void operator()(int64_t row, const T* src) const {
+    const int64_t offset = row * cols;
+    for (int64_t col = 0; col < cols; ++col) {
+      softmax_y[offset + col] = src[col];
+      y[offset + col] = mask[offset + col] ? src[col] * scale : static_cast<T>(0);
+    }
+  }
+};
+
+template<typename T>
+class FusedTrilScaleSoftmaxMaskScaleCpuKernel final : public user_op::OpKernel {
+ public:
+  FusedTrilScaleSoftmaxMaskScaleCpuKernel() = default;
+  ~FusedTrilScaleSoftmaxMaskScaleCpuKernel() override = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    const user_op::Tensor* mask = ctx->Tensor4ArgNameAndIndex("mask", 0);
+    user_op::Tensor* y = ctx->Tensor4ArgNameAndIndex("y", 0);
+    user_op::Tensor* softmax_y = ctx->Tensor4ArgNameAndIndex("softmax_y", 0);
+    const ShapeView& x_shape = x->shape_view();
+    CHECK_GE(x_shape.NumAxes(), 2);
+    const int64_t cols = x_shape.At(x_shape.NumAxes() - 1);
+    const int64_t rows = x_shape.Count(0, x_shape.NumAxes() - 1);
+    const int64_t tril_num_rows = x_shape.At(x_shape.NumAxes() - 2);
+    TrilScaleLoad<T> load{x->dptr<T>(),
+                          tril_num_rows,
+                          cols,
+                          ctx->Attr<int64_t>("diagonal"),
+                          static_cast<T>(ctx->Attr<float>("tril_fill_value")),
+                          static_cast<T>(ctx->Attr<float>("tril_scale_value"))};
+    MaskAndScaleStore<T> store{y->mut_dptr<T>(), softmax_y->mut_dptr<T>(), mask->dptr<bool>(),
+                               cols, static_cast<T>(ctx->Attr<float>("mask_scale_value"))};
+    fused_softmax::SoftmaxRows<T>(ctx->stream(), rows, cols, load, store);
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+template<typename T>
+class FusedTrilScaleSoftmaxMaskScaleGradCpuKernel final : public user_op::OpKernel {
+ public:
+  FusedTrilScaleSoftmaxMaskScaleGradCpuKernel() = default;
+  ~FusedTrilScaleSoftmaxMaskScaleGradCpuKernel() override = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* softmax_y = ctx->Tensor4ArgNameAndIndex("softmax_y", 0);
+    const user_op::Tensor* dy = ctx->Tensor4ArgNameAndIndex("dy", 0);
+    const user_op::Tensor* mask = ctx->Tensor4ArgNameAndIndex("mask", 0);
+    user_op::Tensor* dx = ctx->Tensor4ArgNameAndIndex("dx", 0);
+    const ShapeView& dy_shape = dy->shape_view();
+    CHECK_GE(dy_shape.NumAxes(), 2);
+    const int64_t cols = dy_shape.At(dy_shape.NumAxes() - 1);
+    const int64_t rows = dy_shape.Count(0, dy_shape.NumAxes() - 1);
+    const int64_t tril_num_rows = dy_shape.At(dy_shape.NumAxes() - 2);
+    fused_softmax::DirectLoad<T> load_softmax_y{softmax_y->dptr<T>(), cols};
+    MaskAndScaleLoad<T> load_dy{dy->dptr<T>(), mask->dptr<bool>(), cols,
+                                static_cast<T>(ctx->Attr<float>("mask_scale_value"))};
+    TrilScaleStore<T> store{dx->mut_dptr<T>(), tril_num_rows, cols,
+                            ctx->Attr<int64_t>("diagonal"),
+                            static_cast<T>(ctx->Attr<float>("tril_scale_value"))};
+    fused_softmax::SoftmaxGradRows<T>(ctx->stream(), rows, cols, load_softmax_y, load_dy, store);
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+}  // namespace
+
+#define REGISTER_FUSED_TRIL_SCALE_SOFTMAX_MASK_SCALE_CPU_KERNEL(dtype)                  \
+  REGISTER_USER_KERNEL("fused_tril_scale_softmax_mask_scale")                           \
+      .SetCreateFn<FusedTrilScaleSoftmaxMaskScaleCpuKernel<dtype>>()                    \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                   \
+                       && (user_op::HobDataType("y", 0) == GetDataType<dtype>::value)); \
+  REGISTER_USER_KERNEL("fused_tril_scale_softmax_mask_scale_grad")                      \
+      .SetCreateFn<FusedTrilScaleSoftmaxMaskScaleGradCpuKernel<dtype>>()                \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                   \
+                       && (user_op::HobDataType("dx", 0) == GetDataType<dtype>::value));
+
+REGISTER_FUSED_TRIL_SCALE_SOFTMAX_MASK_SCALE_CPU_KERNEL(float)
+REGISTER_FUSED_TRIL_SCALE_SOFTMAX_MASK_SCALE_CPU_KERNEL(double)
+#undef REGISTER_FUSED_TRIL_SCALE_SOFTMAX_MASK_SCALE_CPU_KERNEL
+
+}  // namespace oneflow
@@ -14,9 +14,225 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/core/framework/framework.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/core/ep/cpu/cpu_device.h"
+#include "oneflow/user/kernels/simd_pack.h"
 
 namespace oneflow {
 
+namespace {
+
+// Merges the mean and the sum of squared deviations of two sets, see Chan et al.
+template<typename T>
+void WelfordCombine(T b_count, T b_mean, T b_m2, T* count, T* mean, T* m2) {
+  if (b_count == 0) { return; }
+  const T new_count = *count + b_count;
+  const T delta = b_mean - *mean;
+  *mean += delta * b_count / new_count;
+  *m2 += b_m2 + delta * delta * *count * b_count / new_count;
+  *count = new_count;
+}
+
+// Single pass mean and variance with Welford's algorithm. Every lane of a pack keeps its own
+// running statistics, which are merged at the end.
+template<typename T>
+OF_CPU_TARGET_CLONES void ComputeRowMeanAndInvVariance(const T* x, int64_t norm_size,
+                                                       double epsilon, T* mean, T* inv_variance) {
+  using P = SimdPack<T>;
+  const int64_t num_packs = norm_size / P::kSize;
+  P pack_mean = P::Broadcast(0);
+  P pack_m2 = P::Broadcast(0);
+  for (int64_t i = 0; i < num_packs; ++i) {
+    const P value = P::Load(x + i * P::kSize);
+    const P delta = value - pack_mean;
+    pack_mean = P::Fma(delta, P::Broadcast(static_cast<T>(1) / static_cast<T>(i + 1)), pack_mean);
+    pack_m2 = P::Fma(delta, value - pack_mean, pack_m2);
+  }
+  T lane_means[P::kSize];
+  T lane_m2s[P::kSize];
+  pack_mean.Store(lane_means);
+  pack_m2.Store(lane_m2s);
+  T count = 0;
+  T row_mean = 0;
+  T row_m2 = 0;
+  for (int64_t i = 0; i < P::kSize; ++i) {
+    WelfordCombine<T>(num_packs, lane_means[i], lane_m2s[i], &count, &row_mean, &row_m2);
+  }
+  for (int64_t i = num_packs * P::kSize; i < norm_size; ++i) {
+    count += 1;
+    const T delta = x[i] - row_mean;
+    row_mean += delta / count;
+    row_m2 += delta * (x[i] - row_mean);
+  }
+  *mean = row_mean;
+  *inv_variance = static_cast<T>(1) / std::sqrt(row_m2 / norm_size + static_cast<T>(epsilon));
+}
+
+template<typename T, bool do_scale, bool do_center>
+OF_CPU_TARGET_CLONES void NormalizeRow(const T* x, int64_t norm_size, T mean, T inv_variance,
+                                       const T* gamma, const T* beta, T* y) {
+  using P = SimdPack<T>;
+  const P pack_inv_variance = P::Broadcast(inv_variance);
+  // (x - mean) * inv_variance = x * inv_variance - mean * inv_variance
+  const P pack_shift = P::Broadcast(-mean * inv_variance);
+  int64_t i = 0;
+  for (; i + P::kSize <= norm_size; i += P::kSize) {
+    P normalized = P::Fma(P::Load(x + i), pack_inv_variance, pack_shift);
+    if (do_scale && do_center) {
+      normalized = P::Fma(normalized, P::Load(gamma + i), P::Load(beta + i));
+    } else if (do_scale) {
+      normalized = normalized * P::Load(gamma + i);
+    } else if (do_center) {
+      normalized = normalized + P::Load(beta + i);
+    }
+    normalized.Store(y + i);
+  }
+  for (; i < norm_size; ++i) {
+    T normalized = (x[i] - mean) * inv_variance;
+    if (do_scale) { normalized *= gamma[i]; }
+    if (do_center) { normalized += beta[i]; }
+    y[i] = normalized;
+  }
+}
+
+template<typename T, bool do_scale, bool do_center>
+void LayerNormForward(ep::CpuStream* stream, int64_t num_instances, int64_t norm_size,
+                      double epsilon, const T* x, const T* gamma, const T* beta, T* y, T* mean,
+                      T* inv_variance) {
+  const size_t grain_size = ep::GetParallelForGrainSize(norm_size);
+  stream->ParallelFor(
+      0, num_instances,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t row = begin; row < end; ++row) {
+          const T* row_x = x + row * norm_size;
+          ComputeRowMeanAndInvVariance<T>(row_x, norm_size, epsilon, mean + row,
+                                          inv_variance + row);
+          NormalizeRow<T, do_scale, do_center>(row_x, norm_size, mean[row], inv_variance[row],
+                                               gamma, beta, y + row * norm_size);
+        }
+      },
+      grain_size);
+}
+
+// With x_hat = (x - mean) * inv_variance and g = dy * gamma,
+// dx = inv_variance * (g - mean(g) - x_hat * mean(g * x_hat)).
+template<typename T, bool do_scale, bool do_add>
+OF_CPU_TARGET_CLONES void LayerNormBackwardRow(const T* dy, const T* x, int64_t norm_size, T mean,
+                                               T inv_variance, const T* gamma,
+                                               const T* add_to_output, T* dx) {
+  using P = SimdPack<T>;
+  const P pack_inv_variance = P::Broadcast(inv_variance);
+  const P pack_shift = P::Broadcast(-mean * inv_variance);
+  P pack_sum_g = P::Broadcast(0);
+  P pack_sum_g_x_hat = P::Broadcast(0);
+  int64_t i = 0;
+  for (; i + P::kSize <= norm_size; i += P::kSize) {
+    const P x_hat = P::Fma(P::Load(x + i), pack_inv_variance, pack_shift);
+    const P g = do_scale ? P::Load(dy + i) * P::Load(gamma + i) : P::Load(dy + i);
+    pack_sum_g = pack_sum_g + g;
+    pack_sum_g_x_hat = P::Fma(g, x_hat, pack_sum_g_x_hat);
+  }
+  T sum_g = ReduceSum(pack_sum_g);
+  T sum_g_x_hat = ReduceSum(pack_sum_g_x_hat);
+  for (; i < norm_size; ++i) {
+    const T x_hat = (x[i] - mean) * inv_variance;
+    const T g = do_scale ? dy[i] * gamma[i] : dy[i];
+    sum_g += g;
+    sum_g_x_hat += g * x_hat;
+  }
+  const T mean_g = sum_g / norm_size;
+  const T mean_g_x_hat = sum_g_x_hat / norm_size;
+  const P pack_neg_mean_g = P::Broadcast(-mean_g);
+  const P pack_neg_mean_g_x_hat = P::Broadcast(-mean_g_x_hat);
+  i = 0;
+  for (; i + P::kSize <= norm_size; i += P::kSize) {
+    const P x_hat = P::Fma(P::Load(x + i), pack_inv_variance, pack_shift);
+    const P g = do_scale ? P::Load(dy + i) * P::Load(gamma + i) : P::Load(dy + i);
+    P result = P::Fma(x_hat, pack_neg_mean_g_x_hat, g + pack_neg_mean_g) * pack_inv_variance;
+    if (do_add) { result = result + P::Load(add_to_output + i); }
+    result.Store(dx + i);
+  }
+  for (; i < norm_size; ++i) {
+    const T x_hat = (x[i] - mean) * inv_variance;
+    const T g = do_scale ? dy[i] * gamma[i] : dy[i];
+    T result = (g - mean_g - x_hat * mean_g_x_hat) * inv_variance;
+    if (do_add) { result += add_to_output[i]; }
+    dx[i] = result;
+  }
+}
+
+template<typename T, bool do_scale, bool do_add>
+void LayerNormBackward(ep::CpuStream* stream, int64_t num_instances, int64_t norm_size,
+                       const T* dy, const T* x, const T* mean, const T* inv_variance,
+                       const T* gamma, const T* add_to_output, T* dx) {
+  const size_t grain_size = ep::GetParallelForGrainSize(norm_size);
+  stream->ParallelFor(
+      0, num_instances,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t row = begin; row < end; ++row) {
+          const int64_t offset = row * norm_size;
+          LayerNormBackwardRow<T, do_scale, do_add>(
+              dy + offset, x + offset, norm_size, mean[row], inv_variance[row], gamma,
+              do_add ? add_to_output + offset : nullptr, dx + offset);
+        }
+      },
+      grain_size);
+}
+
+// Accumulates the gradients of columns [begin, end) over all rows.
+template<typename T>
+OF_CPU_TARGET_CLONES void LayerNormParamGradColumns(int64_t num_instances, int64_t norm_size,
+                                                    int64_t begin, int64_t end, const T* dy,
+                                                    const T* x, const T* mean,
+                                                    const T* inv_variance, T* gamma_diff,
+                                                    T* beta_diff) {
+  using P = SimdPack<T>;
+  for (int64_t j = begin; j < end; ++j) {
+    if (gamma_diff != nullptr) { gamma_diff[j] = 0; }
+    if (beta_diff != nullptr) { beta_diff[j] = 0; }
+  }
+  for (int64_t row = 0; row < num_instances; ++row) {
+    const T* row_dy = dy + row * norm_size;
+    const T* row_x = x + row * norm_size;
+    const P pack_inv_variance = P::Broadcast(inv_variance[row]);
+    const P pack_shift = P::Broadcast(-mean[row] * inv_variance[row]);
+    int64_t j = begin;
+    for (; j + P::kSize <= end; j += P::kSize) {
+      const P pack_dy = P::Load(row_dy + j);
+      if (gamma_diff != nullptr) {
+        const P x_hat = P::Fma(P::Load(row_x + j), pack_inv_variance, pack_shift);
+        P::Fma(pack_dy, x_hat, P::Load(gamma_diff + j)).Store(gamma_diff + j);
+      }
+      if (beta_diff != nullptr) { (P::Load(beta_diff + j) + pack_dy).Store(beta_diff + j); }
+    }
+    for (; j < end; ++j) {
+      if (gamma_diff != nullptr) {
+        gamma_diff[j] += row_dy[j] * (row_x[j] - mean[row]) * inv_variance[row];
+      }
+      if (beta_diff != nullptr) { beta_diff[j] += row_dy[j]; }
+    }
+  }
+}
+
+// Columns are split among threads, every thread accumulates its columns over all rows, so no
+// reduction across threads is needed.
+template<typename T>
+void LayerNormParamGrad(ep::CpuStream* stream, int64_t num_instances, int64_t norm_size,
+                        const T* dy, const T* x, const T* mean, const T* inv_variance,
+                        T* gamma_diff, T* beta_diff) {
+  const size_t grain_size =
+      RoundUp(ep::GetParallelForGrainSize(num_instances), SimdPack<T>::kSize);
+  stream->ParallelFor(
+      0, norm_size,
+      [&](int64_t begin, int64_t end) {
+        LayerNormParamGradColumns<T>(num_instances, norm_size, begin, end, dy, x, mean,
+                                     inv_variance, gamma_diff, beta_diff);
+      },
+      grain_size);
+}
+
+}  // namespace
+
 template<typename T>
 class LayerNormCpuKernel final : public user_op::OpKernel {
  public:
@@ -25,7 +241,43 @@ class LayerNormCpuKernel final : public user_op::OpKernel {
 
  private:
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
-  void Compute(user_op::KernelComputeContext* ctx) const override { TODO(); };
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    user_op::Tensor* y = ctx->Tensor4ArgNameAndIndex("y", 0);
+    user_op::Tensor* mean = ctx->Tensor4ArgNameAndIndex("mean", 0);
+    user_op::Tensor* inv_variance = ctx->Tensor4ArgNameAndIndex("inv_variance", 0);
+    const double epsilon = ctx->Attr<double>("epsilon");
+    const int64_t num_instances = mean->shape_view().elem_cnt();
+    if (num_instances == 0) { return; }
+    const int64_t norm_size = x->shape_view().elem_cnt() / num_instances;
+    const T* gamma_ptr = nullptr;
+    const T* beta_ptr = nullptr;
+    if (ctx->has_input("gamma", 0)) {
+      const user_op::Tensor* gamma = ctx->Tensor4ArgNameAndIndex("gamma", 0);
+      gamma_ptr = gamma->dptr<T>();
+      CHECK_EQ(gamma->shape_view().elem_cnt(), norm_size);
+    }
+    if (ctx->has_input("beta", 0)) {
+      const user_op::Tensor* beta = ctx->Tensor4ArgNameAndIndex("beta", 0);
+      beta_ptr = beta->dptr<T>();
+      CHECK_EQ(beta->shape_view().elem_cnt(), norm_size);
+    }
+    ep::CpuStream* stream = ctx->stream()->As<ep::CpuStream>();
+#define LAUNCH_LAYER_NORM_FORWARD(do_scale, do_center)                                          \
+  LayerNormForward<T, do_scale, do_center>(stream, num_instances, norm_size, epsilon,           \
+                                           x->dptr<T>(), gamma_ptr, beta_ptr, y->mut_dptr<T>(), \
+                                           mean->mut_dptr<T>(), inv_variance->mut_dptr<T>())
+    if (gamma_ptr != nullptr && beta_ptr != nullptr) {
+      LAUNCH_LAYER_NORM_FORWARD(true, true);
+    } else if (gamma_ptr != nullptr) {
+      LAUNCH_LAYER_NORM_FORWARD(true, false);
+    } else if (beta_ptr != nullptr) {
+      LAUNCH_LAYER_NORM_FORWARD(false, true);
+    } else {
+      LAUNCH_LAYER_NORM_FORWARD(false, false);
+    }
+#undef LAUNCH_LAYER_NORM_FORWARD
+  };
 };
 
 #define REGISTER_LAYER_NORM_CPU_KERNEL(dtype)                         \
@@ -45,14 +297,57 @@ class LayerNormGradCpuKernel final : public user_op::OpKernel {
 
  private:
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
-  void Compute(user_op::KernelComputeContext* ctx) const override { TODO(); };
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* dy = ctx->Tensor4ArgNameAndIndex("dy", 0);
+    const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    const user_op::Tensor* mean = ctx->Tensor4ArgNameAndIndex("mean", 0);
+    const user_op::Tensor* inv_variance = ctx->Tensor4ArgNameAndIndex("inv_variance", 0);
+    user_op::Tensor* dx = ctx->Tensor4ArgNameAndIndex("dx", 0);
+    const int64_t num_instances = mean->shape_view().elem_cnt();
+    if (num_instances == 0) { return; }
+    const int64_t norm_size = x->shape_view().elem_cnt() / num_instances;
+    const T* gamma_ptr = nullptr;
+    if (ctx->has_input("gamma", 0)) {
+      gamma_ptr = ctx->Tensor4ArgNameAndIndex("gamma", 0)->dptr<T>();
+    }
+    const T* add_to_output_ptr = nullptr;
+    if (ctx->has_input("_add_to_output", 0)) {
+      const user_op::Tensor* add_to_output = ctx->Tensor4ArgNameAndIndex("_add_to_output", 0);
+      CHECK_EQ(add_to_output->data_type(), dx->data_type());
+      CHECK_EQ(add_to_output->shape_view(), dx->shape_view());
+      add_to_output_ptr = add_to_output->dptr<T>();
+    }
+    ep::CpuStream* stream = ctx->stream()->As<ep::CpuStream>();
+#define LAUNCH_LAYER_NORM_BACKWARD(do_scale, do_add)                                         \
+  LayerNormBackward<T, do_scale, do_add>(stream, num_instances, norm_size, dy->dptr<T>(),    \
+                                         x->dptr<T>(), mean->dptr<T>(), inv_variance->dptr<T>(), \
+                                         gamma_ptr, add_to_output_ptr, dx->mut_dptr<T>())
+    if (gamma_ptr != nullptr && add_to_output_ptr != nullptr) {
+      LAUNCH_LAYER_NORM_BACKWARD(true, true);
+    } else if (gamma_ptr != nullptr) {
+      LAUNCH_LAYER_NORM_BACKWARD(true, false);
+    } else if (add_to_output_ptr != nullptr) {
+      LAUNCH_LAYER_NORM_BACKWARD(false, true);
+    } else {
+      LAUNCH_LAYER_NORM_BACKWARD(false, false);
+    }
+#undef LAUNCH_LAYER_NORM_BACKWARD
+  };
 };
 
-#define REGISTER_LAYER_NORM_GRAD_CPU_KERNEL(dtype)                    \
-  REGISTER_USER_KERNEL("layer_norm_grad")                             \
-      .SetCreateFn<LayerNormGradCpuKernel<dtype>>()                   \
-      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU) \
-                       && (user_op::HobDataType("dy", 0) == GetDataType<dtype>::value));
+#define REGISTER_LAYER_NORM_GRAD_CPU_KERNEL(dtype)                                         \
+  REGISTER_USER_KERNEL("layer_norm_grad")                                                  \
+      .SetCreateFn<LayerNormGradCpuKernel<dtype>>()                                        \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                      \
+                       && (user_op::HobDataType("dy", 0) == GetDataType<dtype>::value))    \
+      .SetInplaceProposalFn(                                                               \
+          [](const user_op::InferContext& ctx,                                             \
+             const user_op::AddInplaceArgPair& AddInplaceArgPairFn) -> Maybe<void> {       \
+            if (ctx.has_input("_add_to_output", 0)) {                                      \
+              OF_RETURN_IF_ERROR(AddInplaceArgPairFn("dx", 0, "_add_to_output", 0, true)); \
+            }                                                                              \
+            return Maybe<void>::Ok();                                                      \
+          });
 
 REGISTER_LAYER_NORM_GRAD_CPU_KERNEL(float)
 REGISTER_LAYER_NORM_GRAD_CPU_KERNEL(double)
@@ -65,7 +360,35 @@ class LayerNormParamGradCpuKernel final : public user_op::OpKernel {
 
  private:
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
-  void Compute(user_op::KernelComputeContext* ctx) const override { TODO(); };
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* dy = ctx->Tensor4ArgNameAndIndex("dy", 0);
+    const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    const user_op::Tensor* mean = ctx->Tensor4ArgNameAndIndex("mean", 0);
+    const user_op::Tensor* inv_variance = ctx->Tensor4ArgNameAndIndex("inv_variance", 0);
+    const int64_t num_instances = mean->shape_view().elem_cnt();
+    const int64_t norm_size = x->shape_view().elem_cnt() / std::max<int64_t>(num_instances, 1);
+    T* gamma_diff_ptr = nullptr;
+    T* beta_diff_ptr = nullptr;
+    if (ctx->has_output("gamma_diff", 0)) {
+      user_op::Tensor* gamma_diff = ctx->Tensor4ArgNameAndIndex("gamma_diff", 0);
+      gamma_diff_ptr = gamma_diff->mut_dptr<T>();
+      // Nothing is accumulated over an empty batch, but the gradient still has to be written.
+      if (num_instances == 0) {
+        std::fill_n(gamma_diff_ptr, gamma_diff->shape_view().elem_cnt(), static_cast<T>(0));
+      }
+    }
+    if (ctx->has_output("beta_diff", 0)) {
+      user_op::Tensor* beta_diff = ctx->Tensor4ArgNameAndIndex("beta_diff", 0);
+      beta_diff_ptr = beta_diff->mut_dptr<T>();
+      if (num_instances == 0) {
+        std::fill_n(beta_diff_ptr, beta_diff->shape_view().elem_cnt(), static_cast<T>(0));
+      }
+    }
+    if (num_instances == 0) { return; }
+    LayerNormParamGrad<T>(ctx->stream()->As<ep::CpuStream>(), num_instances, norm_size,
+                          dy->dptr<T>(), x->dptr<T>(), mean->dptr<T>(), inv_variance->dptr<T>(),
+                          gamma_diff_ptr, beta_diff_ptr);
+  };
 };
 
 #define REGISTER_LAYER_NORM_PARAM_GRAD_CPU_KERNEL(dtype)              \
@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/user/kernels/max_pool_kernel_util.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
 
 namespace oneflow {
 
@@ -93,6 +94,31 @@ void Maxpool2dForwardComputeCLast(const NdIndexOffsetHelper<IDX, 4>& index_helpe
   }
 }
 
+// Pooling a plane of y only reads the same plane of x, where a plane is the (n, c) slice of
+// channels first data and the n slice of channels last data. So the compute functions run on
+// ranges of planes in parallel, with pointers shifted to the first plane of the range.
+template<typename IDX, typename F>
+void ParallelForPlanes(ep::Stream* stream, const MaxPoolParams3D& params_3d, bool channels_last,
+                       int64_t cost_per_y_elem, const F& compute) {
+  const int64_t plane_axis = channels_last ? 1 : 2;
+  const Shape x_shape = params_3d.GetXShape5D();
+  const Shape y_shape = params_3d.GetYShape5D();
+  const int64_t x_plane_size = x_shape.Count(plane_axis);
+  const int64_t y_plane_size = y_shape.Count(plane_axis);
+  stream->As<ep::CpuStream>()->ParallelFor(
+      0, y_shape.Count(0, plane_axis),
+      [&](int64_t begin, int64_t end) {
+        compute(begin * x_plane_size, begin * y_plane_size,
+                static_cast<IDX>((end - begin) * y_plane_size));
+      },
+      ep::GetParallelForGrainSize(y_plane_size * cost_per_y_elem));
+}
+
+int64_t GetWindowSize(const MaxPoolParams3D& params_3d) {
+  const std::vector<int32_t>& pool_size = params_3d.pool_size_3d();
+  return static_cast<int64_t>(pool_size[0]) * pool_size[1] * pool_size[2];
+}
+
 }  // namespace
 
 template<typename T, typename IDX>
@@ -100,86 +126,147 @@ struct PoolKernelUtil<DeviceType::kCPU, T, IDX> {
   static void Maxpool1dForward(ep::Stream* stream, const NdIndexOffsetHelper<IDX, 2>& index_helper,
                                const IDX elem_num, const T* src, T* dest, int64_t* indice_ptr,
                                const MaxPoolParams3D& params_3d) {
-    Maxpool1dForwardCompute<T, IDX>(
-        index_helper, elem_num, src, dest, indice_ptr, params_3d.padding()[2],
-        params_3d.num_batch(), params_3d.num_channel(), params_3d.GetXShape5D().At(4),
-        params_3d.pool_size_3d()[2], params_3d.stride_3d()[2], params_3d.dilation_3d()[2]);
+    ParallelForPlanes<IDX>(
+        stream, params_3d, false, GetWindowSize(params_3d),
+        [&](int64_t x_offset, int64_t y_offset, IDX plane_elem_num) {
+          Maxpool1dForwardCompute<T, IDX>(index_helper, plane_elem_num, src + x_offset,
+                                          dest + y_offset, indice_ptr + y_offset,
+                                          params_3d.padding()[2], params_3d.num_batch(),
+                                          params_3d.num_channel(), params_3d.GetXShape5D().At(4),
+                                          params_3d.pool_size_3d()[2], params_3d.stride_3d()[2],
+                                          params_3d.dilation_3d()[2]);
+        });
   }
 
   static void Maxpool1dBackward(ep::Stream* stream, const NdIndexOffsetHelper<IDX, 2>& index_helper,
                                 const IDX elem_num, const T* src, T* dest,
                                 const int64_t* indice_ptr, const MaxPoolParams3D& params_3d) {
-    Maxpool1dBackwardCompute<T, IDX>(index_helper, elem_num, src, dest, indice_ptr,
-                                     params_3d.num_batch(), params_3d.num_channel(),
-                                     params_3d.GetYShape5D().At(4), params_3d.GetXShape5D().At(4));
+    ParallelForPlanes<IDX>(
+        stream, params_3d, false, ep::parallel_for_cost::kIndexed,
+        [&](int64_t x_offset, int64_t y_offset, IDX plane_elem_num) {
+          Maxpool1dBackwardCompute<T, IDX>(index_helper, plane_elem_num, src + y_offset,
+                                           dest + x_offset, indice_ptr + y_offset,
+                                           params_3d.num_batch(), params_3d.num_channel(),
+                                           params_3d.GetYShape5D().At(4),
+                                           params_3d.GetXShape5D().At(4));
+        });
   }
 
   static void Maxpool2dForwardCFirst(ep::Stream* stream,
                                      const NdIndexOffsetHelper<IDX, 3>& index_helper,
                                      const IDX elem_num, const T* src, T* dest, int64_t* indice_ptr,
                                      const MaxPoolParams3D& params_3d) {
-    Maxpool2dForwardComputeCFirst<T, IDX>(
-        index_helper, elem_num, src, dest, indice_ptr, params_3d.padding()[1],
-        params_3d.padding()[2], params_3d.num_batch(), params_3d.num_channel(),
-        params_3d.GetXShape5D().At(3), params_3d.GetXShape5D().At(4), params_3d.pool_size_3d()[1],
-        params_3d.pool_size_3d()[2], params_3d.stride_3d()[1], params_3d.stride_3d()[2],
-        params_3d.dilation_3d()[1], params_3d.dilation_3d()[2]);
+    ParallelForPlanes<IDX>(
+        stream, params_3d, false, GetWindowSize(params_3d),
+        [&](int64_t x_offset, int64_t y_offset, IDX plane_elem_num) {
+          Maxpool2dForwardComputeCFirst<T, IDX>(index_helper, plane_elem_num, src + x_offset,
+                                                dest + y_offset, indice_ptr + y_offset,
+                                                params_3d.padding()[1], params_3d.padding()[2],
+                                                params_3d.num_batch(), params_3d.num_channel(),
+                                                params_3d.GetXShape5D().At(3),
+                                                params_3d.GetXShape5D().At(4),
+                                                params_3d.pool_size_3d()[1],
+                                                params_3d.pool_size_3d()[2],
+                                                params_3d.stride_3d()[1], params_3d.stride_3d()[2],
+                                                params_3d.dilation_3d()[1],
+                                                params_3d.dilation_3d()[2]);
+        });
   }
 
   static void Maxpool2dBackwardCFirst(ep::Stream* stream,
                                       const NdIndexOffsetHelper<IDX, 3>& index_helper,
                                       const IDX elem_num, const T* src, T* dest,
                                       const int64_t* indice_ptr, const MaxPoolParams3D& params_3d) {
-    Maxpool2dBackwardComputeCFirst<T, IDX>(
-        index_helper, elem_num, src, dest, indice_ptr, params_3d.num_batch(),
-        params_3d.num_channel(), params_3d.GetYShape5D().At(3), params_3d.GetYShape5D().At(4),
-        params_3d.GetXShape5D().At(3), params_3d.GetXShape5D().At(4));
+    ParallelForPlanes<IDX>(
+        stream, params_3d, false, ep::parallel_for_cost::kIndexed,
+        [&](int64_t x_offset, int64_t y_offset, IDX plane_elem_num) {
+          Maxpool2dBackwardComputeCFirst<T, IDX>(index_helper, plane_elem_num, src + y_offset,
+                                                 dest + x_offset, indice_ptr + y_offset,
+                                                 params_3d.num_batch(), params_3d.num_channel(),
+                                                 params_3d.GetYShape5D().At(3),
+                                                 params_3d.GetYShape5D().At(4),
+                                                 params_3d.GetXShape5D().At(3),
+                                                 params_3d.GetXShape5D().At(4));
+        });
   }
 
   static void Maxpool2dForwardCLast(ep::Stream* stream,
                                     const NdIndexOffsetHelper<IDX, 4>& index_helper,
                                     const IDX elem_num, const T* src, T* dest, int64_t* indice_ptr,
                                     const MaxPoolParams3D& params_3d) {
-    Maxpool2dForwardComputeCLast<T, IDX>(
-        index_helper, elem_num, src, dest, indice_ptr, params_3d.padding()[1],
-        params_3d.padding()[2], params_3d.num_batch(), params_3d.num_channel(),
-        params_3d.GetXShape5D().At(3), params_3d.GetXShape5D().At(4), params_3d.GetYShape5D().At(3),
-        params_3d.GetYShape5D().At(4), params_3d.pool_size_3d()[1], params_3d.pool_size_3d()[2],
-        params_3d.stride_3d()[1], params_3d.stride_3d()[2], params_3d.dilation_3d()[1],
-        params_3d.dilation_3d()[2]);
+    ParallelForPlanes<IDX>(
+        stream, params_3d, true, GetWindowSize(params_3d),
+        [&](int64_t x_offset, int64_t y_offset, IDX plane_elem_num) {
+          Maxpool2dForwardComputeCLast<T, IDX>(index_helper, plane_elem_num, src + x_offset,
+                                               dest + y_offset, indice_ptr + y_offset,
+                                               params_3d.padding()[1], params_3d.padding()[2],
+                                               params_3d.num_batch(), params_3d.num_channel(),
+                                               params_3d.GetXShape5D().At(3),
+                                               params_3d.GetXShape5D().At(4),
+                                               params_3d.GetYShape5D().At(3),
+                                               params_3d.GetYShape5D().At(4),
+                                               params_3d.pool_size_3d()[1],
+                                               params_3d.pool_size_3d()[2],
+                                               params_3d.stride_3d()[1], params_3d.stride_3d()[2],
+                                               params_3d.dilation_3d()[1],
+                                               params_3d.dilation_3d()[2]);
+        });
   }
 
   static void Maxpool2dBackwardCLast(ep::Stream* stream,
                                      const NdIndexOffsetHelper<IDX, 4>& index_helper,
                                      const IDX elem_num, const T* src, T* dest,
                                      const int64_t* indice_ptr, const MaxPoolParams3D& params_3d) {
-    Maxpool2dBackwardComputeCLast<T, IDX>(
-        index_helper, elem_num, src, dest, indice_ptr, params_3d.num_batch(),
-        params_3d.num_channel(), params_3d.GetYShape5D().At(3), params_3d.GetYShape5D().At(4),
-        params_3d.GetXShape5D().At(3), params_3d.GetXShape5D().At(4));
+    ParallelForPlanes<IDX>(
+        stream, params_3d, true, ep::parallel_for_cost::kIndexed,
+        [&](int64_t x_offset, int64_t y_offset, IDX plane_elem_num) {
+          Maxpool2dBackwardComputeCLast<T, IDX>(index_helper, plane_elem_num, src + y_offset,
+                                                dest + x_offset, indice_ptr + y_offset,
+                                                params_3d.num_batch(), params_3d.num_channel(),
+                                                params_3d.GetYShape5D().At(3),
+                                                params_3d.GetYShape5D().At(4),
+                                                params_3d.GetXShape5D().At(3),
+                                                params_3d.GetXShape5D().At(4));
+        });
   }
 
   static void Maxpool3dForward(ep::Stream* stream, const NdIndexOffsetHelper<IDX, 4>& index_helper,
                                const IDX elem_num, const T* src, T* dest, int64_t* indice_ptr,
                                const MaxPoolParams3D& params_3d) {
-    Maxpool3dForwardCompute<T, IDX>(
-        index_helper, elem_num, src, dest, indice_ptr, params_3d.padding()[0],
-        params_3d.padding()[1], params_3d.padding()[2], params_3d.num_batch(),
-        params_3d.num_channel(), params_3d.GetXShape5D().At(2), params_3d.GetXShape5D().At(3),
-        params_3d.GetXShape5D().At(4), params_3d.pool_size_3d()[0], params_3d.pool_size_3d()[1],
-        params_3d.pool_size_3d()[2], params_3d.stride_3d()[0], params_3d.stride_3d()[1],
-        params_3d.stride_3d()[2], params_3d.dilation_3d()[0], params_3d.dilation_3d()[1],
-        params_3d.dilation_3d()[2]);
+    ParallelForPlanes<IDX>(
+        stream, params_3d, false, GetWindowSize(params_3d),
+        [&](int64_t x_offset, int64_t y_offset, IDX plane_elem_num) {
+          Maxpool3dForwardCompute<T, IDX>(index_helper, plane_elem_num, src + x_offset,
+                                          dest + y_offset, indice_ptr + y_offset,
+                                          params_3d.padding()[0], params_3d.padding()[1],
+                                          params_3d.padding()[2], params_3d.num_batch(),
+                                          params_3d.num_channel(), params_3d.GetXShape5D().At(2),
+                                          params_3d.GetXShape5D().At(3),
+                                          params_3d.GetXShape5D().At(4),
+                                          params_3d.pool_size_3d()[0], params_3d.pool_size_3d()[1],
+                                          params_3d.pool_size_3d()[2], params_3d.stride_3d()[0],
+                                          params_3d.stride_3d()[1], params_3d.stride_3d()[2],
+                                          params_3d.dilation_3d()[0], params_3d.dilation_3d()[1],
+                                          params_3d.dilation_3d()[2]);
+        });
   }
 
   static void Maxpool3dBackward(ep::Stream* stream, const NdIndexOffsetHelper<IDX, 4> index_helper,
                                 const IDX elem_num, const T* src, T* dest,
                                 const int64_t* indice_ptr, const MaxPoolParams3D& params_3d) {
-    Maxpool3dBackwardCompute<T, IDX>(index_helper, elem_num, src, dest, indice_ptr,
-                                     params_3d.num_batch(), params_3d.num_channel(),
-                                     params_3d.GetYShape5D().At(2), params_3d.GetYShape5D().At(3),
-                                     params_3d.GetYShape5D().At(4), params_3d.GetXShape5D().At(2),
-                                     params_3d.GetXShape5D().At(3), params_3d.GetXShape5D().At(4));
+    ParallelForPlanes<IDX>(
+        stream, params_3d, false, ep::parallel_for_cost::kIndexed,
+        [&](int64_t x_offset, int64_t y_offset, IDX plane_elem_num) {
+          Maxpool3dBackwardCompute<T, IDX>(index_helper, plane_elem_num, src + y_offset,
+                                           dest + x_offset, indice_ptr + y_offset,
+                                           params_3d.num_batch(), params_3d.num_channel(),
+                                           params_3d.GetYShape5D().At(2),
+                                           params_3d.GetYShape5D().At(3),
+                                           params_3d.GetYShape5D().At(4),
+                                           params_3d.GetXShape5D().At(2),
+                                           params_3d.GetXShape5D().At(3),
+                                           params_3d.GetXShape5D().At(4));
+        });
   }
 };
 
@@ -14,14 +14,16 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/core/framework/framework.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
 
 namespace oneflow {
 
 template<typename T>
-static void ComputeMeanAndVar(const T* input_ptr, T* mean_ptr, T* inv_variance_ptr,
-                              T* moving_mean_ptr, T* moving_variance_ptr, const int64_t batch_size,
-                              const int64_t channel_size, const int64_t spatial_size,
-                              const float epsilon, const float momentum) {
+static void ComputeMeanAndVar(ep::Stream* stream, const T* input_ptr, T* mean_ptr,
+                              T* inv_variance_ptr, T* moving_mean_ptr, T* moving_variance_ptr,
+                              const int64_t batch_size, const int64_t channel_size,
+                              const int64_t spatial_size, const float epsilon,
+                              const float momentum) {
   // NOTE(Liang Depeng): the following parameters were used to compute mean and var
   const int64_t jump_step = spatial_size * channel_size;
   const int64_t reduce_count = batch_size * spatial_size;
@@ -33,63 +35,70 @@ static void ComputeMeanAndVar(const T* input_ptr, T* mean_ptr, T* inv_variance_p
 
   const T exponential_average_factor = 1.0f - momentum;
 
-  for (int64_t channel = 0; channel < channel_size; ++channel) {
-    const T* temp_input_ptr = input_ptr + channel * spatial_size;
-    T sum = 0;
-    T sum_square = 0;
-    for (int64_t batch = 0; batch < batch_size; ++batch) {
-      for (int64_t s = 0; s < spatial_size; ++s) {
-        const T x = temp_input_ptr[s];
-        sum += x;
-        sum_square += x * x;
-      }
-      temp_input_ptr += jump_step;
-    }
-
-    const T temp_mean = sum * reduce_scale_factor;
-    mean_ptr[channel] = temp_mean;
-
-    const T temp_mean_square = temp_mean * temp_mean;
-    const T temp_variance = sum_square * reduce_scale_factor - temp_mean_square;
-
-    const T temp_unbias_variance = sum_square * unbias_reduce_scale_factor
-                                   + unbias_reduce_scale_factor_m2 * temp_mean * sum
-                                   + unbias_reduce_scale_factor_mn * temp_mean_square;
-
-    inv_variance_ptr[channel] = static_cast<T>(1) / std::sqrt(temp_variance + epsilon);
-
-    if (moving_mean_ptr != nullptr && moving_variance_ptr != nullptr) {
-      moving_mean_ptr[channel] =
-          moving_mean_ptr[channel] * momentum + temp_mean * exponential_average_factor;
-      moving_variance_ptr[channel] = moving_variance_ptr[channel] * momentum
-                                     + temp_unbias_variance * exponential_average_factor;
-    }
-  }
+  // Channels are independent, each one reads batch_size * spatial_size elements.
+  stream->As<ep::CpuStream>()->ParallelFor(
+      0, channel_size,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t channel = begin; channel < end; ++channel) {
+          const T* temp_input_ptr = input_ptr + channel * spatial_size;
+          T sum = 0;
+          T sum_square = 0;
+          for (int64_t batch = 0; batch < batch_size; ++batch) {
+            for (int64_t s = 0; s < spatial_size; ++s) {
+              const T x = temp_input_ptr[s];
+              sum += x;
+              sum_square += x * x;
+            }
+            temp_input_ptr += jump_step;
+          }
+
+          const T temp_mean = sum * reduce_scale_factor;
+          mean_ptr[channel] = temp_mean;
+
+          const T temp_mean_square = temp_mean * temp_mean;
+          const T temp_variance = sum_square * reduce_scale_factor - temp_mean_square;
+
+          const T temp_unbias_variance = sum_square * unbias_reduce_scale_factor
+                                         + unbias_reduce_scale_factor_m2 * temp_mean * sum
+                                         + unbias_reduce_scale_factor_mn * temp_mean_square;
+
+          inv_variance_ptr[channel] = static_cast<T>(1) / std::sqrt(temp_variance + epsilon);
+
+          if (moving_mean_ptr != nullptr && moving_variance_ptr != nullptr) {
+            moving_mean_ptr[channel] =
+                moving_mean_ptr[channel] * momentum + temp_mean * exponential_average_factor;
+            moving_variance_ptr[channel] = moving_variance_ptr[channel] * momentum
+                                           + temp_unbias_variance * exponential_average_factor;
+          }
+        }
+      },
+      ep::GetParallelForGrainSize(reduce_count * 2 * ep::parallel_for_cost::kElementwise));
 }
 
 template<typename T>
-static void Normalize(const T* input_ptr, const T* mean_ptr, const T* variance_ptr,
-                      const T* gamma_ptr, const T* beta_ptr, T* output_ptr,
+static void Normalize(ep::Stream* stream, const T* input_ptr, const T* mean_ptr,
+                      const T* variance_ptr, const T* gamma_ptr, const T* beta_ptr, T* output_ptr,
                       const int64_t batch_size, const int64_t channel_size,
                       const int64_t spatial_size, const float epsilon, const bool training) {
-  const T* temp_input_ptr = input_ptr;
-  T* temp_output_ptr = output_ptr;
   const int64_t all_channels = batch_size * channel_size;
-  int64_t channel = -1;
-  for (int64_t ac = 0; ac < all_channels; ++ac) {
-    channel += 1;
-    if (channel >= channel_size) { channel = 0; }
-    T inv_variance = variance_ptr[channel];
-    if (!training) { inv_variance = 1.0f / std::sqrt(inv_variance + epsilon); }
-    const T gamma = gamma_ptr[channel] * inv_variance;
-    const T beta = beta_ptr[channel];
-    const T mean = mean_ptr[channel];
-    for (int64_t s = 0; s < spatial_size; ++s) {
-      temp_output_ptr[s] = (temp_input_ptr[s] - mean) * gamma + beta;
-    }
-    temp_input_ptr += spatial_size;
-    temp_output_ptr += spatial_size;
-  }
+  stream->As<ep::CpuStream>()->ParallelFor(
+      0, all_channels,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t ac = begin; ac < end; ++ac) {
+          const int64_t channel = ac % channel_size;
+          const T* temp_input_ptr = input_ptr + ac * spatial_size;
+          T* temp_output_ptr = output_ptr + ac * spatial_size;
+          T inv_variance = variance_ptr[channel];
+          if (!training) { inv_variance = 1.0f / std::sqrt(inv_variance + epsilon); }
+          const T gamma = gamma_ptr[channel] * inv_variance;
+          const T beta = beta_ptr[channel];
+          const T mean = mean_ptr[channel];
+          for (int64_t s = 0; s < spatial_size; ++s) {
+            temp_output_ptr[s] = (temp_input_ptr[s] - mean) * gamma + beta;
+          }
+        }
+      },
+      ep::GetParallelForGrainSize(spatial_size * 2 * ep::parallel_for_cost::kElementwise));
 }
 
 template<typename T>
@@ -309,8 +318,8 @@ class NormalizationInferenceCpuKernel final : public user_op::OpKernel {
 
       // NOTE(Liang Depeng):
       // compute the normalization result
-      Normalize(input_ptr, moving_mean_ptr, moving_variance_ptr, gamma_ptr, beta_ptr, output_ptr,
-                batch_size, channel_size, spatial_size, epsilon, false);
+      Normalize(ctx->stream(), input_ptr, moving_mean_ptr, moving_variance_ptr, gamma_ptr, beta_ptr,
+                output_ptr, batch_size, channel_size, spatial_size, epsilon, false);
 
       if (ctx->has_input("_add_to_output", 0)) {
         const user_op::Tensor* add_to_output = ctx->Tensor4ArgNameAndIndex("_add_to_output", 0);
@@ -405,13 +414,14 @@ class NormalizationTrainCpuKernel final : public user_op::OpKernel {
 
       // NOTE(Liang Depeng):
       // Compute mean & inv_variance and update moving_mean & moving_variance for each channel.
-      ComputeMeanAndVar(input_ptr, mean_ptr, inv_variance_ptr, moving_mean_ptr, moving_variance_ptr,
-                        batch_size, channel_size, spatial_size, epsilon, momentum);
+      ComputeMeanAndVar(ctx->stream(), input_ptr, mean_ptr, inv_variance_ptr, moving_mean_ptr,
+                        moving_variance_ptr, batch_size, channel_size, spatial_size, epsilon,
+                        momentum);
 
       // NOTE(Liang Depeng):
       // compute the normalization result
-      Normalize(input_ptr, mean_ptr, inv_variance_ptr, gamma_ptr, beta_ptr, output_ptr, batch_size,
-                channel_size, spatial_size, epsilon, true);
+      Normalize(ctx->stream(), input_ptr, mean_ptr, inv_variance_ptr, gamma_ptr, beta_ptr,
+                output_ptr, batch_size, channel_size, spatial_size, epsilon, true);
 
       if (ctx->has_input("_add_to_output", 0)) {
         const user_op::Tensor* add_to_output = ctx->Tensor4ArgNameAndIndex("_add_to_output", 0);
@@ -538,39 +548,45 @@ class NormalizationGradCpuKernel final : public user_op::OpKernel {
       // Borrow the MXNet implementation to compute dx, gamma_diff and beta_diff.
       // For more details pls refers to:
       // https://github.com/apache/incubator-mxnet/blob/master/src/operator/nn/batch_norm.cc
-      for (int64_t channel = 0; channel < channel_size; ++channel) {
-        const T gamma_c = gamma_ptr[channel];
-        const T mean_c = mean_ptr[channel];
-        const T inv_variance_c = inv_variance_ptr[channel];
-
-        // NOTE(Liang Depeng): sum dy for specific channel over all samples
-        T sum_dy_out = 0;
-        ForEachFast(dy_ptr, batch_size, spatial_size, jump_step, channel,
-                    [&sum_dy_out](const T* dy_data) { sum_dy_out += *dy_data; });
-
-        // NOTE(Liang Depeng): dot product of the x and dy
-        T dotp = 0;
-        ForEachFast(x_ptr, dy_ptr, batch_size, spatial_size, jump_step, channel,
-                    [&dotp, mean_c](const T* x_data, const T* dy_data) {
-                      dotp += (*x_data - mean_c) * (*dy_data);
-                    });
-
-        // NOTE(Liang Depeng): projection of dy on to output scaled by std
-        const T k = dotp * inv_variance_c * inv_variance_c / reduce_count;
-        const T iw = inv_variance_c * gamma_c;
-        const T grad_mean_c = sum_dy_out / reduce_count;
-        ForEachFast(
-            x_ptr, dx_ptr, batch_size, spatial_size, jump_step, channel,
-            [&mean_c, &k](const T* x_data, T* dx_data) { *dx_data = (*x_data - mean_c) * k; });
-
-        ForEachFast(dy_ptr, dx_ptr, batch_size, spatial_size, jump_step, channel,
-                    [iw, grad_mean_c](const T* dy_data, T* dx_data) {
-                      *dx_data = (*dy_data - grad_mean_c - *dx_data) * iw;
-                    });
-
-        gamma_diff_ptr[channel] = dotp * inv_variance_c;
-        beta_diff_ptr[channel] = sum_dy_out;
-      }
+      ctx->stream()->As<ep::CpuStream>()->ParallelFor(
+          0, channel_size,
+          [&](int64_t begin, int64_t end) {
+            for (int64_t channel = begin; channel < end; ++channel) {
+              const T gamma_c = gamma_ptr[channel];
+              const T mean_c = mean_ptr[channel];
+              const T inv_variance_c = inv_variance_ptr[channel];
+
+              // NOTE(Liang Depeng): sum dy for specific channel over all samples
+              T sum_dy_out = 0;
+              ForEachFast(dy_ptr, batch_size, spatial_size, jump_step, channel,
+                          [&sum_dy_out](const T* dy_data) { sum_dy_out += *dy_data; });
+
+              // NOTE(Liang Depeng): dot product of the x and dy
+              T dotp = 0;
+              ForEachFast(x_ptr, dy_ptr, batch_size, spatial_size, jump_step, channel,
+                          [&dotp, mean_c](const T* x_data, const T* dy_data) {
+                            dotp += (*x_data - mean_c) * (*dy_data);
+                          });
+
+              // NOTE(Liang Depeng): projection of dy on to output scaled by std
+              const T k = dotp * inv_variance_c * inv_variance_c / reduce_count;
+              const T iw = inv_variance_c * gamma_c;
+              const T grad_mean_c = sum_dy_out / reduce_count;
+              ForEachFast(x_ptr, dx_ptr, batch_size, spatial_size, jump_step, channel,
+                          [&mean_c, &k](const T* x_data, T* dx_data) {
+                            *dx_data = (*x_data - mean_c) * k;
+                          });
+
+              ForEachFast(dy_ptr, dx_ptr, batch_size, spatial_size, jump_step, channel,
+                          [iw, grad_mean_c](const T* dy_data, T* dx_data) {
+                            *dx_data = (*dy_data - grad_mean_c - *dx_data) * iw;
+                          });
+
+              gamma_diff_ptr[channel] = dotp * inv_variance_c;
+              beta_diff_ptr[channel] = sum_dy_out;
+            }
+          },
+          ep::GetParallelForGrainSize(reduce_count * 6 * ep::parallel_for_cost::kElementwise));
 
     } else {  // TODO(Liang Depeng): NHWC format
     }
@@ -15,6 +15,7 @@ limitations under the License.
 */
 #include "oneflow/core/framework/framework.h"
 #include "oneflow/user/data/ofrecord_data_reader.h"
+#include "oneflow/user/data/indexed_ofrecord_data_reader.h"
 
 namespace oneflow {
 
@@ -22,13 +23,26 @@ namespace {
 
 class OFRecordReaderWrapper final : public user_op::OpKernelState {
  public:
-  explicit OFRecordReaderWrapper(user_op::KernelInitContext* ctx) : reader_(ctx) {}
+  explicit OFRecordReaderWrapper(user_op::KernelInitContext* ctx) {
+    if (ctx->Attr<bool>("indexed")) {
+      indexed_reader_.reset(new data::IndexedOFRecordDataReader(ctx));
+    } else {
+      reader_.reset(new data::OFRecordDataReader(ctx));
+    }
+  }
   ~OFRecordReaderWrapper() = default;
 
-  void Read(user_op::KernelComputeContext* ctx) { reader_.Read(ctx); }
+  void Read(user_op::KernelComputeContext* ctx) {
+    if (indexed_reader_) {
+      indexed_reader_->Read(ctx);
+    } else {
+      reader_->Read(ctx);
+    }
+  }
 
  private:
-  data::OFRecordDataReader reader_;
+  std::unique_ptr<data::OFRecordDataReader> reader_;
+  std::unique_ptr<data::IndexedOFRecordDataReader> indexed_reader_;
 };
 
 }  // namespace
@@ -0,0 +1,104 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_ONE_EMBEDDING_KERNEL_UTIL_H_
+#define ONEFLOW_USER_KERNELS_ONE_EMBEDDING_KERNEL_UTIL_H_
+
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+enum class InitializerType { kUniform, kNormal, kConstant };
+
+struct EmbeddingInitializer {
+  InitializerType type;
+  union {
+    struct {
+      float low;
+      float high;
+    } uniform_param;
+    struct {
+      float mean;
+      float std;
+    } normal_param;
+    struct {
+      float value;
+    } constant_param;
+  };
+
+  bool operator==(const EmbeddingInitializer& rhs) const {
+    if (this->type != rhs.type) { return false; }
+    if (rhs.type == InitializerType::kUniform) {
+      return (this->uniform_param.low == rhs.uniform_param.low)
+             && (this->uniform_param.high == rhs.uniform_param.high);
+    } else if (rhs.type == InitializerType::kNormal) {
+      return (this->normal_param.mean == rhs.normal_param.mean)
+             && (this->normal_param.std == rhs.normal_param.std);
+    } else if (rhs.type == InitializerType::kConstant) {
+      return this->constant_param.value == rhs.constant_param.value;
+    } else {
+      UNIMPLEMENTED();
+      return false;
+    }
+  }
+};
+
+// Parses the initializers of the model columns of every table in json_serialized and of the
+// optimizer states in state_initializer. initializer_index holds, for every (table, column) of a
+// line, the position of its initializer in initializer_params.
+void ParseInitializers(const int64_t line_size, const int64_t embedding_size,
+                       const std::string& state_initializer, const std::string& json_serialized,
+                       std::vector<EmbeddingInitializer>* initializer_params,
+                       std::vector<int8_t>* initializer_index);
+
+enum class EmbeddingBufferType { kNumMissing = 0, kMissingIndices, kValues, kMaxType };
+
+class EmbeddingTmpBufferManager final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(EmbeddingTmpBufferManager);
+  EmbeddingTmpBufferManager(void* ptr, const int64_t num_ids, const int64_t value_byte_size,
+                            const bool need_value_buffer)
+      : offset_(0), offsets_(static_cast<size_t>(EmbeddingBufferType::kMaxType), -1), ptr_(ptr) {
+    AllocBuffer(EmbeddingBufferType::kNumMissing, sizeof(uint32_t));
+    AllocBuffer(EmbeddingBufferType::kMissingIndices, num_ids * sizeof(uint32_t));
+    if (need_value_buffer) { AllocBuffer(EmbeddingBufferType::kValues, num_ids * value_byte_size); }
+  }
+
+  template<typename T = void>
+  T* Ptr(EmbeddingBufferType type) {
+    CHECK(ptr_ != nullptr);
+    int64_t offset = offsets_.at(static_cast<size_t>(type));
+    CHECK_NE(offset, -1);
+    return reinterpret_cast<T*>(reinterpret_cast<char*>(ptr_) + offset);
+  }
+
+  size_t TotalBufferSize() const { return offset_; }
+
+ private:
+  void AllocBuffer(EmbeddingBufferType type, size_t size) {
+    const size_t type_id = static_cast<size_t>(type);
+    CHECK_EQ(offsets_.at(type_id), -1);
+    offsets_.at(type_id) = offset_;
+    offset_ += GetCudaAlignedSize(size);
+  }
+
+  size_t offset_;
+  std::vector<int64_t> offsets_;
+  void* ptr_;
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_ONE_EMBEDDING_KERNEL_UTIL_H_
@@ -0,0 +1,199 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/user/kernels/model_update_kernel_util.h"
+
+namespace oneflow {
+
+namespace {
+
+template<typename T>
+T GetScale(user_op::KernelComputeContext* ctx, const user_op::Tensor* unique_embeddings) {
+  T scale = static_cast<T>(ctx->Attr<double>("scale"));
+  if (ctx->has_input("scale_by_tensor", 0)) {
+    const user_op::Tensor* scale_by_tensor = ctx->Tensor4ArgNameAndIndex("scale_by_tensor", 0);
+    CHECK_EQ(scale_by_tensor->data_type(), unique_embeddings->data_type());
+    CHECK_EQ(scale_by_tensor->shape_view().elem_cnt(), 1);
+    scale *= *scale_by_tensor->dptr<T>();
+  }
+  if (ctx->has_input("down_scale_by_tensor", 0)) {
+    const user_op::Tensor* down_scale_by_tensor =
+        ctx->Tensor4ArgNameAndIndex("down_scale_by_tensor", 0);
+    CHECK_EQ(down_scale_by_tensor->data_type(), unique_embeddings->data_type());
+    CHECK_EQ(down_scale_by_tensor->shape_view().elem_cnt(), 1);
+    scale /= *down_scale_by_tensor->dptr<T>();
+  }
+  return scale;
+}
+
+bool SkipUpdate(user_op::KernelComputeContext* ctx) {
+  if (!ctx->has_input("skip_if", 0)) { return false; }
+  const user_op::Tensor* skip_if = ctx->Tensor4ArgNameAndIndex("skip_if", 0);
+  CHECK_EQ(skip_if->shape_view().elem_cnt(), 1);
+  return *skip_if->dptr<int64_t>() != 0;
+}
+
+// Runs f(row) for the num_unique rows, a row costs about num_elems_per_row elementwise updates.
+template<typename F>
+void ForEachRow(ep::Stream* stream, int64_t num_unique, int64_t num_elems_per_row, const F& f) {
+  stream->As<ep::CpuStream>()->ParallelFor(
+      0, num_unique,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t row = begin; row < end; ++row) { f(row); }
+      },
+      ep::GetParallelForGrainSize(num_elems_per_row * 4 * ep::parallel_for_cost::kElementwise));
+}
+
+}  // namespace
+
+template<typename T, typename G, typename IDX>
+class SgdEmbeddingUpdateCpuKernel final : public user_op::OpKernel {
+ public:
+  SgdEmbeddingUpdateCpuKernel() = default;
+  ~SgdEmbeddingUpdateCpuKernel() override = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* num_unique_ids = ctx->Tensor4ArgNameAndIndex("num_unique_ids", 0);
+    const user_op::Tensor* unique_embeddings = ctx->Tensor4ArgNameAndIndex("unique_embeddings", 0);
+    const user_op::Tensor* embedding_grad = ctx->Tensor4ArgNameAndIndex("embedding_grad", 0);
+    user_op::Tensor* updated_unique_embeddings =
+        ctx->Tensor4ArgNameAndIndex("updated_unique_embeddings", 0);
+    CHECK_EQ(unique_embeddings->shape_view().NumAxes(), 2);
+    CHECK_EQ(embedding_grad->shape_view().NumAxes(), 2);
+    const int64_t line_size = unique_embeddings->shape_view().At(1);
+    const int64_t embedding_size = embedding_grad->shape_view().At(1);
+    CHECK_EQ(line_size, embedding_size);
+    const int64_t num_unique = *num_unique_ids->dptr<IDX>();
+    const T* model = unique_embeddings->dptr<T>();
+    T* updated_model = updated_unique_embeddings->mut_dptr<T>();
+    if (SkipUpdate(ctx)) {
+      if (updated_model != model) {
+        std::copy(model, model + num_unique * line_size, updated_model);
+      }
+      return;
+    }
+    const T scale = GetScale<T>(ctx, unique_embeddings);
+    const float l1 = ctx->Attr<float>("l1");
+    const float l2 = ctx->Attr<float>("l2");
+    const float weight_decay = ctx->Attr<float>("weight_decay");
+    const float learning_rate = *ctx->Tensor4ArgNameAndIndex("learning_rate", 0)->dptr<float>();
+    const G* model_diff = embedding_grad->dptr<G>();
+    ForEachRow(ctx->stream(), num_unique, embedding_size, [&](int64_t row) {
+      for (int64_t i = row * embedding_size; i < (row + 1) * embedding_size; ++i) {
+        updated_model[i] = model[i];
+        SGDUpdateFunctor<T, G>()(model_diff + i, updated_model + i, scale, l1, l2, weight_decay,
+                                 learning_rate);
+      }
+    });
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+#define IDX_DATA_TYPE_SEQ                           \
+  OF_PP_MAKE_TUPLE_SEQ(uint32_t, DataType::kUInt32) \
+  OF_PP_MAKE_TUPLE_SEQ(int32_t, DataType::kInt32)
+
+#define REGISTER_CPU_SGD_EMBEDDING_UPDATE_KERNEL(t_dtype_pair, g_type_pair, idx_dtype_pair)   \
+  REGISTER_USER_KERNEL("sgd_embedding_update")                                                \
+      .SetCreateFn<SgdEmbeddingUpdateCpuKernel<OF_PP_PAIR_FIRST(t_dtype_pair),                \
+                                               OF_PP_PAIR_FIRST(g_type_pair),                 \
+                                               OF_PP_PAIR_FIRST(idx_dtype_pair)>>()           \
+      .SetIsMatchedHob(                                                                       \
+          (user_op::HobDeviceType() == DeviceType::kCPU)                                      \
+          && (user_op::HobDataType("num_unique_ids", 0) == OF_PP_PAIR_SECOND(idx_dtype_pair)) \
+          && (user_op::HobDataType("embedding_grad", 0) == OF_PP_PAIR_SECOND(g_type_pair))    \
+          && (user_op::HobDataType("unique_embeddings", 0) == OF_PP_PAIR_SECOND(t_dtype_pair)));
+
+OF_PP_SEQ_PRODUCT_FOR_EACH_TUPLE(REGISTER_CPU_SGD_EMBEDDING_UPDATE_KERNEL, FLOATING_DATA_TYPE_SEQ,
+                                 FLOATING_DATA_TYPE_SEQ, IDX_DATA_TYPE_SEQ)
+
+template<typename T, typename G, typename IDX>
+class AdamEmbeddingUpdateCpuKernel final : public user_op::OpKernel {
+ public:
+  AdamEmbeddingUpdateCpuKernel() = default;
+  ~AdamEmbeddingUpdateCpuKernel() override = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* num_unique_ids = ctx->Tensor4ArgNameAndIndex("num_unique_ids", 0);
+    const user_op::Tensor* unique_embeddings = ctx->Tensor4ArgNameAndIndex("unique_embeddings", 0);
+    const user_op::Tensor* embedding_grad = ctx->Tensor4ArgNameAndIndex("embedding_grad", 0);
+    user_op::Tensor* updated_unique_embeddings =
+        ctx->Tensor4ArgNameAndIndex("updated_unique_embeddings", 0);
+    CHECK_EQ(unique_embeddings->shape_view().NumAxes(), 2);
+    CHECK_EQ(embedding_grad->shape_view().NumAxes(), 2);
+    const int64_t line_size = unique_embeddings->shape_view().At(1);
+    const int64_t embedding_size = embedding_grad->shape_view().At(1);
+    CHECK_EQ(line_size, embedding_size * 3);
+    const int64_t num_unique = *num_unique_ids->dptr<IDX>();
+    const T* unique_values = unique_embeddings->dptr<T>();
+    T* updated_unique_values = updated_unique_embeddings->mut_dptr<T>();
+    // a line holds the model, m and v of an id, in that order
+    if (updated_unique_values != unique_values) {
+      std::copy(unique_values, unique_values + num_unique * line_size, updated_unique_values);
+    }
+    if (SkipUpdate(ctx)) { return; }
+    const T scale = GetScale<T>(ctx, unique_embeddings);
+    const float l1 = ctx->Attr<float>("l1");
+    const float l2 = ctx->Attr<float>("l2");
+    const float weight_decay = ctx->Attr<float>("weight_decay");
+    const float beta1 = ctx->Attr<float>("beta1");
+    const float beta2 = ctx->Attr<float>("beta2");
+    const float epsilon = ctx->Attr<float>("epsilon");
+    const float learning_rate = *ctx->Tensor4ArgNameAndIndex("learning_rate", 0)->dptr<float>();
+    float bias_correction1 = 1.0;
+    if (ctx->has_input("bias_correction1", 0)) {
+      bias_correction1 = *ctx->Tensor4ArgNameAndIndex("bias_correction1", 0)->dptr<float>();
+    }
+    float bias_correction2 = 1.0;
+    if (ctx->has_input("bias_correction2", 0)) {
+      bias_correction2 = *ctx->Tensor4ArgNameAndIndex("bias_correction2", 0)->dptr<float>();
+    }
+    const G* model_diff = embedding_grad->dptr<G>();
+    ForEachRow(ctx->stream(), num_unique, line_size, [&](int64_t row) {
+      T* model = updated_unique_values + row * line_size;
+      T* m = model + embedding_size;
+      T* v = model + 2 * embedding_size;
+      const G* row_model_diff = model_diff + row * embedding_size;
+      for (int64_t col = 0; col < embedding_size; ++col) {
+        AdamUpdateFunctor<T, G>()(row_model_diff + col, model + col, m + col, v + col, nullptr,
+                                  scale, l1, l2, beta1, beta2, epsilon, weight_decay, false,
+                                  bias_correction1, bias_correction2, learning_rate);
+      }
+    });
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+#define REGISTER_CPU_ADAM_EMBEDDING_UPDATE_KERNEL(t_dtype_pair, g_type_pair, idx_dtype_pair)  \
+  REGISTER_USER_KERNEL("adam_embedding_update")                                               \
+      .SetCreateFn<AdamEmbeddingUpdateCpuKernel<OF_PP_PAIR_FIRST(t_dtype_pair),               \
+                                                OF_PP_PAIR_FIRST(g_type_pair),                \
+                                                OF_PP_PAIR_FIRST(idx_dtype_pair)>>()          \
+      .SetIsMatchedHob(                                                                       \
+          (user_op::HobDeviceType() == DeviceType::kCPU)                                      \
+          && (user_op::HobDataType("num_unique_ids", 0) == OF_PP_PAIR_SECOND(idx_dtype_pair)) \
+          && (user_op::HobDataType("embedding_grad", 0) == OF_PP_PAIR_SECOND(g_type_pair))    \
+          && (user_op::HobDataType("unique_embeddings", 0) == OF_PP_PAIR_SECOND(t_dtype_pair)));
+
+OF_PP_SEQ_PRODUCT_FOR_EACH_TUPLE(REGISTER_CPU_ADAM_EMBEDDING_UPDATE_KERNEL, FLOATING_DATA_TYPE_SEQ,
+                                 FLOATING_DATA_TYPE_SEQ, IDX_DATA_TYPE_SEQ)
+
+}  // namespace oneflow
@@ -0,0 +1,209 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_RADIX_SORT_CPU_UTIL_H_
+#define ONEFLOW_USER_KERNELS_RADIX_SORT_CPU_UTIL_H_
+
+#include <cstring>
+#include "oneflow/core/common/shape.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+
+namespace oneflow {
+
+namespace radix_sort_cpu {
+
+// Rows shorter than this are sorted with std::sort, below it the histograms of the radix passes
+// cost more than the comparisons they save.
+constexpr int64_t kMinInstanceSize = 256;
+// A row at least this long is split into chunks that all threads sort together when there are
+// fewer rows than threads.
+constexpr int64_t kMinParallelInstanceSize = 1 << 16;
+constexpr int64_t kMinChunkSize = 1 << 14;
+
+constexpr int kRadixBits = 8;
+constexpr int64_t kRadixSize = 1 << kRadixBits;
+
+// RadixKey<T>::ToBits maps a key to an unsigned integer of the same width whose order is the
+// order of the keys, so sorting the bits byte by byte sorts the keys.
+template<typename T>
+struct RadixKey;
+
+template<>
+struct RadixKey<bool> {
+  using Bits = uint8_t;
+  static Bits ToBits(bool x) { return static_cast<Bits>(x); }
+  static bool FromBits(Bits bits) { return bits != 0; }
+};
+
+template<>
+struct RadixKey<uint8_t> {
+  using Bits = uint8_t;
+  static Bits ToBits(uint8_t x) { return x; }
+  static uint8_t FromBits(Bits bits) { return bits; }
+};
+
+// Flipping the sign bit moves the negative keys below the positive ones.
+template<typename T, typename U>
+struct SignedRadixKey {
+  using Bits = U;
+  static constexpr Bits kSignBit = Bits{1} << (sizeof(Bits) * 8 - 1);
+  static Bits ToBits(T x) { return static_cast<Bits>(x) ^ kSignBit; }
+  static T FromBits(Bits bits) { return static_cast<T>(bits ^ kSignBit); }
+};
+
+template<>
+struct RadixKey<int8_t> : public SignedRadixKey<int8_t, uint8_t> {};
+template<>
+struct RadixKey<int32_t> : public SignedRadixKey<int32_t, uint32_t> {};
+template<>
+struct RadixKey<int64_t> : public SignedRadixKey<int64_t, uint64_t> {};
+
+// Positive floats order as their bits once the sign bit is set, negative floats order inversely to
+// their bits, so all of their bits are flipped. NaN with the sign bit cleared sorts after inf.
+template<typename T, typename U>
+struct FloatingRadixKey {
+  using Bits = U;
+  static constexpr Bits kSignBit = Bits{1} << (sizeof(Bits) * 8 - 1);
+  static Bits ToBits(T x) {
+    Bits bits;
+    std::memcpy(&bits, &x, sizeof(Bits));
+    return (bits & kSignBit) ? ~bits : (bits | kSignBit);
+  }
+  static T FromBits(Bits bits) {
+    bits = (bits & kSignBit) ? (bits & ~kSignBit) : ~bits;
+    T x;
+    std::memcpy(&x, &bits, sizeof(Bits));
+    return x;
+  }
+};
+
+template<>
+struct RadixKey<float> : public FloatingRadixKey<float, uint32_t> {};
+template<>
+struct RadixKey<double> : public FloatingRadixKey<double, uint64_t> {};
+
+// Calls f(chunk, begin, end) for the num_chunks chunks of [0, n), on the threads of stream when it
+// is not null.
+template<typename F>
+void ForEachChunk(ep::CpuStream* stream, int64_t n, int64_t num_chunks, const F& f) {
+  const int64_t chunk_size = (n + num_chunks - 1) / num_chunks;
+  auto RunChunks = [&](int64_t begin, int64_t end) {
+    for (int64_t chunk = begin; chunk < end; ++chunk) {
+      f(chunk, std::min(chunk * chunk_size, n), std::min((chunk + 1) * chunk_size, n));
+    }
+  };
+  if (stream == nullptr || num_chunks == 1) {
+    RunChunks(0, num_chunks);
+  } else {
+    stream->ParallelFor(0, num_chunks, RunChunks, 1);
+  }
+}
+
+// Stable LSD radix sort of n keys, which moves the values along unless values is null. keys_tmp
+// and values_tmp hold n elements each, the sorted keys and values end in keys and values. Every
+// pass counts the digits of each chunk, so the chunks are scattered independently to the offsets
+// of a scan over (digit, chunk). A pass in which all keys share the digit is skipped.
+template<typename K, typename V>
+void RadixSortPairs(ep::CpuStream* stream, int64_t num_chunks, int64_t n, K* keys, V* values,
+                    K* keys_tmp, V* values_tmp) {
+  static_assert(std::is_unsigned<K>::value, "");
+  std::vector<int64_t> offsets(num_chunks * kRadixSize);
+  K* src_keys = keys;
+  K* dst_keys = keys_tmp;
+  V* src_values = values;
+  V* dst_values = values_tmp;
+  for (int shift = 0; shift < static_cast<int>(sizeof(K) * 8); shift += kRadixBits) {
+    ForEachChunk(stream, n, num_chunks, [&](int64_t chunk, int64_t begin, int64_t end) {
+      int64_t* count = offsets.data() + chunk * kRadixSize;
+      std::fill(count, count + kRadixSize, 0);
+      for (int64_t i = begin; i < end; ++i) { ++count[(src_keys[i] >> shift) & (kRadixSize - 1)]; }
+    });
+    bool is_trivial_pass = false;
+    int64_t sum = 0;
+    for (int64_t digit = 0; digit < kRadixSize; ++digit) {
+      const int64_t digit_begin = sum;
+      for (int64_t chunk = 0; chunk < num_chunks; ++chunk) {
+        const int64_t count = offsets[chunk * kRadixSize + digit];
+        offsets[chunk * kRadixSize + digit] = sum;
+        sum += count;
+      }
+      if (sum - digit_begin == n) { is_trivial_pass = true; }
+    }
+    if (is_trivial_pass) { continue; }
+    ForEachChunk(stream, n, num_chunks, [&](int64_t chunk, int64_t begin, int64_t end) {
+      int64_t* offset = offsets.data() + chunk * kRadixSize;
+      if (values == nullptr) {
+        for (int64_t i = begin; i < end; ++i) {
+          dst_keys[offset[(src_keys[i] >> shift) & (kRadixSize - 1)]++] = src_keys[i];
+        }
+      } else {
+        for (int64_t i = begin; i < end; ++i) {
+          const int64_t dst = offset[(src_keys[i] >> shift) & (kRadixSize - 1)]++;
+          dst_keys[dst] = src_keys[i];
+          dst_values[dst] = src_values[i];
+        }
+      }
+    });
+    std::swap(src_keys, dst_keys);
+    std::swap(src_values, dst_values);
+  }
+  if (src_keys != keys) {
+    ForEachChunk(stream, n, num_chunks, [&](int64_t chunk, int64_t begin, int64_t end) {
+      std::copy(src_keys + begin, src_keys + end, keys + begin);
+      if (values != nullptr) { std::copy(src_values + begin, src_values + end, values + begin); }
+    });
+  }
+}
+
+// Radix sorts instance_num rows of instance_size keys and their values. Rows are handed to the
+// threads when there are enough of them, otherwise every long row is sorted by all threads.
+template<typename K, typename V>
+void RadixSortRows(ep::CpuStream* stream, int64_t instance_num, int64_t instance_size, K* keys,
+                   V* values, K* keys_tmp, V* values_tmp) {
+  const int64_t num_threads = stream->device()->GetNumThreads();
+  auto ValuesOf = [&](V* ptr, int64_t i) { return ptr == nullptr ? ptr : ptr + i * instance_size; };
+  if (instance_num < num_threads && instance_size >= kMinParallelInstanceSize) {
+    const int64_t num_chunks = std::min(num_threads, instance_size / kMinChunkSize);
+    FOR_RANGE(int64_t, i, 0, instance_num) {
+      RadixSortPairs(stream, num_chunks, instance_size, keys + i * instance_size,
+                     ValuesOf(values, i), keys_tmp + i * instance_size, ValuesOf(values_tmp, i));
+    }
+  } else {
+    stream->ParallelFor(
+        0, instance_num,
+        [&](int64_t begin, int64_t end) {
+          FOR_RANGE(int64_t, i, begin, end) {
+            RadixSortPairs<K, V>(nullptr, 1, instance_size, keys + i * instance_size,
+                                 ValuesOf(values, i), keys_tmp + i * instance_size,
+                                 ValuesOf(values_tmp, i));
+          }
+        },
+        ep::GetParallelForGrainSize(ep::parallel_for_cost::RadixSort(instance_size, sizeof(K))));
+  }
+}
+
+// Bytes of the keys and of the temporary keys of a radix sort of the rows of shape, 0 if the rows
+// are sorted with std::sort.
+template<typename T>
+size_t GetKeysTmpSize(const Shape& shape) {
+  if (shape.elem_cnt() == 0 || shape.At(shape.NumAxes() - 1) < kMinInstanceSize) { return 0; }
+  return GetCudaAlignedSize(shape.elem_cnt() * sizeof(typename RadixKey<T>::Bits));
+}
+
+}  // namespace radix_sort_cpu
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_RADIX_SORT_CPU_UTIL_H_
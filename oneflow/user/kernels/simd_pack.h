@@ -0,0 +1,145 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_SIMD_PACK_H_
+#define ONEFLOW_USER_KERNELS_SIMD_PACK_H_
+
+#include <cstring>
+#include "oneflow/core/common/util.h"
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+namespace oneflow {
+
+// A pack of values processed together by cpu kernels. Rows are processed pack by pack and the
+// remainder one value at a time, so the scalar pack is the fallback for types without a vector
+// pack. Mark the functions with the hot loops OF_CPU_TARGET_CLONES to get AVX2 packs.
+template<typename T>
+struct SimdPack {
+  static constexpr int64_t kSize = 1;
+  T value;
+
+  static SimdPack Load(const T* ptr) { return SimdPack{*ptr}; }
+  static SimdPack Broadcast(T value) { return SimdPack{value}; }
+  // a * b + c
+  static SimdPack Fma(const SimdPack& a, const SimdPack& b, const SimdPack& c) {
+    return SimdPack{a.value * b.value + c.value};
+  }
+  void Store(T* ptr) const { *ptr = value; }
+  SimdPack operator+(const SimdPack& rhs) const { return SimdPack{value + rhs.value}; }
+  SimdPack operator-(const SimdPack& rhs) const { return SimdPack{value - rhs.value}; }
+  SimdPack operator*(const SimdPack& rhs) const { return SimdPack{value * rhs.value}; }
+  static SimdPack Max(const SimdPack& a, const SimdPack& b) {
+    return SimdPack{std::max(a.value, b.value)};
+  }
+};
+
+#if defined(__AVX512F__)
+
+template<>
+struct SimdPack<float> {
+  static constexpr int64_t kSize = 16;
+  __m512 value;
+
+  static SimdPack Load(const float* ptr) { return SimdPack{_mm512_loadu_ps(ptr)}; }
+  static SimdPack Broadcast(float value) { return SimdPack{_mm512_set1_ps(value)}; }
+  static SimdPack Fma(const SimdPack& a, const SimdPack& b, const SimdPack& c) {
+    return SimdPack{_mm512_fmadd_ps(a.value, b.value, c.value)};
+  }
+  void Store(float* ptr) const { _mm512_storeu_ps(ptr, value); }
+  SimdPack operator+(const SimdPack& rhs) const {
+    return SimdPack{_mm512_add_ps(value, rhs.value)};
+  }
+  SimdPack operator-(const SimdPack& rhs) const {
+    return SimdPack{_mm512_sub_ps(value, rhs.value)};
+  }
+  SimdPack operator*(const SimdPack& rhs) const {
+    return SimdPack{_mm512_mul_ps(value, rhs.value)};
+  }
+  static SimdPack Max(const SimdPack& a, const SimdPack& b) {
+    return SimdPack{_mm512_max_ps(a.value, b.value)};
+  }
+};
+
+#else
+
+// With GCC vector extensions, so that the pack is vectorized for whatever target the enclosing
+// function is compiled for, SSE by default and AVX2 in OF_CPU_TARGET_CLONES functions. a * b + c
+// is contracted to an FMA where the target has one.
+template<>
+struct SimdPack<float> {
+  static constexpr int64_t kSize = 8;
+  typedef float Vec __attribute__((vector_size(kSize * sizeof(float))));
+  Vec value;
+
+  static SimdPack Load(const float* ptr) {
+    SimdPack pack;
+    std::memcpy(&pack.value, ptr, sizeof(Vec));
+    return pack;
+  }
+  static SimdPack Broadcast(float value) { return SimdPack{Vec{} + value}; }
+  static SimdPack Fma(const SimdPack& a, const SimdPack& b, const SimdPack& c) {
+    return SimdPack{a.value * b.value + c.value};
+  }
+  void Store(float* ptr) const { std::memcpy(ptr, &value, sizeof(Vec)); }
+  SimdPack operator+(const SimdPack& rhs) const { return SimdPack{value + rhs.value}; }
+  SimdPack operator-(const SimdPack& rhs) const { return SimdPack{value - rhs.value}; }
+  SimdPack operator*(const SimdPack& rhs) const { return SimdPack{value * rhs.value}; }
+  static SimdPack Max(const SimdPack& a, const SimdPack& b) {
+    return SimdPack{a.value > b.value ? a.value : b.value};
+  }
+};
+
+#endif
+
+template<typename T>
+T ReduceSum(const SimdPack<T>& pack) {
+  T lanes[SimdPack<T>::kSize];
+  pack.Store(lanes);
+  T sum = 0;
+  for (int64_t i = 0; i < SimdPack<T>::kSize; ++i) { sum += lanes[i]; }
+  return sum;
+}
+
+// Dot product of two vectors of n values.
+template<typename T>
+OF_CPU_TARGET_CLONES T SimdDot(const T* a, const T* b, int64_t n) {
+  using P = SimdPack<T>;
+  P pack_sum = P::Broadcast(0);
+  int64_t i = 0;
+  for (; i + P::kSize <= n; i += P::kSize) {
+    pack_sum = P::Fma(P::Load(a + i), P::Load(b + i), pack_sum);
+  }
+  T sum = ReduceSum(pack_sum);
+  for (; i < n; ++i) { sum += a[i] * b[i]; }
+  return sum;
+}
+
+// y += alpha * x for vectors of n values.
+template<typename T>
+OF_CPU_TARGET_CLONES void SimdAxpy(int64_t n, T alpha, const T* x, T* y) {
+  using P = SimdPack<T>;
+  const P pack_alpha = P::Broadcast(alpha);
+  int64_t i = 0;
+  for (; i + P::kSize <= n; i += P::kSize) {
+    P::Fma(pack_alpha, P::Load(x + i), P::Load(y + i)).Store(y + i);
+  }
+  for (; i < n; ++i) { y[i] += alpha * x[i]; }
+}
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_SIMD_PACK_H_
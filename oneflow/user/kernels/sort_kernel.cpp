@@ -15,6 +15,8 @@ limitations under the License.
 */
 #include "oneflow/core/framework/framework.h"
 #include "oneflow/core/kernel/new_kernel_util.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/user/kernels/radix_sort_cpu_util.h"
 
 namespace oneflow {
 
@@ -29,31 +31,70 @@ class CpuSortKernel final : public user_op::OpKernel {
     const user_op::Tensor* in = ctx->Tensor4ArgNameAndIndex("in", 0);
     user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
 
-    Memcpy<DeviceType::kCPU>(ctx->stream(), out->mut_dptr<T>(), in->dptr<T>(),
-                             in->shape_view().elem_cnt() * sizeof(T));
     const int32_t instance_size = in->shape_view().At(in->shape_view().NumAxes() - 1);
     const int32_t instance_num = in->shape_view().elem_cnt() / instance_size;
     const std::string& direction = ctx->Attr<std::string>("direction");
     const bool is_ascending = direction == "ASCENDING";
     const bool is_descending = direction == "DESCENDING";
-    FOR_RANGE(int32_t, i, 0, instance_num) {
-      T* out_ptr_i = out->mut_dptr<T>() + i * instance_size;
-      if (is_ascending) {
-        std::sort(out_ptr_i, out_ptr_i + instance_size, std::less<T>());
-      } else if (is_descending) {
-        std::sort(out_ptr_i, out_ptr_i + instance_size, std::greater<T>());
-      } else {
-        UNIMPLEMENTED();
-      }
+    CHECK(is_ascending || is_descending);
+    auto* stream = ctx->stream()->As<ep::CpuStream>();
+    if (instance_size >= radix_sort_cpu::kMinInstanceSize) {
+      using RadixKey = radix_sort_cpu::RadixKey<T>;
+      using Bits = typename RadixKey::Bits;
+      user_op::Tensor* tmp_buffer = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
+      const int64_t elem_cnt = in->shape_view().elem_cnt();
+      const size_t keys_size = radix_sort_cpu::GetKeysTmpSize<T>(in->shape_view());
+      Bits* keys = tmp_buffer->mut_dptr<Bits>();
+      Bits* keys_tmp = reinterpret_cast<Bits*>(tmp_buffer->mut_dptr<char>() + keys_size);
+      // descending order is the ascending order of the inverted bits
+      const Bits flip = is_descending ? static_cast<Bits>(~Bits{0}) : Bits{0};
+      const T* in_ptr = in->dptr<T>();
+      T* out_ptr = out->mut_dptr<T>();
+      const size_t grain = ep::GetParallelForGrainSize(ep::parallel_for_cost::kElementwise);
+      stream->ParallelFor(
+          0, elem_cnt,
+          [&](int64_t begin, int64_t end) {
+            FOR_RANGE(int64_t, i, begin, end) { keys[i] = RadixKey::ToBits(in_ptr[i]) ^ flip; }
+          },
+          grain);
+      radix_sort_cpu::RadixSortRows<Bits, int32_t>(stream, instance_num, instance_size, keys,
+                                                   nullptr, keys_tmp, nullptr);
+      stream->ParallelFor(
+          0, elem_cnt,
+          [&](int64_t begin, int64_t end) {
+            FOR_RANGE(int64_t, i, begin, end) { out_ptr[i] = RadixKey::FromBits(keys[i] ^ flip); }
+          },
+          grain);
+      return;
     }
+    Memcpy<DeviceType::kCPU>(ctx->stream(), out->mut_dptr<T>(), in->dptr<T>(),
+                             in->shape_view().elem_cnt() * sizeof(T));
+    stream->ParallelFor(
+        0, instance_num,
+        [&](int64_t begin, int64_t end) {
+          FOR_RANGE(int64_t, i, begin, end) {
+            T* out_ptr_i = out->mut_dptr<T>() + i * instance_size;
+            if (is_ascending) {
+              std::sort(out_ptr_i, out_ptr_i + instance_size, std::less<T>());
+            } else {
+              std::sort(out_ptr_i, out_ptr_i + instance_size, std::greater<T>());
+            }
+          }
+        },
+        ep::GetParallelForGrainSize(ep::parallel_for_cost::Sort(instance_size)));
   }
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
 };
 
-#define REGISTER_CPU_SORT_KERNEL(dtype)                                             \
-  REGISTER_USER_KERNEL("sort").SetCreateFn<CpuSortKernel<dtype>>().SetIsMatchedHob( \
-      (user_op::HobDeviceType() == DeviceType::kCPU)                                \
-      && (user_op::HobDataType("out", 0) == GetDataType<dtype>::value));
+#define REGISTER_CPU_SORT_KERNEL(dtype)                                                  \
+  REGISTER_USER_KERNEL("sort")                                                           \
+      .SetCreateFn<CpuSortKernel<dtype>>()                                               \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                    \
+                       && (user_op::HobDataType("out", 0) == GetDataType<dtype>::value)) \
+      .SetInferTmpSizeFn([](user_op::InferContext* ctx) {                                \
+        /* keys and temporary keys of the radix sort */                                  \
+        return 2 * radix_sort_cpu::GetKeysTmpSize<dtype>(ctx->InputShape("in", 0));      \
+      });
 
 REGISTER_CPU_SORT_KERNEL(float)
 REGISTER_CPU_SORT_KERNEL(double)
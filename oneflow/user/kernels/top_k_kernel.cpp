@@ -14,13 +14,34 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/core/framework/framework.h"
-#include "oneflow/core/thread/thread_manager.h"
-#include "oneflow/core/common/balanced_splitter.h"
+#include "oneflow/core/common/range.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
 
 namespace oneflow {
 
 namespace {
 
+// A row at least this long is split into chunks whose candidates are selected by all threads
+// together when there are fewer rows than threads.
+constexpr int64_t kMinParallelInstanceSize = 1 << 16;
+constexpr int64_t kMinChunkSize = 1 << 14;
+
+// Orders indices by descending value, equal values by ascending index.
+template<typename T>
+struct TopKComparator {
+  const T* in_ptr;
+
+  bool operator()(const int64_t lhs, const int64_t rhs) const {
+    const T l = in_ptr[lhs];
+    const T r = in_ptr[rhs];
+    if (l == r) {
+      return lhs < rhs;
+    } else {
+      return l > r;
+    }
+  }
+};
+
 template<typename T>
 void ComputeTopOne(const T* in_ptr, const Range& range, int64_t instance_size, int64_t* out_ptr) {
   FOR_RANGE(int64_t, i, range.begin(), range.end()) {
@@ -34,43 +55,102 @@ void ComputeTopK(const T* in_ptr, int64_t* indices_ptr, const Range& range, int6
                  int64_t k, bool sorted, int64_t* out_ptr) {
   FOR_RANGE(int64_t, i, range.begin(), range.end()) {
     const int64_t offset = i * instance_size;
-    const T* in_ptr_i = in_ptr + offset;
     int64_t* indices_ptr_i = indices_ptr + offset;
     std::iota(indices_ptr_i, indices_ptr_i + instance_size, 0);
-    auto comp = [&](const int64_t lhs, const int64_t rhs) {
-      const T l = in_ptr_i[lhs];
-      const T r = in_ptr_i[rhs];
-      if (l == r) {
-        return lhs < rhs;
-      } else {
-        return l > r;
-      }
-    };
+    const TopKComparator<T> comp{in_ptr + offset};
     std::nth_element(indices_ptr_i, indices_ptr_i + k, indices_ptr_i + instance_size, comp);
     if (sorted) { std::sort(indices_ptr_i, indices_ptr_i + k, comp); }
     std::copy(indices_ptr_i, indices_ptr_i + k, out_ptr + i * k);
   }
 }
 
+// Top k of one long row: every chunk selects its own top k in parallel, they are moved to the
+// front of the row and the top k of these candidates is selected from them.
 template<typename T>
-void CpuTopK(ep::Stream* /*stream*/, const T* in_ptr, int64_t* indices_ptr, int64_t instance_num,
-             int64_t instance_size, int64_t k, bool sorted, int64_t* out_ptr) {
-  const int64_t num_thread =
-      std::min(instance_num, static_cast<int64_t>(Global<ThreadPool>::Get()->thread_num()));
-  const BalancedSplitter bs(instance_num, num_thread);
-  BlockingCounter bc(num_thread);
-  FOR_RANGE(int64_t, thread_id, 0, num_thread) {
-    const Range range = bs.At(thread_id);
-    Global<ThreadPool>::Get()->AddWork([=, &bc]() {
-      if (k == 1) {
-        ComputeTopOne(in_ptr, range, instance_size, out_ptr);
-      } else {
-        ComputeTopK(in_ptr, indices_ptr, range, instance_size, k, sorted, out_ptr);
+void ComputeTopKOfLongInstance(ep::CpuStream* stream, int64_t num_chunks, const T* in_ptr_i,
+                               int64_t* indices_ptr_i, int64_t instance_size, int64_t k,
+                               bool sorted, int64_t* out_ptr_i) {
+  const int64_t chunk_size = (instance_size + num_chunks - 1) / num_chunks;
+  const TopKComparator<T> comp{in_ptr_i};
+  std::vector<int64_t> num_chunk_candidates(num_chunks);
+  stream->ParallelFor(
+      0, num_chunks,
+      [&](int64_t begin, int64_t end) {
+        FOR_RANGE(int64_t, chunk, begin, end) {
+          const int64_t chunk_begin = std::min(chunk * chunk_size, instance_size);
+          const int64_t chunk_end = std::min(chunk_begin + chunk_size, instance_size);
+          const int64_t chunk_k = std::min(k, chunk_end - chunk_begin);
+          if (k == 1) {
+            // the first maximum of the chunk, as max_element finds it
+            if (chunk_k == 1) {
+              indices_ptr_i[chunk] = std::distance(
+                  in_ptr_i, std::max_element(in_ptr_i + chunk_begin, in_ptr_i + chunk_end));
+            }
+          } else {
+            int64_t* chunk_indices = indices_ptr_i + chunk_begin;
+            std::iota(chunk_indices, chunk_indices + chunk_end - chunk_begin, chunk_begin);
+            std::nth_element(chunk_indices, chunk_indices + chunk_k,
+                             chunk_indices + chunk_end - chunk_begin, comp);
+          }
+          num_chunk_candidates[chunk] = chunk_k;
+        }
+      },
+      1);
+  if (k == 1) {
+    int64_t index = indices_ptr_i[0];
+    FOR_RANGE(int64_t, chunk, 1, num_chunks) {
+      if (num_chunk_candidates[chunk] > 0 && in_ptr_i[indices_ptr_i[chunk]] > in_ptr_i[index]) {
+        index = indices_ptr_i[chunk];
       }
-      bc.Decrease();
-    });
+    }
+    *out_ptr_i = index;
+    return;
+  }
+  int64_t num_candidates = 0;
+  FOR_RANGE(int64_t, chunk, 0, num_chunks) {
+    // candidates only move towards the front, so no chunk is overwritten before it is read
+    const int64_t* chunk_indices = indices_ptr_i + chunk * chunk_size;
+    FOR_RANGE(int64_t, j, 0, num_chunk_candidates[chunk]) {
+      indices_ptr_i[num_candidates++] = chunk_indices[j];
+    }
+  }
+  std::nth_element(indices_ptr_i, indices_ptr_i + k, indices_ptr_i + num_candidates, comp);
+  if (sorted) { std::sort(indices_ptr_i, indices_ptr_i + k, comp); }
+  std::copy(indices_ptr_i, indices_ptr_i + k, out_ptr_i);
+}
+
+template<typename T>
+void CpuTopK(ep::Stream* stream, const T* in_ptr, int64_t* indices_ptr, int64_t instance_num,
+             int64_t instance_size, int64_t k, bool sorted, int64_t* out_ptr) {
+  auto* cpu_stream = stream->As<ep::CpuStream>();
+  const int64_t num_threads = cpu_stream->device()->GetNumThreads();
+  const int64_t num_chunks = std::min(num_threads, instance_size / kMinChunkSize);
+  // the candidates of all chunks must be few compared with the row for the split to pay off
+  if (instance_num < num_threads && instance_size >= kMinParallelInstanceSize
+      && num_chunks * k * 4 <= instance_size) {
+    // k == 1 has no tmp_buffer, the maximum of every chunk is kept in chunk_max
+    std::vector<int64_t> chunk_max(k == 1 ? num_chunks : 0);
+    FOR_RANGE(int64_t, i, 0, instance_num) {
+      ComputeTopKOfLongInstance(cpu_stream, num_chunks, in_ptr + i * instance_size,
+                                k == 1 ? chunk_max.data() : indices_ptr + i * instance_size,
+                                instance_size, k, sorted, out_ptr + i * k);
+    }
+    return;
   }
-  bc.WaitForeverUntilCntEqualZero();
+  // Selection is linear in instance_size, sorting the selected k is k * log(k).
+  const int64_t cost =
+      k == 1 ? instance_size : 2 * instance_size + (sorted ? ep::parallel_for_cost::Sort(k) : 0);
+  cpu_stream->ParallelFor(
+      0, instance_num,
+      [&](int64_t begin, int64_t end) {
+        const Range range(begin, end);
+        if (k == 1) {
+          ComputeTopOne(in_ptr, range, instance_size, out_ptr);
+        } else {
+          ComputeTopK(in_ptr, indices_ptr, range, instance_size, k, sorted, out_ptr);
+        }
+      },
+      ep::GetParallelForGrainSize(cost));
 }
 
 }  // namespace
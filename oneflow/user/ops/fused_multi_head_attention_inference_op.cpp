@@ -0,0 +1,69 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/framework/op_generated.h"
+
+namespace oneflow {
+
+/*static*/ auto FusedMultiHeadAttentionInferenceOp::InferDataType(user_op::InferContext* ctx)
+    -> Maybe<void> {
+  const DataType& dtype = ctx->InputDType("query", 0);
+  CHECK_EQ_OR_RETURN(ctx->InputDType("key", 0), dtype);
+  CHECK_EQ_OR_RETURN(ctx->InputDType("value", 0), dtype);
+  *ctx->OutputDType("out", 0) = dtype;
+  return Maybe<void>::Ok();
+}
+/*static*/ auto FusedMultiHeadAttentionInferenceOp::InferLogicalTensorDesc(
+    user_op::InferContext* ctx) -> Maybe<void> {
+  const int64_t num_heads = ctx->Attr<int64_t>("num_heads");
+  CHECK_GT_OR_RETURN(num_heads, 0);
+  // query (batch_size, query_seq_len, num_heads * head_size)
+  // key (batch_size, kv_seq_len, num_heads * head_size)
+  // value (batch_size, kv_seq_len, num_heads * value_head_size)
+  const Shape& query_shape = ctx->InputShape("query", 0);
+  const Shape& key_shape = ctx->InputShape("key", 0);
+  const Shape& value_shape = ctx->InputShape("value", 0);
+  CHECK_EQ_OR_RETURN(query_shape.NumAxes(), 3);
+  CHECK_EQ_OR_RETURN(key_shape.NumAxes(), 3);
+  CHECK_EQ_OR_RETURN(value_shape.NumAxes(), 3);
+  const int64_t batch_size = query_shape.At(0);
+  const int64_t query_seq_len = query_shape.At(1);
+  CHECK_EQ_OR_RETURN(key_shape.At(0), batch_size);
+  CHECK_EQ_OR_RETURN(value_shape.At(0), batch_size);
+  CHECK_EQ_OR_RETURN(value_shape.At(1), key_shape.At(1));
+  CHECK_EQ_OR_RETURN(query_shape.At(2), key_shape.At(2));
+  CHECK_EQ_OR_RETURN(query_shape.At(2) % num_heads, 0);
+  CHECK_EQ_OR_RETURN(value_shape.At(2) % num_heads, 0);
+  // out (batch_size, query_seq_len, num_heads * value_head_size)
+  *ctx->OutputShape("out", 0) = Shape({batch_size, query_seq_len, value_shape.At(2)});
+  return Maybe<void>::Ok();
+}
+/*static*/ auto FusedMultiHeadAttentionInferenceOp::InferPhysicalTensorDesc(
+    user_op::InferContext* ctx) -> Maybe<void> {
+  return FusedMultiHeadAttentionInferenceOp::InferLogicalTensorDesc(ctx);
+}
+/*static*/ auto FusedMultiHeadAttentionInferenceOp::GetSbp(user_op::SbpContext* ctx)
+    -> Maybe<void> {
+  ctx->NewBuilder()
+      .Split(user_op::OpArg("query", 0), 0)
+      .Split(user_op::OpArg("key", 0), 0)
+      .Split(user_op::OpArg("value", 0), 0)
+      .Split(user_op::OpArg("out", 0), 0)
+      .Build();
+  return Maybe<void>::Ok();
+}
+
+}  // namespace oneflow
@@ -19,6 +19,9 @@ limitations under the License.
 namespace oneflow {
 
 /* static */ Maybe<void> OFRecordReaderOp::InferLogicalTensorDesc(user_op::InferContext* ctx) {
+  CHECK_GE_OR_RETURN(ctx->Attr<int32_t>("num_reader_threads"), 1);
+  CHECK_GE_OR_RETURN(ctx->Attr<int32_t>("prefetch_buffer_size"), 1);
+  CHECK_GE_OR_RETURN(ctx->Attr<int64_t>("start_sample_offset"), 0);
   user_op::TensorDesc* out_tensor = ctx->OutputTensorDesc("out", 0);
   *out_tensor->mut_shape() = Shape({ctx->Attr<int32_t>("batch_size")});
   return Maybe<void>::Ok();
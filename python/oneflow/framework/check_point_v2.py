@@ -37,6 +37,7 @@ SNAPSHOT_DONE_FILENAME = "snapshot_done"
 META_INFO_FILENAME = "meta"
 PICKLE_FILENAME = "pickled_data"
 DATA_FILENAME = "out"
+CONTAINER_FILENAME = "tensors"
 PROTOCOL_VERSION = 1
 
 
@@ -142,6 +143,33 @@ def _LoadSingleVariable(
     return flow.tensor(FileBackendVariableBlob(path).numpy())
 
 
+def _get_container_array(key: str) -> np.ndarray:
+    global loaded_container_arrays
+    if loaded_container_arrays is None:
+        # the arrays view the mapped container file, nothing is read until it is used
+        loaded_container_arrays = oneflow._oneflow_internal.LoadCheckpointContainer(
+            str(save_load_path / CONTAINER_FILENAME)
+        )
+    return loaded_container_arrays[key]
+
+
+def _LoadTensorFromContainer(
+    key: str, global_src_rank: Optional[int] = None
+) -> "flow.Tensor":
+    if global_src_rank is not None:
+        rank = flow.env.get_rank()
+        if rank == global_src_rank:
+            loaded = flow.from_numpy(_get_container_array(key))
+        else:
+            loaded = flow.tensor([])
+        loaded = loaded.to_global(
+            flow.placement("cpu", [global_src_rank]), flow.sbp.broadcast
+        )
+        return loaded
+
+    return flow.from_numpy(_get_container_array(key))
+
+
 def _broadcast_py_object(obj, src: int = 0):
     rank = flow.env.get_rank()
     if src == rank:
@@ -175,8 +203,13 @@ def tensor_getstate(self):
                 placement=flow.placement("cpu", [global_src_dsk_rank]),
             ).to_local()
         if global_src_dsk_rank is None or global_src_dsk_rank == flow.env.get_rank():
-            _save_tensor_to_disk(tensor, abs_dir_name)
+            if container_tensors is not None:
+                container_tensors[rel_dir_name] = np.ascontiguousarray(tensor.numpy())
+            else:
+                _save_tensor_to_disk(tensor, abs_dir_name)
 
+        if container_tensors is not None:
+            return {"container_key": rel_dir_name}
         return {"path": rel_dir_name}
     else:
         # save_load_path is None means setstate/getstate is called inside
@@ -199,6 +232,12 @@ def tensor_getstate(self):
 def tensor_setstate(self, pickle_dict):
     if save_load_path is not None:
         assert isinstance(save_load_path, Path)
+        if "container_key" in pickle_dict:
+            return self.__init__(
+                _LoadTensorFromContainer(
+                    pickle_dict["container_key"], global_src_dsk_rank
+                )
+            )
         rel_dir_name = pickle_dict["path"]
         abs_dir_name = save_load_path / rel_dir_name
         self.__init__(_LoadSingleVariable(str(abs_dir_name), global_src_dsk_rank))
@@ -267,16 +306,24 @@ def legacy_load(
 
 
 @contextmanager
-def tensor_pickling_context(path: Path, global_src_dst_rank: Optional[int]):
+def tensor_pickling_context(
+    path: Path, global_src_dst_rank: Optional[int], use_container: bool = False
+):
     global save_load_path
     global global_src_dsk_rank
+    global container_tensors
+    global loaded_container_arrays
     global_src_dsk_rank = global_src_dst_rank
     save_load_path = path
+    # tensors to be saved into the container, keyed by their names in it
+    container_tensors = {} if use_container else None
     try:
-        yield
+        yield container_tensors
     finally:
         global_src_dsk_rank = None
         save_load_path = None
+        container_tensors = None
+        loaded_container_arrays = None
 
 
 def load(path: str, global_src_rank: Optional[int] = None,) -> Any:
@@ -322,8 +369,22 @@ def load(path: str, global_src_rank: Optional[int] = None,) -> Any:
     return res["data"]
 
 
+def _save_tensors_to_container(
+    path: Path, tensors: Dict[str, np.ndarray], num_shards: int
+) -> None:
+    oneflow._oneflow_internal.SaveCheckpointContainer(
+        str(path / CONTAINER_FILENAME),
+        list(tensors.keys()),
+        list(tensors.values()),
+        num_shards,
+    )
+
+
 def save(
-    obj: Any, path: Union[str, Path], global_dst_rank: Optional[int] = None,
+    obj: Any,
+    path: Union[str, Path],
+    global_dst_rank: Optional[int] = None,
+    num_shards: Optional[int] = None,
 ) -> None:
     r"""Save an object to a directory.
 
@@ -335,8 +396,15 @@ def save(
             will be saved by the process whose rank == 
             global_src_rank, while other processes will not do any
             disk I/O.
+        num_shards (int, optional): When specified, all the tensors
+            are written in parallel into a single container file
+            (or `num_shards` files) instead of one directory per
+            tensor, and oneflow.load maps the container into memory
+            rather than reading every tensor through numpy.
     """
     path: Path = Path(path)
+    if num_shards is not None:
+        assert num_shards > 0, f"num_shards must be positive, but got {num_shards}."
 
     if isinstance(obj, graph_util.Graph):
         graph: graph_util.Graph = obj
@@ -348,19 +416,31 @@ def save(
         serialized_job = str(text_format.MessageToString(graph._forward_job_proto))
         oneflow._oneflow_internal.nn.graph.SaveJobToIR(serialized_job, str(path))
 
+        if num_shards is not None:
+            tensors = {
+                f"{x.name_prefix}{x.name}": np.ascontiguousarray(x.origin.numpy())
+                for x in graph._state()
+            }
+            _save_tensors_to_container(path, tensors, num_shards)
+            return
+
         for x in graph._state():
             _save_tensor_to_disk(x.origin, path / f"{x.name_prefix}{x.name}")
 
         return
 
     obj = {"protocol_version": PROTOCOL_VERSION, "data": obj}
-    with tensor_pickling_context(path, global_dst_rank):
+    with tensor_pickling_context(
+        path, global_dst_rank, num_shards is not None
+    ) as tensors:
         pickled_bytes = pickle.dumps(obj)
 
     def write_to_path(path):
         path.mkdir(exist_ok=True)
         pickle_path = path / PICKLE_FILENAME
         pickle_path.write_bytes(pickled_bytes)
+        if tensors is not None:
+            _save_tensors_to_container(path, tensors, num_shards)
 
     if global_dst_rank is not None:
         assert isinstance(
@@ -378,3 +458,5 @@ def save(
 
 save_load_path = None
 global_src_dsk_rank = None
+container_tensors = None
+loaded_container_arrays = None
@@ -55,11 +55,18 @@ class OFRecordReader(Module):
         placement: flow.placement = None,
         sbp: Union[flow.sbp.sbp, List[flow.sbp.sbp]] = None,
         name: Optional[str] = None,
+        num_reader_threads: int = 1,
+        prefetch_buffer_size: int = 4,
+        indexed: bool = False,
+        start_sample_offset: int = 0,
     ):
         super().__init__()
 
         if name is not None:
             print("WARNING: name has been deprecated and has NO effect.\n")
+        assert num_reader_threads >= 1
+        assert prefetch_buffer_size >= 1
+        assert start_sample_offset >= 0
         self.ofrecord_dir = ofrecord_dir
         self.batch_size = batch_size
         self.data_part_num = data_part_num
@@ -68,6 +75,10 @@ class OFRecordReader(Module):
         self.random_shuffle = random_shuffle
         self.shuffle_buffer_size = shuffle_buffer_size
         self.shuffle_after_epoch = shuffle_after_epoch
+        self.num_reader_threads = num_reader_threads
+        self.prefetch_buffer_size = prefetch_buffer_size
+        self.indexed = indexed
+        self.start_sample_offset = start_sample_offset
 
         self.placement = placement
         if placement is None:
@@ -104,6 +115,10 @@ class OFRecordReader(Module):
                 random_shuffle=self.random_shuffle,
                 shuffle_after_epoch=self.shuffle_after_epoch,
                 seed=self.seed,
+                num_reader_threads=self.num_reader_threads,
+                prefetch_buffer_size=self.prefetch_buffer_size,
+                indexed=self.indexed,
+                start_sample_offset=self.start_sample_offset,
                 sbp=self.sbp,
                 placement=self.placement,
             )
@@ -119,6 +134,10 @@ class OFRecordReader(Module):
                 random_shuffle=self.random_shuffle,
                 shuffle_after_epoch=self.shuffle_after_epoch,
                 seed=self.seed,
+                num_reader_threads=self.num_reader_threads,
+                prefetch_buffer_size=self.prefetch_buffer_size,
+                indexed=self.indexed,
+                start_sample_offset=self.start_sample_offset,
                 device=self.device,
             )
         return res
@@ -42,10 +42,18 @@ def _check_initializer(initializer):
         raise NotImplementedError("unsupported initializer_type")
 
 
-def _check_cache(cache):
+def _check_cache(cache, device):
     assert isinstance(cache, dict)
     assert cache.__contains__("policy")
-    assert cache["policy"] in ["lru", "full"]
+    policy = cache["policy"]
+    # cuda stores run behind device caches, cpu stores behind host caches
+    if device == "cuda":
+        supported_policies = ["lru", "full"]
+    else:
+        supported_policies = ["lru", "lfu", "tinylfu"]
+    assert (
+        policy in supported_policies
+    ), f"caches of {device} stores support {supported_policies}, not {policy}"
     cache_memory_budget_mb = 0
     if cache.__contains__("cache_memory_budget_mb"):
         cache_memory_budget_mb = cache["cache_memory_budget_mb"]
@@ -55,6 +63,13 @@ def _check_cache(cache):
     assert cache_memory_budget_mb > 0 or capacity > 0
     assert cache.__contains__("value_memory_kind")
     assert cache["value_memory_kind"] in ["device", "host"]
+    if device == "cpu":
+        assert (
+            cache["value_memory_kind"] == "host"
+        ), "the caches of cpu stores keep their values in host memory"
+    if cache.__contains__("admission_min_frequency"):
+        assert policy == "tinylfu", "admission_min_frequency needs the tinylfu policy"
+        assert cache["admission_min_frequency"] > 0
 
 
 def _init(
@@ -89,21 +104,26 @@ def _init(
     key_value_store_options["value_type_size"] = value_type_size
     scale_factor = store_options["size_factor"]
     key_value_store_options["storage_dim"] = scale_factor * embedding_dim
+    # device of the store
+    device = store_options.get("device", "cuda" if flow.cuda.is_available() else "cpu")
+    assert device in ["cuda", "cpu"]
+    key_value_store_options["device"] = device
     # kv store
     assert store_options.__contains__("kv_store")
     kv_store = store_options["kv_store"]
     assert isinstance(kv_store, dict)
+    caches = []
     if kv_store.__contains__("caches"):
         caches = kv_store["caches"]
         assert isinstance(caches, (dict, list, tuple))
         if isinstance(caches, dict):
-            _check_cache(caches)
+            _check_cache(caches, device)
             caches = [caches]
         else:
             assert len(caches) <= 2
             for i in range(len(caches)):
                 assert isinstance(caches[i], dict)
-                _check_cache(caches[i])
+                _check_cache(caches[i], device)
         for i in range(len(caches)):
             if caches[i].__contains__("capacity"):
                 caches[i]["capacity"] = caches[i]["capacity"] // parallel_num
@@ -124,6 +144,18 @@ def _init(
         persistent_table["capacity_hint"] = (
             persistent_table["capacity_hint"] // parallel_num
         )
+    if persistent_table.__contains__("compaction_dead_ratio_threshold"):
+        assert 0 < persistent_table["compaction_dead_ratio_threshold"] <= 1
+    if persistent_table.__contains__("compaction_io_rate_limit_mb"):
+        assert persistent_table["compaction_io_rate_limit_mb"] >= 0
+    if persistent_table.__contains__("value_codecs"):
+        value_codecs = persistent_table["value_codecs"]
+        assert isinstance(value_codecs, (list, tuple))
+        assert len(value_codecs) > 0
+        for value_codec in value_codecs:
+            assert value_codec in ["fp32", "fp16", "bf16", "int8"]
+        # one codec per segment, e.g. the embedding and each optimizer state
+        assert key_value_store_options["storage_dim"] % len(value_codecs) == 0
     key_value_store_options["kv_store"] = kv_store
     # initializer
     if tables is not None:
@@ -184,6 +216,7 @@ class Embedding(Module):
             store_options,
             default_initializer,
         )
+        self.store_device = key_value_store_options["device"]
         self.key_value_store_options = json.dumps(key_value_store_options)
         self.embedding_tables = json.dumps(embedding_tables)
         self.num_tables = len(embedding_tables["tables"])
@@ -197,7 +230,9 @@ class Embedding(Module):
 
     def _save_to_state_dict(self, destination, prefix, keep_vars):
         snapshot_timestamp_tensor = flow.tensor(
-            datetime.datetime.now().timestamp(), dtype=flow.float64, device="cuda"
+            datetime.datetime.now().timestamp(),
+            dtype=flow.float64,
+            device=self.store_device,
         )
         # Broadcast timestamp tensor from master rank.
         flow.comm.broadcast(snapshot_timestamp_tensor, src=0)
@@ -233,11 +268,12 @@ class Embedding(Module):
                     )
                 )
 
-    def save_snapshot(self, snapshot_name):
+    def save_snapshot(self, snapshot_name, base_snapshot_name=None):
         """save snapshot
 
         Args:
             snapshot_name (str): the snapshot_name, snapshot will be saved in the snapshots dir under your_configed_persistent_path
+            base_snapshot_name (str, optional): if set, only save the rows changed since this snapshot, which must be the last snapshot saved or loaded. The base snapshot must be kept as long as snapshots based on it are used.
     
         For example:
 
@@ -248,8 +284,13 @@ class Embedding(Module):
             >>> embedding.save_snapshot("my_snapshot1")
             >>> # a snapshot named "my_snapshot1" have been saved in the "snapshots" dir under your_configed_persistent_path
             >>> # which can be reload by flow.one_embedding.load_snapshot
+            >>> embedding.save_snapshot("my_snapshot2", base_snapshot_name="my_snapshot1")
+            >>> # "my_snapshot2" only holds the rows updated since "my_snapshot1"
         """
-        self.handler.SaveSnapshot(snapshot_name)
+        if base_snapshot_name is None:
+            self.handler.SaveSnapshot(snapshot_name)
+        else:
+            self.handler.SaveDeltaSnapshot(snapshot_name, base_snapshot_name)
 
     def load_snapshot(self, snapshot_name):
         """load snapshot
@@ -268,6 +309,46 @@ class Embedding(Module):
         """
         self.handler.LoadSnapshot(snapshot_name)
 
+    def merge_snapshot(self, snapshot_name, merged_snapshot_name=None):
+        """merge a snapshot saved with base_snapshot_name and the snapshots it is based on into one full snapshot
+
+        Args:
+            snapshot_name (str): the snapshot_name of the snapshot to merge
+            merged_snapshot_name (str, optional): the name of the merged snapshot, defaults to snapshot_name, which replaces it in place. The base snapshots can be removed once no other snapshot refers to them.
+
+        For example:
+
+        .. code-block:: python
+
+            >>> import oneflow as flow
+            >>> # use embedding create by flow.one_embedding.MultiTableEmbedding
+            >>> embedding.merge_snapshot("my_snapshot2")
+            >>> # "my_snapshot2" now holds every row and no longer needs "my_snapshot1"
+        """
+        if merged_snapshot_name is None:
+            merged_snapshot_name = snapshot_name
+        self.handler.MergeSnapshot(snapshot_name, merged_snapshot_name)
+
+    def prefetch(self, ids):
+        """Starts reading the rows of ids from the persistent storage in the background and returns immediately, so that a following lookup of them, e.g. of the next batch, does not wait for the disk
+
+        Args:
+            ids (flow.tensor or numpy.ndarray): the feature ids of the local rank
+
+        For example:
+
+        .. code-block:: python
+
+            >>> import oneflow as flow
+            >>> # use embedding create by flow.one_embedding.MultiTableEmbedding
+            >>> embedding.prefetch(next_ids)
+            >>> # train on the current batch while the rows of next_ids are read
+        """
+        if isinstance(ids, flow.Tensor):
+            ids = ids.numpy()
+        key_dtype = flow.convert_oneflow_dtype_to_numpy_dtype(self.key_type)
+        self.handler.Prefetch(np.ascontiguousarray(ids, dtype=key_dtype).ravel())
+
     def forward(self, ids, table_ids=None):
         """Embedding lookup operation
 
@@ -446,6 +527,60 @@ def make_cached_host_mem_store_options(
     return options
 
 
+def make_cpu_store_options(
+    persistent_path,
+    capacity=None,
+    size_factor=1,
+    physical_block_size=512,
+    cache_budget_mb=0,
+    cache_policy="lru",
+    admission_min_frequency=None,
+):
+    """make store_options param of MultiTableEmbedding for Embeddings looked up by CPU ids
+
+    Args:
+        persistent_path (str, list): persistent storage path of Embedding. If passed a str, current rank Embedding will be saved in path/rank_id-num_ranks path. If passed a list, the list length must equals num_ranks, each elem of list represent the path of rank_id Embedding.
+        capacity (int, optional): total capacity of Embedding, used as a hint of the persistent storage. Defaults to None.
+        size_factor (int, optional): store size factor of embedding_dim, if SGD update, and momentum = 0, should be 1, if momentum > 0, it should be 2. if Adam, should be 3. Defaults to 1.
+        physical_block_size (int, optional): physical_block_size should be sector size. Defaults to 512.
+        cache_budget_mb (int, optional): the MB budget of the host memory cache in front of the persistent storage, 0 means no cache. Defaults to 0.
+        cache_policy (str, optional): eviction policy of the cache, "lru", "lfu" or "tinylfu". "tinylfu" is an lru cache that only admits the ids seen at least admission_min_frequency times, the others are read and written through to the persistent storage. Defaults to "lru".
+        admission_min_frequency (int, optional): the number of times an id has to be seen before a "tinylfu" cache admits it. Defaults to None, which means 2.
+
+    Returns:
+        dict: CPU store_options param of MultiTableEmbedding
+
+    See also :func:`oneflow.one_embedding.make_cached_host_mem_store_options`
+    """
+    assert isinstance(persistent_path, (str, list, tuple))
+    assert cache_budget_mb >= 0
+    assert cache_policy in ["lru", "lfu", "tinylfu"]
+    persistent_table = {
+        "path": persistent_path,
+        "physical_block_size": physical_block_size,
+    }
+    if capacity is not None:
+        assert capacity > 0
+        persistent_table["capacity_hint"] = int(capacity)
+    kv_store = {"persistent_table": persistent_table}
+    if cache_budget_mb > 0:
+        cache = {
+            "policy": cache_policy,
+            "cache_memory_budget_mb": cache_budget_mb,
+            "value_memory_kind": "host",
+        }
+        if admission_min_frequency is not None:
+            assert cache_policy == "tinylfu"
+            cache["admission_min_frequency"] = admission_min_frequency
+        kv_store["caches"] = [cache]
+    options = {
+        "kv_store": kv_store,
+        "size_factor": size_factor,
+        "device": "cpu",
+    }
+    return options
+
+
 def make_uniform_initializer(low, high):
     """make uniform initializer param of make_table_options
 
@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 """
 
+import os
 import unittest
 from collections import OrderedDict
 
@@ -126,6 +127,51 @@ def _test_layernorm_backward(test_case, device):
     )
 
 
+def _composite_layer_norm(x, weight, bias, eps):
+    # The path CPU layer norm used to take before it had its own kernels.
+    reduce_axis = list(range(x.ndim - weight.ndim, x.ndim))
+    mean = x.mean(dim=reduce_axis, keepdim=True)
+    variance = x.var(dim=reduce_axis, unbiased=False, keepdim=True)
+    return (x - mean) * (variance + eps).rsqrt() * weight + bias
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestLayerNormCpu(flow.unittest.TestCase):
+    def test_layernorm_cpu_matches_composite(test_case):
+        for (num_rows, hidden_size) in [(64, 768), (33, 1000), (2, 32768)]:
+            x = flow.randn(num_rows, hidden_size, requires_grad=True)
+            m = flow.nn.LayerNorm(hidden_size)
+            dy = flow.randn(num_rows, hidden_size)
+
+            def forward_backward(layer_norm):
+                x.grad = None
+                m.zero_grad()
+                y = layer_norm(x)
+                y.backward(dy)
+                return [
+                    y.numpy(),
+                    x.grad.numpy(),
+                    m.weight.grad.numpy(),
+                    m.bias.grad.numpy(),
+                ]
+
+            results = forward_backward(m)
+            composite_results = forward_backward(
+                lambda x: _composite_layer_norm(x, m.weight, m.bias, m.eps)
+            )
+            for (result, composite_result) in zip(results, composite_results):
+                test_case.assertTrue(
+                    np.allclose(result, composite_result, rtol=1e-3, atol=1e-3)
+                )
+
+    def test_layernorm_cpu_empty_batch(test_case):
+        x = flow.randn(0, 16, requires_grad=True)
+        m = flow.nn.LayerNorm(16)
+        m(x).sum().backward()
+        test_case.assertTrue(np.array_equal(m.weight.grad.numpy(), np.zeros(16)))
+        test_case.assertTrue(np.array_equal(m.bias.grad.numpy(), np.zeros(16)))
+
+
 @unittest.skipIf(os.getenv("ONEFLOW_TEST_CPU_ONLY"), "only test cpu cases")
 @flow.unittest.skip_unless_1n1d()
 class TestLayerNorm(flow.unittest.TestCase):
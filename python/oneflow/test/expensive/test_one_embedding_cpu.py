@@ -0,0 +1,188 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+
+import tempfile
+import unittest
+from collections import OrderedDict
+
+import numpy as np
+from oneflow.test_utils.test_util import GenArgDict
+
+import oneflow as flow
+import oneflow.unittest
+
+
+def _test_one_embedding_cpu_lookup_update_lookup(
+    test_case,
+    optimizer,
+    cache_budget_mb,
+    cache_policy,
+    prefetch=False,
+    merge_snapshot=False,
+):
+    batch_size = 64
+    num_tables = 2
+    embedding_size = 16
+    learning_rate = 0.1
+    size_factor = {"sgd": 1, "adam": 3}[optimizer]
+    # the parity of an id is its table, the same id always belongs to the same table
+    ids = np.random.randint(0, 50, (batch_size, num_tables)) * num_tables + np.arange(
+        num_tables
+    )
+    ids_tensor = flow.tensor(ids, dtype=flow.int64)
+    name = f"cpu_embedding_{optimizer}_{cache_budget_mb}_{cache_policy}"
+    name += f"_{prefetch}_{merge_snapshot}"
+    with tempfile.TemporaryDirectory() as persistent_path:
+        embedding = flow.one_embedding.MultiTableEmbedding(
+            name=name,
+            embedding_dim=embedding_size,
+            dtype=flow.float,
+            key_type=flow.int64,
+            tables=[
+                flow.one_embedding.make_table_options(
+                    flow.one_embedding.make_uniform_initializer(low=-0.1, high=0.1)
+                )
+                for _ in range(num_tables)
+            ],
+            store_options=flow.one_embedding.make_cpu_store_options(
+                persistent_path=persistent_path,
+                capacity=1024,
+                size_factor=size_factor,
+                cache_budget_mb=cache_budget_mb,
+                cache_policy=cache_policy,
+            ),
+        )
+        if optimizer == "sgd":
+            opt = flow.optim.SGD(embedding.parameters(), lr=learning_rate)
+        else:
+            opt = flow.optim.Adam(embedding.parameters(), lr=learning_rate)
+
+        class TrainGraph(flow.nn.Graph):
+            def __init__(self):
+                super().__init__()
+                self.embedding = embedding
+                self.add_optimizer(opt)
+
+            def build(self, ids):
+                embeddings = self.embedding(ids)
+                embeddings.sum().backward()
+                return embeddings
+
+        class EvalGraph(flow.nn.Graph):
+            def __init__(self):
+                super().__init__()
+                self.embedding = embedding
+
+            def build(self, ids):
+                return self.embedding(ids)
+
+        if merge_snapshot:
+            embedding.save_snapshot("base")
+        before = TrainGraph()(ids_tensor).numpy()
+        if merge_snapshot:
+            # the lookup reads the update back from the delta merged with its base
+            embedding.save_snapshot("delta", base_snapshot_name="base")
+            embedding.merge_snapshot("delta")
+            embedding.load_snapshot("delta")
+        if prefetch:
+            # the lookup is served from the prefetched rows, which hold the update
+            embedding.prefetch(ids_tensor)
+        after = EvalGraph()(ids_tensor).numpy()
+
+    # every occurrence of an id adds one to its gradient
+    unique_ids, counts = np.unique(ids, return_counts=True)
+    grad = counts[np.searchsorted(unique_ids, ids)][..., np.newaxis]
+    if optimizer == "sgd":
+        expected = before - learning_rate * grad
+    else:
+        # the first adam step with bias correction moves by lr * g / (|g| + eps)
+        expected = before - learning_rate * np.ones_like(before)
+    test_case.assertTrue(np.allclose(after, expected, atol=1e-5, rtol=1e-5))
+    # rows of the same id agree
+    flat_ids = ids.flatten()
+    flat_after = after.reshape(-1, embedding_size)
+    for i in range(len(flat_ids)):
+        first = np.argmax(flat_ids == flat_ids[i])
+        test_case.assertTrue(np.array_equal(flat_after[i], flat_after[first]))
+
+
+@flow.unittest.skip_unless_1n1d()
+class OneEmbeddingCpuTestCase(flow.unittest.TestCase):
+    def test_one_embedding_cpu_lookup_update_lookup(test_case):
+        arg_dict = OrderedDict()
+        arg_dict["optimizer"] = ["sgd", "adam"]
+        arg_dict["cache_budget_mb"] = [0, 8]
+        arg_dict["cache_policy"] = ["lru"]
+        for kwargs in GenArgDict(arg_dict):
+            _test_one_embedding_cpu_lookup_update_lookup(test_case, **kwargs)
+
+    def test_one_embedding_cpu_tinylfu(test_case):
+        # ids seen once are turned away by the cache and written through to the store
+        for optimizer in ["sgd", "adam"]:
+            _test_one_embedding_cpu_lookup_update_lookup(
+                test_case, optimizer, cache_budget_mb=8, cache_policy="tinylfu"
+            )
+
+    def test_one_embedding_cpu_prefetch(test_case):
+        for cache_budget_mb in [0, 8]:
+            _test_one_embedding_cpu_lookup_update_lookup(
+                test_case, "sgd", cache_budget_mb, "lru", prefetch=True
+            )
+
+    def test_one_embedding_cpu_merge_snapshot(test_case):
+        for cache_budget_mb in [0, 8]:
+            _test_one_embedding_cpu_lookup_update_lookup(
+                test_case, "sgd", cache_budget_mb, "lru", merge_snapshot=True
+            )
+
+    def test_one_embedding_unsupported_caches(test_case):
+        def make_embedding(persistent_path, device, policy, value_memory_kind):
+            store_options = flow.one_embedding.make_cpu_store_options(persistent_path)
+            store_options["device"] = device
+            store_options["kv_store"]["caches"] = [
+                {
+                    "policy": policy,
+                    "cache_memory_budget_mb": 8,
+                    "value_memory_kind": value_memory_kind,
+                }
+            ]
+            return flow.one_embedding.MultiTableEmbedding(
+                name=f"unsupported_{device}_{policy}_{value_memory_kind}",
+                embedding_dim=16,
+                dtype=flow.float,
+                key_type=flow.int64,
+                tables=[
+                    flow.one_embedding.make_table_options(
+                        flow.one_embedding.make_uniform_initializer(low=-0.1, high=0.1)
+                    )
+                ],
+                store_options=store_options,
+            )
+
+        # rejected before any store is created
+        with tempfile.TemporaryDirectory() as persistent_path:
+            for device, policy, value_memory_kind in [
+                ("cuda", "lfu", "device"),
+                ("cuda", "tinylfu", "device"),
+                ("cpu", "full", "host"),
+                ("cpu", "lru", "device"),
+            ]:
+                with test_case.assertRaises(AssertionError):
+                    make_embedding(persistent_path, device, policy, value_memory_kind)
+
+
+if __name__ == "__main__":
+    unittest.main()
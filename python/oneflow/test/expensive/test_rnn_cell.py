@@ -111,6 +111,43 @@ class TestRNN(flow.unittest.TestCase):
             hx = m(input[i], hx)
         return hx
 
+    @autotest(n=3, check_graph=True)
+    def test_lstm_cell_with_large_hidden_size_on_cpu(test_case):
+        batch_size = random(1, 6)
+        time_steps = random(1, 4)
+        input_size = random(8, 24)
+        hidden_size = random(16, 48)
+        m = torch.nn.LSTMCell(
+            input_size=input_size, hidden_size=hidden_size, bias=random().to(bool),
+        ).to("cpu")
+        input = random_tensor(
+            ndim=3, dim0=time_steps, dim1=batch_size, dim2=input_size
+        ).to("cpu")
+        hx = random_tensor(ndim=2, dim0=batch_size, dim1=hidden_size).to("cpu")
+        cx = random_tensor(ndim=2, dim0=batch_size, dim1=hidden_size).to("cpu")
+        for i in range(time_steps.to(int).value()):
+            res = m(input[i], (hx, cx))
+            hx = res[0]
+            cx = res[1]
+        return res[0] + res[1]
+
+    @autotest(n=3, check_graph=True)
+    def test_gru_cell_with_large_hidden_size_on_cpu(test_case):
+        batch_size = random(1, 6)
+        time_steps = random(1, 4)
+        input_size = random(8, 24)
+        hidden_size = random(16, 48)
+        m = torch.nn.GRUCell(
+            input_size=input_size, hidden_size=hidden_size, bias=random().to(bool)
+        ).to("cpu")
+        input = random_tensor(
+            ndim=3, dim0=time_steps, dim1=batch_size, dim2=input_size
+        ).to("cpu")
+        hx = random_tensor(ndim=2, dim0=batch_size, dim1=hidden_size).to("cpu")
+        for i in range(time_steps.to(int).value()):
+            hx = m(input[i], hx)
+        return hx
+
 
 if __name__ == "__main__":
     unittest.main()
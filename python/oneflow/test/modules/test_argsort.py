@@ -18,7 +18,11 @@ import unittest
 from collections import OrderedDict
 
 import numpy as np
-from oneflow.test_utils.test_util import GenArgList, type_name_to_flow_type
+from oneflow.test_utils.test_util import (
+    GenArgList,
+    type_name_to_flow_type,
+    type_name_to_np_type,
+)
 
 import oneflow as flow
 import oneflow.unittest
@@ -64,6 +68,23 @@ class TestArgsort(flow.unittest.TestCase):
         for arg in GenArgList(arg_dict):
             arg[0](test_case, *arg[1:])
 
+    def test_argsort_long_rows_on_cpu(test_case):
+        # long rows are radix sorted, and a single long row is sorted by all threads
+        arg_dict = OrderedDict()
+        arg_dict["data_shape"] = [(5, 1000), (2, 70000)]
+        arg_dict["descending"] = [True, False]
+        arg_dict["data_type"] = ["double", "float32", "int32", "int8"]
+        for (data_shape, descending, data_type) in GenArgList(arg_dict):
+            np_input = (np.random.randn(*data_shape) * 10).astype(
+                type_name_to_np_type[data_type]
+            )
+            of_out = flow.argsort(
+                flow.tensor(np_input, device="cpu"), dim=-1, descending=descending
+            )
+            # equal values are ordered by index as in a stable sort
+            np_out = np.argsort(-np_input if descending else np_input, kind="stable")
+            test_case.assertTrue(np.array_equal(of_out.numpy(), np_out))
+
     @autotest(auto_backward=False, check_graph=True)
     def test_argsort_with_random_data(test_case):
         device = random_device()
@@ -1851,6 +1851,26 @@ class TestConv2d(flow.unittest.TestCase):
         y = m(x)
         return y
 
+    @autotest(n=5)
+    def test_conv2d_3x3_with_random_data(test_case):
+        # 3x3 convs of stride 1 with enough channels run with winograd on cpu
+        channels = random(16, 33)
+        m = torch.nn.Conv2d(
+            in_channels=channels,
+            out_channels=random(16, 33),
+            kernel_size=3,
+            padding=random(0, 2).to(int),
+            bias=random_bool(),
+        )
+        m.train(random())
+        device = random_device()
+        m.to(device)
+        x = random_tensor(
+            ndim=4, dim1=channels, dim2=random(3, 20), dim3=random(3, 20)
+        ).to(device)
+        y = m(x)
+        return y
+
     @autotest(check_graph=False)
     def test_conv2d_0size_with_random_data(test_case):
         channels = random(1, 6)
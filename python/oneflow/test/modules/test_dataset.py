@@ -16,6 +16,8 @@ limitations under the License.
 
 import math
 import os
+import struct
+import tempfile
 import unittest
 
 import cv2
@@ -23,6 +25,7 @@ import numpy as np
 
 import oneflow as flow
 import oneflow.unittest
+import oneflow.core.record.record_pb2 as record_pb2
 
 
 @flow.unittest.skip_unless_1n1d()
@@ -86,6 +89,138 @@ class TestOFRecordModule(flow.unittest.TestCase):
         test_case.assertTrue(np.array_equal(image_np, gt_np))
 
 
+def _write_ofrecord_parts(data_dir, num_parts, records_per_part):
+    for part in range(num_parts):
+        with open(os.path.join(data_dir, "part-{}".format(part)), "wb") as f:
+            for i in range(records_per_part):
+                record = record_pb2.OFRecord()
+                record.feature["id"].int32_list.value.append(
+                    part * records_per_part + i
+                )
+                data = record.SerializeToString()
+                f.write(struct.pack("q", len(data)))
+                f.write(data)
+
+
+def _read_ofrecord_ids(
+    data_dir,
+    num_parts,
+    batch_size,
+    num_batches,
+    shuffle_after_epoch,
+    num_reader_threads,
+):
+    record_reader = flow.nn.OFRecordReader(
+        data_dir,
+        batch_size=batch_size,
+        data_part_num=num_parts,
+        shuffle_after_epoch=shuffle_after_epoch,
+        num_reader_threads=num_reader_threads,
+        prefetch_buffer_size=2,
+    )
+    id_decoder = flow.nn.OFRecordRawDecoder("id", shape=(), dtype=flow.int32)
+    return [id_decoder(record_reader()).numpy() for _ in range(num_batches)]
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestParallelOFRecordReader(flow.unittest.TestCase):
+    def test_parallel_reader_reads_every_record_once_per_epoch(test_case):
+        num_parts, records_per_part, batch_size = 5, 24, 8
+        num_records = num_parts * records_per_part
+        num_batches = 2 * num_records // batch_size
+        with tempfile.TemporaryDirectory() as data_dir:
+            _write_ofrecord_parts(data_dir, num_parts, records_per_part)
+            for shuffle_after_epoch in [False, True]:
+                for num_reader_threads in [1, 3]:
+                    ids = np.concatenate(
+                        _read_ofrecord_ids(
+                            data_dir,
+                            num_parts,
+                            batch_size,
+                            num_batches,
+                            shuffle_after_epoch,
+                            num_reader_threads,
+                        )
+                    )
+                    for epoch in range(2):
+                        epoch_ids = ids[epoch * num_records : (epoch + 1) * num_records]
+                        test_case.assertTrue(
+                            np.array_equal(np.sort(epoch_ids), np.arange(num_records))
+                        )
+
+
+def _write_ofrecord_index(part_file_path):
+    data_size = os.path.getsize(part_file_path)
+    offsets = []
+    with open(part_file_path, "rb") as f:
+        while f.tell() < data_size:
+            offsets.append(f.tell())
+            (record_size,) = struct.unpack("q", f.read(8))
+            f.seek(record_size, os.SEEK_CUR)
+    with open(part_file_path + ".idx", "wb") as f:
+        f.write(b"OFRIDX\x00\x00")
+        f.write(struct.pack("QQQ", 1, data_size, len(offsets)))
+        f.write(struct.pack("{}q".format(len(offsets)), *offsets))
+
+
+def _read_indexed_ofrecord_ids(data_dir, num_parts, batch_size, num_batches, **kwargs):
+    record_reader = flow.nn.OFRecordReader(
+        data_dir,
+        batch_size=batch_size,
+        data_part_num=num_parts,
+        indexed=True,
+        **kwargs,
+    )
+    id_decoder = flow.nn.OFRecordRawDecoder("id", shape=(), dtype=flow.int32)
+    return np.concatenate(
+        [id_decoder(record_reader()).numpy() for _ in range(num_batches)]
+    )
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestIndexedOFRecordReader(flow.unittest.TestCase):
+    def test_indexed_reader(test_case):
+        num_parts, records_per_part, batch_size = 3, 20, 6
+        num_records = num_parts * records_per_part
+        with tempfile.TemporaryDirectory() as data_dir:
+            _write_ofrecord_parts(data_dir, num_parts, records_per_part)
+            # the other parts are indexed by the reader
+            _write_ofrecord_index(os.path.join(data_dir, "part-0"))
+            ids = _read_indexed_ofrecord_ids(data_dir, num_parts, batch_size, 20)
+            test_case.assertTrue(
+                np.array_equal(ids, np.arange(2 * num_records) % num_records)
+            )
+            ids = _read_indexed_ofrecord_ids(
+                data_dir, num_parts, batch_size, 20, random_shuffle=True, random_seed=7
+            )
+            for epoch in range(2):
+                epoch_ids = ids[epoch * num_records : (epoch + 1) * num_records]
+                test_case.assertTrue(
+                    np.array_equal(np.sort(epoch_ids), np.arange(num_records))
+                )
+            test_case.assertFalse(np.array_equal(ids[:num_records], ids[num_records:]))
+            resumed_ids = _read_indexed_ofrecord_ids(
+                data_dir,
+                num_parts,
+                batch_size,
+                13,
+                random_shuffle=True,
+                random_seed=7,
+                start_sample_offset=7 * batch_size,
+            )
+            test_case.assertTrue(np.array_equal(resumed_ids, ids[7 * batch_size :]))
+
+    def test_indexed_reader_empty_part(test_case):
+        num_parts, records_per_part, batch_size = 2, 10, 4
+        with tempfile.TemporaryDirectory() as data_dir:
+            _write_ofrecord_parts(data_dir, num_parts, records_per_part)
+            # an empty part file holds no records
+            open(os.path.join(data_dir, "part-{}".format(num_parts)), "wb").close()
+            ids = _read_indexed_ofrecord_ids(data_dir, num_parts + 1, batch_size, 5)
+            num_records = num_parts * records_per_part
+            test_case.assertTrue(np.array_equal(ids, np.arange(20) % num_records))
+
+
 @flow.unittest.skip_unless_1n1d()
 class TestConsistentOFRecordModule(flow.unittest.TestCase):
     def test_global_record(test_case):
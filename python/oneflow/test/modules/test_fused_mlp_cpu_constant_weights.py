@@ -0,0 +1,53 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import os
+
+# Read when the kernel of the op is created, so it is set before the first fused_mlp.
+os.environ["ONEFLOW_KERNEL_CPU_FUSED_MLP_CONSTANT_WEIGHTS"] = "1"
+
+import unittest
+import numpy as np
+
+import oneflow as flow
+import oneflow.unittest
+
+
+def _mlp(x, weights, biases):
+    out = x
+    for (weight, bias) in zip(weights, biases):
+        out = flow._C.relu(flow._C.matmul(out, weight, transpose_b=True) + bias)
+    return out
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestFusedMLPCpuConstantWeights(flow.unittest.TestCase):
+    def test_weight_updated_in_place_is_repacked(test_case):
+        x = flow.randn(8, 64)
+        weights = [flow.randn(96, 64), flow.randn(32, 96)]
+        biases = [flow.randn(96), flow.randn(32)]
+        for _ in range(3):
+            out = flow._C.fused_mlp(x, weights, biases, skip_final_activation=False)
+            test_case.assertTrue(
+                np.allclose(
+                    out.numpy(), _mlp(x, weights, biases).numpy(), rtol=1e-4, atol=1e-4
+                )
+            )
+            # An optimizer step writes to the same memory.
+            weights[1].mul_(0.5).add_(0.1)
+
+
+if __name__ == "__main__":
+    unittest.main()
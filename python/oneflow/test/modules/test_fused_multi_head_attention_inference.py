@@ -0,0 +1,92 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import math
+import unittest
+from collections import OrderedDict
+
+import numpy as np
+from oneflow.test_utils.test_util import GenArgList
+
+import oneflow as flow
+import oneflow.unittest
+
+
+def _ref_attention(query, key, value, num_heads, causal, scale):
+    batch_size, query_seq_len, _ = query.shape
+    kv_seq_len = key.shape[1]
+    q = query.reshape(batch_size, query_seq_len, num_heads, -1).transpose(0, 2, 1, 3)
+    k = key.reshape(batch_size, kv_seq_len, num_heads, -1).transpose(0, 2, 1, 3)
+    v = value.reshape(batch_size, kv_seq_len, num_heads, -1).transpose(0, 2, 1, 3)
+    scores = np.matmul(q, k.transpose(0, 1, 3, 2)) * scale
+    if causal:
+        # aligned to the bottom right, the last query attends to all keys
+        mask = np.triu(
+            np.ones((query_seq_len, kv_seq_len), dtype=bool),
+            k=1 + kv_seq_len - query_seq_len,
+        )
+        scores = np.where(mask, -np.inf, scores)
+    scores = scores - scores.max(axis=-1, keepdims=True)
+    probs = np.exp(scores)
+    probs = probs / probs.sum(axis=-1, keepdims=True)
+    out = np.matmul(probs, v).transpose(0, 2, 1, 3)
+    return out.reshape(batch_size, query_seq_len, -1)
+
+
+def _test_fused_multi_head_attention_inference(
+    test_case,
+    batch_size,
+    num_heads,
+    query_seq_len,
+    kv_seq_len,
+    head_size,
+    value_head_size,
+    causal,
+    device_type,
+):
+    query = np.random.randn(batch_size, query_seq_len, num_heads * head_size)
+    key = np.random.randn(batch_size, kv_seq_len, num_heads * head_size)
+    value = np.random.randn(batch_size, kv_seq_len, num_heads * value_head_size)
+    out = flow._C.fused_multi_head_attention_inference(
+        flow.tensor(query, dtype=flow.float32, device=device_type),
+        flow.tensor(key, dtype=flow.float32, device=device_type),
+        flow.tensor(value, dtype=flow.float32, device=device_type),
+        num_heads,
+        causal=causal,
+    )
+    scale = 1.0 / math.sqrt(head_size)
+    ref = _ref_attention(query, key, value, num_heads, causal, scale)
+    test_case.assertTrue(np.allclose(out.numpy(), ref, atol=1e-4, rtol=1e-4))
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestFusedMultiHeadAttentionInference(flow.unittest.TestCase):
+    def test_fused_multi_head_attention_inference(test_case):
+        arg_dict = OrderedDict()
+        arg_dict["test_fun"] = [_test_fused_multi_head_attention_inference]
+        arg_dict["batch_size"] = [1, 3]
+        arg_dict["num_heads"] = [1, 4]
+        arg_dict["query_seq_len"] = [7, 100]
+        arg_dict["kv_seq_len"] = [100, 300]
+        arg_dict["head_size"] = [16, 40]
+        arg_dict["value_head_size"] = [16]
+        arg_dict["causal"] = [False, True]
+        arg_dict["device_type"] = ["cpu"]
+        for arg in GenArgList(arg_dict):
+            arg[0](test_case, *arg[1:])
+
+
+if __name__ == "__main__":
+    unittest.main()
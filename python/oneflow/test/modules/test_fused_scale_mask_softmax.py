@@ -26,7 +26,14 @@ import oneflow.unittest
 
 
 def _test_fused_scale_mask_softmax(
-    test_case, batch_size, num_heads, seq_length, fill_value, scale_value, broadcast_dim
+    test_case,
+    batch_size,
+    num_heads,
+    seq_length,
+    fill_value,
+    scale_value,
+    broadcast_dim,
+    device_type="cuda",
 ):
     x = np.random.randn(batch_size, num_heads, seq_length, seq_length).astype(
         np.float32
@@ -36,16 +43,16 @@ def _test_fused_scale_mask_softmax(
         mask_size[broadcast_dim] = 1
 
     mask = np.random.randint(0, 2, size=mask_size, dtype=np.bool)
-    fused_x_tensor = flow.tensor(x, dtype=flow.float32).to("cuda")
-    fused_mask_tensor = flow.tensor(mask, dtype=flow.bool).to("cuda")
+    fused_x_tensor = flow.tensor(x, dtype=flow.float32).to(device_type)
+    fused_mask_tensor = flow.tensor(mask, dtype=flow.bool).to(device_type)
     fused_x_tensor.requires_grad = True
 
     fused_out = flow._C.fused_scale_mask_softmax(
         fused_x_tensor, fused_mask_tensor, fill_value=fill_value, scale=scale_value,
     )
 
-    origin_x_tensor = flow.tensor(x).to("cuda")
-    origin_mask_tensor = flow.tensor(mask, dtype=flow.float32).to("cuda")
+    origin_x_tensor = flow.tensor(x).to(device_type)
+    origin_mask_tensor = flow.tensor(mask, dtype=flow.float32).to(device_type)
     origin_x_tensor.requires_grad = True
     origin_out = flow.mul(
         origin_x_tensor, origin_mask_tensor
@@ -85,5 +92,22 @@ class TestFusedScaleMaskSoftmax(flow.unittest.TestCase):
             arg[0](test_case, *arg[1:])
 
 
+@flow.unittest.skip_unless_1n1d()
+class TestFusedScaleMaskSoftmaxCpu(flow.unittest.TestCase):
+    def test_fused_op(test_case):
+        args_dict = OrderedDict()
+        args_dict["test_fun"] = [_test_fused_scale_mask_softmax]
+        args_dict["batch_size"] = [2, 4]
+        args_dict["num_heads"] = [1, 4]
+        args_dict["seq_length"] = [16, 33]
+        args_dict["fill_value"] = [-10000.0]
+        args_dict["scale_value"] = [1.0, 2.0]
+        args_dict["broadcast_dim"] = [None, 0, 1, 2]
+        args_dict["device_type"] = ["cpu"]
+
+        for arg in GenArgList(args_dict):
+            arg[0](test_case, *arg[1:])
+
+
 if __name__ == "__main__":
     unittest.main()
@@ -24,11 +24,13 @@ import oneflow as flow
 import oneflow.unittest
 
 
-def _test_fused_self_attention(test_case, batch_size, seq_len, num_heads, head_size):
+def _test_fused_self_attention(
+    test_case, batch_size, seq_len, num_heads, head_size, device_type="cuda"
+):
     hidden_size = num_heads * 3 * head_size
 
     x = np.random.randn(seq_len, batch_size, hidden_size)
-    fused_input = flow.Tensor(x).to("cuda")
+    fused_input = flow.Tensor(x).to(device_type)
     fused_input.requires_grad = True
     (fused_qmk, fused_v) = flow._C.fused_self_attention(
         fused_input, head_size=head_size, alpha=1.0,
@@ -36,7 +38,7 @@ def _test_fused_self_attention(test_case, batch_size, seq_len, num_heads, head_s
     fused_atten = flow.matmul(fused_qmk, fused_v)
     fused_atten_sum = fused_atten.sum()
 
-    origin_input = flow.Tensor(x).to("cuda")
+    origin_input = flow.Tensor(x).to(device_type)
     origin_input.requires_grad = True
     reshape_input = flow.reshape(origin_input, (seq_len, batch_size, -1, 3 * head_size))
 
@@ -100,5 +102,19 @@ class TestFusedSelfAttention(flow.unittest.TestCase):
             arg[0](test_case, *arg[1:])
 
 
+@flow.unittest.skip_unless_1n1d()
+class TestFusedSelfAttentionCpu(flow.unittest.TestCase):
+    def test_fused_self_attention(test_case):
+        arg_dict = OrderedDict()
+        arg_dict["test_fun"] = [_test_fused_self_attention]
+        arg_dict["batch_size"] = [1, 4]
+        arg_dict["seq_len"] = [5, 12]
+        arg_dict["num_heads"] = [4, 8]
+        arg_dict["head_size"] = [16, 32]
+        arg_dict["device_type"] = ["cpu"]
+        for arg in GenArgList(arg_dict):
+            arg[0](test_case, *arg[1:])
+
+
 if __name__ == "__main__":
     unittest.main()
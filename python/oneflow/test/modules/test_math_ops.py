@@ -306,6 +306,26 @@ class TestTopk(flow.unittest.TestCase):
         )
         return y[0], y[1]
 
+    def test_flow_topk_long_rows_on_cpu(test_case):
+        # the candidates of a single long row are selected by all threads
+        np_input = np.random.randn(2, 100000).astype(np.float32)
+        for k in [1, 5, 64]:
+            for is_sorted in [True, False]:
+                (values, indices) = flow.topk(
+                    flow.tensor(np_input, device="cpu"), k, dim=-1, sorted=is_sorted
+                )
+                np_values = -np.sort(-np_input, axis=-1)[:, :k]
+                of_values = values.numpy()
+                if not is_sorted:
+                    of_values = -np.sort(-of_values, axis=-1)
+                test_case.assertTrue(np.array_equal(of_values, np_values))
+                test_case.assertTrue(
+                    np.array_equal(
+                        np.take_along_axis(np_input, indices.numpy(), axis=-1),
+                        values.numpy(),
+                    )
+                )
+
 
 @flow.unittest.skip_unless_1n1d()
 class TestPow(flow.unittest.TestCase):
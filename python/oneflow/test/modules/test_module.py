@@ -201,6 +201,37 @@ class TestModule(flow.unittest.TestCase):
         res2 = m()
         test_case.assertTrue(np.array_equal(res1.numpy(), res2.numpy()))
 
+    @flow.unittest.skip_unless_1n1d()
+    def test_save_state_dict_to_container(test_case):
+        class CustomModule(flow.nn.Module):
+            def __init__(self):
+                super().__init__()
+                self.param1 = flow.nn.Parameter(flow.randn(32, 1024))
+                self.param2 = flow.nn.Parameter(flow.randn(3, 5).to(flow.float64))
+                self.register_buffer("step", flow.tensor(7, dtype=flow.int64))
+
+            def forward(self):
+                return self.param1.sum() + self.param2.sum() + self.step
+
+        for num_shards in [1, 3]:
+            m = CustomModule()
+            res1 = m()
+            state = {"model": m.state_dict(), "epoch": 3}
+            with tempfile.TemporaryDirectory() as save_dir:
+                flow.save(state, save_dir, num_shards=num_shards)
+                test_case.assertEqual(
+                    len([f for f in os.listdir(save_dir) if f.startswith("tensors")]),
+                    num_shards,
+                )
+                loaded = flow.load(save_dir)
+                test_case.assertEqual(loaded["epoch"], 3)
+                test_case.assertEqual(loaded["model"]["step"].item(), 7)
+                test_case.assertEqual(loaded["model"]["param2"].dtype, flow.float64)
+                m = CustomModule()
+                m.load_state_dict(loaded["model"])
+            res2 = m()
+            test_case.assertTrue(np.array_equal(res1.numpy(), res2.numpy()))
+
     def _test_save_and_load_global_from_nested_dict(test_case):
         class CustomModule(flow.nn.Module):
             def __init__(self):
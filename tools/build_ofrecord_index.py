@@ -0,0 +1,63 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+# Writes the <part>.idx index sidecar of OFRecord part files, read by
+# flow.nn.OFRecordReader(..., indexed=True). Without a sidecar the reader indexes a part
+# itself when it starts, by walking the length prefixes of all records of the part.
+#
+#   python3 tools/build_ofrecord_index.py /dataset/ofrecord/train/part-*
+
+import argparse
+import os
+import struct
+
+MAGIC_CODE = b"OFRIDX\x00\x00"
+VERSION = 1
+
+
+def build_index(part_file_path):
+    data_size = os.path.getsize(part_file_path)
+    offsets = []
+    with open(part_file_path, "rb") as f:
+        offset = 0
+        while offset < data_size:
+            (record_size,) = struct.unpack("<q", f.read(8))
+            assert record_size > 0, "{}: bad record at {}".format(
+                part_file_path, offset
+            )
+            offsets.append(offset)
+            offset += 8 + record_size
+            f.seek(offset)
+    assert offset == data_size, "{} is truncated".format(part_file_path)
+    with open(part_file_path + ".idx", "wb") as f:
+        f.write(MAGIC_CODE)
+        f.write(struct.pack("<QQQ", VERSION, data_size, len(offsets)))
+        f.write(struct.pack("<{}q".format(len(offsets)), *offsets))
+    return len(offsets)
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("part_files", nargs="+")
+    args = parser.parse_args()
+    for part_file_path in args.part_files:
+        if part_file_path.endswith(".idx"):
+            continue
+        num_records = build_index(part_file_path)
+        print("{}: {} records".format(part_file_path, num_records))
+
+
+if __name__ == "__main__":
+    main()
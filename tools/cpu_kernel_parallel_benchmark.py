@@ -0,0 +1,129 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+# Benchmarks CPU user kernels that run with CpuStream::ParallelFor and reports the speedup of N
+# threads over the sequential path. The thread number must be set before any eager op runs, so
+# every thread number is measured in a subprocess of this script.
+#
+#   python3 tools/cpu_kernel_parallel_benchmark.py --num-threads 8
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import time
+
+import numpy as np
+
+
+def _cases(flow):
+    def tensor(*shape, requires_grad=False):
+        rng = np.random.default_rng(0)
+        return flow.tensor(
+            rng.standard_normal(shape).astype(np.float32), requires_grad=requires_grad
+        )
+
+    x_sort = tensor(4096, 1024)
+    x_gather = tensor(64, 4096, 256)
+    index = flow.tensor(
+        np.random.default_rng(1).integers(0, 4096, size=4096), dtype=flow.int64
+    )
+    x_bn = tensor(32, 64, 56, 56)
+    bn = flow.nn.BatchNorm2d(64)
+    x_pool = tensor(32, 64, 112, 112, requires_grad=True)
+    pool = flow.nn.MaxPool2d(kernel_size=3, stride=2, padding=1)
+    x_softmax = tensor(8192, 1024)
+
+    def max_pool_grad():
+        x_pool.grad = None
+        pool(x_pool).sum().backward()
+        return x_pool.grad
+
+    return {
+        "sort": lambda: flow.sort(x_sort, dim=1)[0],
+        "arg_sort": lambda: flow.argsort(x_sort, dim=1),
+        "top_k": lambda: flow.topk(x_sort, 16, dim=1)[0],
+        "gather": lambda: flow.index_select(x_gather, 1, index),
+        "batch_norm_train": lambda: bn.train()(x_bn),
+        "max_pool2d": lambda: pool(x_pool),
+        "max_pool2d_grad": max_pool_grad,
+        "softmax": lambda: flow.softmax(x_softmax, dim=1),
+    }
+
+
+def _measure(num_threads, warmup, iters):
+    import oneflow as flow
+
+    flow.set_num_threads(num_threads)
+    results = {}
+    for name, fn in _cases(flow).items():
+        for _ in range(warmup):
+            fn().numpy()
+        start = time.perf_counter()
+        for _ in range(iters):
+            out = fn().numpy()
+        elapsed = (time.perf_counter() - start) / iters
+        results[name] = {"ms": elapsed * 1000, "checksum": float(np.abs(out).sum())}
+    return results
+
+
+def _run_subprocess(num_threads, args):
+    cmd = [
+        sys.executable,
+        os.path.abspath(__file__),
+        "--worker",
+        "--num-threads",
+        str(num_threads),
+        "--warmup",
+        str(args.warmup),
+        "--iters",
+        str(args.iters),
+    ]
+    return json.loads(subprocess.check_output(cmd).decode().strip().splitlines()[-1])
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--num-threads", type=int, default=os.cpu_count())
+    parser.add_argument("--warmup", type=int, default=3)
+    parser.add_argument("--iters", type=int, default=10)
+    parser.add_argument("--worker", action="store_true", help=argparse.SUPPRESS)
+    args = parser.parse_args()
+
+    if args.worker:
+        print(json.dumps(_measure(args.num_threads, args.warmup, args.iters)))
+        return
+
+    sequential = _run_subprocess(1, args)
+    parallel = _run_subprocess(args.num_threads, args)
+    print(
+        "{:<20}{:>14}{:>14}{:>10}".format(
+            "kernel", "1 thread ms", f"{args.num_threads} threads ms", "speedup"
+        )
+    )
+    for name, seq in sequential.items():
+        par = parallel[name]
+        if not np.isclose(seq["checksum"], par["checksum"], rtol=1e-4):
+            print(f"{name}: results of 1 and {args.num_threads} threads differ")
+        print(
+            "{:<20}{:>14.3f}{:>14.3f}{:>9.2f}x".format(
+                name, seq["ms"], par["ms"], seq["ms"] / par["ms"]
+            )
+        )
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,127 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+# Benchmarks the CPU sort, arg_sort and top_k kernels over sweeps of the row count and
+# the row length, on one thread and on N threads. Few long rows are sorted by all
+# threads together, many short rows are handed to the threads one by one. The thread
+# number must be set before any eager op runs, so every thread number is measured in a
+# subprocess of this script.
+#
+#   python3 tools/cpu_sort_benchmark.py --num-threads 8 --dtype float32
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import time
+
+import numpy as np
+
+ROW_COUNTS = [1, 4, 64, 1024]
+ROW_LENGTHS = [64, 1024, 16384, 262144, 1048576]
+# rows of a case hold at most this many elements
+MAX_ELEMENTS = 1 << 24
+
+
+def _cases(flow, dtype, top_k):
+    rng = np.random.default_rng(0)
+    for num_rows in ROW_COUNTS:
+        for row_length in ROW_LENGTHS:
+            if num_rows * row_length > MAX_ELEMENTS:
+                continue
+            if np.issubdtype(dtype, np.integer):
+                data = rng.integers(-(1 << 20), 1 << 20, size=(num_rows, row_length))
+            else:
+                data = rng.standard_normal((num_rows, row_length))
+            x = flow.tensor(data.astype(dtype))
+            k = min(top_k, row_length)
+            shape = f"{num_rows}x{row_length}"
+            yield f"sort {shape}", lambda x=x: flow.sort(x, dim=-1)[0]
+            yield f"arg_sort {shape}", lambda x=x: flow.argsort(x, dim=-1)
+            yield f"top_k {shape}", lambda x=x, k=k: flow.topk(x, k, dim=-1)[0]
+
+
+def _measure(args):
+    import oneflow as flow
+
+    flow.set_num_threads(args.num_threads)
+    results = {}
+    for name, fn in _cases(flow, np.dtype(args.dtype), args.k):
+        for _ in range(args.warmup):
+            fn().numpy()
+        start = time.perf_counter()
+        for _ in range(args.iters):
+            out = fn().numpy()
+        elapsed = (time.perf_counter() - start) / args.iters
+        results[name] = {"ms": elapsed * 1000, "checksum": float(np.abs(out).sum())}
+    return results
+
+
+def _run_subprocess(num_threads, args):
+    cmd = [
+        sys.executable,
+        os.path.abspath(__file__),
+        "--worker",
+        "--num-threads",
+        str(num_threads),
+        "--dtype",
+        args.dtype,
+        "--k",
+        str(args.k),
+        "--warmup",
+        str(args.warmup),
+        "--iters",
+        str(args.iters),
+    ]
+    return json.loads(subprocess.check_output(cmd).decode().strip().splitlines()[-1])
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--num-threads", type=int, default=os.cpu_count())
+    parser.add_argument(
+        "--dtype", default="float32", choices=["float32", "float64", "int32", "int64"]
+    )
+    parser.add_argument("--k", type=int, default=16, help="k of top_k")
+    parser.add_argument("--warmup", type=int, default=2)
+    parser.add_argument("--iters", type=int, default=5)
+    parser.add_argument("--worker", action="store_true", help=argparse.SUPPRESS)
+    args = parser.parse_args()
+
+    if args.worker:
+        print(json.dumps(_measure(args)))
+        return
+
+    sequential = _run_subprocess(1, args)
+    parallel = _run_subprocess(args.num_threads, args)
+    print(
+        "{:<28}{:>14}{:>14}{:>10}".format(
+            "case", "1 thread ms", f"{args.num_threads} threads ms", "speedup"
+        )
+    )
+    for name, seq in sequential.items():
+        par = parallel[name]
+        if not np.isclose(seq["checksum"], par["checksum"], rtol=1e-4):
+            print(f"{name}: results of 1 and {args.num_threads} threads differ")
+        print(
+            "{:<28}{:>14.3f}{:>14.3f}{:>9.2f}x".format(
+                name, seq["ms"], par["ms"], seq["ms"] / par["ms"]
+            )
+        )
+
+
+if __name__ == "__main__":
+    main()
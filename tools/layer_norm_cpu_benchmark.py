@@ -0,0 +1,89 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+# Measures forward+backward of nn.LayerNorm on CPU, which runs the layer_norm kernels,
+# against the same normalization composed of mean, var and elementwise ops.
+#
+#   python3 tools/layer_norm_cpu_benchmark.py --shapes 4096x768 8192x1024 64x32768
+
+import argparse
+import time
+
+import oneflow as flow
+
+
+def _composite_layer_norm(x, weight, bias, eps):
+    reduce_axis = list(range(x.ndim - weight.ndim, x.ndim))
+    mean = x.mean(dim=reduce_axis, keepdim=True)
+    variance = x.var(dim=reduce_axis, unbiased=False, keepdim=True)
+    return (x - mean) * (variance + eps).rsqrt() * weight + bias
+
+
+def _time_per_iter(fn, iters, warmup):
+    for _ in range(warmup):
+        fn()
+    start = time.perf_counter()
+    for _ in range(iters):
+        fn()
+    return (time.perf_counter() - start) / iters * 1000
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument(
+        "--shapes", nargs="+", default=["4096x768", "8192x1024", "64x32768"]
+    )
+    parser.add_argument("--iters", type=int, default=20)
+    parser.add_argument("--warmup", type=int, default=2)
+    parser.add_argument("--num-threads", type=int, default=None)
+    args = parser.parse_args()
+
+    if args.num_threads is not None:
+        flow.set_num_threads(args.num_threads)
+    print(
+        "{:<16}{:>12}{:>16}{:>10}".format(
+            "shape", "kernel ms", "composite ms", "speedup"
+        )
+    )
+    for shape in args.shapes:
+        num_rows, hidden_size = (int(dim) for dim in shape.split("x"))
+        x = flow.randn(num_rows, hidden_size, requires_grad=True)
+        m = flow.nn.LayerNorm(hidden_size)
+        dy = flow.randn(num_rows, hidden_size)
+
+        def forward_backward(layer_norm):
+            x.grad = None
+            m.zero_grad()
+            y = layer_norm(x)
+            y.backward(dy)
+            m.weight.grad.numpy()
+
+        kernel_ms = _time_per_iter(lambda: forward_backward(m), args.iters, args.warmup)
+        composite_ms = _time_per_iter(
+            lambda: forward_backward(
+                lambda x: _composite_layer_norm(x, m.weight, m.bias, m.eps)
+            ),
+            args.iters,
+            args.warmup,
+        )
+        print(
+            "{:<16}{:>12.3f}{:>16.3f}{:>9.2f}x".format(
+                shape, kernel_ms, composite_ms, composite_ms / kernel_ms
+            )
+        )
+
+
+if __name__ == "__main__":
+    main()
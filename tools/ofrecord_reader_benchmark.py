@@ -0,0 +1,101 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+# Measures the samples/s of flow.nn.OFRecordReader with one reader thread, the reader
+# before parallel reading, and with N reader threads. Without --data-dir, part files of
+# random records are written to a temporary directory first; put it on the disk to
+# measure with --tmp-dir. Drop the page cache between runs to measure cold reads.
+#
+#   python3 tools/ofrecord_reader_benchmark.py --num-reader-threads 8
+#   python3 tools/ofrecord_reader_benchmark.py --data-dir /path/to/ofrecord/train \
+#       --data-part-num 256 --part-name-suffix-length 5
+
+import argparse
+import os
+import struct
+import tempfile
+import time
+
+import numpy as np
+
+
+def _write_parts(data_dir, num_parts, records_per_part, record_bytes):
+    import oneflow.core.record.record_pb2 as record_pb2
+
+    rng = np.random.default_rng(0)
+    for part in range(num_parts):
+        with open(os.path.join(data_dir, "part-{}".format(part)), "wb") as f:
+            for _ in range(records_per_part):
+                record = record_pb2.OFRecord()
+                record.feature["encoded"].bytes_list.value.append(
+                    rng.bytes(record_bytes)
+                )
+                data = record.SerializeToString()
+                f.write(struct.pack("q", len(data)))
+                f.write(data)
+
+
+def _measure(args, data_dir, num_reader_threads):
+    import oneflow as flow
+
+    reader = flow.nn.OFRecordReader(
+        data_dir,
+        batch_size=args.batch_size,
+        data_part_num=args.data_part_num,
+        part_name_suffix_length=args.part_name_suffix_length,
+        num_reader_threads=num_reader_threads,
+        prefetch_buffer_size=args.prefetch_buffer_size,
+    )
+    for _ in range(args.warmup):
+        reader().numpy()
+    start = time.perf_counter()
+    for _ in range(args.iters):
+        reader().numpy()
+    elapsed = time.perf_counter() - start
+    return args.iters * args.batch_size / elapsed
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--num-reader-threads", type=int, default=8)
+    parser.add_argument("--prefetch-buffer-size", type=int, default=4)
+    parser.add_argument("--batch-size", type=int, default=256)
+    parser.add_argument("--data-dir", default=None)
+    parser.add_argument("--tmp-dir", default=None)
+    parser.add_argument("--data-part-num", type=int, default=32)
+    parser.add_argument("--part-name-suffix-length", type=int, default=-1)
+    parser.add_argument("--records-per-part", type=int, default=1024)
+    parser.add_argument("--record-bytes", type=int, default=64 * 1024)
+    parser.add_argument("--warmup", type=int, default=4)
+    parser.add_argument("--iters", type=int, default=64)
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory(dir=args.tmp_dir) as tmp_dir:
+        data_dir = args.data_dir
+        if data_dir is None:
+            data_dir = tmp_dir
+            _write_parts(
+                data_dir, args.data_part_num, args.records_per_part, args.record_bytes
+            )
+        sequential = _measure(args, data_dir, 1)
+        parallel = _measure(args, data_dir, args.num_reader_threads)
+    print("{:<24}{:>16}".format("reader threads", "samples/s"))
+    print("{:<24}{:>16.1f}".format(1, sequential))
+    print("{:<24}{:>16.1f}".format(args.num_reader_threads, parallel))
+    print("speedup {:.2f}x".format(parallel / sequential))
+
+
+if __name__ == "__main__":
+    main()
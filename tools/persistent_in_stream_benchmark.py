@@ -0,0 +1,155 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+# Compares the read throughput of flow.nn.OFRecordReader on the blocking
+# BinaryInStreamWithoutLocalCopy with the async readahead stream
+# (ONEFLOW_PERSISTENT_IN_STREAM_ASYNC_READ=1), with and without O_DIRECT. Every mode
+# runs in its own process since the stream is picked from the environment. Put the
+# data on the disk under test with --tmp-dir, and drop the page cache between modes with
+# --drop-caches (needs root) to measure cold reads.
+#
+#   python3 tools/persistent_in_stream_benchmark.py --tmp-dir /mnt/nvme --drop-caches
+
+import argparse
+import os
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+import numpy as np
+
+MODES = {
+    "sync": {},
+    "async": {"ONEFLOW_PERSISTENT_IN_STREAM_ASYNC_READ": "1"},
+    "async+direct": {
+        "ONEFLOW_PERSISTENT_IN_STREAM_ASYNC_READ": "1",
+        "ONEFLOW_PERSISTENT_IN_STREAM_DIRECT_IO": "1",
+    },
+}
+
+
+def _write_parts(data_dir, num_parts, records_per_part, record_bytes):
+    import oneflow.core.record.record_pb2 as record_pb2
+
+    rng = np.random.default_rng(0)
+    for part in range(num_parts):
+        with open(os.path.join(data_dir, "part-{}".format(part)), "wb") as f:
+            for _ in range(records_per_part):
+                record = record_pb2.OFRecord()
+                record.feature["encoded"].bytes_list.value.append(
+                    rng.bytes(record_bytes)
+                )
+                data = record.SerializeToString()
+                f.write(struct.pack("q", len(data)))
+                f.write(data)
+
+
+def _worker(args):
+    import oneflow as flow
+
+    reader = flow.nn.OFRecordReader(
+        args.data_dir,
+        batch_size=args.batch_size,
+        data_part_num=args.data_part_num,
+        part_name_suffix_length=args.part_name_suffix_length,
+        random_shuffle=False,
+        shuffle_after_epoch=False,
+    )
+    for _ in range(args.warmup):
+        reader().numpy()
+    start = time.perf_counter()
+    for _ in range(args.iters):
+        reader().numpy()
+    elapsed = time.perf_counter() - start
+    print(args.iters * args.batch_size / elapsed)
+
+
+def _measure(args, data_dir, mode):
+    if args.drop_caches:
+        subprocess.check_call(["sync"])
+        with open("/proc/sys/vm/drop_caches", "w") as f:
+            f.write("3")
+    env = dict(os.environ)
+    env.update(MODES[mode])
+    env["ONEFLOW_PERSISTENT_IN_STREAM_READAHEAD_CHUNK_SIZE_BYTES"] = str(
+        args.chunk_size
+    )
+    env["ONEFLOW_PERSISTENT_IN_STREAM_NUM_READAHEAD_CHUNKS"] = str(
+        args.num_readahead_chunks
+    )
+    cmd = [
+        sys.executable,
+        os.path.abspath(__file__),
+        "--worker",
+        "--data-dir",
+        data_dir,
+        "--data-part-num",
+        str(args.data_part_num),
+        "--part-name-suffix-length",
+        str(args.part_name_suffix_length),
+        "--batch-size",
+        str(args.batch_size),
+        "--warmup",
+        str(args.warmup),
+        "--iters",
+        str(args.iters),
+    ]
+    output = subprocess.check_output(cmd, env=env)
+    return float(output.decode().strip().splitlines()[-1])
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--worker", action="store_true")
+    parser.add_argument("--modes", default=",".join(MODES.keys()))
+    parser.add_argument("--chunk-size", type=int, default=512 * 1024)
+    parser.add_argument("--num-readahead-chunks", type=int, default=4)
+    parser.add_argument("--drop-caches", action="store_true")
+    parser.add_argument("--batch-size", type=int, default=256)
+    parser.add_argument("--data-dir", default=None)
+    parser.add_argument("--tmp-dir", default=None)
+    parser.add_argument("--data-part-num", type=int, default=8)
+    parser.add_argument("--part-name-suffix-length", type=int, default=-1)
+    parser.add_argument("--records-per-part", type=int, default=2048)
+    parser.add_argument("--record-bytes", type=int, default=64 * 1024)
+    parser.add_argument("--warmup", type=int, default=4)
+    parser.add_argument("--iters", type=int, default=64)
+    args = parser.parse_args()
+    if args.worker:
+        _worker(args)
+        return
+
+    results = []
+    with tempfile.TemporaryDirectory(dir=args.tmp_dir) as tmp_dir:
+        data_dir = args.data_dir
+        if data_dir is None:
+            data_dir = tmp_dir
+            _write_parts(
+                data_dir, args.data_part_num, args.records_per_part, args.record_bytes
+            )
+        for mode in args.modes.split(","):
+            results.append((mode, _measure(args, data_dir, mode)))
+    print("{:<24}{:>16}".format("stream", "samples/s"))
+    for mode, samples_per_second in results:
+        print("{:<24}{:>16.1f}".format(mode, samples_per_second))
+    if results[0][0] == "sync":
+        for mode, samples_per_second in results[1:]:
+            print("{} speedup {:.2f}x".format(mode, samples_per_second / results[0][1]))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,119 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+# Measures the per-step latency of nn.LSTMCell and nn.GRUCell on CPU, which run the fused cell
+# kernels, against the same cells composed of separate gate ops. Small batch sizes are the
+# interesting ones, where the elementwise ops around the two gate matmuls dominate a step.
+#
+#   python3 tools/rnn_cell_cpu_benchmark.py --hidden-size 256 --batch-sizes 1 4 16
+
+import argparse
+import time
+
+import numpy as np
+import oneflow as flow
+
+
+def _unfused_lstm_cell(cell, x, hx, cx):
+    gates = flow._C.matmul(x, cell.weight_ih, transpose_b=True) + flow._C.matmul(
+        hx, cell.weight_hh, transpose_b=True
+    )
+    if cell.bias_ih is not None:
+        gates = gates + cell.bias_ih + cell.bias_hh
+    ig, fg, cg, og = flow.chunk(gates, 4, dim=1)
+    cy = flow.sigmoid(fg) * cx + flow.sigmoid(ig) * flow.tanh(cg)
+    return flow.sigmoid(og) * flow.tanh(cy), cy
+
+
+def _unfused_gru_cell(cell, x, hx):
+    igates = flow._C.matmul(x, cell.weight_ih, transpose_b=True)
+    hgates = flow._C.matmul(hx, cell.weight_hh, transpose_b=True)
+    if cell.bias_ih is not None:
+        igates = igates + cell.bias_ih
+        hgates = hgates + cell.bias_hh
+    ir, ii, in_ = flow.chunk(igates, 3, dim=1)
+    hr, hi, hn = flow.chunk(hgates, 3, dim=1)
+    rg = flow.sigmoid(ir + hr)
+    ig = flow.sigmoid(ii + hi)
+    ng = flow.tanh(in_ + rg * hn)
+    return ng + ig * (hx - ng)
+
+
+def _time_per_step(step, steps, warmup):
+    for _ in range(warmup):
+        step()
+    start = time.perf_counter()
+    for _ in range(steps):
+        out = step()
+    out.numpy()
+    return (time.perf_counter() - start) / steps * 1e6
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--input-size", type=int, default=256)
+    parser.add_argument("--hidden-size", type=int, default=256)
+    parser.add_argument(
+        "--batch-sizes", type=int, nargs="+", default=[1, 2, 4, 8, 16, 32]
+    )
+    parser.add_argument("--steps", type=int, default=200)
+    parser.add_argument("--warmup", type=int, default=20)
+    parser.add_argument("--num-threads", type=int, default=None)
+    args = parser.parse_args()
+
+    if args.num_threads is not None:
+        flow.set_num_threads(args.num_threads)
+    lstm = flow.nn.LSTMCell(args.input_size, args.hidden_size)
+    gru = flow.nn.GRUCell(args.input_size, args.hidden_size)
+    print(
+        "{:<8}{:>8}{:>14}{:>14}{:>10}".format(
+            "cell", "batch", "fused us", "unfused us", "speedup"
+        )
+    )
+    with flow.no_grad():
+        for batch_size in args.batch_sizes:
+            rng = np.random.default_rng(batch_size)
+            x = flow.tensor(
+                rng.standard_normal((batch_size, args.input_size)).astype(np.float32)
+            )
+            hx = flow.tensor(
+                rng.standard_normal((batch_size, args.hidden_size)).astype(np.float32)
+            )
+            cx = flow.tensor(
+                rng.standard_normal((batch_size, args.hidden_size)).astype(np.float32)
+            )
+            cases = {
+                "lstm": (
+                    lambda: lstm(x, (hx, cx))[0],
+                    lambda: _unfused_lstm_cell(lstm, x, hx, cx)[0],
+                ),
+                "gru": (lambda: gru(x, hx), lambda: _unfused_gru_cell(gru, x, hx)),
+            }
+            for name, (fused, unfused) in cases.items():
+                if not np.allclose(
+                    fused().numpy(), unfused().numpy(), rtol=1e-4, atol=1e-5
+                ):
+                    print(f"{name}: fused and unfused results differ")
+                fused_us = _time_per_step(fused, args.steps, args.warmup)
+                unfused_us = _time_per_step(unfused, args.steps, args.warmup)
+                print(
+                    "{:<8}{:>8}{:>14.1f}{:>14.1f}{:>9.2f}x".format(
+                        name, batch_size, fused_us, unfused_us, unfused_us / fused_us
+                    )
+                )
+
+
+if __name__ == "__main__":
+    main()